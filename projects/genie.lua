@@ -18,6 +18,8 @@ local working_dir = nil
 local debug_args = nil
 local release_args = nil
 local plugins = {}
+-- plugins with LUMIX_ASSET_COMPILER_ENTRY
+local compiler_plugins = { "renderer", "lua_script", "animation" }
 local embed_resources = false
 build_studio_callbacks = {}
 build_app_callbacks = {}
@@ -612,10 +614,13 @@ if has_plugin("renderer") then
 			linkLib "cmft"
 		end
 		linkLib "freetype"
-		links { "opengl32" }
-		configuration { "linux-*" }
-			links { "GL", "X11" }
-		configuration {}
+		-- static builds link these in the executables which create the renderer, so the cooker does not need them
+		if not _OPTIONS["static-plugins"] then
+			links { "opengl32" }
+			configuration { "linux-*" }
+				links { "GL", "X11" }
+			configuration {}
+		end
 		useLua()
 		
 		configuration { "windows" }
@@ -897,7 +902,11 @@ if build_studio then
 				forceLink("setStudioApp_" .. plugin)
 				links { plugin }
 			end
-			
+			for _, plugin in ipairs(compiler_plugins) do
+				if has_plugin(plugin) then
+					forceLink("setAssetCompiler_" .. plugin)
+				end
+			end
 		
 
 			links { "editor", "engine" }
@@ -946,4 +955,56 @@ if build_studio then
 			copyDlls("release", "linux64", "Debug")
 			copyDlls("release", "linux64", "Release")
 		end
+
+	project "cooker"
+		kind "ConsoleApp"
+
+		if build_game then
+			debugdir ("../../" .. build_game)
+		elseif working_dir then
+			debugdir ("../../" .. working_dir)
+		else
+			debugdir "../data"
+		end
+
+		files { "../src/cooker/**.cpp" }
+		includedirs { "../src" }
+
+		if _OPTIONS["static-plugins"] then	
+			-- only asset compilers, engine plugins (renderer, physics, ...) are not created by the cooker
+			for _, plugin in ipairs(compiler_plugins) do
+				if has_plugin(plugin) then
+					forceLink("setAssetCompiler_" .. plugin)
+					links { plugin }
+				end
+			end
+
+			links { "editor", "engine" }
+			if has_plugin("renderer") then
+				linkLib "nvtt"
+			end
+			linkLib "luajit"
+			
+			configuration { "linux-*" }
+				links { "dl", "rt" }
+				linkoptions { "-Wl,-rpath '-Wl,$$ORIGIN'" }
+
+			configuration { "vs*" }
+				links { "psapi", "winmm" }
+			
+			configuration {}
+		else
+			links { "editor", "engine" }
+		end
+
+		for _, callback in ipairs(build_studio_callbacks) do
+			callback()
+		end
+		
+		configuration {"vs*"}
+			links { "winmm", "imm32", "version" }
+		configuration {}
+		
+		useLua()
+		defaultConfigurations()
 end
@@ -55,6 +55,7 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, float weig
 		{
 			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
 			if (!iter.isValid()) continue;
+			if (iter.value() >= pose.count) continue;
 			if (mask && mask->bones.find(bone.name) == mask->bones.end()) continue;
 
 			int idx = 1;
@@ -91,6 +92,7 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, float weig
 		{
 			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
 			if (!iter.isValid()) continue;
+			if (iter.value() >= pose.count) continue;
 			if (mask && mask->bones.find(bone.name) == mask->bones.end()) continue;
 
 			int model_bone_index = iter.value();
@@ -168,6 +170,7 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, BoneMask*
 		{
 			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
 			if (!iter.isValid()) continue;
+			if (iter.value() >= pose.count) continue;
 			if (mask && mask->bones.find(bone.name) == mask->bones.end()) continue;
 
 			int model_bone_index = iter.value();
@@ -212,6 +215,7 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, BoneMask*
 		{
 			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
 			if (!iter.isValid()) continue;
+			if (iter.value() >= pose.count) continue;
 			if (mask && mask->bones.find(bone.name) == mask->bones.end()) continue;
 
 			int model_bone_index = iter.value();
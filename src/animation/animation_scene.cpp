@@ -19,6 +19,7 @@
 #include "renderer/model.h"
 #include "renderer/pose.h"
 #include "renderer/render_scene.h"
+#include <float.h>
 
 
 namespace Lumix
@@ -42,6 +43,9 @@ static const ComponentType ANIMABLE_TYPE = Reflection::getComponentType("animabl
 static const ComponentType PROPERTY_ANIMATOR_TYPE = Reflection::getComponentType("property_animator");
 static const ComponentType CONTROLLER_TYPE = Reflection::getComponentType("anim_controller");
 static const ComponentType SHARED_CONTROLLER_TYPE = Reflection::getComponentType("shared_anim_controller");
+// squared ratio of the bounding radius to the distance from camera, below which the pose is evaluated less often
+static const float UPDATE_INTERVAL_SCREEN_SIZES[] = { 0.1f * 0.1f, 0.05f * 0.05f, 0.025f * 0.025f };
+static const u8 MAX_UPDATE_INTERVAL = lengthOf(UPDATE_INTERVAL_SCREEN_SIZES) + 1;
 
 
 struct AnimationSceneImpl final : public AnimationScene
@@ -54,9 +58,39 @@ struct AnimationSceneImpl final : public AnimationScene
 		EntityPtr parent;
 	};
 
+	// decided every frame on the main thread from the cameras, consumed by the update jobs
+	struct AnimationLOD
+	{
+		enum Mode : u8
+		{
+			EVALUATE,
+			TICK,
+			PAUSE
+		};
+
+		explicit AnimationLOD(IAllocator& allocator) : target(allocator) {}
+
+		Array<LocalRigidTransform> target; // last evaluated absolute pose, the pose is interpolated towards it
+		float time_delta = 0; // time of the skipped frames, applied at the next evaluation
+		i32 bones_count = 0;
+		i32 evaluated_bones_count = 0; // bones_count of the last evaluation
+		Mode mode = EVALUATE;
+		u8 interval = 1; // pose is evaluated every `interval` frames
+		u8 frames_left = 0; // frames until the next evaluation
+		bool snap = true; // do not interpolate from the current pose, it's stale
+	};
+
+
+	struct LODView
+	{
+		DVec3 pos;
+		float lod_multiplier;
+	};
+
+
 	struct Controller
 	{
-		explicit Controller(IAllocator& allocator) : input(allocator), animations(allocator) {}
+		explicit Controller(IAllocator& allocator) : input(allocator), animations(allocator), lod(allocator) {}
 
 		EntityRef entity;
 		Anim::ControllerResource* resource = nullptr;
@@ -74,6 +108,8 @@ struct AnimationSceneImpl final : public AnimationScene
 			u32 bones[MAX_BONES_COUNT];
 			Vec3 target;
 		} inverse_kinematics[4];
+
+		AnimationLOD lod;
 	};
 
 
@@ -108,11 +144,14 @@ struct AnimationSceneImpl final : public AnimationScene
 		, m_engine(engine)
 		, m_anim_system(anim_system)
 		, m_animables(allocator)
+		, m_animable_lods(allocator)
 		, m_property_animators(allocator)
 		, m_controllers(allocator)
 		, m_shared_controllers(allocator)
 		, m_event_stream(allocator)
 		, m_allocator(allocator)
+		, m_lod_views(allocator)
+		, m_pending_resources(allocator)
 	{
 		m_is_game_running = false;
 		m_render_scene = static_cast<RenderScene*>(universe.getScene(crc32("renderer")));
@@ -250,6 +289,7 @@ struct AnimationSceneImpl final : public AnimationScene
 			unloadResource(animable.animation);
 		}
 		m_animables.clear();
+		m_animable_lods.clear();
 
 		for (Controller& controller : m_controllers)
 		{
@@ -395,8 +435,7 @@ struct AnimationSceneImpl final : public AnimationScene
 	{
 		for (auto& controller : m_controllers)
 		{
-			LUMIX_DELETE(m_allocator, controller.root);
-			controller.root = nullptr;
+			destroyControllerRuntime(controller);
 		}
 		m_is_game_running = false;
 	}
@@ -422,8 +461,7 @@ struct AnimationSceneImpl final : public AnimationScene
 		}
 		if (controller.root != nullptr)
 		{
-			LUMIX_DELETE(m_engine.getAllocator(), controller.root);
-			controller.root = nullptr;
+			destroyControllerRuntime(controller);
 			controller.default_set = 0;
 			controller.animations.clear();
 			controller.input.clear();
@@ -442,8 +480,7 @@ struct AnimationSceneImpl final : public AnimationScene
 		{
 			if (controller.resource == &resource && controller.root != nullptr && new_state != Resource::State::READY)
 			{
-				LUMIX_DELETE(m_engine.getAllocator(), controller.root);
-				controller.root = nullptr;
+				destroyControllerRuntime(controller);
 				controller.default_set = 0;
 				controller.animations.clear();
 				controller.input.clear();
@@ -467,6 +504,7 @@ struct AnimationSceneImpl final : public AnimationScene
 		auto& animable = m_animables[entity];
 		unloadResource(animable.animation);
 		m_animables.erase(entity);
+		m_animable_lods.erase(entity);
 		m_universe.onComponentDestroyed(entity, ANIMABLE_TYPE, this);
 	}
 
@@ -541,7 +579,8 @@ struct AnimationSceneImpl final : public AnimationScene
 
 			char path[MAX_PATH_LENGTH];
 			serializer.readString(path, sizeof(path));
-			animable.animation = path[0] == '\0' ? nullptr : loadAnimation(Path(path));
+			animable.animation = nullptr;
+			if (path[0]) m_pending_resources.push({animable.entity, ANIMABLE_TYPE, Path(path)});
 			m_animables.insert(animable.entity, animable);
 			m_universe.onComponentCreated(animable.entity, ANIMABLE_TYPE, this);
 		}
@@ -558,7 +597,8 @@ struct AnimationSceneImpl final : public AnimationScene
 			serializer.readString(path, sizeof(path));
 			serializer.read(animator.flags.base);
 			animator.time = 0;
-			animator.animation = loadPropertyAnimation(Path(path));
+			animator.animation = nullptr;
+			if (path[0]) m_pending_resources.push({entity, PROPERTY_ANIMATOR_TYPE, Path(path)});
 			m_universe.onComponentCreated(entity, PROPERTY_ANIMATOR_TYPE, this);
 		}
 
@@ -572,7 +612,7 @@ struct AnimationSceneImpl final : public AnimationScene
 			serializer.read(controller.entity);
 			char tmp[MAX_PATH_LENGTH];
 			serializer.readString(tmp, lengthOf(tmp));
-			setControllerResource(controller, tmp[0] ? loadController(Path(tmp)) : nullptr);
+			if (tmp[0]) m_pending_resources.push({controller.entity, CONTROLLER_TYPE, Path(tmp)});
 			m_controllers.insert(controller.entity, Move(controller));
 			m_universe.onComponentCreated(controller.entity, CONTROLLER_TYPE, this);
 		}
@@ -590,6 +630,31 @@ struct AnimationSceneImpl final : public AnimationScene
 	}
 
 
+	// deserialize runs on a worker, the resource manager is not thread safe, so resources are loaded here
+	bool isDeserializeThreadSafe() const override { return true; }
+
+
+	void postDeserialize() override
+	{
+		for (const PendingResource& pending : m_pending_resources)
+		{
+			if (pending.type == ANIMABLE_TYPE)
+			{
+				m_animables[pending.entity].animation = loadAnimation(pending.path);
+			}
+			else if (pending.type == PROPERTY_ANIMATOR_TYPE)
+			{
+				m_property_animators.get(pending.entity).animation = loadPropertyAnimation(pending.path);
+			}
+			else
+			{
+				setControllerResource(m_controllers.get(pending.entity), loadController(pending.path));
+			}
+		}
+		m_pending_resources.clear();
+	}
+
+
 	void setSharedControllerParent(EntityRef entity, EntityRef parent) override
 	{
 		m_shared_controllers[entity].parent = parent;
@@ -667,6 +732,23 @@ struct AnimationSceneImpl final : public AnimationScene
 	}
 
 
+	static void tickAnimable(Animable& animable, float time_delta)
+	{
+		float t = animable.time + time_delta * animable.time_scale;
+		float l = animable.animation->getLength();
+		while (t > l) t -= l;
+		animable.time = t;
+	}
+
+
+	static void evaluateAnimable(const Animable& animable, Pose& pose, Model& model)
+	{
+		model.getRelativePose(pose);
+		animable.animation->getRelativePose(animable.time, pose, model, nullptr);
+		pose.computeAbsolute(model);
+	}
+
+
 	void updateAnimable(Animable& animable, float time_delta) const
 	{
 		if (!animable.animation || !animable.animation->isReady()) return;
@@ -679,14 +761,100 @@ struct AnimationSceneImpl final : public AnimationScene
 		Pose* pose = m_render_scene->lockPose(entity);
 		if (!pose) return;
 
-		model->getRelativePose(*pose);
-		animable.animation->getRelativePose(animable.time, *pose, *model, nullptr);
-		pose->computeAbsolute(*model);
+		evaluateAnimable(animable, *pose, *model);
+		tickAnimable(animable, time_delta);
 
-		float t = animable.time + time_delta * animable.time_scale;
-		float l = animable.animation->getLength();
-		while (t > l) t -= l;
-		animable.time = t;
+		m_render_scene->unlockPose(entity, true);
+	}
+
+
+	void updateAnimable(Animable& animable, AnimationLOD& lod, float time_delta) const
+	{
+		if (!animable.animation || !animable.animation->isReady()) return;
+
+		switch (lod.mode) {
+			case AnimationLOD::PAUSE: return;
+			case AnimationLOD::TICK: tickAnimable(animable, time_delta); return;
+			case AnimationLOD::EVALUATE: break;
+		}
+
+		if (lod.frames_left > 0) {
+			lod.time_delta += time_delta;
+			interpolatePose(lod, animable.entity);
+			return;
+		}
+
+		tickAnimable(animable, lod.time_delta);
+		lod.time_delta = 0;
+		evaluatePose(lod, animable.entity, [&](Pose& pose, Model& model){
+			evaluateAnimable(animable, pose, model);
+		});
+		tickAnimable(animable, time_delta);
+	}
+
+
+	// evaluates only the first lod.bones_count bones and, if the pose is updated less often than every frame,
+	// starts interpolating from the current pose to the new one; bones which were not evaluated
+	// the last time have stale poses, so they snap to the new pose
+	template <typename F>
+	void evaluatePose(AnimationLOD& lod, EntityRef entity, F&& evaluate) const
+	{
+		if (!m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) return;
+
+		Model* model = m_render_scene->getModelInstanceModel(entity);
+		if (!model || !model->isReady()) return;
+
+		Pose* pose = m_render_scene->lockPose(entity);
+		if (!pose) return;
+
+		const i32 count = pose->count;
+		const i32 bones_count = minimum(lod.bones_count, count);
+		const bool interpolate = lod.interval > 1 && !lod.snap;
+		const i32 interpolated_count = minimum(bones_count, lod.evaluated_bones_count);
+		LocalRigidTransform prev[Model::Bone::MAX_COUNT];
+		if (interpolate) {
+			for (int i = 0; i < interpolated_count; ++i) {
+				prev[i] = {pose->positions[i], pose->rotations[i]};
+			}
+		}
+
+		pose->count = bones_count;
+		evaluate(*pose, *model);
+		pose->count = count;
+
+		if (lod.interval > 1) {
+			lod.target.resize(bones_count);
+			for (int i = 0; i < bones_count; ++i) {
+				lod.target[i] = {pose->positions[i], pose->rotations[i]};
+			}
+		}
+		if (interpolate) {
+			const float t = 1.0f / lod.interval;
+			for (int i = 0; i < interpolated_count; ++i) {
+				lerp(prev[i].pos, lod.target[i].pos, &pose->positions[i], t);
+				nlerp(prev[i].rot, lod.target[i].rot, &pose->rotations[i], t);
+			}
+		}
+		lod.frames_left = lod.interval - 1;
+		lod.snap = false;
+		lod.evaluated_bones_count = bones_count;
+
+		m_render_scene->unlockPose(entity, true);
+	}
+
+
+	void interpolatePose(AnimationLOD& lod, EntityRef entity) const
+	{
+		const float t = 1.0f / lod.frames_left;
+		--lod.frames_left;
+
+		Pose* pose = m_render_scene->lockPose(entity);
+		if (!pose) return;
+
+		for (int i = 0, c = minimum(lod.target.size(), pose->count); i < c; ++i) {
+			lerp(pose->positions[i], lod.target[i].pos, &pose->positions[i], t);
+			nlerp(pose->rotations[i], lod.target[i].rot, &pose->rotations[i], t);
+		}
 
 		m_render_scene->unlockPose(entity, true);
 	}
@@ -804,12 +972,22 @@ struct AnimationSceneImpl final : public AnimationScene
 	}
 
 
+	// runtime instances live in the resource's pool, so they must be destroyed before the resource changes
+	void destroyControllerRuntime(Controller& controller)
+	{
+		if (!controller.root) return;
+
+		LUMIX_DELETE(controller.resource->getInstancePool(), controller.root);
+		controller.root = nullptr;
+	}
+
+
 	bool initControllerRuntime(Controller& controller)
 	{
 		if (!controller.resource) return false;
 		if (!controller.resource->isReady()) return false;
 		if (controller.resource->m_input_decl.getSize() == 0) return false;
-		controller.root = controller.resource->createInstance(m_allocator);
+		controller.root = controller.resource->createInstance(controller.resource->getInstancePool());
 		controller.input.resize(controller.resource->m_input_decl.getSize());
 		int set_idx = 0;
 		for (int i = 0; i < controller.resource->m_sets_names.size(); ++i)
@@ -828,7 +1006,7 @@ struct AnimationSceneImpl final : public AnimationScene
 		setMemory(&controller.input[0], 0, controller.input.size());
 		Anim::RunningContext rc;
 		rc.time_delta = 0;
-		rc.allocator = &m_allocator;
+		rc.allocator = &controller.resource->getInstancePool();
 		rc.input = &controller.input[0];
 		rc.current = nullptr;
 		rc.anim_set = &controller.animations;
@@ -867,26 +1045,49 @@ struct AnimationSceneImpl final : public AnimationScene
 	}
 
 
-	void updateController(Controller& controller, float time_delta)
+	bool tickController(Controller& controller, float time_delta)
 	{
 		if (!controller.resource || !controller.resource->isReady())
 		{
-			LUMIX_DELETE(m_allocator, controller.root);
-			controller.root = nullptr;
-			return;
+			destroyControllerRuntime(controller);
+			return false;
 		}
 
-		if (!controller.root && !initControllerRuntime(controller)) return;
+		if (!controller.root && !initControllerRuntime(controller)) return false;
 
 		Anim::RunningContext rc;
 		rc.time_delta = time_delta;
 		rc.current = controller.root;
-		rc.allocator = &m_allocator;
+		rc.allocator = &controller.resource->getInstancePool();
 		rc.input = &controller.input[0];
 		rc.anim_set = &controller.animations;
 		rc.event_stream = &m_event_stream;
 		rc.controller = {controller.entity.index};
 		controller.root = controller.root->update(rc, true);
+		return true;
+	}
+
+
+	void evaluateController(Controller& controller, Pose& pose, Model& model) const
+	{
+		model.getRelativePose(pose);
+
+		controller.root->fillPose(m_engine, pose, model, 1, nullptr);
+
+		for (Controller::IK& ik : controller.inverse_kinematics)
+		{
+			if (ik.weight == 0) break;
+
+			updateIK(ik, pose, model);
+		}
+
+		pose.computeAbsolute(model);
+	}
+
+
+	void updateController(Controller& controller, float time_delta)
+	{
+		if (!tickController(controller, time_delta)) return;
 
 		EntityRef entity = controller.entity;
 		if (!m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) return;
@@ -897,19 +1098,31 @@ struct AnimationSceneImpl final : public AnimationScene
 		Pose* pose = m_render_scene->lockPose(entity);
 		if (!pose) return;
 
-		model->getRelativePose(*pose);
+		evaluateController(controller, *pose, *model);
+		m_render_scene->unlockPose(entity, true);
+	}
 
-		controller.root->fillPose(m_engine, *pose, *model, 1, nullptr);
 
-		for (Controller::IK& ik : controller.inverse_kinematics)
-		{
-			if (ik.weight == 0) break;
+	void updateControllerLOD(Controller& controller, float time_delta)
+	{
+		AnimationLOD& lod = controller.lod;
+		switch (lod.mode) {
+			case AnimationLOD::PAUSE: return;
+			case AnimationLOD::TICK: tickController(controller, time_delta); return;
+			case AnimationLOD::EVALUATE: break;
+		}
 
-			updateIK(ik, *pose, *model);
+		if (lod.frames_left > 0) {
+			lod.time_delta += time_delta;
+			interpolatePose(lod, controller.entity);
+			return;
 		}
 
-		pose->computeAbsolute(*model);
-		m_render_scene->unlockPose(entity, true);
+		if (!tickController(controller, lod.time_delta + time_delta)) return;
+		lod.time_delta = 0;
+		evaluatePose(lod, controller.entity, [&](Pose& pose, Model& model){
+			evaluateController(controller, pose, model);
+		});
 	}
 
 	static LocalRigidTransform getAbsolutePosition(const Pose& pose, const Model& model, int bone_index)
@@ -935,6 +1148,8 @@ struct AnimationSceneImpl final : public AnimationScene
 		for (int i = 0; i < ik.bones_count; ++i) {
 			auto iter = model.getBoneIndex(ik.bones[i]);
 			if (!iter.isValid()) return;
+			// not evaluated in the current LOD
+			if (iter.value() >= pose.count) return;
 
 			indices[i] = iter.value();
 		}
@@ -1068,11 +1283,109 @@ struct AnimationSceneImpl final : public AnimationScene
 
 		JobSystem::forEach(m_animables.size(), [&](int idx){
 			Animable& animable = m_animables.at(idx);
-			AnimationSceneImpl::updateAnimable(animable, time_delta);
+			AnimationLOD& lod = m_animable_lods.get(animable.entity);
+			AnimationSceneImpl::updateAnimable(animable, lod, time_delta);
 		});
 	}
 
 
+	void setCulledUpdatePolicy(CulledUpdatePolicy policy) override { m_culled_update_policy = policy; }
+	CulledUpdatePolicy getCulledUpdatePolicy() const override { return m_culled_update_policy; }
+
+
+	// visibility comes from the active camera, update rate and evaluated bones from the nearest camera,
+	// so a model is never skinned with fewer bones than any view needs
+	void updateLOD(AnimationLOD& lod, EntityRef entity, const ShiftedFrustum* frustum, i32* evaluated, i32* skipped)
+	{
+		if (!m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) return;
+
+		Model* model = m_render_scene->getModelInstanceModel(entity);
+		if (!model || !model->isReady()) return;
+
+		const i32 model_bones_count = model->getBoneCount();
+		if (!frustum) {
+			lod.mode = AnimationLOD::EVALUATE;
+			lod.interval = 1;
+			lod.frames_left = 0;
+			lod.bones_count = model_bones_count;
+			*evaluated += model_bones_count;
+			return;
+		}
+
+		const Transform tr = m_universe.getTransform(entity);
+		const float radius = model->getBoundingRadius() * tr.scale;
+		float squared_distance = FLT_MAX;
+		for (const LODView& view : m_lod_views) {
+			squared_distance = minimum(squared_distance, float((tr.pos - view.pos).squaredLength()) * view.lod_multiplier);
+		}
+		const bool visible = frustum->intersectsAABB(tr.pos - Vec3(radius), Vec3(2 * radius));
+
+		u8 interval = 1;
+		const float screen_size = radius * radius / maximum(squared_distance, 0.0001f);
+		while (interval < MAX_UPDATE_INTERVAL && screen_size < UPDATE_INTERVAL_SCREEN_SIZES[interval - 1]) ++interval;
+
+		lod.mode = AnimationLOD::EVALUATE;
+		if (!visible) {
+			switch (m_culled_update_policy) {
+				case CulledUpdatePolicy::ALWAYS: interval = MAX_UPDATE_INTERVAL; break;
+				case CulledUpdatePolicy::TICK_ONLY: lod.mode = AnimationLOD::TICK; break;
+				case CulledUpdatePolicy::PAUSE: lod.mode = AnimationLOD::PAUSE; break;
+			}
+		}
+
+		// attachments are updated from the pose, so their bones must not freeze
+		lod.bones_count = model->getLODBonesCount(squared_distance);
+		if (lod.bones_count < model_bones_count) {
+			lod.bones_count = minimum(maximum(lod.bones_count, m_render_scene->getAttachedBonesCount(entity)), model_bones_count);
+		}
+		if (lod.bones_count == 0 && lod.mode == AnimationLOD::EVALUATE) lod.mode = AnimationLOD::TICK;
+
+		if (lod.mode != AnimationLOD::EVALUATE) {
+			// the pose is stale once visible again
+			lod.snap = true;
+			lod.frames_left = 0;
+			lod.time_delta = 0;
+		}
+		lod.interval = interval;
+		lod.frames_left = minimum(lod.frames_left, u8(interval - 1));
+
+		const bool evaluate = lod.mode == AnimationLOD::EVALUATE && lod.frames_left == 0;
+		*evaluated += evaluate ? lod.bones_count : 0;
+		*skipped += evaluate ? model_bones_count - lod.bones_count : model_bones_count;
+	}
+
+
+	void updateLODs()
+	{
+		PROFILE_FUNCTION();
+		const EntityPtr camera = m_render_scene->getActiveCamera();
+		ShiftedFrustum frustum;
+		if (camera.isValid()) frustum = m_render_scene->getCameraFrustum((EntityRef)camera);
+		const ShiftedFrustum* frustum_ptr = camera.isValid() ? &frustum : nullptr;
+
+		m_lod_views.clear();
+		for (EntityPtr e = m_render_scene->getFirstCamera(); e.isValid(); e = m_render_scene->getNextCamera((EntityRef)e)) {
+			LODView& view = m_lod_views.emplace();
+			view.pos = m_universe.getPosition((EntityRef)e);
+			view.lod_multiplier = m_render_scene->getCameraLODMultiplier((EntityRef)e);
+		}
+
+		i32 evaluated = 0;
+		i32 skipped = 0;
+		for (const Animable& animable : m_animables) {
+			const int idx = m_animable_lods.find(animable.entity);
+			AnimationLOD& lod = idx < 0 ? m_animable_lods.emplace(animable.entity, m_allocator) : m_animable_lods.at(idx);
+			updateLOD(lod, animable.entity, frustum_ptr, &evaluated, &skipped);
+		}
+		for (Controller& controller : m_controllers) {
+			updateLOD(controller.lod, controller.entity, frustum_ptr, &evaluated, &skipped);
+		}
+
+		Profiler::pushInt("Evaluated bones", evaluated);
+		Profiler::pushInt("Skipped bones", skipped);
+	}
+
+
 	void update(float time_delta, bool paused) override
 	{
 		PROFILE_FUNCTION();
@@ -1081,12 +1394,13 @@ struct AnimationSceneImpl final : public AnimationScene
 
 		m_event_stream.clear();
 
+		updateLODs();
 		updateAnimables(time_delta);
 		updatePropertyAnimators(time_delta);
 
 		for (Controller& controller : m_controllers)
 		{
-			AnimationSceneImpl::updateController(controller, time_delta);
+			AnimationSceneImpl::updateControllerLOD(controller, time_delta);
 		}
 
 		for (SharedController& controller : m_shared_controllers)
@@ -1101,7 +1415,7 @@ struct AnimationSceneImpl final : public AnimationScene
 	void processEventStream()
 	{
 		InputMemoryStream blob(m_event_stream);
-		u32 set_input_type = crc32("set_input");
+		static constexpr u32 set_input_type = crc32Const("set_input");
 		while (blob.getPosition() < blob.size())
 		{
 			u32 type;
@@ -1205,12 +1519,24 @@ struct AnimationSceneImpl final : public AnimationScene
 	IPlugin& m_anim_system;
 	Engine& m_engine;
 	AssociativeArray<EntityRef, Animable> m_animables;
+	AssociativeArray<EntityRef, AnimationLOD> m_animable_lods;
 	AssociativeArray<EntityRef, PropertyAnimator> m_property_animators;
 	AssociativeArray<EntityRef, Controller> m_controllers;
 	AssociativeArray<EntityRef, SharedController> m_shared_controllers;
 	RenderScene* m_render_scene;
 	bool m_is_game_running;
+	CulledUpdatePolicy m_culled_update_policy = CulledUpdatePolicy::TICK_ONLY;
+	Array<LODView> m_lod_views;
 	OutputMemoryStream m_event_stream;
+
+	struct PendingResource
+	{
+		EntityRef entity;
+		ComponentType type;
+		Path path;
+	};
+	// resources referenced by deserialized components, loaded in postDeserialize
+	Array<PendingResource> m_pending_resources;
 };
 
 
@@ -33,6 +33,15 @@ struct Animable
 };
 
 
+// what happens with animables and controllers outside of the active camera's frustum
+enum class CulledUpdatePolicy : u8
+{
+	ALWAYS, // evaluated like visible ones, at the lowest update rate
+	TICK_ONLY, // time and state machines advance, pose is not evaluated
+	PAUSE // nothing is updated until it's visible again
+};
+
+
 struct AnimationScene : public IScene
 {
 	static AnimationScene* create(Engine& engine, IPlugin& plugin, Universe& universe, IAllocator& allocator);
@@ -66,6 +75,8 @@ struct AnimationScene : public IScene
 	virtual int getControllerDefaultSet(EntityRef entity) = 0;
 	virtual Anim::ControllerResource* getControllerResource(EntityRef entity) = 0;
 	virtual float getAnimationLength(int animation_idx) = 0;
+	virtual void setCulledUpdatePolicy(CulledUpdatePolicy policy) = 0;
+	virtual CulledUpdatePolicy getCulledUpdatePolicy() const = 0;
 };
 
 
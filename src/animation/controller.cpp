@@ -25,6 +25,72 @@ struct Header
 const ResourceType ControllerResource::TYPE("anim_controller");
 
 
+InstancePool::InstancePool(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_chunks(allocator)
+	, m_free_slots(nullptr)
+	, m_used_slots(0)
+{
+}
+
+
+InstancePool::~InstancePool()
+{
+	ASSERT(m_used_slots == 0);
+	for (u8* chunk : m_chunks)
+	{
+		m_allocator.deallocate_aligned(chunk);
+	}
+}
+
+
+void* InstancePool::allocate_aligned(size_t size, size_t align)
+{
+	ASSERT(size <= SLOT_SIZE && align <= 16);
+	MT::CriticalSectionLock lock(m_mutex);
+	if (!m_free_slots)
+	{
+		u8* chunk = (u8*)m_allocator.allocate_aligned(SLOT_SIZE * SLOTS_PER_CHUNK, 16);
+		m_chunks.push(chunk);
+		for (int i = SLOTS_PER_CHUNK - 1; i >= 0; --i)
+		{
+			FreeSlot* slot = (FreeSlot*)(chunk + i * SLOT_SIZE);
+			slot->next = m_free_slots;
+			m_free_slots = slot;
+		}
+	}
+	FreeSlot* slot = m_free_slots;
+	m_free_slots = slot->next;
+	++m_used_slots;
+	return slot;
+}
+
+
+void InstancePool::deallocate_aligned(void* ptr)
+{
+	if (!ptr) return;
+
+	MT::CriticalSectionLock lock(m_mutex);
+	FreeSlot* slot = (FreeSlot*)ptr;
+	slot->next = m_free_slots;
+	m_free_slots = slot;
+	--m_used_slots;
+}
+
+
+void* InstancePool::reallocate_aligned(void* ptr, size_t size, size_t align)
+{
+	if (!ptr) return allocate_aligned(size, align);
+	if (size == 0)
+	{
+		deallocate_aligned(ptr);
+		return nullptr;
+	}
+	ASSERT(size <= SLOT_SIZE);
+	return ptr;
+}
+
+
 ControllerResource::ControllerResource(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
 	, m_root(nullptr)
@@ -32,6 +98,7 @@ ControllerResource::ControllerResource(const Path& path, ResourceManager& resour
 	, m_animation_set(allocator)
 	, m_sets_names(allocator)
 	, m_masks(allocator)
+	, m_instance_pool(allocator)
 {
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include "engine/mt/sync.h"
 #include "engine/resource.h"
 #include "state_machine.h"
 
@@ -13,6 +14,40 @@ namespace Anim
 {
 
 
+// runtime instances (ComponentInstance) of all controllers using one ControllerResource,
+// they are created and destroyed on every transition, so they are kept in fixed size slots
+// of a few contiguous chunks instead of going through the general allocator;
+// only the allocation is pooled, instances are still a tree evaluated through virtual calls
+class InstancePool final : public IAllocator
+{
+public:
+	enum { SLOT_SIZE = 320, SLOTS_PER_CHUNK = 64 };
+
+	explicit InstancePool(IAllocator& allocator);
+	~InstancePool();
+
+	void* allocate_aligned(size_t size, size_t align) override;
+	void deallocate_aligned(void* ptr) override;
+	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+	void* allocate(size_t size) override { return allocate_aligned(size, 8); }
+	void deallocate(void* ptr) override { deallocate_aligned(ptr); }
+	void* reallocate(void* ptr, size_t size) override { return reallocate_aligned(ptr, size, 8); }
+
+private:
+	struct FreeSlot
+	{
+		FreeSlot* next;
+	};
+
+	IAllocator& m_allocator;
+	Array<u8*> m_chunks;
+	FreeSlot* m_free_slots;
+	int m_used_slots;
+	// controllers are updated on multiple threads
+	MT::CriticalSection m_mutex;
+};
+
+
 class ControllerResource : public Resource
 {
 public:
@@ -44,6 +79,7 @@ public:
 	void serialize(OutputMemoryStream& blob);
 	bool deserialize(InputMemoryStream& blob, int& version);
 	IAllocator& getAllocator() const { return m_allocator; }
+	IAllocator& getInstancePool() { return m_instance_pool; }
 	void addAnimation(int set, u32 hash, Animation* animation);
 
 	struct AnimSetEntry
@@ -65,6 +101,7 @@ private:
 	void clearAnimationSets();
 
 	IAllocator& m_allocator;
+	InstancePool m_instance_pool;
 };
 
 
@@ -0,0 +1,73 @@
+#include "editor/asset_compiler.h"
+#include "editor/studio_app.h"
+#include "editor/world_editor.h"
+
+
+// does not reference animation's runtime, so the cooker can link it on its own
+using namespace Lumix;
+
+
+namespace
+{
+
+
+static const ResourceType ANIM_CONTROLLER_TYPE("anim_controller");
+
+
+struct ControllerCompiler final : AssetCompiler::IPlugin
+{
+	explicit ControllerCompiler(StudioApp& app)
+		: m_app(app)
+	{}
+
+	bool compile(const Path& src) override
+	{
+		return m_app.getAssetCompiler().copyCompile(src);
+	}
+
+	bool isThreadSafe() const override { return true; }
+
+	StudioApp& m_app;
+};
+
+
+struct CompilersPlugin : StudioApp::IPlugin
+{
+	explicit CompilersPlugin(StudioApp& app)
+		: m_app(app)
+		, m_controller_compiler(app)
+	{
+	}
+
+
+	const char* getName() const override { return "animation_compilers"; }
+
+
+	void init() override
+	{
+		AssetCompiler& asset_compiler = m_app.getAssetCompiler();
+		asset_compiler.registerExtension("act", ANIM_CONTROLLER_TYPE);
+		const char* exts[] = { "act", nullptr };
+		asset_compiler.addPlugin(m_controller_compiler, exts);
+	}
+
+
+	~CompilersPlugin()
+	{
+		m_app.getAssetCompiler().removePlugin(m_controller_compiler);
+	}
+
+
+	StudioApp& m_app;
+	ControllerCompiler m_controller_compiler;
+};
+
+
+} // anonymous namespace
+
+
+LUMIX_ASSET_COMPILER_ENTRY(animation)
+{
+	IAllocator& allocator = app.getWorldEditor().getAllocator();
+	return LUMIX_NEW(allocator, CompilersPlugin)(app);
+}
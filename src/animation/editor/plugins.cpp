@@ -277,16 +277,11 @@ struct PropertyAnimationAssetBrowserPlugin : AssetBrowser::IPlugin
 };
 
 
-struct AnimControllerAssetBrowserPlugin : AssetBrowser::IPlugin, AssetCompiler::IPlugin
+struct AnimControllerAssetBrowserPlugin : AssetBrowser::IPlugin
 {
 	explicit AnimControllerAssetBrowserPlugin(StudioApp& app)
 		: m_app(app)
 	{
-		app.getAssetCompiler().registerExtension("act", Anim::ControllerResource::TYPE);
-	}
-
-	bool compile(const Path& src) {
-		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
 	void onGUI(Span<Resource*> resources) override {}
@@ -396,9 +391,6 @@ struct StudioAppPlugin : StudioApp::IPlugin
 		m_animtion_plugin = LUMIX_NEW(allocator, AnimationAssetBrowserPlugin)(m_app);
 		m_prop_anim_plugin = LUMIX_NEW(allocator, PropertyAnimationAssetBrowserPlugin)(m_app);
 		m_anim_ctrl_plugin = LUMIX_NEW(allocator, AnimControllerAssetBrowserPlugin)(m_app);
-		
-		const char* act_exts[] = { "act", nullptr };
-		m_app.getAssetCompiler().addPlugin(*m_anim_ctrl_plugin, act_exts);
 
 		AssetBrowser& asset_browser = m_app.getAssetBrowser();
 		asset_browser.addPlugin(*m_animtion_plugin);
@@ -415,8 +407,6 @@ struct StudioAppPlugin : StudioApp::IPlugin
 
 	~StudioAppPlugin()
 	{
-		m_app.getAssetCompiler().removePlugin(*m_anim_ctrl_plugin);
-
 		AssetBrowser& asset_browser = m_app.getAssetBrowser();
 		asset_browser.removePlugin(*m_animtion_plugin);
 		asset_browser.removePlugin(*m_prop_anim_plugin);
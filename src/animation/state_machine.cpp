@@ -245,6 +245,15 @@ Blend1DNodeInstance::Blend1DNodeInstance(Blend1DNode& _node)
 }
 
 
+Blend1DNodeInstance::~Blend1DNodeInstance()
+{
+	for (int i = 0; i < instances_count; ++i)
+	{
+		LUMIX_DELETE(*allocator, instances[i]);
+	}
+}
+
+
 void Blend1DNodeInstance::fillPose(Engine& engine, Pose& pose, Model& model, float weight, BoneMask* mask)
 {
 	if (!a0 || !a1) return;
@@ -318,10 +327,12 @@ void Blend1DNodeInstance::enter(RunningContext& rc, ComponentInstance* from)
 	{
 		logError("Animation") << "Too many nodes in Blend1D, only " << lengthOf(instances) << " are used.";
 	}
+	allocator = rc.allocator;
 	for (int i = 0; i < node.items.size() && i < lengthOf(instances); ++i)
 	{
 		instances[i] = (NodeInstance*)node.items[i].node->createInstance(*rc.allocator);
 		instances[i]->enter(rc, nullptr);
+		++instances_count;
 	}
 }
 
@@ -345,6 +356,15 @@ LayersNodeInstance::LayersNodeInstance(LayersNode& _node)
 }
 
 
+LayersNodeInstance::~LayersNodeInstance()
+{
+	for (int i = 0; i < layers_count; ++i)
+	{
+		LUMIX_DELETE(*allocator, layers[i]);
+	}
+}
+
+
 LocalRigidTransform LayersNodeInstance::getRootMotion() const
 {
 	if (layers_count == 0) return {{0, 0, 0}, {0, 0, 0, 1}};
@@ -396,6 +416,7 @@ void LayersNodeInstance::enter(RunningContext& rc, ComponentInstance* from)
 	{
 		logError("Animation") << "Too many layers in LayerNode, only " << lengthOf(layers) << " are used.";
 	}
+	allocator = rc.allocator;
 	for (int i = 0; i < node.children.size() && i < lengthOf(layers); ++i)
 	{
 		++layers_count;
@@ -751,6 +772,13 @@ struct AnimationNodeInstance : public NodeInstance
 };
 
 
+static_assert(sizeof(EdgeInstance) <= InstancePool::SLOT_SIZE, "Instance does not fit into InstancePool slot");
+static_assert(sizeof(AnimationNodeInstance) <= InstancePool::SLOT_SIZE, "Instance does not fit into InstancePool slot");
+static_assert(sizeof(Blend1DNodeInstance) <= InstancePool::SLOT_SIZE, "Instance does not fit into InstancePool slot");
+static_assert(sizeof(LayersNodeInstance) <= InstancePool::SLOT_SIZE, "Instance does not fit into InstancePool slot");
+static_assert(sizeof(StateMachineInstance) <= InstancePool::SLOT_SIZE, "Instance does not fit into InstancePool slot");
+
+
 ComponentInstance* AnimationNode::createInstance(IAllocator& allocator)
 {
 	return LUMIX_NEW(allocator, AnimationNodeInstance)(*this);
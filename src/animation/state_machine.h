@@ -160,6 +160,7 @@ struct AnimationNode : public Node
 struct Blend1DNodeInstance : public NodeInstance
 {
 	explicit Blend1DNodeInstance(Blend1DNode& _node);
+	~Blend1DNodeInstance();
 
 	LocalRigidTransform getRootMotion() const override;
 	float getTime() const override { return time; }
@@ -174,6 +175,8 @@ struct Blend1DNodeInstance : public NodeInstance
 	NodeInstance* a1 = nullptr;
 	float current_weight = 1;
 	NodeInstance* instances[16];
+	int instances_count = 0;
+	IAllocator* allocator = nullptr;
 	Blend1DNode& node;
 	float time;
 };
@@ -200,6 +203,7 @@ struct Blend1DNode : public Container
 struct LayersNodeInstance : public NodeInstance
 {
 	explicit LayersNodeInstance(LayersNode& _node);
+	~LayersNodeInstance();
 
 	LocalRigidTransform getRootMotion() const override;
 	float getTime() const override;
@@ -212,6 +216,7 @@ struct LayersNodeInstance : public NodeInstance
 	NodeInstance* layers[16];
 	struct BoneMask* masks[16];
 	int layers_count = 0;
+	IAllocator* allocator = nullptr;
 	LayersNode& node;
 	float time;
 };
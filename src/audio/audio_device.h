@@ -38,13 +38,34 @@ public:
 	typedef int BufferHandle;
 	static const BufferHandle INVALID_BUFFER_HANDLE = -1;
 
+	// keeps data of a buffer alive, the device releases it once it does not read the data anymore,
+	// which can be later than stop() and on another thread
+	struct IDataOwner
+	{
+		virtual ~IDataOwner() {}
+		virtual void release() = 0;
+	};
+
+	// source of 16bit interleaved samples decoded while the buffer plays
+	struct IStream
+	{
+		virtual ~IStream() {}
+		// returns number of frames written to output, less than requested at the end of the stream
+		virtual u32 read(i16* output, u32 frames) = 0;
+		virtual void seek(u32 frame) = 0;
+		virtual void destroy() = 0;
+	};
+
 public:
 	virtual ~AudioDevice() {}
 
 	static AudioDevice* create(Engine& engine);
 	static void destroy(AudioDevice& device);
 
-	virtual BufferHandle createBuffer(const void* data, int size_bytes, int channels, int sample_rate, int flags) = 0;
+	// owner (optional) is released when the data is not needed anymore or the buffer can not be created
+	virtual BufferHandle createBuffer(const void* data, int size_bytes, int channels, int sample_rate, int flags, IDataOwner* owner) = 0;
+	// device takes ownership of the stream and destroys it when the buffer is stopped or can not be created
+	virtual BufferHandle createStreamBuffer(IStream& stream, u32 frames, int channels, int sample_rate, int flags) = 0;
 	virtual void setEcho(BufferHandle handle,
 		float wet_dry_mix,
 		float feedback,
@@ -118,7 +118,7 @@ struct AudioSceneImpl final : public AudioScene
 	}
 
 
-	void deserialize(IDeserializer& serializer) override
+	void deserialize(IDeserializer& serializer, int version) override
 	{
 		int count;
 		serializer.read(Ref(count));
@@ -680,8 +680,7 @@ struct AudioSceneImpl final : public AudioScene
 				if (!clip->isReady()) return -1;
 
 				int flags = is_3d ? (int)AudioDevice::BufferFlags::IS3D : 0;
-				auto buffer = m_device.createBuffer(
-					clip->getData(), clip->getSize(), clip->getChannels(), clip->getSampleRate(), flags);
+				auto buffer = clip->createBuffer(m_device, flags);
 				if (buffer == AudioDevice::INVALID_BUFFER_HANDLE) return -1;
 				m_device.play(buffer, clip_info->looped);
 				m_device.setVolume(buffer, clip_info->volume);
@@ -1,6 +1,7 @@
 #include "clip.h"
 #include "engine/allocator.h"
 #include "engine/lumix.h"
+#include "engine/mt/atomic.h"
 #include "engine/profiler.h"
 #include "engine/resource.h"
 #include "engine/string.h"
@@ -16,22 +17,111 @@ namespace Lumix
 const ResourceType Clip::TYPE("clip");
 
 
+void Clip::Data::addRef()
+{
+	MT::atomicIncrement(&refs);
+}
+
+
+void Clip::Data::release()
+{
+	if (MT::atomicDecrement(&refs) == 0) LUMIX_DELETE(allocator, this);
+}
+
+
+// vorbis decoder reads compressed data, so the stream holds a reference to it
+struct ClipStream final : AudioDevice::IStream
+{
+	ClipStream(stb_vorbis* vorbis, Clip::Data& data, int channels, IAllocator& allocator)
+		: m_vorbis(vorbis)
+		, m_data(data)
+		, m_channels(channels)
+		, m_allocator(allocator)
+	{
+		m_data.addRef();
+	}
+
+	u32 read(i16* output, u32 frames) override
+	{
+		PROFILE_FUNCTION();
+		return (u32)stb_vorbis_get_samples_short_interleaved(m_vorbis, m_channels, output, int(frames * m_channels));
+	}
+
+	void seek(u32 frame) override { stb_vorbis_seek(m_vorbis, frame); }
+
+	void destroy() override
+	{
+		stb_vorbis_close(m_vorbis);
+		m_data.release();
+		LUMIX_DELETE(m_allocator, this);
+	}
+
+	stb_vorbis* m_vorbis;
+	Clip::Data& m_data;
+	int m_channels;
+	IAllocator& m_allocator;
+};
+
+
+// buffers playing the clip keep their reference to the data, so it's freed after the device stops reading it
 void Clip::unload()
 {
-	m_data.clear();
+	if (m_data) m_data->release();
+	m_data = nullptr;
+}
+
+
+AudioDevice::BufferHandle Clip::createBuffer(AudioDevice& device, int flags)
+{
+	if (!m_data) return AudioDevice::INVALID_BUFFER_HANDLE;
+
+	if (!isStreamed()) {
+		const Array<u16>& decoded = m_data->decoded;
+		m_data->addRef();
+		return device.createBuffer(decoded.begin(), decoded.byte_size(), m_channels, m_sample_rate, flags, m_data);
+	}
+
+	const Array<u8>& compressed = m_data->compressed;
+	stb_vorbis* vorbis = stb_vorbis_open_memory(compressed.begin(), compressed.size(), nullptr, nullptr);
+	if (!vorbis) return AudioDevice::INVALID_BUFFER_HANDLE;
+
+	ClipStream* stream = LUMIX_NEW(m_allocator, ClipStream)(vorbis, *m_data, m_channels, m_allocator);
+	return device.createStreamBuffer(*stream, m_frames, m_channels, m_sample_rate, flags);
 }
 
 
 bool Clip::load(u64 size, const u8* mem)
 {
 	PROFILE_FUNCTION();
+	ASSERT(!m_data);
+	if (size > STREAMING_THRESHOLD) {
+		stb_vorbis* vorbis = stb_vorbis_open_memory(mem, (int)size, nullptr, nullptr);
+		if (!vorbis) return false;
+
+		const stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+		m_channels = info.channels;
+		m_sample_rate = info.sample_rate;
+		m_frames = stb_vorbis_stream_length_in_samples(vorbis);
+		stb_vorbis_close(vorbis);
+
+		m_data = LUMIX_NEW(m_allocator, Data)(m_allocator);
+		m_data->compressed.resize((int)size);
+		copyMemory(m_data->compressed.begin(), mem, size);
+		Profiler::pushInt("Resident KB", int(size / 1024));
+		Profiler::pushInt("Decoded KB", int(u64(m_frames) * m_channels * sizeof(i16) / 1024));
+		return true;
+	}
+
 	short* output = nullptr;
 	auto res = stb_vorbis_decode_memory((unsigned char*)mem, (int)size, &m_channels, &m_sample_rate, &output);
 	if (res <= 0) return false;
 
-	m_data.resize(res * m_channels);
-	copyMemory(&m_data[0], output, res * m_channels * sizeof(m_data[0]));
+	m_frames = res;
+	m_data = LUMIX_NEW(m_allocator, Data)(m_allocator);
+	m_data->decoded.resize(res * m_channels);
+	copyMemory(m_data->decoded.begin(), output, m_data->decoded.byte_size());
 	free(output);
+	Profiler::pushInt("Resident KB", int(m_data->decoded.byte_size() / 1024));
 
 	return true;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include "audio_device.h"
 #include "engine/array.h"
 #include "engine/resource.h"
 #include "engine/resource_manager.h"
@@ -13,28 +14,54 @@ namespace Lumix
 class Clip final : public Resource
 {
 public:
+	// decoded or compressed samples, shared by the clip and its buffers, since the audio device can read
+	// them after the clip is unloaded
+	struct Data final : AudioDevice::IDataOwner
+	{
+		explicit Data(IAllocator& allocator)
+			: allocator(allocator)
+			, decoded(allocator)
+			, compressed(allocator)
+		{}
+
+		void addRef();
+		void release() override;
+
+		IAllocator& allocator;
+		volatile i32 refs = 1;
+		Array<u16> decoded;
+		Array<u8> compressed;
+	};
+
 	Clip(const Path& path, ResourceManager& manager, IAllocator& allocator)
 		: Resource(path, manager, allocator)
-		, m_data(allocator)
+		, m_allocator(allocator)
 	{
 	}
 
+	~Clip() { if (m_data) m_data->release(); }
+
 	ResourceType getType() const override { return TYPE; }
 
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
 	int getChannels() const { return m_channels; }
 	int getSampleRate() const { return m_sample_rate; }
-	int getSize() const { return m_data.size() * sizeof(m_data[0]); }
-	u16* getData() { return &m_data[0]; }
-	float getLengthSeconds() const { return m_data.size() / float(m_channels * m_sample_rate); }
+	float getLengthSeconds() const { return m_frames / float(m_sample_rate); }
+	bool isStreamed() const { return m_data && !m_data->compressed.empty(); }
+	// streamed clips get a decoder per buffer, others share decoded data
+	AudioDevice::BufferHandle createBuffer(AudioDevice& device, int flags);
 
 	static const ResourceType TYPE;
+	// bigger clips stay compressed in memory and are decoded while playing
+	static const u64 STREAMING_THRESHOLD = 256 * 1024;
 
 private:
+	IAllocator& m_allocator;
 	int m_channels;
 	int m_sample_rate;
-	Array<u16> m_data;
+	u32 m_frames;
+	Data* m_data = nullptr;
 };
 
 
@@ -80,8 +80,7 @@ struct AssetBrowserPlugin final : public AssetBrowser::IPlugin
 		{
 			stopAudio();
 
-			auto handle =
-				device.createBuffer(clip->getData(), clip->getSize(), clip->getChannels(), clip->getSampleRate(), 0);
+			auto handle = clip->createBuffer(device, 0);
 			device.play(handle, true);
 			m_playing_clip = handle;
 		}
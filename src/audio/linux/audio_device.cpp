@@ -1,26 +1,33 @@
 #include "audio_device.h"
-#include "clip_manager.h"
-#include "engine/log.h"
+#include "engine/allocator.h"
+#include "engine/array.h"
 #include "engine/engine.h"
-#include "engine/iplugin.h"
 #include "engine/log.h"
+#include "engine/math.h"
+#include "engine/mt/atomic.h"
+#include "engine/mt/sync.h"
 #include "engine/mt/task.h"
-#include "engine/system.h"
+#include "engine/mt/thread.h"
+#include "engine/os.h"
+#include "engine/profiler.h"
+#include "engine/simd.h"
+#include "engine/string.h"
 #include <alsa/asoundlib.h>
+#include <math.h>
 
 
 namespace Lumix
 {
 
 
-struct AudioTask : MT::Task
+struct AudioTask final : MT::Task
 {
-	AudioTask(class AudioDeviceImpl& device, IAllocator& allocator)
+	AudioTask(struct AudioDeviceImpl& device, IAllocator& allocator)
 		: Task(allocator)
 		, m_device(device)
 	{}
 
-	virtual int task() override;
+	int task() override;
 	void handleError(int error_code);
 
 	volatile bool m_finished = false;
@@ -28,64 +35,278 @@ struct AudioTask : MT::Task
 };
 
 
-class AudioDeviceImpl : public AudioDevice
+// decodes streamed voices ahead of the mixer, so the audio thread never runs the decoder
+struct StreamDecodeTask final : MT::Task
 {
-public:
-	struct Buffer
+	StreamDecodeTask(struct AudioDeviceImpl& device, IAllocator& allocator)
+		: Task(allocator)
+		, m_device(device)
+		, m_wake(false)
+	{}
+
+	int task() override;
+
+	volatile bool m_finished = false;
+	AudioDeviceImpl& m_device;
+	MT::Event m_wake;
+};
+
+
+// software mixer, game thread only records commands into a single producer / single consumer ring,
+// audio thread applies them before it mixes the next block, so no lock is held on either side
+struct AudioDeviceImpl final : public AudioDevice
+{
+	static constexpr u32 MIX_FRAMES = 512;
+	static constexpr u32 COMMAND_QUEUE_SIZE = 1024;
+	static constexpr u32 STREAM_RING_FRAMES = 8192;
+	static constexpr u32 STREAM_DECODE_FRAMES = 1024;
+	static constexpr i64 STREAM_END_UNKNOWN = 0x7fffFFFFffffFFFFll;
+	static constexpr float MIN_DISTANCE = 2;
+	static constexpr float MIN_FREQUENCY = 100;
+	static constexpr float MAX_FREQUENCY = 200000;
+	// mixed signal passes unchanged below this level, above it's compressed towards 1
+	static constexpr float SOFT_CLIP_THRESHOLD = 0.5f;
+
+	enum class CommandType : u8
 	{
-		enum class RuntimeFlags
-		{
-			READY = 1 << 0,
-			PLAYING = 1 << 1,
-			LOOPED = 1 << 2
-		};
-
-		Buffer(IAllocator& allocator) : data(allocator) {}
-		
-		Array<u8> data;
-		int channels;
-		int sample_rate;
-		int flags;
-		int cursor;
-		u8 runtime_flags;
+		CREATE,
+		PLAY,
+		PAUSE,
+		STOP,
+		VOLUME,
+		FREQUENCY,
+		TIME,
+		SOURCE_POSITION,
+		MASTER_VOLUME,
+		LISTENER_POSITION,
+		LISTENER_ORIENTATION
 	};
 
+	struct Command
+	{
+		CommandType type;
+		bool flag;
+		u16 generation;
+		BufferHandle handle;
+		u32 channels;
+		u32 sample_rate;
+		u32 frames;
+		const i16* data;
+		IDataOwner* owner;
+		struct StreamState* stream;
+		float values[6];
+		DVec3 position;
+	};
+
+	// created on the game thread with its ring, filled by the decode thread, read by the audio thread;
+	// the ring is indexed by the number of frames decoded since creation / seek, which keeps counting through loops
+	struct StreamState
+	{
+		IStream* stream;
+		i16* ring;
+		u32 channels;
+		// written by the audio thread
+		volatile i32 seek_request;
+		u32 seek_frame;
+		volatile i64 consumed; // the mixer does not read frames before this anymore
+		volatile bool looped;
+		volatile bool retired; // the decode thread destroys retired streams
+		// written by the decode thread, decoded and end are valid only if seek_done == seek_request
+		volatile i32 seek_done;
+		volatile i64 decoded;
+		volatile i64 end;
+	};
+
+	// owned by the audio thread
+	struct Voice
+	{
+		const i16* data;
+		IDataOwner* owner;
+		StreamState* stream;
+		double stream_cursor;
+		u32 stream_base; // frame of the clip where the ring starts
+		u32 frames;
+		u32 channels;
+		u32 sample_rate;
+		u16 generation;
+		double cursor;
+		float volume;
+		float frequency; // in Hz, 0 == sample rate of the data
+		DVec3 position;
+		bool is_3d;
+		bool active;
+		bool playing;
+		bool looped;
+		bool finished;
+	};
+
+	// owned by the game thread
+	struct Slot
+	{
+		u32 sample_rate;
+		u16 generation;
+		bool used;
+		bool playing;
+	};
+
+	// written by the audio thread, read by the game thread
+	// bits 0-31 cursor in frames, bit 32 finished, bits 48-63 generation
+	static i64 packStatus(u32 cursor, bool finished, u16 generation)
+	{
+		return i64(cursor) | (finished ? (1ll << 32) : 0) | (i64(generation) << 48);
+	}
+
+	AudioDeviceImpl(Engine& engine)
+		: m_allocator(engine.getAllocator())
+		, m_engine(engine)
+		, m_new_streams(engine.getAllocator())
+		, m_decoded_streams(engine.getAllocator())
+	{
+		setMemory(m_voices, 0, sizeof(m_voices));
+		setMemory(m_slots, 0, sizeof(m_slots));
+		setMemory((void*)m_status, 0, sizeof(m_status));
+		m_listener_position = DVec3(0, 0, 0);
+		m_listener_right = Vec3(1, 0, 0);
+	}
+
+
+	~AudioDeviceImpl()
+	{
+		if (m_task)
+		{
+			m_task->m_finished = true;
+			m_task->destroy();
+			LUMIX_DELETE(m_allocator, m_task);
+		}
+		if (m_decode_task)
+		{
+			m_decode_task->m_finished = true;
+			m_decode_task->m_wake.trigger();
+			m_decode_task->destroy();
+			LUMIX_DELETE(m_allocator, m_decode_task);
+		}
+		processCommands();
+		for (Voice& voice : m_voices) releaseData(voice);
+		for (StreamState* stream : m_new_streams) destroyStream(stream);
+		for (StreamState* stream : m_decoded_streams) destroyStream(stream);
+		if (m_device) m_api.snd_pcm_close(m_device);
+		if (m_alsa_lib) OS::unloadLibrary(m_alsa_lib);
+	}
+
+
+	void pushCommand(const Command& cmd)
+	{
+		while (m_commands_write - m_commands_read >= (i32)COMMAND_QUEUE_SIZE)
+		{
+			MT::yield();
+		}
+		m_commands[m_commands_write & (COMMAND_QUEUE_SIZE - 1)] = cmd;
+		MT::memoryBarrier();
+		m_commands_write = m_commands_write + 1;
+	}
+
+
+	void pushCommand(CommandType type, BufferHandle handle, float value)
+	{
+		Command cmd;
+		cmd.type = type;
+		cmd.handle = handle;
+		cmd.values[0] = value;
+		pushCommand(cmd);
+	}
+
+
+	BufferHandle createVoice(const i16* data, IDataOwner* owner, StreamState* stream, u32 frames, int channels, int sample_rate, int flags)
+	{
+		ASSERT(channels > 0);
+		for (int i = 0; i < lengthOf(m_slots); ++i)
+		{
+			Slot& slot = m_slots[i];
+			if (slot.used) continue;
+
+			slot.used = true;
+			slot.playing = false;
+			slot.sample_rate = sample_rate;
+			++slot.generation;
+
+			Command cmd;
+			cmd.type = CommandType::CREATE;
+			cmd.handle = i;
+			cmd.generation = slot.generation;
+			cmd.data = data;
+			cmd.owner = owner;
+			cmd.stream = stream;
+			cmd.frames = frames;
+			cmd.channels = channels;
+			cmd.sample_rate = sample_rate;
+			cmd.flag = (flags & (int)BufferFlags::IS3D) != 0;
+			pushCommand(cmd);
+			return i;
+		}
+		return INVALID_BUFFER_HANDLE;
+	}
+
 
 	BufferHandle createBuffer(const void* data,
 		int size_bytes,
 		int channels,
 		int sample_rate,
-		int flags) override
+		int flags,
+		IDataOwner* owner) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(flags == 0); // nothing else supported yet
-		for(int i = 0, c = m_buffers.size(); i < c; ++i)
-		{
-			Buffer& buffer = m_buffers[i];
-			if((buffer.runtime_flags & (u8)Buffer::RuntimeFlags::READY)) continue;
+		// the audio thread reads data until it processes STOP, owner is released after that
+		const u32 frames = u32(size_bytes / (sizeof(i16) * channels));
+		const BufferHandle handle = createVoice((const i16*)data, owner, nullptr, frames, channels, sample_rate, flags);
+		if (handle == INVALID_BUFFER_HANDLE && owner) owner->release();
+		return handle;
+	}
 
-			buffer.channels = channels;
-			buffer.sample_rate = sample_rate;
-			buffer.flags = flags;
-			buffer.data.resize(size_bytes);
-			buffer.runtime_flags = (u8)Buffer::RuntimeFlags::READY;
-			buffer.cursor = 0;
-			copyMemory(&buffer.data[0], data, size_bytes);
 
-			return i;
+	// the ring is allocated here and not on the audio thread, the decode thread starts filling it once it's registered
+	BufferHandle createStreamBuffer(IStream& stream, u32 frames, int channels, int sample_rate, int flags) override
+	{
+		ASSERT(channels > 0);
+		StreamState* state = LUMIX_NEW(m_allocator, StreamState);
+		state->stream = &stream;
+		state->ring = (i16*)m_allocator.allocate(STREAM_RING_FRAMES * channels * sizeof(i16));
+		state->channels = channels;
+		state->seek_request = 0;
+		state->seek_frame = 0;
+		state->consumed = 0;
+		state->looped = false;
+		state->retired = false;
+		state->seek_done = 0;
+		state->decoded = 0;
+		state->end = STREAM_END_UNKNOWN;
+
+		const BufferHandle handle = createVoice(nullptr, nullptr, state, frames, channels, sample_rate, flags);
+		if (handle == INVALID_BUFFER_HANDLE)
+		{
+			destroyStream(state);
+			return handle;
 		}
-		return INVALID_BUFFER_HANDLE;
+
+		MT::CriticalSectionLock lock(m_new_streams_mutex);
+		m_new_streams.push(state);
+		return handle;
 	}
 
 
+	void destroyStream(StreamState* state)
+	{
+		state->stream->destroy();
+		m_allocator.deallocate(state->ring);
+		LUMIX_DELETE(m_allocator, state);
+	}
+
+
+	// echo and chorus are not supported by the software mixer
 	void setEcho(BufferHandle handle,
 		float wet_dry_mix,
 		float feedback,
 		float left_delay,
-		float right_delay) override 
+		float right_delay) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(false); // not implemented yet
 	}
 
 
@@ -97,142 +318,110 @@ public:
 		float delay,
 		i32 phase) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(false); // not implemented yet
 	}
 
 
-	void mix(u16* output, int size_bytes)
+	void play(BufferHandle handle, bool looped) override
 	{
-		setMemory(output, 0, size_bytes);
-
-		MT::SpinLock lock(m_mutex);
-		for (Buffer& buffer : m_buffers)
-		{
-			if((buffer.runtime_flags & (u8)Buffer::RuntimeFlags::PLAYING) == 0) continue;
-			
-			mixBuffer(output, size_bytes, buffer);
-		}
+		ASSERT(m_slots[handle].used);
+		m_slots[handle].playing = true;
+		Command cmd;
+		cmd.type = CommandType::PLAY;
+		cmd.handle = handle;
+		cmd.flag = looped;
+		pushCommand(cmd);
 	}
 
 
-	void mixBuffer(u16* output, int size_bytes, Buffer& buffer)
+	// status of a buffer whose commands were not processed yet belongs to the previous buffer in the slot
+	bool getStatus(BufferHandle handle, i64* status) const
 	{
-		ASSERT(buffer.runtime_flags & (u8)Buffer::RuntimeFlags::PLAYING);
-		ASSERT(buffer.channels == 1); // nothing else supported yet
-		if (buffer.cursor >= buffer.data.size()) return;
-		int total = size_bytes;
-		bool is_looped = buffer.runtime_flags & (u8)Buffer::RuntimeFlags::LOOPED;
-		do
-		{
-			int to_copy = Math::minimum(total, buffer.data.size() - buffer.cursor);
-			copyMemory(output, &buffer.data[buffer.cursor], to_copy);
-			buffer.cursor += to_copy;
-			if(is_looped) buffer.cursor = buffer.cursor % buffer.data.size();
-			total -= to_copy;
-		} while(total > 0 && is_looped);
-	}
-
-	void play(BufferHandle buffer, bool looped) override 
-	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		m_buffers[buffer].runtime_flags |= (u8)Buffer::RuntimeFlags::PLAYING;
-		if(looped)
-		{
-			m_buffers[buffer].runtime_flags |= (u8)Buffer::RuntimeFlags::LOOPED;
-		}
-		else
-		{
-			m_buffers[buffer].runtime_flags &= ~(u8)Buffer::RuntimeFlags::LOOPED;
-		}
+		const i64 s = m_status[handle];
+		if (u16(s >> 48) != m_slots[handle].generation) return false;
+		*status = s;
+		return true;
 	}
 
 
-	bool isPlaying(BufferHandle buffer) override 
+	bool isPlaying(BufferHandle handle) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		return m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::PLAYING;
+		ASSERT(m_slots[handle].used);
+		if (!m_slots[handle].playing) return false;
+		i64 status;
+		if (!getStatus(handle, &status)) return true;
+		return (status & (1ll << 32)) == 0;
 	}
 
 
-	void stop(BufferHandle buffer) override
+	void stop(BufferHandle handle) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		m_buffers[buffer].runtime_flags &= ~(u8)Buffer::RuntimeFlags::PLAYING;
-		m_buffers[buffer].cursor = 0;
+		ASSERT(m_slots[handle].used);
+		m_slots[handle].used = false;
+		m_slots[handle].playing = false;
+		pushCommand(CommandType::STOP, handle, 0);
 	}
 
 
-	bool isEnd(BufferHandle buffer) override
-	{ 
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		return m_buffers[buffer].cursor >= m_buffers[buffer].data.size();
+	bool isEnd(BufferHandle handle) override
+	{
+		ASSERT(m_slots[handle].used);
+		i64 status;
+		if (!getStatus(handle, &status)) return false;
+		return (status & (1ll << 32)) != 0;
 	}
 
 
-	void pause(BufferHandle buffer) override
+	void pause(BufferHandle handle) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		m_buffers[buffer].runtime_flags &= ~(u8)Buffer::RuntimeFlags::PLAYING;
+		ASSERT(m_slots[handle].used);
+		m_slots[handle].playing = false;
+		pushCommand(CommandType::PAUSE, handle, 0);
 	}
 
 
-	void setMasterVolume(float volume) override 
+	void setMasterVolume(float volume) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(false); // not implemented yet
+		pushCommand(CommandType::MASTER_VOLUME, INVALID_BUFFER_HANDLE, volume);
 	}
 
 
-	void setVolume(BufferHandle buffer, float volume) override 
+	void setVolume(BufferHandle handle, float volume) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		ASSERT(false); // not implemented yet
+		ASSERT(m_slots[handle].used);
+		pushCommand(CommandType::VOLUME, handle, volume);
 	}
 
 
-	void setFrequency(BufferHandle buffer, float frequency) override 
+	void setFrequency(BufferHandle handle, float frequency) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		ASSERT(false); // not implemented yet
+		ASSERT(m_slots[handle].used);
+		pushCommand(CommandType::FREQUENCY, handle, MIN_FREQUENCY + frequency * (MAX_FREQUENCY - MIN_FREQUENCY));
 	}
 
 
-	void setCurrentTime(BufferHandle handle, float time_seconds) override 
+	void setCurrentTime(BufferHandle handle, float time_seconds) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[handle].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		
-		Buffer& buffer = m_buffers[handle];
-		float length = float(buffer.data.size() / double(buffer.sample_rate * 2 * buffer.channels));
-		float rel = time_seconds / length;
-		buffer.cursor = rel * buffer.data.size();
-		buffer.cursor = Math::clamp(buffer.cursor, 0, buffer.data.size());
+		ASSERT(m_slots[handle].used);
+		pushCommand(CommandType::TIME, handle, time_seconds);
 	}
 
 
 	float getCurrentTime(BufferHandle handle) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[handle].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		
-		Buffer& buffer = m_buffers[handle];
-		float length = float(buffer.data.size() / double(buffer.sample_rate * 2 * buffer.channels));
-		return float(length * double(buffer.cursor) / buffer.data.size());
+		ASSERT(m_slots[handle].used);
+		i64 status;
+		if (!getStatus(handle, &status)) return 0;
+		return float(double(u32(status)) / m_slots[handle].sample_rate);
 	}
 
 
-	void setListenerPosition(float x, float y, float z) override
+	void setListenerPosition(const DVec3& pos) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(false); // not implemented yet
+		Command cmd;
+		cmd.type = CommandType::LISTENER_POSITION;
+		cmd.handle = INVALID_BUFFER_HANDLE;
+		cmd.position = pos;
+		pushCommand(cmd);
 	}
 
 
@@ -243,63 +432,406 @@ public:
 		float up_y,
 		float up_z) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(false); // not implemented yet
+		Command cmd;
+		cmd.type = CommandType::LISTENER_ORIENTATION;
+		cmd.handle = INVALID_BUFFER_HANDLE;
+		cmd.values[0] = front_x;
+		cmd.values[1] = front_y;
+		cmd.values[2] = front_z;
+		cmd.values[3] = up_x;
+		cmd.values[4] = up_y;
+		cmd.values[5] = up_z;
+		pushCommand(cmd);
 	}
-	
 
-	void setSourcePosition(BufferHandle buffer, float x, float y, float z) override
+
+	void setSourcePosition(BufferHandle handle, const DVec3& pos) override
 	{
-		MT::SpinLock lock(m_mutex);
-		ASSERT(m_buffers[buffer].runtime_flags & (u8)Buffer::RuntimeFlags::READY);
-		ASSERT(false); // not implemented yet
+		ASSERT(m_slots[handle].used);
+		Command cmd;
+		cmd.type = CommandType::SOURCE_POSITION;
+		cmd.handle = handle;
+		cmd.position = pos;
+		pushCommand(cmd);
 	}
-	
-	
-	void update(float time_delta) override 
+
+
+	void update(float time_delta) override {}
+
+
+	// called on the audio thread once the voice does not read its data anymore,
+	// streams are handed over to the decode thread which destroys them
+	void releaseData(Voice& voice)
 	{
+		if (voice.owner) voice.owner->release();
+		voice.owner = nullptr;
+		voice.data = nullptr;
+		if (!voice.stream) return;
+		MT::memoryBarrier();
+		voice.stream->retired = true;
+		voice.stream = nullptr;
 	}
 
 
-	AudioDeviceImpl(Engine& engine)
-		: m_allocator(engine.getAllocator())
-		, m_engine(engine)
-		, m_buffers(m_allocator)
-		, m_mutex(false)
+	void processCommand(const Command& cmd)
 	{
-		m_buffers.reserve(MAX_BUFFERS_COUNT);
-		for (int i = 0; i < MAX_BUFFERS_COUNT; ++i)
+		Voice* voice = cmd.handle == INVALID_BUFFER_HANDLE ? nullptr : &m_voices[cmd.handle];
+		switch (cmd.type)
 		{
-			Buffer& buffer = m_buffers.emplace(m_allocator);
-			buffer.runtime_flags = 0;
+			case CommandType::CREATE:
+				voice->data = cmd.data;
+				voice->owner = cmd.owner;
+				voice->stream = cmd.stream;
+				voice->stream_cursor = 0;
+				voice->stream_base = 0;
+				voice->frames = cmd.frames;
+				voice->channels = cmd.channels;
+				voice->sample_rate = cmd.sample_rate;
+				voice->generation = cmd.generation;
+				voice->cursor = 0;
+				voice->volume = 1;
+				voice->frequency = 0;
+				voice->position = DVec3(0, 0, 0);
+				voice->is_3d = cmd.flag;
+				voice->active = true;
+				voice->playing = false;
+				voice->looped = false;
+				voice->finished = false;
+				m_status[cmd.handle] = packStatus(0, false, cmd.generation);
+				break;
+			case CommandType::PLAY:
+				voice->playing = true;
+				voice->looped = cmd.flag;
+				if (voice->stream) voice->stream->looped = cmd.flag;
+				break;
+			case CommandType::PAUSE: voice->playing = false; break;
+			case CommandType::STOP:
+				voice->active = false;
+				releaseData(*voice);
+				break;
+			case CommandType::VOLUME: voice->volume = cmd.values[0]; break;
+			case CommandType::FREQUENCY: voice->frequency = cmd.values[0]; break;
+			case CommandType::TIME:
+				voice->cursor = clamp(double(cmd.values[0]) * voice->sample_rate, 0.0, double(voice->frames));
+				voice->finished = false;
+				if (voice->stream)
+				{
+					// the decode thread seeks and restarts the ring, the voice is silent until it does
+					StreamState& stream = *voice->stream;
+					voice->stream_base = u32(voice->cursor);
+					voice->stream_cursor = voice->cursor - voice->stream_base;
+					stream.consumed = 0;
+					stream.seek_frame = voice->stream_base;
+					MT::memoryBarrier();
+					stream.seek_request = stream.seek_request + 1;
+				}
+				break;
+			case CommandType::SOURCE_POSITION: voice->position = cmd.position; break;
+			case CommandType::MASTER_VOLUME: m_master_volume = cmd.values[0]; break;
+			case CommandType::LISTENER_POSITION: m_listener_position = cmd.position; break;
+			case CommandType::LISTENER_ORIENTATION:
+			{
+				const Vec3 front(cmd.values[0], cmd.values[1], cmd.values[2]);
+				const Vec3 up(cmd.values[3], cmd.values[4], cmd.values[5]);
+				const Vec3 right = crossProduct(front, up);
+				const float len = right.length();
+				if (len > 0.00001f) m_listener_right = right * (1 / len);
+				break;
+			}
+			default: ASSERT(false); break;
 		}
 	}
 
 
-	~AudioDeviceImpl()
+	void processCommands()
 	{
-		if (m_task)
+		const i32 write = m_commands_write;
+		MT::memoryBarrier();
+		for (i32 i = m_commands_read; i != write; ++i)
 		{
-			m_task->m_finished = true;
-			m_task->destroy();
-			LUMIX_DELETE(m_allocator, m_task);
+			processCommand(m_commands[i & (COMMAND_QUEUE_SIZE - 1)]);
+		}
+		MT::memoryBarrier();
+		m_commands_read = write;
+	}
+
+
+	void getGains(const Voice& voice, float* left, float* right) const
+	{
+		const float gain = voice.volume * m_master_volume;
+		if (!voice.is_3d)
+		{
+			*left = *right = gain;
+			return;
+		}
+
+		const Vec3 rel = (voice.position - m_listener_position).toFloat();
+		const float dist = rel.length();
+		const float attenuation = MIN_DISTANCE / maximum(dist, MIN_DISTANCE);
+		const float pan = dist > 0.00001f ? clamp(dotProduct(rel, m_listener_right) / dist, -1.f, 1.f) : 0;
+		// equal power panning
+		const float angle = (pan + 1) * PI * 0.25f;
+		*left = gain * attenuation * cosf(angle);
+		*right = gain * attenuation * sinf(angle);
+	}
+
+
+	// resamples the voice to the output rate using linear interpolation,
+	// writes interleaved stereo and zeroes the rest of the block if the voice ends
+	void resample(Voice& voice, float* out)
+	{
+		const double rate = voice.frequency > 0 ? voice.frequency : voice.sample_rate;
+		const double step = rate / m_output_rate;
+		const i16* data = voice.data;
+		const u32 frames = voice.frames;
+		const u32 channels = voice.channels;
+		const u32 right_offset = channels > 1 ? 1 : 0;
+		const bool downmix = voice.is_3d && channels > 1;
+		constexpr float scale = 1 / 32768.f;
+		double cursor = voice.cursor;
+
+		u32 i = 0;
+		for (; i < MIX_FRAMES; ++i)
+		{
+			if (cursor >= frames)
+			{
+				if (!voice.looped || frames == 0)
+				{
+					voice.finished = true;
+					break;
+				}
+				cursor = fmod(cursor, double(frames));
+			}
+
+			const u32 i0 = u32(cursor);
+			const u32 i1 = i0 + 1 < frames ? i0 + 1 : (voice.looped ? 0 : i0);
+			const float t = float(cursor - i0);
+			const i16* s0 = data + i0 * channels;
+			const i16* s1 = data + i1 * channels;
+			const float l = (s0[0] + (s1[0] - s0[0]) * t) * scale;
+			const float r = (s0[right_offset] + (s1[right_offset] - s0[right_offset]) * t) * scale;
+			if (downmix)
+			{
+				out[i * 2] = out[i * 2 + 1] = (l + r) * 0.5f;
+			}
+			else
+			{
+				out[i * 2] = l;
+				out[i * 2 + 1] = r;
+			}
+			cursor += step;
+		}
+		if (i < MIX_FRAMES) setMemory(out + i * 2, 0, (MIX_FRAMES - i) * 2 * sizeof(float));
+		voice.cursor = cursor;
+	}
+
+
+	// decode thread, fills the whole ring in small blocks, never overwriting frames the mixer can still read
+	static void decodeAhead(StreamState& state)
+	{
+		const i32 seek_request = state.seek_request;
+		MT::memoryBarrier();
+		if (seek_request != state.seek_done)
+		{
+			state.stream->seek(state.seek_frame);
+			state.decoded = 0;
+			state.end = STREAM_END_UNKNOWN;
+			MT::memoryBarrier();
+			state.seek_done = seek_request;
+		}
+
+		const u32 channels = state.channels;
+		bool restarted = false;
+		// a new seek request makes the rest of the ring useless, it's handled on the next wake up
+		while (state.decoded < state.end && state.seek_request == seek_request)
+		{
+			const i64 decoded = state.decoded;
+			const i64 keep_from = minimum(state.consumed, decoded);
+			if (decoded - keep_from >= STREAM_RING_FRAMES) break;
+
+			const u32 space = STREAM_RING_FRAMES - u32(decoded - keep_from);
+			const u32 ring_pos = u32(decoded & (STREAM_RING_FRAMES - 1));
+			const u32 to_read = minimum(space, STREAM_RING_FRAMES - ring_pos, STREAM_DECODE_FRAMES);
+			if (to_read == 0) break;
+
+			const u32 read = state.stream->read(state.ring + ring_pos * channels, to_read);
+			MT::memoryBarrier();
+			state.decoded = decoded + read;
+			if (read > 0) restarted = false;
+			if (read == to_read) continue;
+
+			if (!state.looped || restarted)
+			{
+				state.end = state.decoded;
+				break;
+			}
+			state.stream->seek(0);
+			restarted = true;
+		}
+	}
+
+
+	// decode thread
+	void decodeStreams()
+	{
+		PROFILE_FUNCTION();
+		{
+			MT::CriticalSectionLock lock(m_new_streams_mutex);
+			for (StreamState* stream : m_new_streams) m_decoded_streams.push(stream);
+			m_new_streams.clear();
+		}
+
+		for (int i = m_decoded_streams.size() - 1; i >= 0; --i)
+		{
+			StreamState* stream = m_decoded_streams[i];
+			if (stream->retired)
+			{
+				MT::memoryBarrier();
+				destroyStream(stream);
+				m_decoded_streams.eraseFast(i);
+				continue;
+			}
+			decodeAhead(*stream);
+		}
+	}
+
+
+	void resampleStream(Voice& voice, float* out)
+	{
+		const double rate = voice.frequency > 0 ? voice.frequency : voice.sample_rate;
+		const double step = rate / m_output_rate;
+		StreamState& stream = *voice.stream;
+
+		const i16* ring = stream.ring;
+		const u32 channels = voice.channels;
+		const u32 right_offset = channels > 1 ? 1 : 0;
+		const bool downmix = voice.is_3d && channels > 1;
+		// nothing is available until the decode thread handles the last seek
+		const bool seeked = stream.seek_done == stream.seek_request;
+		MT::memoryBarrier();
+		const i64 stream_end = seeked ? stream.end : STREAM_END_UNKNOWN;
+		const i64 available = seeked ? minimum(stream.decoded, stream_end) : 0;
+		MT::memoryBarrier();
+		constexpr float scale = 1 / 32768.f;
+		constexpr u32 mask = STREAM_RING_FRAMES - 1;
+		double cursor = voice.stream_cursor;
+
+		u32 i = 0;
+		for (; i < MIX_FRAMES; ++i)
+		{
+			const i64 i0 = i64(cursor);
+			if (i0 >= available)
+			{
+				// end of the stream, or the decode thread is late and the rest of the block is silent
+				voice.finished = i0 >= stream_end;
+				break;
+			}
+			const i64 i1 = i0 + 1 < available ? i0 + 1 : i0;
+			const float t = float(cursor - i0);
+			const i16* s0 = ring + (i0 & mask) * channels;
+			const i16* s1 = ring + (i1 & mask) * channels;
+			const float l = (s0[0] + (s1[0] - s0[0]) * t) * scale;
+			const float r = (s0[right_offset] + (s1[right_offset] - s0[right_offset]) * t) * scale;
+			if (downmix)
+			{
+				out[i * 2] = out[i * 2 + 1] = (l + r) * 0.5f;
+			}
+			else
+			{
+				out[i * 2] = l;
+				out[i * 2 + 1] = r;
+			}
+			cursor += step;
+		}
+		if (i < MIX_FRAMES) setMemory(out + i * 2, 0, (MIX_FRAMES - i) * 2 * sizeof(float));
+		voice.stream_cursor = cursor;
+		stream.consumed = i64(cursor);
+		const double clip_cursor = voice.stream_base + cursor;
+		voice.cursor = voice.frames > 0 ? fmod(clip_cursor, double(voice.frames)) : 0;
+		if (voice.finished) voice.cursor = voice.frames;
+	}
+
+
+	void mix(i16* output)
+	{
+		PROFILE_FUNCTION();
+		processCommands();
+
+		setMemory(m_mix_buffer, 0, sizeof(m_mix_buffer));
+		int voices_mixed = 0;
+		for (int v = 0; v < lengthOf(m_voices); ++v)
+		{
+			Voice& voice = m_voices[v];
+			if (!voice.active || !voice.playing || voice.finished) continue;
+
+			if (voice.stream)
+			{
+				resampleStream(voice, m_voice_buffer);
+			}
+			else
+			{
+				resample(voice, m_voice_buffer);
+			}
+			m_status[v] = packStatus(u32(minimum(voice.cursor, double(voice.frames))), voice.finished, voice.generation);
+
+			alignas(16) float gains[4];
+			getGains(voice, &gains[0], &gains[1]);
+			gains[2] = gains[0];
+			gains[3] = gains[1];
+			const float4 g = f4Load(gains);
+			for (u32 i = 0; i < MIX_FRAMES * 2; i += 4)
+			{
+				const float4 acc = f4Load(&m_mix_buffer[i]);
+				f4Store(&m_mix_buffer[i], f4Add(acc, f4Mul(f4Load(&m_voice_buffer[i]), g)));
+			}
+			++voices_mixed;
+		}
+		Profiler::pushInt("Voices", voices_mixed);
+		if (m_decode_task) m_decode_task->m_wake.trigger();
+
+		// soft clip, unity gain up to the threshold, the part above it is compressed by
+		// u * (27 + u^2) / (27 + 9 * u^2), which approximates tanh on <-3, 3> and reaches 1 at 3,
+		// so the output is continuous with continuous slope and never exceeds 1
+		const float4 threshold = f4Splat(SOFT_CLIP_THRESHOLD);
+		const float4 neg_threshold = f4Splat(-SOFT_CLIP_THRESHOLD);
+		const float4 knee = f4Splat(1 - SOFT_CLIP_THRESHOLD);
+		const float4 inv_knee = f4Splat(1 / (1 - SOFT_CLIP_THRESHOLD));
+		const float4 limit = f4Splat(3);
+		const float4 neg_limit = f4Splat(-3);
+		const float4 c27 = f4Splat(27);
+		const float4 c9 = f4Splat(9);
+		const float4 out_scale = f4Splat(32767);
+		for (u32 i = 0; i < MIX_FRAMES * 2; i += 4)
+		{
+			const float4 x = f4Load(&m_mix_buffer[i]);
+			const float4 linear = f4Min(f4Max(x, neg_threshold), threshold);
+			// nonzero only above the threshold
+			const float4 u = f4Min(f4Max(f4Mul(f4Sub(x, linear), inv_knee), neg_limit), limit);
+			const float4 u2 = f4Mul(u, u);
+			const float4 compressed = f4Div(f4Mul(u, f4Add(c27, u2)), f4Add(c27, f4Mul(c9, u2)));
+			const float4 y = f4Add(linear, f4Mul(compressed, knee));
+			alignas(16) float tmp[4];
+			f4Store(tmp, f4Mul(y, out_scale));
+			output[i + 0] = i16(tmp[0]);
+			output[i + 1] = i16(tmp[1]);
+			output[i + 2] = i16(tmp[2]);
+			output[i + 3] = i16(tmp[3]);
 		}
-		if (m_device) m_api.snd_pcm_close(m_device);
-		if (m_alsa_lib) unloadLibrary(m_alsa_lib);
 	}
 
 
 	bool loadAlsa()
 	{
-		m_alsa_lib = loadLibrary("libasound.so");
+		m_alsa_lib = OS::loadLibrary("libasound.so.2");
+		if (!m_alsa_lib) m_alsa_lib = OS::loadLibrary("libasound.so");
 		if (!m_alsa_lib) return false;
 
 		#define API(func) \
 			do { \
-				m_api.func = (decltype(m_api.func))getLibrarySymbol(m_alsa_lib, #func);\
+				m_api.func = (decltype(m_api.func))OS::getLibrarySymbol(m_alsa_lib, #func);\
 				if(!m_api.func)\
 				{\
-					unloadLibrary(m_alsa_lib);\
+					OS::unloadLibrary(m_alsa_lib);\
 					m_alsa_lib = nullptr;\
 					return false;\
 				}\
@@ -335,41 +867,51 @@ public:
 	bool init()
 	{
 		if (!loadAlsa()) return false;
-		
+
 		unsigned int rate = 44100;
-		int channels = 1;
 		snd_pcm_hw_params_t* hw_params;
-		snd_pcm_uframes_t buffer_size = 1024;
+		snd_pcm_uframes_t buffer_size = MIX_FRAMES * 4;
 
-		int res = m_api.snd_pcm_open(&m_device, "default", SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
-		if(res < 0) goto error;
+		int res = m_api.snd_pcm_open(&m_device, "default", SND_PCM_STREAM_PLAYBACK, 0);
+		if (res < 0) goto error;
 
 		hw_params = (snd_pcm_hw_params_t*)alloca(m_api.snd_pcm_hw_params_sizeof());
 		res = m_api.snd_pcm_hw_params_any(m_device, hw_params);
-		if(res < 0) goto error;
+		if (res < 0) goto error;
 
-		if (m_api.snd_pcm_hw_params_set_access(m_device, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED) < 0) goto error;
-		if (m_api.snd_pcm_hw_params_set_format(m_device, hw_params, SND_PCM_FORMAT_S16_LE) < 0)  goto error;
-		if (m_api.snd_pcm_hw_params_set_channels(m_device, hw_params, channels) < 0) goto error; 
-		if (m_api.snd_pcm_hw_params_set_rate_near(m_device, hw_params, &rate, 0) < 0) goto error;
-		if (m_api.snd_pcm_hw_params_set_buffer_size_near(m_device, hw_params, &buffer_size) < 0) goto error;
+		if ((res = m_api.snd_pcm_hw_params_set_access(m_device, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) goto error;
+		if ((res = m_api.snd_pcm_hw_params_set_format(m_device, hw_params, SND_PCM_FORMAT_S16_LE)) < 0) goto error;
+		if ((res = m_api.snd_pcm_hw_params_set_channels(m_device, hw_params, 2)) < 0) goto error;
+		if ((res = m_api.snd_pcm_hw_params_set_rate_near(m_device, hw_params, &rate, 0)) < 0) goto error;
+		if ((res = m_api.snd_pcm_hw_params_set_buffer_size_near(m_device, hw_params, &buffer_size)) < 0) goto error;
 		res = m_api.snd_pcm_hw_params(m_device, hw_params);
-		if(res < 0) goto error;
-		
-		res = m_api.snd_pcm_start(m_device);
-		if(res < 0) goto error;
+		if (res < 0) goto error;
+		m_output_rate = rate;
 
-		g_log_info.log("Audio") << "PCM name: '" << m_api.snd_pcm_name(m_device) << "'";
-		g_log_info.log("Audio") << "PCM state: '" << m_api.snd_pcm_state(m_device) << "'";
+		logInfo("Audio") << "PCM name: '" << m_api.snd_pcm_name(m_device) << "', rate: " << rate;
+
+		m_decode_task = LUMIX_NEW(m_allocator, StreamDecodeTask)(*this, m_allocator);
+		if (!m_decode_task->create("AudioDecodeTask", true))
+		{
+			LUMIX_DELETE(m_allocator, m_decode_task);
+			m_decode_task = nullptr;
+			logError("Audio") << "Failed to create audio decode task";
+			return false;
+		}
 
 		m_task = LUMIX_NEW(m_allocator, AudioTask)(*this, m_allocator);
-		m_task->create("AudioTask");
+		if (!m_task->create("AudioTask", true))
+		{
+			LUMIX_DELETE(m_allocator, m_task);
+			m_task = nullptr;
+			logError("Audio") << "Failed to create audio task";
+			return false;
+		}
 
 		return true;
 
 		error:
-			const char* error_msg = m_api.snd_strerror(res);
-			g_log_error.log("Audio") << error_msg;
+			logError("Audio") << m_api.snd_strerror(res);
 			return false;
 	}
 
@@ -378,12 +920,12 @@ public:
 	{
 		int	(*snd_pcm_open)(snd_pcm_t** pcm, const char* name, snd_pcm_stream_t stream, int mode);
 		int (*snd_pcm_close)(snd_pcm_t* handle);
-		int (*snd_pcm_start)(snd_pcm_t* pcm); 	
+		int (*snd_pcm_start)(snd_pcm_t* pcm);
 		int (*snd_pcm_hw_params_any)(snd_pcm_t* pcm, snd_pcm_hw_params_t* params);
 		int (*snd_pcm_hw_params)(snd_pcm_t* pcm, snd_pcm_hw_params_t* params);
 		const char* (*snd_strerror)(int error_num);
-		int (*snd_pcm_delay)(snd_pcm_t* pcm, snd_pcm_sframes_t* delayp); 
-		int (*snd_pcm_reset)(snd_pcm_t*	pcm); 	
+		int (*snd_pcm_delay)(snd_pcm_t* pcm, snd_pcm_sframes_t* delayp);
+		int (*snd_pcm_reset)(snd_pcm_t*	pcm);
 		int (*snd_pcm_recover)(snd_pcm_t* pcm, int err, int silent);
 		size_t (*snd_pcm_hw_params_sizeof)();
 		int (*snd_pcm_hw_params_set_access)(snd_pcm_t* pcm, snd_pcm_hw_params_t* params, snd_pcm_access_t _access);
@@ -399,83 +941,99 @@ public:
 	};
 
 
-	static const int MAX_BUFFERS_COUNT = 256;
-
-
 	IAllocator& m_allocator;
-	Array<Buffer> m_buffers;
-	AudioTask* m_task = nullptr;
 	Engine& m_engine;
-	MT::SpinMutex m_mutex;
+	AudioTask* m_task = nullptr;
+	StreamDecodeTask* m_decode_task = nullptr;
+	MT::CriticalSection m_new_streams_mutex;
+	Array<StreamState*> m_new_streams; // registered by the game thread
+	Array<StreamState*> m_decoded_streams; // owned by the decode thread
 	void* m_alsa_lib = nullptr;
 	snd_pcm_t* m_device = nullptr;
 	API m_api;
+	u32 m_output_rate = 44100;
+
+	Slot m_slots[MAX_PLAYING_SOUNDS];
+	Command m_commands[COMMAND_QUEUE_SIZE];
+	volatile i32 m_commands_write = 0;
+	volatile i32 m_commands_read = 0;
+	volatile i64 m_status[MAX_PLAYING_SOUNDS];
+
+	Voice m_voices[MAX_PLAYING_SOUNDS];
+	float m_master_volume = 1;
+	DVec3 m_listener_position;
+	Vec3 m_listener_right;
+	alignas(16) float m_mix_buffer[MIX_FRAMES * 2];
+	alignas(16) float m_voice_buffer[MIX_FRAMES * 2];
 };
 
 
 void AudioTask::handleError(int error_code)
 {
-	const char* error_msg = m_device.m_api.snd_strerror(error_code);
-	g_log_error.log("Audio") << error_msg;
+	logError("Audio") << m_device.m_api.snd_strerror(error_code);
 }
 
 
 int AudioTask::task()
 {
-	while(!m_finished)
+	i16 buffer[AudioDeviceImpl::MIX_FRAMES * 2];
+	while (!m_finished)
 	{
-		u16 buffer[2*1024];
-		int frames_avail = lengthOf(buffer);
-		m_device.mix(buffer, frames_avail * 2);
+		m_device.mix(buffer);
 
-		u16* iter = buffer;
-		while(frames_avail > 0)
-		{		
-			snd_pcm_sframes_t frames_written = m_device.m_api.snd_pcm_writei(m_device.m_device, buffer, frames_avail);
+		const i16* iter = buffer;
+		snd_pcm_sframes_t frames_left = AudioDeviceImpl::MIX_FRAMES;
+		while (frames_left > 0 && !m_finished)
+		{
+			const snd_pcm_sframes_t frames_written = m_device.m_api.snd_pcm_writei(m_device.m_device, iter, frames_left);
+			if (frames_written == -EAGAIN) continue;
 			if (frames_written < 0)
 			{
-				if (frames_written == -EAGAIN) continue;
-				if (frames_written == -EPIPE) 
+				const int recover_result = m_device.m_api.snd_pcm_recover(m_device.m_device, (int)frames_written, 1);
+				if (recover_result < 0)
 				{
-					int recover_result = m_device.m_api.snd_pcm_recover(m_device.m_device, frames_written, 1);
-					if (recover_result < 0)
-					{
-						handleError(recover_result);
-						break;
-					}
-
-					frames_written = m_device.m_api.snd_pcm_writei(m_device.m_device, buffer, frames_avail);
-					if (frames_written < 0)
-					{
-						handleError(recover_result);
-						break;
-					}
-				} 
-				else 
-				{
-					handleError(frames_written);
+					handleError(recover_result);
+					MT::sleep(10);
+					break;
 				}
+				continue;
 			}
-			else
-			{
-				frames_avail -= frames_written;
-				iter += frames_written;
-			}
+			frames_left -= frames_written;
+			iter += frames_written * 2;
 		}
 	}
 	return 0;
 }
 
 
-class NullAudioDevice LUMIX_FINAL : public AudioDevice
+int StreamDecodeTask::task()
+{
+	while (!m_finished)
+	{
+		// the mixer wakes us up after every block, the timeout only covers the time nothing plays
+		m_wake.waitTimeout(10);
+		m_device.decodeStreams();
+	}
+	return 0;
+}
+
+
+class NullAudioDevice final : public AudioDevice
 {
 public:
 	BufferHandle createBuffer(const void* data,
 		int size_bytes,
 		int channels,
 		int sample_rate,
-		int flags) override
+		int flags,
+		IDataOwner* owner) override
+	{
+		if (owner) owner->release();
+		return INVALID_BUFFER_HANDLE;
+	}
+	BufferHandle createStreamBuffer(IStream& stream, u32 frames, int channels, int sample_rate, int flags) override
 	{
+		stream.destroy();
 		return INVALID_BUFFER_HANDLE;
 	}
 	void setEcho(BufferHandle handle,
@@ -483,6 +1041,7 @@ public:
 		float feedback,
 		float left_delay,
 		float right_delay) override {}
+
 	void setChorus(BufferHandle handle,
 		float wet_dry_mix,
 		float depth,
@@ -490,6 +1049,7 @@ public:
 		float frequency,
 		float delay,
 		i32 phase) override {}
+
 	void play(BufferHandle buffer, bool looped) override {}
 	bool isPlaying(BufferHandle buffer) override { return false; }
 	void stop(BufferHandle buffer) override {}
@@ -500,14 +1060,14 @@ public:
 	void setFrequency(BufferHandle buffer, float frequency) override {}
 	void setCurrentTime(BufferHandle buffer, float time_seconds) override {}
 	float getCurrentTime(BufferHandle buffer) override { return -1; }
-	void setListenerPosition(float x, float y, float z) override {}
+	void setListenerPosition(const DVec3& pos) override {}
 	void setListenerOrientation(float front_x,
 		float front_y,
 		float front_z,
 		float up_x,
 		float up_y,
 		float up_z) override {}
-	void setSourcePosition(BufferHandle buffer, float x, float y, float z) override {}
+	void setSourcePosition(BufferHandle buffer, const DVec3& pos) override {}
 	void update(float time_delta) override {}
 };
 
@@ -521,7 +1081,7 @@ AudioDevice* AudioDevice::create(Engine& engine)
 	if (!device->init())
 	{
 		LUMIX_DELETE(engine.getAllocator(), device);
-		g_log_warning.log("Audio") << "Using null device";
+		logWarning("Audio") << "Using null device";
 		return &g_null_device;
 	}
 	return device;
@@ -535,4 +1095,4 @@ void AudioDevice::destroy(AudioDevice& device)
 }
 
 
-} // namespace Lumix
\ No newline at end of file
+} // namespace Lumix
@@ -19,6 +19,9 @@ struct AudioDeviceImpl final : public AudioDevice
 		LPDIRECTSOUND3DBUFFER8 handle_3d;
 		IDirectSoundBuffer8* handle8;
 		const void* data;
+		IDataOwner* owner;
+		IStream* stream;
+		DWORD frame_size;
 		DWORD data_size;
 		DWORD written;
 		int sparse_idx;
@@ -147,11 +150,59 @@ struct AudioDeviceImpl final : public AudioDevice
 	}
 
 
+	// fills dest from the stream, restarts looped streams, zeroes what is left after the end
+	static void readStream(IStream& stream, bool looped, DWORD frame_size, void* dest, DWORD size)
+	{
+		u8* out = (u8*)dest;
+		bool restarted = false;
+		while (size >= frame_size)
+		{
+			const u32 read = stream.read((i16*)out, size / frame_size);
+			out += read * frame_size;
+			size -= read * frame_size;
+			if (read > 0) restarted = false;
+			if (size < frame_size) break;
+			if (!looped || restarted) break;
+			stream.seek(0);
+			restarted = true;
+		}
+		ZeroMemory(out, size);
+	}
+
+
 	BufferHandle createBuffer(const void* data,
 		int data_size,
 		int channels,
 		int sample_rate,
-		int flags) override
+		int flags,
+		IDataOwner* owner) override
+	{
+		// data is streamed into the DirectSound buffer as it plays, owner keeps it alive until stop
+		const BufferHandle handle = createBuffer(data, nullptr, data_size, channels, sample_rate, flags);
+		if (handle == INVALID_BUFFER_HANDLE)
+		{
+			if (owner) owner->release();
+			return handle;
+		}
+		m_buffers[m_buffer_map[handle]].owner = owner;
+		return handle;
+	}
+
+
+	BufferHandle createStreamBuffer(IStream& stream, u32 frames, int channels, int sample_rate, int flags) override
+	{
+		const BufferHandle handle = createBuffer(nullptr, &stream, frames * channels * sizeof(i16), channels, sample_rate, flags);
+		if (handle == INVALID_BUFFER_HANDLE) stream.destroy();
+		return handle;
+	}
+
+
+	BufferHandle createBuffer(const void* data,
+		IStream* stream,
+		int data_size,
+		int channels,
+		int sample_rate,
+		int flags)
 	{
 		if (m_buffer_count == MAX_PLAYING_SOUNDS) return INVALID_BUFFER_HANDLE;
 
@@ -187,7 +238,14 @@ struct AudioDeviceImpl final : public AudioDevice
 			buffer->Release();
 			return INVALID_BUFFER_HANDLE;
 		}
-		memcpy(p1, data, s1);
+		if (stream)
+		{
+			readStream(*stream, false, channels * sizeof(i16), p1, s1);
+		}
+		else
+		{
+			memcpy(p1, data, s1);
+		}
 		result = SUCCEEDED(buffer->Unlock(p1, s1, p2, s2));
 		if (!result)
 		{
@@ -219,6 +277,9 @@ struct AudioDeviceImpl final : public AudioDevice
 				m_buffer_map[i] = m_buffer_count;
 				m_buffers[m_buffer_count].handle = buffer;
 				m_buffers[m_buffer_count].data = data;
+				m_buffers[m_buffer_count].owner = nullptr;
+				m_buffers[m_buffer_count].stream = stream;
+				m_buffers[m_buffer_count].frame_size = channels * sizeof(i16);
 				m_buffers[m_buffer_count].data_size = data_size;
 				m_buffers[m_buffer_count].written = buffer_size;
 				m_buffers[m_buffer_count].sparse_idx = i;
@@ -402,6 +463,8 @@ struct AudioDeviceImpl final : public AudioDevice
 		if (buffer.handle_3d) buffer.handle_3d->Release();
 		if (buffer.handle8) buffer.handle8->Release();
 		buffer.handle->Release();
+		if (buffer.stream) buffer.stream->destroy();
+		if (buffer.owner) buffer.owner->release();
 
 		m_buffers[dense_idx] = m_buffers[m_buffer_count];
 		m_buffers[m_buffer_count].handle = nullptr;
@@ -468,6 +531,7 @@ struct AudioDeviceImpl final : public AudioDevice
 			}
 			else
 			{
+				if (buffer.stream) buffer.stream->seek(pos / buffer.frame_size);
 				buffer.written = pos;
 			}
 		}
@@ -485,7 +549,11 @@ struct AudioDeviceImpl final : public AudioDevice
 		}
 		auto updateBuffer = [&buffer](void* p, DWORD size) {
 			if (!p) return;
-			if (buffer.written + size > buffer.data_size)
+			if (buffer.stream)
+			{
+				readStream(*buffer.stream, buffer.looped, buffer.frame_size, p, size);
+			}
+			else if (buffer.written + size > buffer.data_size)
 			{
 				memcpy(p, (u8*)buffer.data + buffer.written, buffer.data_size - buffer.written);
 				void* p_2 = (u8*)p + (buffer.data_size - buffer.written);
@@ -572,8 +640,15 @@ public:
 		int size_bytes,
 		int channels,
 		int sample_rate,
-		int flags) override
+		int flags,
+		IDataOwner* owner) override
+	{
+		if (owner) owner->release();
+		return INVALID_BUFFER_HANDLE;
+	}
+	BufferHandle createStreamBuffer(IStream& stream, u32 frames, int channels, int sample_rate, int flags) override
 	{
+		stream.destroy();
 		return INVALID_BUFFER_HANDLE;
 	}
 	void setEcho(BufferHandle handle,
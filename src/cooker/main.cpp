@@ -0,0 +1,11 @@
+#include "editor/studio_app.h"
+
+
+int main(int argc, char* argv[])
+{
+	auto* app = Lumix::StudioApp::createCooker();
+	app->run();
+	const int exit_code = app->getExitCode();
+	Lumix::StudioApp::destroy(*app);
+	return exit_code;
+}
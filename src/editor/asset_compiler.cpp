@@ -3,6 +3,7 @@
 #include "editor/log_ui.h"
 #include "editor/studio_app.h"
 #include "editor/world_editor.h"
+#include "engine/command_line_parser.h"
 #include "engine/crc32.h"
 #include "engine/engine.h"
 #include "engine/log.h"
@@ -10,12 +11,15 @@
 #include "engine/mt/atomic.h"
 #include "engine/mt/sync.h"
 #include "engine/mt/task.h"
+#include "engine/mt/thread.h"
 #include "engine/os.h"
 #include "engine/path_utils.h"
 #include "engine/profiler.h"
 #include "engine/resource.h"
 #include "engine/resource_manager.h"
+#include "engine/stream.h"
 #include "imgui/imgui.h"
+#include <stdlib.h>
 
 
 namespace Lumix
@@ -46,6 +50,8 @@ struct AssetCompilerTask : MT::Task
 
 	AssetCompilerImpl& m_compiler;
 	volatile bool m_finished = false;
+	// guarded by AssetCompilerImpl::m_to_compile_mutex
+	Path m_res_in_progress;
 };
 
 
@@ -66,6 +72,36 @@ struct AssetCompilerImpl : AssetCompiler
 		Resource* resource;
 	};
 
+	struct CompileResult
+	{
+		Path path;
+		float time;
+		bool success;
+	};
+
+	struct FileHash
+	{
+		u64 last_modified = 0;
+		u64 hash = 0;
+	};
+
+	struct QueuedResource
+	{
+		u32 order; // dependencies can only wait for resources queued before them, so there are no cycles
+		u32 pending_dependencies; // queued or compiling resources this one depends on
+	};
+
+	enum class HashesVersion : u32
+	{
+		FIRST,
+		HASH64,
+
+		LATEST
+	};
+
+	static const u32 HASHES_MAGIC = 0x5f4c4853; // == '_LHS'
+	static const u64 DEFAULT_CACHE_SIZE = 2048ULL << 20;
+
 	struct LoadHook : ResourceManagerHub::LoadHook
 	{
 		LoadHook(AssetCompilerImpl& compiler) : compiler(compiler) {}
@@ -83,22 +119,43 @@ struct AssetCompilerImpl : AssetCompiler
 		: m_app(app)
 		, m_load_hook(*this)
 		, m_plugins(app.getWorldEditor().getAllocator())
-		, m_task(*this, app.getWorldEditor().getAllocator())
+		, m_tasks(app.getWorldEditor().getAllocator())
 		, m_to_compile(app.getWorldEditor().getAllocator())
+		, m_queued(app.getWorldEditor().getAllocator())
 		, m_compiled(app.getWorldEditor().getAllocator())
 		, m_semaphore(0, 0x7fFFffFF)
 		, m_registered_extensions(app.getWorldEditor().getAllocator())
 		, m_resources(app.getWorldEditor().getAllocator())
 		, m_to_compile_subresources(app.getWorldEditor().getAllocator())
 		, m_dependencies(app.getWorldEditor().getAllocator())
+		, m_source_dependencies(app.getWorldEditor().getAllocator())
+		, m_compiling_done(true)
+		, m_file_hashes(app.getWorldEditor().getAllocator())
+		, m_compiled_hashes(app.getWorldEditor().getAllocator())
+		, m_pending_hashes(app.getWorldEditor().getAllocator())
+		, m_compiled_outputs(app.getWorldEditor().getAllocator())
+		, m_results(app.getWorldEditor().getAllocator())
 	{
 		FileSystem& fs = app.getWorldEditor().getEngine().getFileSystem();
 		m_watcher = FileSystemWatcher::create(fs.getBasePath(), app.getWorldEditor().getAllocator());
 		m_watcher->getCallback().bind<AssetCompilerImpl, &AssetCompilerImpl::onFileChanged>(this);
-		m_task.create("Asset compiler", true);
+		
+		IAllocator& allocator = app.getWorldEditor().getAllocator();
+		const u32 workers_count = getWorkersCountFromCommandLine();
+		for (u32 i = 0; i < workers_count; ++i) {
+			AssetCompilerTask* task = LUMIX_NEW(allocator, AssetCompilerTask)(*this, allocator);
+			task->create("Asset compiler", true);
+			m_tasks.push(task);
+		}
+
 		const char* base_path = m_app.getWorldEditor().getEngine().getFileSystem().getBasePath();
 		StaticString<MAX_PATH_LENGTH> path(base_path, ".lumix/assets");
 		OS::makePath(path);
+		m_local_cache_dir = path;
+		m_local_cache_dir << "/cache";
+		OS::makePath(m_local_cache_dir);
+		getSharedCacheDirFromCommandLine();
+		if (m_shared_cache_dir[0]) OS::makePath(m_shared_cache_dir);
 		ResourceManagerHub& rm = app.getWorldEditor().getEngine().getResourceManager();
 		rm.setLoadHook(&m_load_hook);
 	}
@@ -115,6 +172,7 @@ struct AssetCompilerImpl : AssetCompiler
 			}
 			file << "}\n\n";
 			file << "dependencies = {\n";
+			MT::CriticalSectionLock lock(m_dependencies_mutex);
 			for (auto iter = m_dependencies.begin(), end = m_dependencies.end(); iter != end; ++iter) {
 				file << "\t[\"" << iter.key().c_str() << "\"] = {\n";
 				for (const Path& p : iter.value()) {
@@ -129,12 +187,24 @@ struct AssetCompilerImpl : AssetCompiler
 		else {
 			logError("Editor") << "Could not save .lumix/assets/_list.txt";
 		}
+		saveHashes();
 
 		ASSERT(m_plugins.empty());
-		m_task.m_finished = true;
-		m_to_compile.emplace();
-		m_semaphore.signal();
-		m_task.destroy();
+		for (AssetCompilerTask* task : m_tasks) {
+			task->m_finished = true;
+		}
+		{
+			MT::CriticalSectionLock lock(m_to_compile_mutex);
+			for (int i = 0; i < m_tasks.size(); ++i) {
+				m_to_compile.emplace();
+				m_semaphore.signal();
+			}
+		}
+		IAllocator& allocator = m_app.getWorldEditor().getAllocator();
+		for (AssetCompilerTask* task : m_tasks) {
+			task->destroy();
+			LUMIX_DELETE(allocator, task);
+		}
 		ResourceManagerHub& rm = m_app.getWorldEditor().getEngine().getResourceManager();
 		rm.setLoadHook(nullptr);
 		FileSystemWatcher::destroy(m_watcher);
@@ -144,7 +214,9 @@ struct AssetCompilerImpl : AssetCompiler
 		const StaticString<MAX_PATH_LENGTH> dst(".lumix/assets/", src.getHash(), ".res");
 
 		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
-		return fs.copyFile(src.c_str(), dst);
+		if (!fs.copyFile(src.c_str(), dst)) return false;
+		onResourceCompiled(src.c_str(), src.getHash());
+		return true;
 	}
 
 	bool writeCompiledResource(const char* locator, Span<u8> data) override {
@@ -161,9 +233,312 @@ struct AssetCompilerImpl : AssetCompiler
 		const bool written = file.write(data.begin(), data.length());
 		if (!written) logError("Editor") << "Could not write " << out_path;
 		file.close();
+		if (written) onResourceCompiled(normalized, hash);
 		return written;
 	}
 
+
+	void getSharedCacheDirFromCommandLine()
+	{
+		m_shared_cache_dir.data[0] = '\0';
+		char cmd_line[2048];
+		OS::getCommandLine(Span(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (!parser.currentEquals("-asset_cache_dir")) continue;
+			if (!parser.next()) break;
+
+			char tmp[MAX_PATH_LENGTH];
+			parser.getCurrent(tmp, lengthOf(tmp));
+			PathUtils::normalize(tmp, Span(m_shared_cache_dir.data));
+			if (endsWith(m_shared_cache_dir, "/")) m_shared_cache_dir.data[stringLength(m_shared_cache_dir) - 1] = '\0';
+			break;
+		}
+	}
+
+
+	// content hash of a file, rehashed only if its modification time changed
+	u64 getFileHash(const char* path)
+	{
+		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
+		if (!fs.fileExists(path)) return 0;
+
+		const u64 last_modified = fs.getLastModified(path);
+		const Path path_obj(path);
+		{
+			MT::CriticalSectionLock lock(m_hashes_mutex);
+			auto iter = m_file_hashes.find(path_obj.getHash());
+			if (iter.isValid() && iter.value().last_modified == last_modified) return iter.value().hash;
+		}
+
+		Array<u8> content(m_app.getWorldEditor().getAllocator());
+		if (!fs.getContentSync(path_obj, Ref(content))) return 0;
+		FileHash file_hash;
+		file_hash.last_modified = last_modified;
+		file_hash.hash = hash64(content.begin(), content.byte_size());
+		
+		MT::CriticalSectionLock lock(m_hashes_mutex);
+		auto iter = m_file_hashes.find(path_obj.getHash());
+		if (iter.isValid()) {
+			iter.value() = file_hash;
+		}
+		else {
+			m_file_hashes.insert(path_obj.getHash(), file_hash);
+		}
+		return file_hash.hash;
+	}
+
+
+	// hash of source, .meta and compiler plugin version
+	u64 getSourceHash(const char* filepath)
+	{
+		const PathUtils::FileInfo info(filepath);
+		const StaticString<MAX_PATH_LENGTH> meta_path(info.m_dir, info.m_basename, ".meta");
+
+		u64 hash = getFileHash(filepath);
+		const u64 meta_hash = getFileHash(meta_path);
+		hash = continueHash64(hash, &meta_hash, sizeof(meta_hash));
+
+		char ext[16];
+		PathUtils::getExtension(Span(ext), filepath);
+		makeLowercase(Span(ext), ext);
+		u32 version = 0;
+		{
+			MT::CriticalSectionLock lock(m_plugin_mutex);
+			auto iter = m_plugins.find(crc32(ext));
+			if (iter.isValid()) version = iter.value()->getVersion();
+		}
+		return continueHash64(hash, &version, sizeof(version));
+	}
+
+
+	// hash of registered dependencies of `filepath`
+	u64 getDependenciesHash(const char* filepath)
+	{
+		Array<Path> dependencies(m_app.getWorldEditor().getAllocator());
+		{
+			MT::CriticalSectionLock lock(m_dependencies_mutex);
+			auto iter = m_source_dependencies.find(Path(filepath));
+			if (iter.isValid()) {
+				dependencies.reserve(iter.value().size());
+				for (const Path& dep : iter.value()) dependencies.push(dep);
+			}
+		}
+		// order independent, dependencies are registered in compile order
+		u64 deps_hash = 0;
+		for (const Path& dep : dependencies) {
+			const u64 dep_hash = getFileHash(dep.c_str());
+			deps_hash ^= continueHash64(dep.getHash(), &dep_hash, sizeof(dep_hash));
+		}
+		return deps_hash;
+	}
+
+
+	static u64 getInputHash(u64 source_hash, u64 dependencies_hash)
+	{
+		return continueHash64(source_hash, &dependencies_hash, sizeof(dependencies_hash));
+	}
+
+
+	// hash of everything the compiled version of `filepath` depends on
+	u64 getInputHash(const char* filepath)
+	{
+		return getInputHash(getSourceHash(filepath), getDependenciesHash(filepath));
+	}
+
+
+	u64 getCompiledHash(u32 res_hash)
+	{
+		MT::CriticalSectionLock lock(m_hashes_mutex);
+		auto iter = m_compiled_hashes.find(res_hash);
+		return iter.isValid() ? iter.value() : 0;
+	}
+
+
+	void setCompiledHash(u32 res_hash, u64 input_hash)
+	{
+		MT::CriticalSectionLock lock(m_hashes_mutex);
+		auto iter = m_compiled_hashes.find(res_hash);
+		if (iter.isValid()) {
+			iter.value() = input_hash;
+		}
+		else {
+			m_compiled_hashes.insert(res_hash, input_hash);
+		}
+	}
+
+
+	// called whenever a plugin writes a compiled resource, resources of queued sources are
+	// finished in onSourceCompiled, once all dependencies of the source are registered
+	void onResourceCompiled(const char* locator, u32 res_hash)
+	{
+		const Path src(getResourceFilePath(locator));
+		{
+			MT::CriticalSectionLock lock(m_hashes_mutex);
+			if (m_pending_hashes.find(src.getHash()).isValid()) {
+				auto iter = m_compiled_outputs.find(src.getHash());
+				if (!iter.isValid()) {
+					m_compiled_outputs.insert(src.getHash(), Array<u32>(m_app.getWorldEditor().getAllocator()));
+					iter = m_compiled_outputs.find(src.getHash());
+				}
+				if (iter.value().indexOf(res_hash) < 0) iter.value().push(res_hash);
+				return;
+			}
+		}
+		storeCompiled(res_hash, getInputHash(src.c_str()));
+	}
+
+
+	// called from compile workers after a queued source is compiled
+	void onSourceCompiled(const Path& src, bool success)
+	{
+		u64 source_hash = 0;
+		Array<u32> outputs(m_app.getWorldEditor().getAllocator());
+		{
+			MT::CriticalSectionLock lock(m_hashes_mutex);
+			auto iter = m_compiled_outputs.find(src.getHash());
+			if (iter.isValid()) {
+				outputs = static_cast<Array<u32>&&>(iter.value());
+				m_compiled_outputs.erase(iter);
+			}
+			auto pending_iter = m_pending_hashes.find(src.getHash());
+			if (pending_iter.isValid()) source_hash = pending_iter.value();
+		}
+		if (!success) return;
+
+		// source hash is from the time the source was queued, so changes made during the compilation 
+		// are not marked as compiled; dependencies are the ones registered by this compilation
+		if (source_hash == 0) source_hash = getSourceHash(src.c_str());
+		const u64 input_hash = getInputHash(source_hash, getDependenciesHash(src.c_str()));
+		for (u32 res_hash : outputs) storeCompiled(res_hash, input_hash);
+	}
+
+
+	void storeCompiled(u32 res_hash, u64 input_hash)
+	{
+		setCompiledHash(res_hash, input_hash);
+
+		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
+		const StaticString<MAX_PATH_LENGTH> res_path(fs.getBasePath(), ".lumix/assets/", res_hash, ".res");
+		const char* dirs[] = { m_local_cache_dir, m_shared_cache_dir };
+		for (const char* dir : dirs) {
+			if (!dir[0]) continue;
+			const StaticString<MAX_PATH_LENGTH> cache_path(dir, "/", input_hash, "_", res_hash, ".res");
+			if (!OS::copyFile(res_path, cache_path)) {
+				logWarning("Editor") << "Could not copy " << res_path << " to " << cache_path;
+			}
+		}
+	}
+
+
+	// .lumix/assets/*.res holds only the last compiled version of each resource, cache dirs keep
+	// all versions keyed by input hash, so e.g. switching branches back and forth does not recompile;
+	// local cache is trimmed to -asset_cache_size MB on startup, shared cache is never evicted by the editor,
+	// it's up to whoever hosts it
+	bool fetchFromCache(u32 res_hash, u64 input_hash)
+	{
+		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
+		const StaticString<MAX_PATH_LENGTH> res_path(fs.getBasePath(), ".lumix/assets/", res_hash, ".res");
+		const char* dirs[] = { m_local_cache_dir, m_shared_cache_dir };
+		for (const char* dir : dirs) {
+			if (!dir[0]) continue;
+
+			const StaticString<MAX_PATH_LENGTH> cache_path(dir, "/", input_hash, "_", res_hash, ".res");
+			if (!OS::fileExists(cache_path)) continue;
+			if (!OS::copyFile(cache_path, res_path)) continue;
+
+			setCompiledHash(res_hash, input_hash);
+			return true;
+		}
+		return false;
+	}
+
+
+	void saveHashes()
+	{
+		OutputMemoryStream blob(m_app.getWorldEditor().getAllocator());
+		{
+			MT::CriticalSectionLock lock(m_hashes_mutex);
+			blob.write(HASHES_MAGIC);
+			blob.write(HashesVersion::LATEST);
+			blob.write(m_file_hashes.size());
+			for (auto iter = m_file_hashes.begin(), end = m_file_hashes.end(); iter != end; ++iter) {
+				blob.write(iter.key());
+				blob.write(iter.value().last_modified);
+				blob.write(iter.value().hash);
+			}
+			blob.write(m_compiled_hashes.size());
+			for (auto iter = m_compiled_hashes.begin(), end = m_compiled_hashes.end(); iter != end; ++iter) {
+				blob.write(iter.key());
+				blob.write(iter.value());
+			}
+		}
+
+		OS::OutputFile file;
+		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
+		if (!fs.open(".lumix/assets/_hashes.bin", Ref(file))) {
+			logError("Editor") << "Could not save .lumix/assets/_hashes.bin";
+			return;
+		}
+		if (!file.write(blob.getData(), blob.getPos())) {
+			logError("Editor") << "Could not write .lumix/assets/_hashes.bin";
+		}
+		file.close();
+	}
+
+
+	void loadHashes()
+	{
+		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
+		Array<u8> data(m_app.getWorldEditor().getAllocator());
+		if (!fs.getContentSync(Path(".lumix/assets/_hashes.bin"), Ref(data))) return;
+
+		InputMemoryStream blob(data.begin(), data.byte_size());
+		u32 magic;
+		HashesVersion version;
+		if (!blob.read(&magic, sizeof(magic)) || !blob.read(&version, sizeof(version))
+			|| magic != HASHES_MAGIC || version != HashesVersion::LATEST) 
+		{
+			logWarning("Editor") << ".lumix/assets/_hashes.bin has unsupported format, ignoring";
+			return;
+		}
+
+		// counts must fit in the rest of the file
+		auto readCount = [&](u64 item_size, u32& count){
+			if (!blob.read(&count, sizeof(count))) return false;
+			return (u64)count * item_size <= blob.size() - blob.getPosition();
+		};
+
+		const u64 file_hash_size = sizeof(u32) + 2 * sizeof(u64);
+		const u64 compiled_hash_size = sizeof(u32) + sizeof(u64);
+		MT::CriticalSectionLock lock(m_hashes_mutex);
+		u32 count;
+		if (!readCount(file_hash_size, count)) {
+			logWarning("Editor") << ".lumix/assets/_hashes.bin is corrupted, ignoring";
+			return;
+		}
+		m_file_hashes.reserve(count);
+		for (u32 i = 0; i < count; ++i) {
+			const u32 key = blob.read<u32>();
+			FileHash value;
+			value.last_modified = blob.read<u64>();
+			value.hash = blob.read<u64>();
+			m_file_hashes.insert(key, value);
+		}
+		if (!readCount(compiled_hash_size, count)) {
+			logWarning("Editor") << ".lumix/assets/_hashes.bin is corrupted, ignoring compiled hashes";
+			return;
+		}
+		m_compiled_hashes.reserve(count);
+		for (u32 i = 0; i < count; ++i) {
+			const u32 key = blob.read<u32>();
+			const u64 value = blob.read<u64>();
+			m_compiled_hashes.insert(key, value);
+		}
+	}
+
 	void addResource(ResourceType type, const char* path) override {
 		const Path path_obj(path);
 		MT::CriticalSectionLock lock(m_resources_mutex);
@@ -252,15 +627,32 @@ struct AssetCompilerImpl : AssetCompiler
 	}
 
 
-	void registerDependency(const Path& included_from, const Path& dependency) override
+	static Array<Path>& getOrCreate(HashMap<Path, Array<Path>>& map, const Path& key, IAllocator& allocator)
 	{
-		auto iter = m_dependencies.find(dependency);
+		auto iter = map.find(key);
 		if (!iter.isValid()) {
-			IAllocator& allocator = m_app.getWorldEditor().getAllocator();
-			m_dependencies.insert(dependency, Array<Path>(allocator));
-			iter = m_dependencies.find(dependency);
+			map.insert(key, Array<Path>(allocator));
+			iter = map.find(key);
 		}
-		iter.value().push(included_from);
+		return iter.value();
+	}
+
+
+	// must be called with m_dependencies_mutex locked
+	void addDependency(const Path& included_from, const Path& dependency)
+	{
+		IAllocator& allocator = m_app.getWorldEditor().getAllocator();
+		Array<Path>& dependants = getOrCreate(m_dependencies, dependency, allocator);
+		if (dependants.indexOf(included_from) >= 0) return;
+		dependants.push(included_from);
+		getOrCreate(m_source_dependencies, included_from, allocator).push(dependency);
+	}
+
+
+	void registerDependency(const Path& included_from, const Path& dependency) override
+	{
+		MT::CriticalSectionLock lock(m_dependencies_mutex);
+		addDependency(included_from, dependency);
 	}
 
 
@@ -304,6 +696,8 @@ struct AssetCompilerImpl : AssetCompiler
 				lua_getglobal(L, "dependencies");
 				if (lua_type(L, -1) != LUA_TTABLE) return;
 
+				MT::CriticalSectionLock lock(m_dependencies_mutex);
+
 				lua_pushnil(L);
 				while (lua_next(L, -2) != 0) {
 					if (!lua_isstring(L, -2) || !lua_istable(L, -1)) {
@@ -313,13 +707,9 @@ struct AssetCompilerImpl : AssetCompiler
 					}
 					
 					const char* key = lua_tostring(L, -2);
-					IAllocator& allocator = m_app.getWorldEditor().getAllocator();
 					const Path key_path(key);
-					m_dependencies.insert(key_path, Array<Path>(allocator));
-					Array<Path>& values = m_dependencies.find(key_path).value();
-
-					LuaWrapper::forEachArrayItem<Path>(L, -1, "array of strings expected", [&values](const Path& p){ 
-						values.push(p); 
+					LuaWrapper::forEachArrayItem<Path>(L, -1, "array of strings expected", [&](const Path& p){ 
+						addDependency(p, key_path);
 					});
 
 					lua_pop(L, 1);
@@ -331,6 +721,9 @@ struct AssetCompilerImpl : AssetCompiler
 			lua_close(L);
 		}
 
+		loadHashes();
+		evictLocalCache();
+
 		const u64 list_last_modified = OS::getLastModified(list_path);
 		processDir("", list_last_modified);
 
@@ -350,8 +743,15 @@ struct AssetCompilerImpl : AssetCompiler
 		});
 
 		const Path path_obj(path);
-		for (Array<Path>& deps : m_dependencies) {
-			deps.eraseItems([&](const Path& p){ return p == path_obj; });
+		MT::CriticalSectionLock deps_lock(m_dependencies_mutex);
+		auto iter = m_source_dependencies.find(path_obj);
+		if (iter.isValid()) {
+			for (const Path& dependency : iter.value()) {
+				auto dependants_iter = m_dependencies.find(dependency);
+				if (!dependants_iter.isValid()) continue;
+				dependants_iter.value().eraseItems([&](const Path& p){ return p == path_obj; });
+			}
+			m_source_dependencies.erase(iter);
 		}
 
 		return res;
@@ -377,11 +777,17 @@ struct AssetCompilerImpl : AssetCompiler
 		addResource(path);
 		reloadSubresources(removed_subresources);
 
-		auto iter = m_dependencies.find(path_obj);
-		if (iter.isValid()) {
-			const Array<Path> tmp(iter.value());
-			m_dependencies.erase(iter);
-			for (Path& p : tmp) {
+		Array<Path> dependants(m_app.getWorldEditor().getAllocator());
+		{
+			MT::CriticalSectionLock lock(m_dependencies_mutex);
+			auto iter = m_dependencies.find(path_obj);
+			if (iter.isValid()) {
+				dependants = static_cast<Array<Path>&&>(iter.value());
+				m_dependencies.erase(iter);
+			}
+		}
+		if (!dependants.empty()) {
+			for (Path& p : dependants) {
 				Array<Path> removed_subresources = removeResource(p.c_str());
 				addResource(p.c_str());
 				reloadSubresources(removed_subresources);
@@ -443,18 +849,320 @@ struct AssetCompilerImpl : AssetCompiler
 	}
 
 
+	static u64 getCacheSizeFromCommandLine()
+	{
+		char cmd_line[2048];
+		OS::getCommandLine(Span(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (!parser.currentEquals("-asset_cache_size")) continue;
+			if (!parser.next()) break;
+
+			char tmp[16];
+			parser.getCurrent(tmp, lengthOf(tmp));
+			u32 size_mb;
+			if (fromCString(Span(tmp, stringLength(tmp)), Ref(size_mb))) return (u64)size_mb << 20;
+			break;
+		}
+		return DEFAULT_CACHE_SIZE;
+	}
+
+
+	// drops the oldest versions once the local cache is over its size limit
+	void evictLocalCache()
+	{
+		struct CacheFile
+		{
+			u64 last_modified;
+			u64 size;
+			StaticString<MAX_PATH_LENGTH> path;
+		};
+
+		IAllocator& allocator = m_app.getWorldEditor().getAllocator();
+		Array<CacheFile> files(allocator);
+		u64 total_size = 0;
+		OS::FileIterator* iter = OS::createFileIterator(m_local_cache_dir, allocator);
+		OS::FileInfo info;
+		while (OS::getNextFile(iter, &info)) {
+			if (info.is_directory) continue;
+			CacheFile& file = files.emplace();
+			file.path = m_local_cache_dir;
+			file.path << "/" << info.filename;
+			file.size = OS::getFileSize(file.path);
+			file.last_modified = OS::getLastModified(file.path);
+			total_size += file.size;
+		}
+		OS::destroyFileIterator(iter);
+
+		const u64 max_size = getCacheSizeFromCommandLine();
+		if (total_size <= max_size) return;
+
+		qsort(files.begin(), files.size(), sizeof(files[0]), [](const void* a, const void* b) -> int {
+			const u64 a_time = ((const CacheFile*)a)->last_modified;
+			const u64 b_time = ((const CacheFile*)b)->last_modified;
+			return a_time < b_time ? -1 : (a_time > b_time ? 1 : 0);
+		});
+
+		u32 deleted = 0;
+		for (const CacheFile& file : files) {
+			if (total_size <= max_size) break;
+			if (!OS::deleteFile(file.path)) continue;
+			total_size -= file.size;
+			++deleted;
+		}
+		logInfo("Editor") << "Evicted " << deleted << " files from " << m_local_cache_dir;
+	}
+
+
+	static u32 getWorkersCountFromCommandLine()
+	{
+		char cmd_line[2048];
+		OS::getCommandLine(Span(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (!parser.currentEquals("-asset_compile_workers")) continue;
+			if (!parser.next()) break;
+
+			char tmp[16];
+			parser.getCurrent(tmp, lengthOf(tmp));
+			u32 count;
+			if (fromCString(Span(tmp, stringLength(tmp)), Ref(count)) && count > 0) return count;
+			break;
+		}
+		return maximum(1, (i32)MT::getCPUsCount() - 1);
+	}
+
+
 	bool compile(const Path& src) override
 	{
 		char ext[16];
 		PathUtils::getExtension(Span(ext), src.c_str());
 		const u32 hash = crc32(ext);
+		IPlugin* plugin;
+		{
+			MT::CriticalSectionLock lock(m_plugin_mutex);
+			auto iter = m_plugins.find(hash);
+			if (!iter.isValid()) return false;
+			plugin = iter.value();
+			// removePlugin waits until this gets back to zero
+			++m_compiling_count;
+		}
+
+		bool res;
+		if (plugin->isThreadSafe()) {
+			res = plugin->compile(src);
+		}
+		else {
+			MT::CriticalSectionLock lock(m_serial_compile_mutex);
+			res = plugin->compile(src);
+		}
+
 		MT::CriticalSectionLock lock(m_plugin_mutex);
-		auto iter = m_plugins.find(hash);
-		if (!iter.isValid()) return false;
-		return iter.value()->compile(src);
+		--m_compiling_count;
+		if (m_compiling_count == 0) m_compiling_done.trigger();
+		return res;
+	}
+
+
+	// must be called with m_to_compile_mutex locked
+	bool isQueued(const Path& path) const { return m_queued.find(path).isValid(); }
+
+
+	// must be called with m_to_compile_mutex locked
+	// resources wait until their queued dependencies (e.g. included files) are compiled
+	bool pushToCompile(const Path& path)
+	{
+		if (isQueued(path)) return false;
+
+		QueuedResource queued;
+		queued.order = ++m_queue_order;
+		queued.pending_dependencies = 0;
+		{
+			MT::CriticalSectionLock lock(m_dependencies_mutex);
+			auto iter = m_source_dependencies.find(path);
+			if (iter.isValid()) {
+				for (const Path& dependency : iter.value()) {
+					if (dependency != path && isQueued(dependency)) ++queued.pending_dependencies;
+				}
+			}
+		}
+		m_queued.insert(path, queued);
+		if (queued.pending_dependencies == 0) {
+			m_to_compile.push(path);
+			m_semaphore.signal();
+		}
+		return true;
+	}
+
+
+	// must be called with m_to_compile_mutex locked
+	void onCompileFinished(const Path& path)
+	{
+		auto iter = m_queued.find(path);
+		if (!iter.isValid()) return;
+		const u32 order = iter.value().order;
+		m_queued.erase(iter);
+
+		MT::CriticalSectionLock lock(m_dependencies_mutex);
+		auto dependants_iter = m_dependencies.find(path);
+		if (!dependants_iter.isValid()) return;
+		for (const Path& dependant : dependants_iter.value()) {
+			auto queued_iter = m_queued.find(dependant);
+			if (!queued_iter.isValid()) continue;
+			QueuedResource& queued = queued_iter.value();
+			// dependants queued before `path` did not wait for it
+			if (queued.order < order || queued.pending_dependencies == 0) continue;
+			--queued.pending_dependencies;
+			if (queued.pending_dependencies == 0) {
+				m_to_compile.push(dependant);
+				m_semaphore.signal();
+			}
+		}
+	}
+
+
+	Path popToCompile(AssetCompilerTask& task)
+	{
+		MT::CriticalSectionLock lock(m_to_compile_mutex);
+		if (m_to_compile.empty()) return Path();
+		const Path p = m_to_compile.back();
+		m_to_compile.pop();
+		task.m_res_in_progress = p;
+		return p;
 	}
 	
 
+	bool compileAll(IOutputStream& report) override
+	{
+		OS::Timer timer;
+		IAllocator& allocator = m_app.getWorldEditor().getAllocator();
+		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
+
+		{
+			// before up to date checks, so sources compiled from now on are not missed
+			MT::CriticalSectionLock lock(m_compiled_mutex);
+			m_results.clear();
+			m_collect_results = true;
+		}
+
+		Array<Path> resources(allocator);
+		{
+			MT::CriticalSectionLock lock(m_resources_mutex);
+			resources.reserve(m_resources.size());
+			for (const ResourceItem& ri : m_resources) resources.push(ri.path);
+		}
+
+		// source path hash -> source hash, for sources with at least one out of date resource
+		HashMap<u32, u64> to_compile(allocator);
+		Array<Path> up_to_date(allocator);
+		for (const Path& res : resources) {
+			const char* filepath = getResourceFilePath(res.c_str());
+			const Path src(filepath);
+			if (to_compile.find(src.getHash()).isValid()) continue;
+
+			const u64 source_hash = getSourceHash(filepath);
+			const u64 input_hash = getInputHash(source_hash, getDependenciesHash(filepath));
+			const StaticString<MAX_PATH_LENGTH> dst_path(".lumix/assets/", res.getHash(), ".res");
+			if ((getCompiledHash(res.getHash()) == input_hash && fs.fileExists(dst_path))
+				|| fetchFromCache(res.getHash(), input_hash))
+			{
+				up_to_date.push(res);
+				continue;
+			}
+			to_compile.insert(src.getHash(), source_hash);
+		}
+
+		// sources this call waits for, some of them can be already queued by onBeforeLoad
+		HashMap<u32, Path> waiting(allocator);
+		{
+			MT::CriticalSectionLock lock(m_to_compile_mutex);
+			MT::CriticalSectionLock hashes_lock(m_hashes_mutex);
+			for (const Path& res : resources) {
+				const Path src(getResourceFilePath(res.c_str()));
+				auto iter = to_compile.find(src.getHash());
+				if (!iter.isValid() || waiting.find(src.getHash()).isValid()) continue;
+
+				waiting.insert(src.getHash(), src);
+				if (isQueued(src)) continue;
+
+				auto pending_iter = m_pending_hashes.find(src.getHash());
+				if (pending_iter.isValid()) {
+					pending_iter.value() = iter.value();
+				}
+				else {
+					m_pending_hashes.insert(src.getHash(), iter.value());
+				}
+				pushToCompile(src);
+			}
+		}
+
+		Array<CompileResult> results(allocator);
+		u32 processed_results = 0;
+		while (!waiting.empty()) {
+			bool idle;
+			{
+				MT::CriticalSectionLock lock(m_to_compile_mutex);
+				idle = m_queued.empty();
+			}
+			{
+				// workers publish results before they clear m_res_in_progress, so if they were idle,
+				// every result is already here
+				MT::CriticalSectionLock lock(m_compiled_mutex);
+				for (; processed_results < (u32)m_results.size(); ++processed_results) {
+					const CompileResult& r = m_results[processed_results];
+					auto iter = waiting.find(r.path.getHash());
+					if (!iter.isValid()) continue;
+					waiting.erase(iter);
+					results.push(r);
+				}
+			}
+			if (waiting.empty()) break;
+			if (idle) {
+				logError("Editor") << waiting.size() << " resources were not compiled, compile queue is empty"
+					<< (m_tasks.empty() ? " and there are no compile workers" : "");
+				break;
+			}
+			MT::sleep(10);
+		}
+
+		MT::CriticalSectionLock lock(m_compiled_mutex);
+		m_collect_results = false;
+		m_results.clear();
+		{
+			MT::CriticalSectionLock hashes_lock(m_hashes_mutex);
+			for (const CompileResult& r : results) m_pending_hashes.erase(r.path.getHash());
+		}
+
+		u32 failed_count = waiting.size();
+		report << "results = {\n";
+		for (const CompileResult& r : results) {
+			if (!r.success) ++failed_count;
+			report << "\t{ path = \"" << r.path.c_str() << "\", status = \"" << (r.success ? "compiled" : "failed") 
+				<< "\", time = " << r.time << " },\n";
+		}
+		for (const Path& p : waiting) {
+			report << "\t{ path = \"" << p.c_str() << "\", status = \"not_compiled\" },\n";
+		}
+		for (const Path& p : up_to_date) {
+			report << "\t{ path = \"" << p.c_str() << "\", status = \"up_to_date\" },\n";
+		}
+		report << "}\n";
+		report << "compiled = " << (u32)results.size() - (failed_count - waiting.size()) << "\n";
+		report << "failed = " << failed_count << "\n";
+		report << "up_to_date = " << (u32)up_to_date.size() << "\n";
+		report << "total_time = " << timer.getTimeSinceStart() << "\n";
+
+		logInfo("Editor") << "Compiled " << results.size() - (failed_count - waiting.size()) << " resources, " 
+			<< failed_count << " failed, " << up_to_date.size() << " up to date, in " 
+			<< timer.getTimeSinceStart() << " s";
+		return failed_count == 0;
+	}
+
+
 	static const char* getResourceFilePath(const char* str)
 	{
 		const char* c = str;
@@ -473,23 +1181,42 @@ struct AssetCompilerImpl : AssetCompiler
 
 		const u32 hash = res.getPath().getHash();
 		const StaticString<MAX_PATH_LENGTH> dst_path(".lumix/assets/", hash, ".res");
-		const PathUtils::FileInfo info(filepath);
-		const StaticString<MAX_PATH_LENGTH> meta_path(info.m_dir, info.m_basename, ".meta");
+		const u64 source_hash = getSourceHash(filepath);
+		const u64 input_hash = getInputHash(source_hash, getDependenciesHash(filepath));
+		const u64 compiled_hash = getCompiledHash(hash);
+
+		bool up_to_date = compiled_hash == input_hash && fs.fileExists(dst_path);
+		if (!up_to_date && compiled_hash == 0 && fs.fileExists(dst_path)) {
+			// compiled before hashes were tracked, trust modification times once
+			const PathUtils::FileInfo info(filepath);
+			const StaticString<MAX_PATH_LENGTH> meta_path(info.m_dir, info.m_basename, ".meta");
+			up_to_date = fs.getLastModified(dst_path) >= fs.getLastModified(filepath)
+				&& fs.getLastModified(dst_path) >= fs.getLastModified(meta_path);
+			if (up_to_date) setCompiledHash(hash, input_hash);
+		}
+		if (!up_to_date) up_to_date = fetchFromCache(hash, input_hash);
 
-		if (!fs.fileExists(dst_path)
-			|| fs.getLastModified(dst_path) < fs.getLastModified(filepath)
-			|| fs.getLastModified(dst_path) < fs.getLastModified(meta_path)
-			)
+		if (!up_to_date)
 		{
 			logInfo("Editor") << res.getPath() << " is not compiled, pushing to compile queue";
 			MT::CriticalSectionLock lock(m_to_compile_mutex);
 			const Path path(filepath);
+			{
+				MT::CriticalSectionLock hashes_lock(m_hashes_mutex);
+				auto hash_iter = m_pending_hashes.find(path.getHash());
+				if (hash_iter.isValid()) {
+					hash_iter.value() = source_hash;
+				}
+				else {
+					m_pending_hashes.insert(path.getHash(), source_hash);
+				}
+			}
 			auto iter = m_to_compile_subresources.find(path);
 			if (!iter.isValid()) {
-				m_to_compile.push(path);
+				pushToCompile(path);
+				if (m_compile_batch_count == 0) m_batch_timer.tick();
 				++m_compile_batch_count;
 				++m_batch_remaining_count;
-				m_semaphore.signal();
 				IAllocator& allocator = m_app.getWorldEditor().getAllocator();
 				m_to_compile_subresources.insert(path, Array<Resource*>(allocator));
 				iter = m_to_compile_subresources.find(path);
@@ -547,14 +1274,15 @@ struct AssetCompilerImpl : AssetCompiler
 			| ImGuiWindowFlags_NoSavedSettings;
 		ImGui::PushStyleVar(ImGuiStyleVar_WindowBorderSize, 1);
 		if (ImGui::Begin("Resource compilation", nullptr, flags)) {
-			ImGui::Text("%s", "Compiling resources...");
+			const u32 done_count = m_compile_batch_count - m_batch_remaining_count;
+			const float time = m_batch_timer.getTimeSinceTick();
+			ImGui::Text("Compiling resources... %d / %d", done_count, m_compile_batch_count);
+			ImGui::Text("%d workers, %.1f resources/s", m_tasks.size(), time > 0 ? done_count / time : 0.f);
 			ImGui::ProgressBar(((float)m_compile_batch_count - m_batch_remaining_count) / m_compile_batch_count);
-			StaticString<MAX_PATH_LENGTH> path;
-			{
-				MT::CriticalSectionLock lock(m_to_compile_mutex);
-				path = m_res_in_progress;
+			MT::CriticalSectionLock lock(m_to_compile_mutex);
+			for (const AssetCompilerTask* task : m_tasks) {
+				if (task->m_res_in_progress.isValid()) ImGui::TextWrapped("%s", task->m_res_in_progress.c_str());
 			}
-			ImGui::TextWrapped("%s", path.data);
 		}
 		ImGui::End();
 		ImGui::PopStyleVar();
@@ -569,28 +1297,43 @@ struct AssetCompilerImpl : AssetCompiler
 			// this can take some time, mutex is probably not the best option
 			MT::CriticalSectionLock lock(m_compiled_mutex);
 
-			for (Resource* r : m_to_compile_subresources[p]) {
+			auto iter = m_to_compile_subresources.find(p);
+			if (!iter.isValid()) continue;
+			for (Resource* r : iter.value()) {
 				m_load_hook.continueLoad(*r);
 			}
-			m_to_compile_subresources.erase(p);
+			m_to_compile_subresources.erase(iter);
+			MT::CriticalSectionLock hashes_lock(m_hashes_mutex);
+			m_pending_hashes.erase(p.getHash());
 		}
 	}
 
 
 	void removePlugin(IPlugin& plugin) override
 	{
-		MT::CriticalSectionLock lock(m_plugin_mutex);
-		bool removed;
-		do {
-			removed = false;
-			for(auto iter = m_plugins.begin(), end = m_plugins.end(); iter != end; ++iter) {
-				if (iter.value() == &plugin) {
-					m_plugins.erase(iter);
-					removed = true;
-					break;
+		{
+			MT::CriticalSectionLock lock(m_plugin_mutex);
+			bool removed;
+			do {
+				removed = false;
+				for(auto iter = m_plugins.begin(), end = m_plugins.end(); iter != end; ++iter) {
+					if (iter.value() == &plugin) {
+						m_plugins.erase(iter);
+						removed = true;
+						break;
+					}
 				}
+			} while(removed);
+		}
+		// plugins are not locked while compiling, wait for compilations in flight
+		for (;;) {
+			{
+				MT::CriticalSectionLock lock(m_plugin_mutex);
+				if (m_compiling_count == 0) break;
+				m_compiling_done.reset();
 			}
-		} while(removed);
+			m_compiling_done.wait();
+		}
 	}
 
 	void addPlugin(IPlugin& plugin, const char** extensions) override
@@ -617,22 +1360,47 @@ struct AssetCompilerImpl : AssetCompiler
 	MT::CriticalSection m_to_compile_mutex;
 	MT::CriticalSection m_compiled_mutex;
 	MT::CriticalSection m_plugin_mutex;
+	MT::CriticalSection m_serial_compile_mutex;
+	MT::CriticalSection m_dependencies_mutex;
+	MT::CriticalSection m_hashes_mutex;
+	HashMap<u32, FileHash> m_file_hashes;
+	// compiled resource path hash -> input hash it was compiled from
+	HashMap<u32, u64> m_compiled_hashes;
+	// source path hash -> source hash, for sources in the compile queue
+	HashMap<u32, u64> m_pending_hashes;
+	// source path hash -> resources written while compiling the source
+	HashMap<u32, Array<u32>> m_compiled_outputs;
+	StaticString<MAX_PATH_LENGTH> m_local_cache_dir;
+	StaticString<MAX_PATH_LENGTH> m_shared_cache_dir;
+	// guarded by m_plugin_mutex
+	u32 m_compiling_count = 0;
+	MT::Event m_compiling_done;
 	HashMap<Path, Array<Resource*>> m_to_compile_subresources; 
+	// dependency -> sources which depend on it
 	HashMap<Path, Array<Path>> m_dependencies;
+	// source -> its dependencies, inverse of m_dependencies
+	HashMap<Path, Array<Path>> m_source_dependencies;
+	// queued resources with no pending dependencies
 	Array<Path> m_to_compile;
+	// resources in m_to_compile, waiting for dependencies or compiling
+	HashMap<Path, QueuedResource> m_queued;
+	u32 m_queue_order = 0;
 	Array<Path> m_compiled;
 	StudioApp& m_app;
 	LoadHook m_load_hook;
 	HashMap<u32, IPlugin*> m_plugins;
-	AssetCompilerTask m_task;
+	Array<AssetCompilerTask*> m_tasks;
 	FileSystemWatcher* m_watcher;
 	MT::CriticalSection m_resources_mutex;
 	HashMap<u32, ResourceItem> m_resources;
 	HashMap<u32, ResourceType> m_registered_extensions;
 
+	// per-source results collected by workers during compileAll
+	Array<CompileResult> m_results;
+	bool m_collect_results = false;
 	u32 m_compile_batch_count = 0;
 	u32 m_batch_remaining_count = 0;
-	StaticString<MAX_PATH_LENGTH> m_res_in_progress;
+	OS::Timer m_batch_timer;
 };
 
 
@@ -640,25 +1408,33 @@ int AssetCompilerTask::task()
 {
 	while (!m_finished) {
 		m_compiler.m_semaphore.wait();
-		const Path p = [&]{
-			MT::CriticalSectionLock lock(m_compiler.m_to_compile_mutex);
-			Path p = m_compiler.m_to_compile.back();
-			m_compiler.m_res_in_progress = p.c_str();
-			m_compiler.m_to_compile.pop();
-			return p;
-		}();
+		const Path p = m_compiler.popToCompile(*this);
 		if (p.isValid()) {
 			PROFILE_BLOCK("compile asset");
 			Profiler::pushString(p.c_str());
 			logInfo("Editor") << "Compiling " << p << "...";
+			OS::Timer timer;
 			const bool compiled = m_compiler.compile(p);
-			if (compiled) {
-				MT::CriticalSectionLock lock(m_compiler.m_compiled_mutex);
-				m_compiler.m_compiled.push(p);
+			const float time = timer.getTimeSinceStart();
+			if (!compiled) logError("Editor") << "Failed to compile resource " << p;
+			m_compiler.onSourceCompiled(p, compiled);
+
+			bool requested;
+			{
+				MT::CriticalSectionLock lock(m_compiler.m_to_compile_mutex);
+				requested = m_compiler.m_to_compile_subresources.find(p).isValid();
 			}
-			else {
-				logError("Editor") << "Failed to compile resource " << p;
+
+			{
+				MT::CriticalSectionLock lock(m_compiler.m_compiled_mutex);
+				if (compiled && requested) m_compiler.m_compiled.push(p);
+				if (m_compiler.m_collect_results) m_compiler.m_results.push({p, time, compiled});
 			}
+
+			// after results are published, compileAll relies on this order
+			MT::CriticalSectionLock lock(m_compiler.m_to_compile_mutex);
+			m_res_in_progress = Path();
+			m_compiler.onCompileFinished(p);
 		}
 	}
 	return 0;
@@ -9,6 +9,7 @@ namespace Lumix
 {
 
 
+struct IOutputStream;
 class OutputMemoryStream;
 class Path;
 struct ResourceType;
@@ -34,6 +35,10 @@ struct AssetCompiler
 		virtual ~IPlugin() {}
 		virtual bool compile(const Path& src) = 0;
 		virtual void addSubresources(AssetCompiler& compiler, const char* path);
+		// plugins which can run several compile() calls at once, the rest are serialized
+		virtual bool isThreadSafe() const { return false; }
+		// bump to invalidate resources compiled by older versions of the plugin
+		virtual u32 getVersion() const { return 0; }
 	};
 
 	struct ResourceItem {
@@ -60,6 +65,9 @@ struct AssetCompiler
 	virtual void addResource(ResourceType type, const char* path) = 0;
 	virtual bool writeCompiledResource(const char* locator, Span<u8> data) = 0;
 	virtual bool copyCompile(const Path& src) = 0;
+	// blocks until all out of date resources are compiled, writes per-resource results
+	// as a lua table to `report`, returns false if any resource failed to compile
+	virtual bool compileAll(IOutputStream& report) = 0;
 
 	virtual ResourceType getResourceType(const char* path) const = 0;
 	virtual void registerExtension(const char* extension, ResourceType type) = 0;
@@ -26,7 +26,29 @@ namespace Lumix
 {
 
 
-class AssetBrowserPlugin final : public AssetBrowser::IPlugin, public AssetCompiler::IPlugin
+class PrefabCompiler final : public AssetCompiler::IPlugin
+{
+public:
+	explicit PrefabCompiler(StudioApp& app)
+		: app(app)
+	{
+		app.getAssetCompiler().registerExtension("fab", PrefabResource::TYPE);
+	}
+
+
+	bool compile(const Path& src) override
+	{
+		return app.getAssetCompiler().copyCompile(src);
+	}
+
+	bool isThreadSafe() const override { return true; }
+
+
+	StudioApp& app;
+};
+
+
+class AssetBrowserPlugin final : public AssetBrowser::IPlugin
 {
 public:
 	AssetBrowserPlugin(StudioApp& app, PrefabSystem& system)
@@ -34,7 +56,6 @@ public:
 		, editor(app.getWorldEditor())
 		, app(app)
 	{
-		app.getAssetCompiler().registerExtension("fab", PrefabResource::TYPE);
 	}
 
 
@@ -47,12 +68,6 @@ public:
 			system.instantiatePrefab(*(PrefabResource*)resources[0], editor.getCameraRaycastHit(), {0, 0, 0, 1}, 1);
 		}
 	}
-	
-	
-	bool compile(const Path& src) override
-	{
-		return app.getAssetCompiler().copyCompile(src);
-	}
 
 
 	void onResourceUnloaded(Resource* resource) override {}
@@ -739,23 +754,39 @@ void PrefabSystem::destroy(PrefabSystem* system)
 
 
 static AssetBrowserPlugin* ab_plugin = nullptr;
+static PrefabCompiler* compiler_plugin = nullptr;
+
+
+void PrefabSystem::createCompilerPlugins(StudioApp& app)
+{
+	compiler_plugin = LUMIX_NEW(app.getWorldEditor().getAllocator(), PrefabCompiler)(app);
+	const char* extensions[] = { "fab", nullptr };
+	app.getAssetCompiler().addPlugin(*compiler_plugin, extensions);
+}
+
+
+void PrefabSystem::destroyCompilerPlugins(StudioApp& app)
+{
+	app.getAssetCompiler().removePlugin(*compiler_plugin);
+	LUMIX_DELETE(app.getWorldEditor().getAllocator(), compiler_plugin);
+	compiler_plugin = nullptr;
+}
 
 
 void PrefabSystem::createEditorPlugins(StudioApp& app, PrefabSystem& system)
 {
+	createCompilerPlugins(app);
 	ab_plugin = LUMIX_NEW(app.getWorldEditor().getAllocator(), AssetBrowserPlugin)(app, system);
 	app.getAssetBrowser().addPlugin(*ab_plugin);
-	const char* extensions[] = { "fab", nullptr };
-	app.getAssetCompiler().addPlugin(*ab_plugin, extensions);
 }
 
 
 void PrefabSystem::destroyEditorPlugins(StudioApp& app)
 {
 	app.getAssetBrowser().removePlugin(*ab_plugin);
-	app.getAssetCompiler().removePlugin(*ab_plugin);
 	LUMIX_DELETE(app.getWorldEditor().getAllocator(), ab_plugin);
 	ab_plugin = nullptr;
+	destroyCompilerPlugins(app);
 }
 
 
@@ -28,6 +28,9 @@ public:
 	static void destroy(PrefabSystem* system);
 	static void createEditorPlugins(StudioApp& app, PrefabSystem& system);
 	static void destroyEditorPlugins(StudioApp& app);
+	// included in createEditorPlugins, the cooker uses only these
+	static void createCompilerPlugins(StudioApp& app);
+	static void destroyCompilerPlugins(StudioApp& app);
 
 	virtual ~PrefabSystem() {}
 	virtual void serialize(IOutputStream& serializer) = 0;
@@ -133,8 +133,9 @@ struct LuaPlugin : public StudioApp::GUIPlugin
 class StudioAppImpl final : public StudioApp
 {
 public:
-	StudioAppImpl()
-		: m_is_entity_list_open(true)
+	explicit StudioAppImpl(bool is_cooker)
+		: m_is_cooker(is_cooker)
+		, m_is_entity_list_open(true)
 		, m_is_save_as_dialog_open(false)
 		, m_finished(false)
 		, m_deferred_game_mode_exit(false)
@@ -151,6 +152,7 @@ public:
 		, m_settings(*this)
 		, m_gui_plugins(m_allocator)
 		, m_plugins(m_allocator)
+		, m_compiler_libraries(m_allocator)
 		, m_add_cmp_plugins(m_allocator)
 		, m_component_labels(m_allocator)
 		, m_confirm_load(false)
@@ -260,9 +262,17 @@ public:
 	void run() override
 	{
 		JobSystem::SignalHandle finished = JobSystem::INVALID_HANDLE;
-		JobSystem::runEx(this, [](void* data) {
-			Lumix::OS::run(*(StudioAppImpl*)data);
-		}, &finished, JobSystem::INVALID_HANDLE, 0);
+		if (m_is_cooker) {
+			// no window, so no OS loop either
+			JobSystem::runEx(this, [](void* data) {
+				((StudioAppImpl*)data)->cook();
+			}, &finished, JobSystem::INVALID_HANDLE, 0);
+		}
+		else {
+			JobSystem::runEx(this, [](void* data) {
+				Lumix::OS::run(*(StudioAppImpl*)data);
+			}, &finished, JobSystem::INVALID_HANDLE, 0);
+		}
 		Profiler::setThreadName("Main thread");
 		JobSystem::wait(finished);
 	}
@@ -278,20 +288,9 @@ public:
 
 		checkWorkingDirectory();
 
-		char saved_data_dir[MAX_PATH_LENGTH] = {};
-		OS::InputFile cfg_file;
-		if (cfg_file.open(".lumixuser")) {
-			cfg_file.read(saved_data_dir, minimum(lengthOf(saved_data_dir), (int)cfg_file.size()));
-			cfg_file.close();
-		}
-
 		char current_dir[MAX_PATH_LENGTH];
 		OS::getCurrentDirectory(Span(current_dir));
-
-		char data_dir[MAX_PATH_LENGTH] = {};
-		checkDataDirCommandLine(data_dir, lengthOf(data_dir));
-		m_engine = Engine::create(data_dir[0] ? data_dir : (saved_data_dir[0] ? saved_data_dir : current_dir)
-			, m_allocator);
+		createEngine(current_dir);
 		createLua();
 
 		m_editor = WorldEditor::create(current_dir, *m_engine, m_allocator);
@@ -339,8 +338,30 @@ public:
 	}
 
 
+	void createEngine(const char* current_dir)
+	{
+		char saved_data_dir[MAX_PATH_LENGTH] = {};
+		OS::InputFile cfg_file;
+		if (cfg_file.open(".lumixuser")) {
+			cfg_file.read(saved_data_dir, minimum(lengthOf(saved_data_dir), (int)cfg_file.size()));
+			cfg_file.close();
+		}
+
+		char data_dir[MAX_PATH_LENGTH] = {};
+		checkDataDirCommandLine(data_dir, lengthOf(data_dir));
+		m_engine = Engine::create(data_dir[0] ? data_dir : (saved_data_dir[0] ? saved_data_dir : current_dir)
+			, m_allocator);
+	}
+
+
 	~StudioAppImpl()
 	{
+		if (m_is_cooker) {
+			destroyCooker();
+			JobSystem::shutdown();
+			return;
+		}
+
 		ImGuiIO& io = ImGui::GetIO();
 		if (io.WantSaveIniSettings) {
 			size_t size;
@@ -1957,6 +1978,7 @@ public:
 		{
 			if (&scene->getPlugin() != m_watched_plugin.plugin) continue;
 			scene->deserialize(input_blob);
+			scene->postDeserialize();
 			if (m_editor->isGameMode()) scene->startGame();
 		}
 		logInfo("Editor") << "Finished reloading plugin.";
@@ -1997,6 +2019,113 @@ public:
 		}
 	}
 
+	// cooker creates only the engine, a headless editor and the asset compiler with its plugins,
+	// engine plugins are not loaded, so there is no window, no renderer and no GPU context
+	void initCooker()
+	{
+		char current_dir[MAX_PATH_LENGTH];
+		OS::getCurrentDirectory(Span(current_dir));
+		createEngine(current_dir);
+
+		m_editor = WorldEditor::createHeadless(current_dir, *m_engine, m_allocator);
+		m_asset_compiler = AssetCompiler::create(*this);
+
+#ifdef STATIC_PLUGINS
+		StudioApp::StaticPluginRegister::createCompilers(*this);
+#else
+		const char* plugins[] = { ""
+			#ifdef LUMIXENGINE_PLUGINS
+				, LUMIXENGINE_PLUGINS
+			#endif
+		};
+		for (const char* plugin_name : plugins) {
+			if (!plugin_name[0]) continue;
+
+			const char* ext =
+			#ifdef _WIN32
+				".dll";
+			#else
+				".so";
+			#endif
+			const StaticString<MAX_PATH_LENGTH> path(plugin_name, ext);
+			void* lib = OS::loadLibrary(path);
+			if (!lib) continue;
+
+			auto* f = (StudioApp::IPlugin * (*)(StudioApp&)) OS::getLibrarySymbol(lib, "setAssetCompiler");
+			if (f) {
+				StudioApp::IPlugin* plugin = f(*this);
+				addPlugin(*plugin);
+				m_compiler_libraries.push(lib);
+			}
+			else {
+				OS::unloadLibrary(lib);
+			}
+		}
+		initPlugins();
+#endif
+		PrefabSystem::createCompilerPlugins(*this);
+
+		m_asset_compiler->onInitFinished();
+	}
+
+
+	void destroyCooker()
+	{
+		for (IPlugin* plugin : m_plugins) {
+			LUMIX_DELETE(m_editor->getAllocator(), plugin);
+		}
+		m_plugins.clear();
+		PrefabSystem::destroyCompilerPlugins(*this);
+
+		AssetCompiler::destroy(*m_asset_compiler);
+		WorldEditor::destroy(m_editor, m_allocator);
+		Engine::destroy(m_engine, m_allocator);
+		m_engine = nullptr;
+		m_editor = nullptr;
+
+		for (void* lib : m_compiler_libraries) {
+			OS::unloadLibrary(lib);
+		}
+	}
+
+
+	void cook()
+	{
+		initCooker();
+
+		char report_path[MAX_PATH_LENGTH] = "cook_report.txt";
+		char cmd_line[2048];
+		OS::getCommandLine(Span(cmd_line));
+
+		CommandLineParser parser(cmd_line);
+		while (parser.next())
+		{
+			if (!parser.currentEquals("-report")) continue;
+			if (!parser.next()) break;
+
+			parser.getCurrent(report_path, lengthOf(report_path));
+			break;
+		}
+
+		OutputMemoryStream report(m_allocator);
+		const bool success = m_asset_compiler->compileAll(report);
+		m_exit_code = success ? 0 : 1;
+
+		OS::OutputFile file;
+		if (file.open(report_path)) {
+			if (!file.write(report.getData(), report.getPos())) {
+				logError("Editor") << "Could not write " << report_path;
+				m_exit_code = 1;
+			}
+			file.close();
+		}
+		else {
+			logError("Editor") << "Could not create " << report_path;
+			m_exit_code = 1;
+		}
+	}
+
+
 	static void checkDataDirCommandLine(char* dir, int max_size)
 	{
 		char cmd_line[2048];
@@ -2072,6 +2201,12 @@ public:
 		auto& plugin_manager = m_editor->getEngine().getPluginManager();
 		for (auto* lib : plugin_manager.getLibraries())
 		{
+			auto* compiler_creator = (StudioApp::IPlugin * (*)(StudioApp&)) getLibrarySymbol(lib, "setAssetCompiler");
+			if (compiler_creator)
+			{
+				StudioApp::IPlugin* plugin = compiler_creator(*this);
+				addPlugin(*plugin);
+			}
 			auto* f = (StudioApp::IPlugin * (*)(StudioApp&)) getLibrarySymbol(lib, "setStudioApp");
 			if (f)
 			{
@@ -2798,6 +2933,8 @@ public:
 	Array<Action*> m_toolbar_actions;
 	Array<GUIPlugin*> m_gui_plugins;
 	Array<IPlugin*> m_plugins;
+	// dynamic builds only, libraries the cooker loaded to get their asset compiler plugins
+	Array<void*> m_compiler_libraries;
 	Array<IAddComponentPlugin*> m_add_cmp_plugins;
 	Array<StaticString<MAX_PATH_LENGTH>> m_universes;
 	AddCmpTreeNode m_add_cmp_root;
@@ -2834,6 +2971,7 @@ public:
 	};
 
 	PackConfig m_pack;
+	bool m_is_cooker;
 	bool m_finished;
 	bool m_deferred_game_mode_exit;
 	int m_exit_code;
@@ -2882,7 +3020,14 @@ static void* alignPtr(void* _ptr, size_t _align)
 StudioApp* StudioApp::create()
 {
 	static char buf[sizeof(StudioAppImpl) * 2];
-	return new (NewPlaceholder(), alignPtr(buf, alignof(StudioAppImpl))) StudioAppImpl;
+	return new (NewPlaceholder(), alignPtr(buf, alignof(StudioAppImpl))) StudioAppImpl(false);
+}
+
+
+StudioApp* StudioApp::createCooker()
+{
+	static char buf[sizeof(StudioAppImpl) * 2];
+	return new (NewPlaceholder(), alignPtr(buf, alignof(StudioAppImpl))) StudioAppImpl(true);
 }
 
 
@@ -2895,10 +3040,11 @@ void StudioApp::destroy(StudioApp& app)
 static StudioApp::StaticPluginRegister* s_first_plugin = nullptr;
 
 
-StudioApp::StaticPluginRegister::StaticPluginRegister(const char* name, Creator creator)
+StudioApp::StaticPluginRegister::StaticPluginRegister(const char* name, Creator creator, bool is_compiler)
 {
 	this->creator = creator;
 	this->name = name;
+	this->is_compiler = is_compiler;
 	next = s_first_plugin;
 	s_first_plugin = this;
 }
@@ -2917,4 +3063,19 @@ void StudioApp::StaticPluginRegister::create(StudioApp& app)
 }
 
 
+void StudioApp::StaticPluginRegister::createCompilers(StudioApp& app)
+{
+	auto* i = s_first_plugin;
+	while (i)
+	{
+		if (i->is_compiler) {
+			StudioApp::IPlugin* plugin = i->creator(app);
+			if (plugin) app.addPlugin(*plugin);
+		}
+		i = i->next;
+	}
+	app.initPlugins();
+}
+
+
 } // namespace Lumix
\ No newline at end of file
@@ -11,11 +11,17 @@ struct ImFont;
 #ifdef STATIC_PLUGINS
 	#define LUMIX_STUDIO_ENTRY(plugin_name) \
 		extern "C" StudioApp::IPlugin* setStudioApp_##plugin_name(StudioApp& app); \
-		extern "C" { StudioApp::StaticPluginRegister s_##plugin_name##_editor_register(#plugin_name, setStudioApp_##plugin_name); } \
+		extern "C" { StudioApp::StaticPluginRegister s_##plugin_name##_editor_register(#plugin_name, setStudioApp_##plugin_name, false); } \
 		extern "C" StudioApp::IPlugin* setStudioApp_##plugin_name(StudioApp& app)
+	#define LUMIX_ASSET_COMPILER_ENTRY(plugin_name) \
+		extern "C" StudioApp::IPlugin* setAssetCompiler_##plugin_name(StudioApp& app); \
+		extern "C" { StudioApp::StaticPluginRegister s_##plugin_name##_compiler_register(#plugin_name, setAssetCompiler_##plugin_name, true); } \
+		extern "C" StudioApp::IPlugin* setAssetCompiler_##plugin_name(StudioApp& app)
 #else
 	#define LUMIX_STUDIO_ENTRY(plugin_name) \
 		extern "C" LUMIX_LIBRARY_EXPORT StudioApp::IPlugin* setStudioApp(StudioApp& app)
+	#define LUMIX_ASSET_COMPILER_ENTRY(plugin_name) \
+		extern "C" LUMIX_LIBRARY_EXPORT StudioApp::IPlugin* setAssetCompiler(StudioApp& app)
 #endif
 
 
@@ -77,17 +83,22 @@ public:
 	struct LUMIX_EDITOR_API StaticPluginRegister
 	{
 		typedef IPlugin* (*Creator)(StudioApp& app);
-		StaticPluginRegister(const char* name, Creator creator);
+		StaticPluginRegister(const char* name, Creator creator, bool is_compiler);
 
 		static void create(StudioApp& app);
+		// only plugins registered by LUMIX_ASSET_COMPILER_ENTRY, they do not need a window or a renderer
+		static void createCompilers(StudioApp& app);
 
 		StaticPluginRegister* next;
 		Creator creator;
 		const char* name;
+		bool is_compiler;
 	};
 
 public:
 	static StudioApp* create();
+	// compiles all assets and exits, without running the editor
+	static StudioApp* createCooker();
 	static void destroy(StudioApp& app);
 
 	virtual void run() = 0;
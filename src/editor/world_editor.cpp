@@ -12,7 +12,10 @@
 #include "engine/engine.h"
 #include "engine/file_system.h"
 #include "engine/geometry.h"
+#include "engine/hash_map.h"
 #include "engine/iplugin.h"
+#include "engine/mt/atomic.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/math.h"
 #include "engine/os.h"
@@ -1403,7 +1406,8 @@ public:
 
 	~WorldEditorImpl()
 	{
-		destroyUniverse();
+		// headless editor never gets a render interface, so it has no universe
+		if (m_universe) destroyUniverse();
 
 		Gizmo::destroy(*m_gizmo);
 		m_gizmo = nullptr;
@@ -1734,6 +1738,29 @@ public:
 	};
 
 
+	// file of a universe directory, name is relative to the directory
+	struct UniverseFile
+	{
+		enum class Type : u8
+		{
+			SCENE,
+			ENTITY,
+			SYSTEM
+		};
+
+		StaticString<64> name;
+		Type type;
+		EntityGUID guid;
+		EntityPtr entity;
+		IScene* scene;
+		i32 worker;
+		u64 offset;
+		u64 size;
+		bool written;
+		bool failed;
+	};
+
+
 	bool deserialize(Universe& universe
 		, const char* basedir
 		, const char* basename
@@ -1742,177 +1769,226 @@ public:
 		, IAllocator& allocator) const
 	{
 		PROFILE_FUNCTION();
+		OS::Timer timer;
 		
 		entity_map.clear();
-		StaticString<MAX_PATH_LENGTH> scn_dir(basedir, "/", basename, "/scenes/");
-		OS::FileIterator* scn_file_iter = m_engine->getFileSystem().createFileIterator(scn_dir);
-		Array<u8> data(allocator);
 		FileSystem& fs = m_engine->getFileSystem();
-		OS::InputFile file;
-		auto loadFile = [&file, &data, &entity_map, &fs](const char* filepath, auto callback) {
-			if (fs.open(filepath, Ref(file)))
-			{
-				if (file.size() > 0)
-				{
-					data.resize((int)file.size());
-					file.read(&data[0], data.size());
-					InputMemoryStream blob(&data[0], data.size());
-					TextDeserializer deserializer(blob, entity_map);
-					callback(deserializer);
-				}
-				file.close();
-			}
-		};
+		Array<UniverseFile> files(allocator);
+		StaticString<MAX_PATH_LENGTH> dir(basedir, "/", basename, "/");
+		StaticString<MAX_PATH_LENGTH> scn_dir(dir, "scenes/");
+		OS::FileIterator* scn_file_iter = fs.createFileIterator(scn_dir);
 		OS::FileInfo info;
-		int versions[ComponentType::MAX_TYPES_COUNT];
 		while (OS::getNextFile(scn_file_iter, &info))
 		{
 			if (info.is_directory) continue;
 			if (info.filename[0] == '.') continue;
 
-			StaticString<MAX_PATH_LENGTH> filepath(scn_dir, info.filename);
 			char plugin_name[64];
-			PathUtils::getBasename(Span(plugin_name), filepath);
+			PathUtils::getBasename(Span(plugin_name), info.filename);
 			IScene* scene = universe.getScene(crc32(plugin_name));
 			if (!scene)
 			{
-				logError("Editor") << "Could not open " << filepath << " since there is not plugin " << plugin_name;
+				logError("Editor") << "Could not open " << scn_dir << info.filename << " since there is not plugin " << plugin_name;
+				OS::destroyFileIterator(scn_file_iter);
 				return false;
 			}
 
-			loadFile(filepath, [scene, &versions, &universe](TextDeserializer& deserializer) {
-				int version;
-				deserializer.read(Ref(version));
-				for (int i = 0; i < ComponentType::MAX_TYPES_COUNT; ++i)
-				{
-					ComponentType cmp_type = {i};
-					if (universe.getScene(cmp_type) == scene)
-					{
-						versions[i] = version;
-					}
-				}
-				scene->deserialize(deserializer);
-			});
+			UniverseFile& file = files.emplace();
+			file.name = "scenes/";
+			file.name << info.filename;
+			file.type = UniverseFile::Type::SCENE;
+			file.entity = INVALID_ENTITY;
+			file.scene = scene;
 		}
 		OS::destroyFileIterator(scn_file_iter);
 		
-		StaticString<MAX_PATH_LENGTH> dir(basedir, "/", basename, "/");
-		auto file_iter = m_engine->getFileSystem().createFileIterator(dir);
+		OS::FileIterator* file_iter = fs.createFileIterator(dir);
 		while (OS::getNextFile(file_iter, &info))
 		{
 			if (info.is_directory) continue;
 			if (info.filename[0] == '.') continue;
 
-			StaticString<MAX_PATH_LENGTH> filepath(dir, info.filename);
 			char tmp[32];
-			PathUtils::getBasename(Span(tmp), filepath);
-			EntityGUID guid;
-			fromCString(Span(tmp), Ref(guid.value));
+			PathUtils::getBasename(Span(tmp), info.filename);
+			UniverseFile& file = files.emplace();
+			file.name = info.filename;
+			file.type = UniverseFile::Type::ENTITY;
+			fromCString(Span(tmp), Ref(file.guid.value));
 			EntityRef entity = universe.createEntity({0, 0, 0}, {0, 0, 0, 1});
-			entity_map.insert(guid, entity);
+			entity_map.insert(file.guid, entity);
+			file.entity = entity;
+			file.scene = nullptr;
 		}
 		OS::destroyFileIterator(file_iter);
-		
-		file_iter = m_engine->getFileSystem().createFileIterator(dir);
-		while (OS::getNextFile(file_iter, &info))
-		{
-			if (info.is_directory) continue;
-			if (info.filename[0] == '.') continue;
 
-			StaticString<MAX_PATH_LENGTH> filepath(dir, info.filename);
-			char tmp[32];
-			PathUtils::getBasename(Span(tmp), filepath);
-			EntityGUID guid;
-			fromCString(Span(tmp), Ref(guid.value));
-			loadFile(filepath, [&versions, &entity_map, &universe, guid](TextDeserializer& deserializer) {
-				char name[64];
-				deserializer.read(name, lengthOf(name));
-				RigidTransform tr;
-				deserializer.read(Ref(tr));
-				float scale;
-				deserializer.read(Ref(scale));
-
-				const EntityPtr e = entity_map.get(guid);
-				const EntityRef entity = (EntityRef)e;
+		UniverseFile& templates_file = files.emplace();
+		templates_file.name = "systems/templates.sys";
+		templates_file.type = UniverseFile::Type::SYSTEM;
+		templates_file.entity = INVALID_ENTITY;
+		templates_file.scene = nullptr;
 
-				EntityPtr parent;
-				deserializer.read(Ref(parent));
-				if (parent.isValid()) universe.setParent(parent, entity);
-
-				if(name[0]) universe.setEntityName(entity, name);
-				universe.setTransformKeepChildren(entity, {tr.pos, tr.rot, scale});
-				u32 cmp_type_hash;
-				deserializer.read(Ref(cmp_type_hash));
-				while (cmp_type_hash != 0)
+		// files are read on workers in chunks, each worker appends to its own buffer,
+		// then the chunk is applied to the universe in the same order as the files are listed
+		constexpr int CHUNK_SIZE = 4096;
+		Array<OutputMemoryStream> worker_buffers(allocator);
+		const int workers_count = JobSystem::getWorkersCount();
+		worker_buffers.reserve(workers_count);
+		for (int i = 0; i < workers_count; ++i) worker_buffers.emplace(allocator);
+
+		int versions[ComponentType::MAX_TYPES_COUNT];
+		for (int chunk = 0; chunk < files.size(); chunk += CHUNK_SIZE)
+		{
+			const int chunk_end = minimum(chunk + CHUNK_SIZE, files.size());
+			for (OutputMemoryStream& buffer : worker_buffers) buffer.clear();
+
+			volatile i32 next_file = chunk;
+			volatile i32 next_worker = 0;
+			auto read_files = [&]() {
+				PROFILE_BLOCK("read universe files");
+				const i32 worker = MT::atomicIncrement(&next_worker) - 1;
+				OutputMemoryStream& buffer = worker_buffers[worker];
+				for (;;)
 				{
-					ComponentType cmp_type = Reflection::getComponentTypeFromHash(cmp_type_hash);
-					universe.deserializeComponent(deserializer, entity, cmp_type, versions[cmp_type.index]);
-					deserializer.read(Ref(cmp_type_hash));
+					const i32 idx = MT::atomicIncrement(&next_file) - 1;
+					if (idx >= chunk_end) break;
+
+					UniverseFile& file = files[idx];
+					file.worker = worker;
+					file.offset = buffer.getPos();
+					file.size = 0;
+					file.failed = true;
+					OS::InputFile f;
+					const StaticString<MAX_PATH_LENGTH> path(dir, file.name);
+					if (!fs.open(path, Ref(f))) continue;
+
+					const u64 size = f.size();
+					buffer.resize(file.offset + size);
+					file.failed = size > 0 && !f.read((u8*)buffer.getMutableData() + file.offset, size);
+					file.size = file.failed ? 0 : size;
+					buffer.resize(file.offset + file.size);
+					f.close();
 				}
-			});
-		}
-		OS::destroyFileIterator(file_iter);
+			};
+			JobSystem::runOnWorkers(read_files);
 
-		StaticString<MAX_PATH_LENGTH> filepath(basedir, "/", basename, "/systems/templates.sys");
-		loadFile(filepath, [&](TextDeserializer& deserializer) {
-			prefab_system.deserialize(deserializer);
-			for (int i = 0, c = prefab_system.getMaxEntityIndex(); i < c; ++i)
+			PROFILE_BLOCK("apply universe files");
+			for (int file_idx = chunk; file_idx < chunk_end; ++file_idx)
 			{
-				u64 prefab = prefab_system.getPrefab({i});
-				if (prefab != 0) entity_map.create({i});
+				const UniverseFile& file = files[file_idx];
+				if (file.size == 0) continue;
+
+				const u8* data = (const u8*)worker_buffers[file.worker].getData() + file.offset;
+				InputMemoryStream blob(data, file.size);
+				TextDeserializer deserializer(blob, entity_map);
+				switch (file.type)
+				{
+					case UniverseFile::Type::SCENE:
+					{
+						int version;
+						deserializer.read(Ref(version));
+						for (int i = 0; i < ComponentType::MAX_TYPES_COUNT; ++i)
+						{
+							ComponentType cmp_type = {i};
+							if (universe.getScene(cmp_type) == file.scene)
+							{
+								versions[i] = version;
+							}
+						}
+						file.scene->deserialize(deserializer, version);
+						break;
+					}
+					case UniverseFile::Type::ENTITY:
+					{
+						char name[64];
+						deserializer.read(name, lengthOf(name));
+						RigidTransform tr;
+						deserializer.read(Ref(tr));
+						float scale;
+						deserializer.read(Ref(scale));
+
+						const EntityPtr e = entity_map.get(file.guid);
+						const EntityRef entity = (EntityRef)e;
+
+						EntityPtr parent;
+						deserializer.read(Ref(parent));
+						if (parent.isValid()) universe.setParent(parent, entity);
+
+						if(name[0]) universe.setEntityName(entity, name);
+						universe.setTransformKeepChildren(entity, {tr.pos, tr.rot, scale});
+						u32 cmp_type_hash;
+						deserializer.read(Ref(cmp_type_hash));
+						while (cmp_type_hash != 0)
+						{
+							ComponentType cmp_type = Reflection::getComponentTypeFromHash(cmp_type_hash);
+							universe.deserializeComponent(deserializer, entity, cmp_type, versions[cmp_type.index]);
+							deserializer.read(Ref(cmp_type_hash));
+						}
+						break;
+					}
+					case UniverseFile::Type::SYSTEM:
+						prefab_system.deserialize(deserializer);
+						for (int i = 0, c = prefab_system.getMaxEntityIndex(); i < c; ++i)
+						{
+							u64 prefab = prefab_system.getPrefab({i});
+							if (prefab != 0) entity_map.create({i});
+						}
+						break;
+				}
 			}
-		});
-		return &universe;
+		}
+
+		logInfo("Editor") << "Universe " << basename << " loaded in " << timer.getTimeSinceStart() << "s, " << files.size() << " files";
+		return true;
 	}
 
 	
 	void serialize(const char* basename)
 	{
+		PROFILE_FUNCTION();
+		OS::Timer timer;
 		StaticString<MAX_PATH_LENGTH> dir(m_engine->getFileSystem().getBasePath(), "universes/", basename, "/");
 		OS::makePath(dir);
 		OS::makePath(dir + "probes/");
 		OS::makePath(dir + "scenes/");
 		OS::makePath(dir + "systems/");
 
-		OS::OutputFile file;
+		// everything is serialized, so changes made by scripts and plugins outside of editor commands
+		// are saved too, on workers each file is compared with the one on disk and written only if it differs
+		Array<UniverseFile> files(m_allocator);
 		OutputMemoryStream blob(m_allocator);
 		TextSerializer serializer(blob, m_entity_map);
-		auto saveFile = [&file, &blob](const char* path) {
-			if (file.open(path))
-			{
-				file.write(blob.getData(), blob.getPos());
-				file.close();
-			}
-			else {
-				logError("Editor") << "Failed to save " << path;
-			}
+		auto addFile = [&](const char* name, u64 offset) {
+			UniverseFile& file = files.emplace();
+			file.name = name;
+			file.offset = offset;
+			file.size = blob.getPos() - offset;
+			file.written = false;
+			file.failed = false;
 		};
 		for (IScene* scene : m_universe->getScenes())
 		{
-			blob.clear();
+			const u64 offset = blob.getPos();
 			serializer.write("version", scene->getVersion());
 			scene->serialize(serializer);
-			StaticString<MAX_PATH_LENGTH> scene_file_path(dir, "scenes/", scene->getPlugin().getName(), ".scn");
-			saveFile(scene_file_path);
+			const StaticString<64> name("scenes/", scene->getPlugin().getName(), ".scn");
+			addFile(name, offset);
 		}
 
-		blob.clear();
+		const u64 templates_offset = blob.getPos();
 		m_prefab_system->serialize(serializer);
-		StaticString<MAX_PATH_LENGTH> system_file_path(dir, "systems/templates.sys");
-		saveFile(system_file_path);
+		addFile("systems/templates.sys", templates_offset);
 
 		for (EntityPtr entity = m_universe->getFirstEntity(); entity.isValid(); entity = m_universe->getNextEntity((EntityRef)entity))
 		{
 			const EntityRef e = (EntityRef)entity;
 			if (m_prefab_system->getPrefab(e) != 0) continue;
-			blob.clear();
+
+			const u64 offset = blob.getPos();
 			serializer.write("name", m_universe->getEntityName(e));
 			serializer.write("transform", m_universe->getTransform(e).getRigidPart());
 			serializer.write("scale", m_universe->getScale(e));
 			EntityPtr parent = m_universe->getParent(e);
 			serializer.write("parent", parent);
-			EntityGUID guid = m_entity_map.get(entity);
-			StaticString<MAX_PATH_LENGTH> entity_file_path(dir, guid.value, ".ent");
 			for (ComponentUID cmp = m_universe->getFirstComponent(e); cmp.entity.isValid();
 				 cmp = m_universe->getNextComponent(cmp))
 			{
@@ -1922,9 +1998,68 @@ public:
 				m_universe->serializeComponent(serializer, cmp.type, (EntityRef)cmp.entity);
 			}
 			serializer.write("cmp_end", (u32)0);
-			saveFile(entity_file_path);
+			const StaticString<64> name("", m_entity_map.get(entity).value, ".ent");
+			addFile(name, offset);
+		}
+
+		Array<OutputMemoryStream> worker_buffers(m_allocator);
+		const int workers_count = JobSystem::getWorkersCount();
+		worker_buffers.reserve(workers_count);
+		for (int i = 0; i < workers_count; ++i) worker_buffers.emplace(m_allocator);
+
+		volatile i32 next_file = 0;
+		volatile i32 next_worker = 0;
+		auto write_files = [&]() {
+			PROFILE_BLOCK("write universe files");
+			OutputMemoryStream& on_disk = worker_buffers[MT::atomicIncrement(&next_worker) - 1];
+			for (;;)
+			{
+				const i32 idx = MT::atomicIncrement(&next_file) - 1;
+				if (idx >= files.size()) break;
+
+				UniverseFile& file = files[idx];
+				const StaticString<MAX_PATH_LENGTH> path(dir, file.name);
+				const u8* data = (const u8*)blob.getData() + file.offset;
+				OS::InputFile in;
+				if (in.open(path))
+				{
+					bool same = in.size() == file.size;
+					if (same && file.size > 0)
+					{
+						on_disk.resize(file.size);
+						same = in.read(on_disk.getMutableData(), file.size)
+							&& compareMemory(on_disk.getData(), data, file.size) == 0;
+					}
+					in.close();
+					if (same) continue;
+				}
+
+				OS::OutputFile f;
+				if (!f.open(path))
+				{
+					file.failed = true;
+					continue;
+				}
+				file.failed = !f.write(data, file.size);
+				file.written = true;
+				f.close();
+			}
+		};
+		JobSystem::runOnWorkers(write_files);
+
+		int written_count = 0;
+		for (const UniverseFile& file : files)
+		{
+			if (file.failed)
+			{
+				logError("Editor") << "Failed to save " << dir << file.name;
+				continue;
+			}
+			if (file.written) ++written_count;
 		}
 		clearUniverseDir(dir);
+		logInfo("Editor") << "Universe " << basename << " saved in " << timer.getTimeSinceStart() << "s, "
+			<< written_count << " of " << files.size() << " files written";
 	}
 
 
@@ -2477,7 +2612,7 @@ public:
 		} map;
 		map.editor = this;
 
-		TextSerializer serializer(m_copy_buffer, map);
+		BinarySerializer serializer(m_copy_buffer, map);
 
 		Array<EntityRef> entities(m_allocator);
 		entities = m_selected_entities;
@@ -2669,7 +2804,7 @@ public:
 	}
 
 
-	WorldEditorImpl(const char* base_path, Engine& engine, IAllocator& allocator)
+	WorldEditorImpl(const char* base_path, Engine& engine, IAllocator& allocator, bool headless)
 		: m_allocator(allocator)
 		, m_entity_selected(m_allocator)
 		, m_universe_destroyed(m_allocator)
@@ -2713,26 +2848,29 @@ public:
 		m_measure_tool = LUMIX_NEW(m_allocator, MeasureTool)();
 		addPlugin(*m_measure_tool);
 
-		const char* plugins[] = { ""
-			#ifdef LUMIXENGINE_PLUGINS
-				, LUMIXENGINE_PLUGINS
-			#endif
-		};
-
+		m_window = OS::INVALID_WINDOW;
 		PluginManager& plugin_manager = m_engine->getPluginManager();
-		for (auto* plugin_name : plugins) {
-			if (plugin_name[0] && !plugin_manager.load(plugin_name)) {
-				logInfo("Editor") << plugin_name << " plugin has not been loaded";
+		if (!headless) {
+			const char* plugins[] = { ""
+				#ifdef LUMIXENGINE_PLUGINS
+					, LUMIXENGINE_PLUGINS
+				#endif
+			};
+
+			for (auto* plugin_name : plugins) {
+				if (plugin_name[0] && !plugin_manager.load(plugin_name)) {
+					logInfo("Editor") << plugin_name << " plugin has not been loaded";
+				}
 			}
-		}
 
-		OS::InitWindowArgs create_win_args;
-		create_win_args.name = "Lumix Studio";
-		create_win_args.handle_file_drops = true;
-		m_window = OS::createWindow(create_win_args);
-		Engine::PlatformData platform_data = {};
-		platform_data.window_handle = m_window;
-		m_engine->setPlatformData(platform_data);
+			OS::InitWindowArgs create_win_args;
+			create_win_args.name = "Lumix Studio";
+			create_win_args.handle_file_drops = true;
+			m_window = OS::createWindow(create_win_args);
+			Engine::PlatformData platform_data = {};
+			platform_data.window_handle = m_window;
+			m_engine->setPlatformData(platform_data);
+		}
 
 		plugin_manager.initPlugins();
 
@@ -3279,7 +3417,7 @@ public:
 			Array<EntityRef> entities;
 		} map(m_editor.getAllocator());
 		InputMemoryStream input_blob(m_copy_buffer);
-		TextDeserializer deserializer(input_blob, map);
+		BinaryDeserializer deserializer(input_blob, map);
 
 		Universe& universe = *m_editor.getUniverse();
 		int entity_count;
@@ -3398,7 +3536,13 @@ void WorldEditorImpl::duplicateEntities()
 
 WorldEditor* WorldEditor::create(const char* base_path, Engine& engine, IAllocator& allocator)
 {
-	return LUMIX_NEW(allocator, WorldEditorImpl)(base_path, engine, allocator);
+	return LUMIX_NEW(allocator, WorldEditorImpl)(base_path, engine, allocator, false);
+}
+
+
+WorldEditor* WorldEditor::createHeadless(const char* base_path, Engine& engine, IAllocator& allocator)
+{
+	return LUMIX_NEW(allocator, WorldEditorImpl)(base_path, engine, allocator, true);
 }
 
 
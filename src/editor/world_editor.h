@@ -73,6 +73,8 @@ public:
 
 public:
 	static WorldEditor* create(const char* base_path, Engine& engine, IAllocator& allocator);
+	// no window and no engine plugins, enough for the asset compiler
+	static WorldEditor* createHeadless(const char* base_path, Engine& engine, IAllocator& allocator);
 	static void destroy(WorldEditor* editor, IAllocator& allocator);
 
 	virtual void setRenderInterface(RenderInterface* interface) = 0;
@@ -1,5 +1,11 @@
 #include "engine/allocator.h"
+#include "engine/log.h"
+#include "engine/math.h"
 #include "engine/mt/atomic.h"
+#include "engine/mt/sync.h"
+#include "engine/os.h"
+#include "engine/profiler.h"
+#include "engine/string.h"
 #include <stdlib.h>
 #ifndef _WIN32
 	#include <string.h>
@@ -133,4 +139,341 @@ void* BaseProxyAllocator::reallocate(void* ptr, size_t size)
 }
 
 
+static thread_local struct
+{
+	const FrameAllocator* allocator = nullptr;
+	i32 frame = -1;
+	u8* pos = nullptr;
+	u8* end = nullptr;
+} g_frame_block;
+
+
+static u8* alignPointer(u8* ptr, size_t align)
+{
+	return (u8*)(((uintptr)ptr + align - 1) & ~(uintptr)(align - 1));
+}
+
+
+// stored right before the memory returned from the arena, so reallocate knows how much to copy
+struct FrameAllocationHeader
+{
+	u64 size;
+};
+
+
+static FrameAllocationHeader* getFrameHeader(void* ptr)
+{
+	return (FrameAllocationHeader*)((u8*)ptr - sizeof(FrameAllocationHeader));
+}
+
+
+FrameAllocator::FrameAllocator(IAllocator& fallback, size_t frame_capacity)
+	: m_fallback(fallback)
+	, m_blocks_per_frame(i32((frame_capacity + BLOCK_SIZE - 1) / BLOCK_SIZE))
+	, m_state(0)
+	, m_fallback_count(0)
+{
+	const size_t size = (size_t)m_blocks_per_frame * BLOCK_SIZE * FRAMES_COUNT;
+	m_memory = (u8*)OS::memReserve(size);
+	OS::memCommit(m_memory, size);
+}
+
+
+FrameAllocator::~FrameAllocator()
+{
+	OS::memRelease(m_memory);
+}
+
+
+u8* FrameAllocator::getFrameMemory(i32 frame) const
+{
+	return m_memory + (size_t)(frame % FRAMES_COUNT) * m_blocks_per_frame * BLOCK_SIZE;
+}
+
+
+bool FrameAllocator::owns(const void* ptr) const
+{
+	return ptr >= m_memory && ptr < m_memory + (size_t)m_blocks_per_frame * BLOCK_SIZE * FRAMES_COUNT;
+}
+
+
+void FrameAllocator::nextFrame()
+{
+	for (;;) {
+		const i64 state = m_state;
+		const i32 frame = i32(state >> 32);
+		const i32 used_blocks = minimum(i32(state & 0xffFFffFF), m_blocks_per_frame);
+		if (MT::compareAndExchange64(&m_state, i64(frame + 1) << 32, state)) {
+			const i32 fallbacks = m_fallback_count;
+			MT::atomicSubtract(&m_fallback_count, fallbacks);
+			Profiler::pushInt("Frame allocator KB", used_blocks * (BLOCK_SIZE / 1024));
+			Profiler::pushInt("Frame allocator fallbacks", fallbacks);
+			return;
+		}
+	}
+}
+
+
+void* FrameAllocator::allocate_aligned(size_t size, size_t align)
+{
+	auto& block = g_frame_block;
+	const i32 current_frame = i32(m_state >> 32);
+	if (block.allocator != this || block.frame != current_frame) {
+		block.allocator = this;
+		block.frame = current_frame;
+		block.pos = block.end = nullptr;
+	}
+
+	align = maximum(align, alignof(FrameAllocationHeader));
+	u8* ptr = block.pos ? alignPointer(block.pos + sizeof(FrameAllocationHeader), align) : nullptr;
+	if (!ptr || ptr + size > block.end) {
+		const i32 count = i32((size + sizeof(FrameAllocationHeader) + align + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		for (;;) {
+			const i64 state = m_state;
+			const i32 frame = i32(state >> 32);
+			const i32 used_blocks = i32(state & 0xffFFffFF);
+			if (used_blocks + count > m_blocks_per_frame) {
+				MT::atomicIncrement(&m_fallback_count);
+				return m_fallback.allocate_aligned(size, align);
+			}
+			if (MT::compareAndExchange64(&m_state, state + count, state)) {
+				block.frame = frame;
+				block.pos = getFrameMemory(frame) + (size_t)used_blocks * BLOCK_SIZE;
+				block.end = block.pos + (size_t)count * BLOCK_SIZE;
+				break;
+			}
+		}
+		ptr = alignPointer(block.pos + sizeof(FrameAllocationHeader), align);
+	}
+	getFrameHeader(ptr)->size = size;
+	block.pos = ptr + size;
+	return ptr;
+}
+
+
+void FrameAllocator::deallocate_aligned(void* ptr)
+{
+	if (ptr && !owns(ptr)) m_fallback.deallocate_aligned(ptr);
+}
+
+
+void* FrameAllocator::reallocate_aligned(void* ptr, size_t size, size_t align)
+{
+	if (!ptr) return allocate_aligned(size, align);
+	if (!owns(ptr)) return m_fallback.reallocate_aligned(ptr, size, align);
+	if (size == 0) return nullptr;
+
+	void* new_ptr = allocate_aligned(size, align);
+	copyMemory(new_ptr, ptr, minimum(size, (size_t)getFrameHeader(ptr)->size));
+	return new_ptr;
+}
+
+
+void* FrameAllocator::allocate(size_t size)
+{
+	return allocate_aligned(size, 16);
+}
+
+
+void FrameAllocator::deallocate(void* ptr)
+{
+	deallocate_aligned(ptr);
+}
+
+
+void* FrameAllocator::reallocate(void* ptr, size_t size)
+{
+	return reallocate_aligned(ptr, size, 16);
+}
+
+
+static TagAllocator* g_first_tag = nullptr;
+static MT::CriticalSection g_tags_mutex;
+static thread_local i32 g_tag_thread_idx = -1;
+static volatile i32 g_tag_threads_count = 0;
+
+
+// stored right before the memory returned to user
+struct TagAllocationHeader
+{
+	u64 size;
+	u64 offset;
+};
+
+
+static const size_t TAG_HEADER_ALIGN = 16;
+
+
+static TagAllocationHeader* getTagHeader(void* ptr)
+{
+	return (TagAllocationHeader*)((u8*)ptr - sizeof(TagAllocationHeader));
+}
+
+
+static void atomicAdd64(volatile i64* dest, i64 value)
+{
+	for (;;) {
+		const i64 prev = *dest;
+		if (MT::compareAndExchange64(dest, prev + value, prev)) return;
+	}
+}
+
+
+TagAllocator::TagAllocator(IAllocator& source, const char* tag_name, size_t budget)
+	: m_source(source)
+	, m_tag_name(tag_name)
+	, m_budget(budget)
+	, m_over_budget(false)
+	, m_live_bytes(0)
+	, m_live_allocations(0)
+	, m_peak_bytes(0)
+{
+	for (Counters& c : m_counters) {
+		c.bytes = 0;
+		c.allocations = 0;
+	}
+
+	MT::CriticalSectionLock lock(g_tags_mutex);
+	m_next = g_first_tag;
+	g_first_tag = this;
+}
+
+
+TagAllocator::~TagAllocator()
+{
+	MT::CriticalSectionLock lock(g_tags_mutex);
+	TagAllocator** iter = &g_first_tag;
+	while (*iter != this) iter = &(*iter)->m_next;
+	*iter = m_next;
+}
+
+
+void TagAllocator::count(i64 bytes, i64 allocations)
+{
+	if (g_tag_thread_idx < 0) {
+		g_tag_thread_idx = minimum(MT::atomicIncrement(&g_tag_threads_count) - 1, (i32)MAX_THREADS);
+	}
+
+	Counters& counters = m_counters[g_tag_thread_idx];
+	if (g_tag_thread_idx == MAX_THREADS) {
+		atomicAdd64(&counters.bytes, bytes);
+		atomicAdd64(&counters.allocations, allocations);
+		return;
+	}
+	counters.bytes += bytes;
+	counters.allocations += allocations;
+}
+
+
+void TagAllocator::update()
+{
+	i64 bytes = 0;
+	i64 allocations = 0;
+	for (const Counters& c : m_counters) {
+		bytes += c.bytes;
+		allocations += c.allocations;
+	}
+	m_live_bytes = bytes;
+	m_live_allocations = allocations;
+	m_peak_bytes = maximum(m_peak_bytes, bytes);
+
+	Profiler::pushInt(m_tag_name, int(bytes / 1024));
+
+	const bool over_budget = m_budget > 0 && bytes > (i64)m_budget;
+	if (over_budget && !m_over_budget) {
+		logWarning("Engine") << "Memory budget of " << m_tag_name << " exceeded, " << u64(bytes / 1024) << " KB used, "
+							 << u64(m_budget / 1024) << " KB budget";
+	}
+	m_over_budget = over_budget;
+}
+
+
+void TagAllocator::updateAll()
+{
+	PROFILE_FUNCTION();
+	MT::CriticalSectionLock lock(g_tags_mutex);
+	for (TagAllocator* tag = g_first_tag; tag; tag = tag->m_next) {
+		tag->update();
+	}
+}
+
+
+void TagAllocator::dumpAll()
+{
+	MT::CriticalSectionLock lock(g_tags_mutex);
+	for (TagAllocator* tag = g_first_tag; tag; tag = tag->m_next) {
+		tag->update();
+		logInfo("Engine") << tag->m_tag_name << ": " << u64(tag->m_live_bytes / 1024) << " KB in "
+						  << u64(tag->m_live_allocations) << " allocations, peak " << u64(tag->m_peak_bytes / 1024)
+						  << " KB, budget " << u64(tag->m_budget / 1024) << " KB";
+	}
+}
+
+
+void* TagAllocator::allocate_aligned(size_t size, size_t align)
+{
+	const size_t offset = maximum(align, TAG_HEADER_ALIGN);
+	u8* mem = (u8*)m_source.allocate_aligned(size + offset, offset);
+	if (!mem) return nullptr;
+
+	void* ptr = mem + offset;
+	TagAllocationHeader* header = getTagHeader(ptr);
+	header->size = size;
+	header->offset = offset;
+	count(size, 1);
+	return ptr;
+}
+
+
+void TagAllocator::deallocate_aligned(void* ptr)
+{
+	if (!ptr) return;
+
+	TagAllocationHeader* header = getTagHeader(ptr);
+	count(-(i64)header->size, -1);
+	m_source.deallocate_aligned((u8*)ptr - header->offset);
+}
+
+
+void* TagAllocator::reallocate_aligned(void* ptr, size_t size, size_t align)
+{
+	if (!ptr) return allocate_aligned(size, align);
+	if (size == 0) {
+		deallocate_aligned(ptr);
+		return nullptr;
+	}
+
+	const TagAllocationHeader* header = getTagHeader(ptr);
+	const size_t offset = (size_t)header->offset;
+	const i64 old_size = (i64)header->size;
+	ASSERT(offset == maximum(align, TAG_HEADER_ALIGN));
+
+	u8* mem = (u8*)m_source.reallocate_aligned((u8*)ptr - offset, size + offset, offset);
+	if (!mem) return nullptr;
+
+	void* new_ptr = mem + offset;
+	getTagHeader(new_ptr)->size = size;
+	count((i64)size - old_size, 0);
+	return new_ptr;
+}
+
+
+void* TagAllocator::allocate(size_t size)
+{
+	return allocate_aligned(size, TAG_HEADER_ALIGN);
+}
+
+
+void TagAllocator::deallocate(void* ptr)
+{
+	deallocate_aligned(ptr);
+}
+
+
+void* TagAllocator::reallocate(void* ptr, size_t size)
+{
+	return reallocate_aligned(ptr, size, TAG_HEADER_ALIGN);
+}
+
+
 } // namespace Lumix
@@ -84,4 +84,96 @@ private:
 	IAllocator& m_source;
 	volatile i32 m_allocation_count;
 };
+
+
+// linear allocator for data which does not outlive the rendering of the current frame,
+// each thread bump allocates from its own block, deallocating memory from the arena is a no-op,
+// anything which does not fit is forwarded to the fallback allocator;
+// nextFrame switches to the other half of the arena, so memory allocated in a frame stays valid
+// while the render thread executes that frame, one frame behind
+class LUMIX_ENGINE_API FrameAllocator final : public IAllocator
+{
+public:
+	FrameAllocator(IAllocator& fallback, size_t frame_capacity);
+	~FrameAllocator();
+
+	void nextFrame();
+	IAllocator& getFallbackAllocator() { return m_fallback; }
+
+	void* allocate_aligned(size_t size, size_t align) override;
+	void deallocate_aligned(void* ptr) override;
+	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+	void* allocate(size_t size) override;
+	void deallocate(void* ptr) override;
+	void* reallocate(void* ptr, size_t size) override;
+
+private:
+	enum { FRAMES_COUNT = 2, BLOCK_SIZE = 64 * 1024 };
+
+	bool owns(const void* ptr) const;
+	u8* getFrameMemory(i32 frame) const;
+
+	IAllocator& m_fallback;
+	u8* m_memory;
+	i32 m_blocks_per_frame;
+	// frame index in the high 32 bits, blocks used in that frame in the low 32 bits,
+	// so a block can not be taken from a frame which was already switched
+	volatile i64 m_state;
+	volatile i32 m_fallback_count;
+};
+
+
+// tracks memory of a subsystem (renderer, physics, ...), allocations are counted in per-thread slots
+// without atomics, updateAll merges the slots once per frame into live bytes, live allocations and peak,
+// pushes them to profiler and warns when a budget is exceeded;
+// tag_name must be a string literal since it's used as a profiler key
+class LUMIX_ENGINE_API TagAllocator final : public IAllocator
+{
+public:
+	TagAllocator(IAllocator& source, const char* tag_name, size_t budget = 0);
+	~TagAllocator();
+
+	static void updateAll();
+	static void dumpAll();
+
+	const char* getTagName() const { return m_tag_name; }
+	i64 getLiveBytes() const { return m_live_bytes; }
+	i64 getLiveAllocations() const { return m_live_allocations; }
+	i64 getPeakBytes() const { return m_peak_bytes; }
+	size_t getBudget() const { return m_budget; }
+	void setBudget(size_t budget) { m_budget = budget; m_over_budget = false; }
+	IAllocator& getSourceAllocator() { return m_source; }
+
+	void* allocate_aligned(size_t size, size_t align) override;
+	void deallocate_aligned(void* ptr) override;
+	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+	void* allocate(size_t size) override;
+	void deallocate(void* ptr) override;
+	void* reallocate(void* ptr, size_t size) override;
+
+private:
+	enum { MAX_THREADS = 64 };
+
+	struct alignas(64) Counters
+	{
+		volatile i64 bytes;
+		volatile i64 allocations;
+	};
+
+	void count(i64 bytes, i64 allocations);
+	void update();
+
+	IAllocator& m_source;
+	const char* m_tag_name;
+	size_t m_budget;
+	bool m_over_budget;
+	TagAllocator* m_next;
+	// threads which do not get their own slot share the last one, updated atomically
+	Counters m_counters[MAX_THREADS + 1];
+	i64 m_live_bytes;
+	i64 m_live_allocations;
+	i64 m_peak_bytes;
+};
+
+
 } // namespace Lumix
\ No newline at end of file
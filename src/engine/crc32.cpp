@@ -1,11 +1,12 @@
 #include "engine/crc32.h"
+#include <string.h>
 
 
 namespace Lumix
 {
 
 
-static u32 crc32Table[256] = {
+static constexpr u32 crc32Table[256] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
 	0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
 	0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
@@ -51,58 +52,120 @@ static u32 crc32Table[256] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d};
 
 
-u32 crc32(const void* data, int length)
+// slicing-by-8 tables, table[k][i] is crc of byte i followed by k zero bytes
+struct Crc32SliceTables
 {
-	const u8* c = static_cast<const u8*>(data);
-	u32 crc = 0xffffFFFF;
-	int len = length;
-	while (len)
-	{
-		crc = (crc >> 8) ^ crc32Table[(crc & 0xFF) ^ *c];
-		--len;
-		++c;
+	u32 table[8][256];
+};
+
+
+static constexpr Crc32SliceTables buildSliceTables()
+{
+	Crc32SliceTables res = {};
+	for (int i = 0; i < 256; ++i) {
+		res.table[0][i] = crc32Table[i];
+	}
+	for (int k = 1; k < 8; ++k) {
+		for (int i = 0; i < 256; ++i) {
+			const u32 prev = res.table[k - 1][i];
+			res.table[k][i] = (prev >> 8) ^ crc32Table[prev & 0xff];
+		}
 	}
-	return ~crc;
+	return res;
 }
 
 
-u32 crc32(const char* str)
+static constexpr Crc32SliceTables crc32Slices = buildSliceTables();
+
+
+// crc is not inverted here, processes 8 bytes per iteration, little endian only
+static u32 update(u32 crc, const u8* c, size_t length)
 {
-	const u8* c = reinterpret_cast<const u8*>(str);
-	u32 crc = 0xffffFFFF;
-	while (*c)
-	{
+	const auto& t = crc32Slices.table;
+	while (length >= 8) {
+		u32 one;
+		u32 two;
+		memcpy(&one, c, sizeof(one));
+		memcpy(&two, c + 4, sizeof(two));
+		one ^= crc;
+		crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^ t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+			  t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+		c += 8;
+		length -= 8;
+	}
+	while (length) {
 		crc = (crc >> 8) ^ crc32Table[(crc & 0xFF) ^ *c];
 		++c;
+		--length;
 	}
-	return ~crc;
+	return crc;
+}
+
+
+u32 crc32(const void* data, int length)
+{
+	return ~update(0xffffFFFF, static_cast<const u8*>(data), length);
+}
+
+
+u32 crc32(const char* str)
+{
+	return ~update(0xffffFFFF, reinterpret_cast<const u8*>(str), strlen(str));
 }
 
 
 u32 continueCrc32(u32 original_crc, const char* str)
 {
-	const u8* c = reinterpret_cast<const u8*>(str);
-	u32 crc = ~original_crc;
-	while (*c)
-	{
-		crc = (crc >> 8) ^ crc32Table[(crc & 0xFF) ^ *c];
-		++c;
-	}
-	return ~crc;
+	return ~update(~original_crc, reinterpret_cast<const u8*>(str), strlen(str));
 }
 
 
 u32 continueCrc32(u32 original_crc, const void* data, int length)
 {
-	const u8* c = reinterpret_cast<const u8*>(data);
-	u32 crc = ~original_crc;
-	while (length)
-	{
-		crc = (crc >> 8) ^ crc32Table[(crc & 0xFF) ^ *c];
-		++c;
-		--length;
+	return ~update(~original_crc, static_cast<const u8*>(data), length);
+}
+
+
+// MurmurHash64A
+u64 continueHash64(u64 original_hash, const void* data, u64 length)
+{
+	const u64 m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+
+	u64 h = original_hash ^ (length * m);
+
+	const u8* c = static_cast<const u8*>(data);
+	const u8* end = c + (length & ~(u64)7);
+	for (; c != end; c += 8) {
+		u64 k;
+		memcpy(&k, c, sizeof(k));
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	switch (length & 7) {
+		case 7: h ^= u64(c[6]) << 48; // fallthrough
+		case 6: h ^= u64(c[5]) << 40; // fallthrough
+		case 5: h ^= u64(c[4]) << 32; // fallthrough
+		case 4: h ^= u64(c[3]) << 24; // fallthrough
+		case 3: h ^= u64(c[2]) << 16; // fallthrough
+		case 2: h ^= u64(c[1]) << 8; // fallthrough
+		case 1: h ^= u64(c[0]); h *= m;
 	}
-	return ~crc;
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+
+u64 hash64(const void* data, u64 length)
+{
+	return continueHash64(0x8445d61a4e774912ULL, data, length);
 }
 
 
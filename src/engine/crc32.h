@@ -12,6 +12,24 @@ LUMIX_ENGINE_API u32 crc32(const void* data, int length);
 LUMIX_ENGINE_API u32 crc32(const char* str);
 LUMIX_ENGINE_API u32 continueCrc32(u32 original_crc, const char* str);
 LUMIX_ENGINE_API u32 continueCrc32(u32 original_crc, const void* data, int length);
+// 64bit non-cryptographic hash, for content keys where crc32 collisions are not acceptable
+LUMIX_ENGINE_API u64 hash64(const void* data, u64 length);
+LUMIX_ENGINE_API u64 continueHash64(u64 original_hash, const void* data, u64 length);
+
+
+// same values as crc32(const char*), but evaluated at compile time when used for a literal,
+// e.g. static constexpr u32 HASH = crc32Const("name");
+constexpr u32 crc32Const(const char* str)
+{
+	u32 crc = 0xffffFFFF;
+	for (; *str; ++str) {
+		crc ^= (u8)*str;
+		for (int i = 0; i < 8; ++i) {
+			crc = (crc >> 1) ^ (0xEDB88320 & (0U - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
 
 
 } // namespace Lumix
\ No newline at end of file
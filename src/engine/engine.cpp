@@ -17,6 +17,7 @@
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
+#include "engine/string.h"
 #include "engine/universe/component.h"
 #include "engine/universe/universe.h"
 #include <imgui/imgui.h>
@@ -387,6 +388,7 @@ void registerCFunction(lua_State* L, const char* name, lua_CFunction f)
 }
 
 static const u32 SERIALIZED_ENGINE_MAGIC = 0x5f4c454e; // == '_LEN'
+static const size_t FRAME_ALLOCATOR_CAPACITY = 32 * 1024 * 1024;
 
 
 static OS::OutputFile g_log_file;
@@ -397,8 +399,14 @@ static bool g_is_log_file_open = false;
 class SerializedEngineHeader
 {
 public:
+	enum Flags : u32
+	{
+		// 1 << 0 is reserved, blobs with it set are rejected
+		SCENE_SIZES = 1 << 1
+	};
+
 	u32 m_magic;
-	u32 m_reserved; // for crc
+	u32 m_flags;
 };
 #pragma pack()
 
@@ -456,6 +464,7 @@ public:
 
 	EngineImpl(const char* working_dir, IAllocator& allocator)
 		: m_allocator(allocator)
+		, m_frame_allocator(m_allocator, FRAME_ALLOCATOR_CAPACITY)
 		, m_prefab_resource_manager(m_allocator)
 		, m_resource_manager(m_allocator)
 		, m_lua_resources(m_allocator)
@@ -861,6 +870,7 @@ public:
 	static void LUA_logInfo(const char* text) { logInfo("Lua Script") << text; }
 	static void LUA_pause(Engine* engine, bool pause) { engine->pause(pause); }
 	static void LUA_nextFrame(Engine* engine) { engine->nextFrame(); }
+	static void LUA_dumpMemoryTags() { TagAllocator::dumpAll(); }
 	static void LUA_setTimeMultiplier(Engine* engine, float multiplier) { engine->setTimeMultiplier(multiplier); }
 	static Vec4 LUA_multMatrixVec(const Matrix& m, const Vec4& v) { return m * v; }
 	static Quat LUA_multQuat(const Quat& a, const Quat& b) { return a * b; }
@@ -997,6 +1007,7 @@ public:
 		REGISTER_FUNCTION(createEntity);
 		REGISTER_FUNCTION(createUniverse);
 		REGISTER_FUNCTION(destroyUniverse);
+		REGISTER_FUNCTION(dumpMemoryTags);
 		REGISTER_FUNCTION(getComponentType);
 		REGISTER_FUNCTION(getComponentTypeByIndex);
 		REGISTER_FUNCTION(getComponentTypesCount);
@@ -1229,6 +1240,7 @@ public:
 
 	IAllocator& getAllocator() override { return m_allocator; }
 	PageAllocator& getPageAllocator() override { return m_page_allocator; }
+	FrameAllocator& getFrameAllocator() override { return m_frame_allocator; }
 
 
 	Universe& createUniverse(bool set_lua_globals) override
@@ -1365,6 +1377,7 @@ public:
 		m_plugin_manager->update(dt, m_paused);
 		m_input_system->update(dt);
 		getFileSystem().updateAsyncTransactions();
+		TagAllocator::updateAll();
 
 		if (m_next_frame)
 		{
@@ -1450,7 +1463,7 @@ public:
 	{
 		SerializedEngineHeader header;
 		header.m_magic = SERIALIZED_ENGINE_MAGIC; // == '_LEN'
-		header.m_reserved = 0;
+		header.m_flags = SerializedEngineHeader::SCENE_SIZES;
 		serializer.write(header);
 		serializePluginList(serializer);
 		serializerSceneVersions(serializer, ctx);
@@ -1462,7 +1475,11 @@ public:
 		for (auto* scene : ctx.getScenes())
 		{
 			serializer.writeString(scene->getPlugin().getName());
+			const u64 size_pos = serializer.getPos();
+			serializer.write((u32)0);
 			scene->serialize(serializer);
+			const u32 size = u32(serializer.getPos() - size_pos - sizeof(u32));
+			copyMemory((u8*)serializer.getMutableData() + size_pos, &size, sizeof(size));
 		}
 		u32 crc = crc32((const u8*)serializer.getData() + pos, (int)serializer.getPos() - pos);
 		return crc;
@@ -1473,7 +1490,7 @@ public:
 	{
 		SerializedEngineHeader header;
 		serializer.read(header);
-		if (header.m_magic != SERIALIZED_ENGINE_MAGIC)
+		if (header.m_magic != SERIALIZED_ENGINE_MAGIC || (header.m_flags & ~(u32)SerializedEngineHeader::SCENE_SIZES))
 		{
 			logError("Core") << "Wrong or corrupted file";
 			return false;
@@ -1486,15 +1503,108 @@ public:
 		m_plugin_manager->deserialize(serializer);
 		i32 scene_count;
 		serializer.read(scene_count);
+		if (header.m_flags & SerializedEngineHeader::SCENE_SIZES) {
+			if (!deserializeScenes(ctx, serializer, scene_count)) return false;
+		}
+		else {
+			for (int i = 0; i < scene_count; ++i)
+			{
+				char tmp[32];
+				serializer.readString(tmp, sizeof(tmp));
+				IScene* scene = ctx.getScene(crc32(tmp));
+				scene->deserialize(serializer);
+			}
+			for (IScene* scene : ctx.getScenes()) {
+				scene->postDeserialize();
+			}
+		}
+		m_path_manager->clear();
+		return true;
+	}
+
+
+	struct SceneBlob
+	{
+		IScene* scene;
+		const u8* data;
+		u32 size;
+		float time;
+		bool failed;
+	};
+
+
+	static void deserializeScene(SceneBlob& blob)
+	{
+		OS::Timer timer;
+		InputMemoryStream stream(blob.data, blob.size);
+		blob.scene->deserialize(stream);
+		blob.failed = stream.getPosition() != blob.size;
+		blob.time = timer.getTimeSinceStart();
+	}
+
+
+	// thread safe scenes are deserialized on workers while the rest is deserialized here on the main thread,
+	// per scene sizes let us find each scene's data without parsing the preceding scenes
+	bool deserializeScenes(Universe& ctx, InputMemoryStream& serializer, i32 scene_count)
+	{
+		PROFILE_FUNCTION();
+		Array<SceneBlob> blobs(m_allocator);
+		blobs.reserve(scene_count);
 		for (int i = 0; i < scene_count; ++i)
 		{
 			char tmp[32];
 			serializer.readString(tmp, sizeof(tmp));
+			u32 size;
+			serializer.read(size);
+			const u8* data = (const u8*)serializer.skip(size);
 			IScene* scene = ctx.getScene(crc32(tmp));
-			scene->deserialize(serializer);
+			if (!scene) {
+				logWarning("Engine") << "Skipping data of unknown scene " << tmp;
+				continue;
+			}
+			SceneBlob& blob = blobs.emplace();
+			blob.scene = scene;
+			blob.data = data;
+			blob.size = size;
+			blob.time = 0;
+			blob.failed = false;
 		}
-		m_path_manager->clear();
-		return true;
+
+		// only scenes on workers defer their onComponentCreated, the deferred list must be complete before any job starts
+		OS::Timer timer;
+		for (SceneBlob& blob : blobs) {
+			if (blob.scene->isDeserializeThreadSafe()) ctx.beginDeferredComponentsCreated(*blob.scene);
+		}
+		JobSystem::SignalHandle signal = JobSystem::INVALID_HANDLE;
+		for (SceneBlob& blob : blobs) {
+			if (!blob.scene->isDeserializeThreadSafe()) continue;
+			JobSystem::run(&blob, [](void* data){
+				PROFILE_BLOCK("deserialize scene");
+				deserializeScene(*(SceneBlob*)data);
+			}, &signal);
+		}
+		for (SceneBlob& blob : blobs) {
+			if (!blob.scene->isDeserializeThreadSafe()) deserializeScene(blob);
+		}
+		JobSystem::wait(signal);
+		ctx.endDeferredComponentsCreated();
+
+		for (IScene* scene : ctx.getScenes()) {
+			scene->postDeserialize();
+		}
+
+		bool res = true;
+		for (const SceneBlob& blob : blobs) {
+			const char* name = blob.scene->getPlugin().getName();
+			if (blob.failed) {
+				logError("Engine") << "Scene " << name << " did not read all its data";
+				res = false;
+			}
+			logInfo("Engine") << "Scene " << name << (blob.scene->isDeserializeThreadSafe() ? " (worker)" : "")
+				<< ": " << blob.size << " B in " << blob.time * 1000 << " ms";
+		}
+		logInfo("Engine") << "Scenes deserialized in " << timer.getTimeSinceStart() * 1000 << " ms";
+		return res;
 	}
 
 
@@ -1584,6 +1694,7 @@ public:
 private:
 	IAllocator& m_allocator;
 	PageAllocator m_page_allocator;
+	FrameAllocator m_frame_allocator;
 
 	FileSystem* m_file_system;
 
@@ -12,6 +12,7 @@ namespace Lumix
 
 struct ComponentUID;
 class FileSystem;
+class FrameAllocator;
 struct IAllocator;
 class InputMemoryStream;
 class InputSystem;
@@ -50,6 +51,8 @@ public:
 	virtual ResourceManagerHub& getResourceManager() = 0;
 	virtual IAllocator& getAllocator() = 0;
 	virtual PageAllocator& getPageAllocator() = 0;
+	// for temporary data which does not outlive the rendering of the current frame, recycled by the renderer
+	virtual FrameAllocator& getFrameAllocator() = 0;
 
 	virtual void startGame(Universe& context) = 0;
 	virtual void stopGame(Universe& context) = 0;
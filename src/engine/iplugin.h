@@ -21,8 +21,13 @@ namespace Lumix
 
 		virtual void serialize(OutputMemoryStream& serializer) = 0;
 		virtual void serialize(ISerializer& serializer) {}
-		virtual void deserialize(IDeserializer& serializer) {}
+		virtual void deserialize(IDeserializer& serializer, int version) {}
 		virtual void deserialize(InputMemoryStream& serializer) = 0;
+		// scenes which touch only their own data in deserialize (no resource loading) are deserialized on workers
+		virtual bool isDeserializeThreadSafe() const { return false; }
+		// called on the main thread once all scenes are deserialized, e.g. to load resources
+		// a thread safe deserialize could not
+		virtual void postDeserialize() {}
 		virtual IPlugin& getPlugin() const = 0;
 		virtual void update(float time_delta, bool paused) = 0;
 		virtual void lateUpdate(float time_delta, bool paused) {}
@@ -8,9 +8,27 @@ namespace Lumix
 const ResourceType PrefabResource::TYPE("prefab");
 
 
+PrefabTemplate::PrefabTemplate(IAllocator& allocator)
+	: entities(allocator)
+	, components(allocator)
+	, data(allocator)
+{
+}
+
+
+void PrefabTemplate::clear()
+{
+	entities.clear();
+	components.clear();
+	data.clear();
+	is_compiled = false;
+}
+
+
 PrefabResource::PrefabResource(const Path& path, ResourceManager& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
 	, data(allocator)
+	, compiled(allocator)
 {
 }
 
@@ -18,13 +36,18 @@ PrefabResource::PrefabResource(const Path& path, ResourceManager& resource_manag
 ResourceType PrefabResource::getType() const { return TYPE; }
 
 
-void PrefabResource::unload() { data.clear(); }
+void PrefabResource::unload()
+{
+	data.clear();
+	compiled.clear();
+}
 
 
 bool PrefabResource::load(u64 size, const u8* mem)
 {
 	data.resize((int)size);
 	copyMemory(data.begin(), mem, size);
+	compiled.clear();
 	return true;
 }
 
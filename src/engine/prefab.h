@@ -1,6 +1,8 @@
 #pragma once
 
 
+#include "engine/array.h"
+#include "engine/math.h"
 #include "engine/resource.h"
 
 
@@ -17,6 +19,34 @@ enum class PrefabVersion : u32
 };
 
 
+// binary form of a prefab, compiled by Universe the first time the prefab is instantiated,
+// components are stored as the sequence of values their deserializers read, so they are not parsed again
+struct PrefabTemplate
+{
+	struct Entity
+	{
+		i32 parent; // index of the parent in entities, -1 if the entity is a root
+		Transform local_transform;
+		u32 first_component;
+		u32 components_count;
+	};
+
+	struct Component
+	{
+		ComponentType type;
+		i32 scene_version;
+	};
+
+	explicit PrefabTemplate(IAllocator& allocator);
+	void clear();
+
+	Array<Entity> entities;
+	Array<Component> components;
+	Array<u8> data;
+	bool is_compiled = false;
+};
+
+
 struct LUMIX_ENGINE_API PrefabResource final : public Resource
 {
 	PrefabResource(const Path& path, ResourceManager& resource_manager, IAllocator& allocator);
@@ -26,6 +56,7 @@ struct LUMIX_ENGINE_API PrefabResource final : public Resource
 
 
 	Array<u8> data;
+	PrefabTemplate compiled;
 	static const ResourceType TYPE;
 };
 
@@ -494,4 +494,209 @@ void TextDeserializer::skip()
 	while (blob.readChar() != '\t')
 		;
 }
-}
\ No newline at end of file
+
+
+void BinarySerializer::writeUnsigned(u64 value)
+{
+	while (value >= 0x80) {
+		blob.write(u8(value | 0x80));
+		value >>= 7;
+	}
+	blob.write(u8(value));
+}
+
+
+void BinarySerializer::writeSigned(i64 value)
+{
+	writeUnsigned(((u64)value << 1) ^ (u64)(value >> 63));
+}
+
+
+EntityGUID BinarySerializer::getGUID(EntityRef entity)
+{
+	return entity_map.get(entity);
+}
+
+
+void BinarySerializer::write(const char* label, EntityPtr entity)
+{
+	write(label, entity_map.get(entity).value);
+}
+
+
+void BinarySerializer::write(const char* label, EntityRef entity)
+{
+	write(label, entity_map.get(entity).value);
+}
+
+
+void BinarySerializer::write(const char* label, const RigidTransform& value) { blob.write(value); }
+void BinarySerializer::write(const char* label, const LocalRigidTransform& value) { blob.write(value); }
+void BinarySerializer::write(const char* label, const Transform& value) { blob.write(value); }
+void BinarySerializer::write(const char* label, const Vec4& value) { blob.write(value); }
+void BinarySerializer::write(const char* label, const DVec3& value) { blob.write(value); }
+void BinarySerializer::write(const char* label, const Vec3& value) { blob.write(value); }
+void BinarySerializer::write(const char* label, const Quat& value) { blob.write(value); }
+void BinarySerializer::write(const char* label, float value) { blob.write(value); }
+void BinarySerializer::write(const char* label, double value) { blob.write(value); }
+void BinarySerializer::write(const char* label, bool value) { blob.write(value); }
+void BinarySerializer::write(const char* label, i8 value) { blob.write(value); }
+void BinarySerializer::write(const char* label, u8 value) { blob.write(value); }
+
+
+void BinarySerializer::write(const char* label, i64 value)
+{
+	if (varint) writeSigned(value);
+	else blob.write(value);
+}
+
+
+void BinarySerializer::write(const char* label, u64 value)
+{
+	if (varint) writeUnsigned(value);
+	else blob.write(value);
+}
+
+
+void BinarySerializer::write(const char* label, i32 value)
+{
+	if (varint) writeSigned(value);
+	else blob.write(value);
+}
+
+
+void BinarySerializer::write(const char* label, u32 value)
+{
+	if (varint) writeUnsigned(value);
+	else blob.write(value);
+}
+
+
+void BinarySerializer::write(const char* label, u16 value)
+{
+	if (varint) writeUnsigned(value);
+	else blob.write(value);
+}
+
+
+void BinarySerializer::write(const char* label, const char* value)
+{
+	const u32 len = stringLength(value);
+	write(label, len);
+	blob.write(value, len);
+}
+
+
+u64 BinaryDeserializer::readUnsigned()
+{
+	u64 value = 0;
+	u32 shift = 0;
+	for (;;) {
+		const u8 c = blob.readChar();
+		value |= u64(c & 0x7f) << shift;
+		if ((c & 0x80) == 0) return value;
+		shift += 7;
+	}
+}
+
+
+i64 BinaryDeserializer::readSigned()
+{
+	const u64 v = readUnsigned();
+	return i64(v >> 1) ^ -i64(v & 1);
+}
+
+
+EntityPtr BinaryDeserializer::getEntity(EntityGUID guid)
+{
+	return entity_map.get(guid);
+}
+
+
+void BinaryDeserializer::read(Ref<EntityPtr> entity)
+{
+	EntityGUID guid;
+	read(Ref(guid.value));
+	entity = entity_map.get(guid);
+}
+
+
+void BinaryDeserializer::read(Ref<EntityRef> entity)
+{
+	EntityGUID guid;
+	read(Ref(guid.value));
+	entity = (EntityRef)entity_map.get(guid);
+}
+
+
+void BinaryDeserializer::read(Ref<RigidTransform> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<LocalRigidTransform> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<Transform> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<Vec4> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<DVec3> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<Vec3> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<Quat> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<float> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<double> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<bool> value) { value = blob.read<bool>(); }
+void BinaryDeserializer::read(Ref<u8> value) { blob.read(value.value); }
+void BinaryDeserializer::read(Ref<i8> value) { blob.read(value.value); }
+
+
+void BinaryDeserializer::read(Ref<u64> value)
+{
+	if (varint) value = readUnsigned();
+	else blob.read(value.value);
+}
+
+
+void BinaryDeserializer::read(Ref<i64> value)
+{
+	if (varint) value = readSigned();
+	else blob.read(value.value);
+}
+
+
+void BinaryDeserializer::read(Ref<u32> value)
+{
+	if (varint) value = (u32)readUnsigned();
+	else blob.read(value.value);
+}
+
+
+void BinaryDeserializer::read(Ref<i32> value)
+{
+	if (varint) value = (i32)readSigned();
+	else blob.read(value.value);
+}
+
+
+void BinaryDeserializer::read(Ref<u16> value)
+{
+	if (varint) value = (u16)readUnsigned();
+	else blob.read(value.value);
+}
+
+
+void BinaryDeserializer::read(Ref<String> value)
+{
+	u32 len;
+	read(Ref(len));
+	value->resize(len + 1);
+	blob.read(value->getData(), len);
+}
+
+
+void BinaryDeserializer::read(char* value, int max_size)
+{
+	u32 len;
+	read(Ref(len));
+	const u32 copy_len = minimum(len, u32(max_size - 1));
+	blob.read(value, copy_len);
+	value[copy_len] = '\0';
+	blob.skip(len - copy_len);
+}
+
+
+
+}
@@ -174,5 +174,88 @@ struct LUMIX_ENGINE_API TextDeserializer final : public IDeserializer
 	ILoadEntityGUIDMap& entity_map;
 };
 
+// raw little-endian values without labels, strings are prefixed by u32 length;
+// with varint == true integers are LEB128 encoded (signed ones zigzagged first)
+// use only for in-memory snapshots, the format is not versioned
+struct LUMIX_ENGINE_API BinarySerializer final : public ISerializer
+{
+	BinarySerializer(OutputMemoryStream& _blob, ISaveEntityGUIDMap& _entity_map, bool _varint = false)
+		: blob(_blob)
+		, entity_map(_entity_map)
+		, varint(_varint)
+	{
+	}
+
+	void write(const char* label, EntityPtr entity)  override;
+	void write(const char* label, EntityRef entity)  override;
+	void write(const char* label, const RigidTransform& value)  override;
+	void write(const char* label, const LocalRigidTransform& value)  override;
+	void write(const char* label, const Transform& value)  override;
+	void write(const char* label, const Vec4& value)  override;
+	void write(const char* label, const DVec3& value)  override;
+	void write(const char* label, const Vec3& value)  override;
+	void write(const char* label, const Quat& value)  override;
+	void write(const char* label, float value)  override;
+	void write(const char* label, double value)  override;
+	void write(const char* label, bool value)  override;
+	void write(const char* label, i64 value)  override;
+	void write(const char* label, u64 value)  override;
+	void write(const char* label, i32 value)  override;
+	void write(const char* label, u32 value)  override;
+	void write(const char* label, u16 value)  override;
+	void write(const char* label, i8 value)  override;
+	void write(const char* label, u8 value)  override;
+	void write(const char* label, const char* value)  override;
+	EntityGUID getGUID(EntityRef entity) override;
+
+	void writeUnsigned(u64 value);
+	void writeSigned(i64 value);
+
+	OutputMemoryStream& blob;
+	ISaveEntityGUIDMap& entity_map;
+	bool varint;
+};
+
+
+struct LUMIX_ENGINE_API BinaryDeserializer final : public IDeserializer
+{
+	BinaryDeserializer(InputMemoryStream& _blob, ILoadEntityGUIDMap& _entity_map, bool _varint = false)
+		: blob(_blob)
+		, entity_map(_entity_map)
+		, varint(_varint)
+	{
+	}
+
+	void read(Ref<EntityPtr> entity)  override;
+	void read(Ref<EntityRef> entity)  override;
+	void read(Ref<RigidTransform> value)  override;
+	void read(Ref<LocalRigidTransform> value)  override;
+	void read(Ref<Transform> value)  override;
+	void read(Ref<Vec4> value)  override;
+	void read(Ref<DVec3> value)  override;
+	void read(Ref<Vec3> value)  override;
+	void read(Ref<Quat> value)  override;
+	void read(Ref<float> value)  override;
+	void read(Ref<double> value)  override;
+	void read(Ref<bool> value)  override;
+	void read(Ref<u64> value)  override;
+	void read(Ref<i64> value)  override;
+	void read(Ref<u32> value)  override;
+	void read(Ref<i32> value)  override;
+	void read(Ref<u16> value)  override;
+	void read(Ref<u8> value)  override;
+	void read(Ref<i8> value)  override;
+	void read(char* value, int max_size)  override;
+	void read(Ref<String> value)  override;
+	EntityPtr getEntity(EntityGUID guid) override;
+
+	u64 readUnsigned();
+	i64 readSigned();
+
+	InputMemoryStream& blob;
+	ILoadEntityGUIDMap& entity_map;
+	bool varint;
+};
+
 
-}
\ No newline at end of file
+}
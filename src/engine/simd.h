@@ -101,6 +101,18 @@ namespace Lumix
 		return _mm_max_ps(a, b);
 	}
 
+
+	LUMIX_FORCE_INLINE float4 f4CmpGT(float4 a, float4 b)
+	{
+		return _mm_cmpgt_ps(a, b);
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4CmpGE(float4 a, float4 b)
+	{
+		return _mm_cmpge_ps(a, b);
+	}
+
 #else 
 	struct float4
 	{
@@ -239,6 +251,29 @@ namespace Lumix
 		};
 	}
 
+
+	// lanes are -1 where the condition holds, so that f4MoveMask picks them up
+	LUMIX_FORCE_INLINE float4 f4CmpGT(float4 a, float4 b)
+	{
+		return{
+			a.x > b.x ? -1.f : 0.f,
+			a.y > b.y ? -1.f : 0.f,
+			a.z > b.z ? -1.f : 0.f,
+			a.w > b.w ? -1.f : 0.f
+		};
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4CmpGE(float4 a, float4 b)
+	{
+		return{
+			a.x >= b.x ? -1.f : 0.f,
+			a.y >= b.y ? -1.f : 0.f,
+			a.z >= b.z ? -1.f : 0.f,
+			a.w >= b.w ? -1.f : 0.f
+		};
+	}
+
 #endif
 
 
@@ -4,8 +4,11 @@
 #include "engine/log.h"
 #include "engine/math.h"
 #include "engine/prefab.h"
+#include "engine/profiler.h"
 #include "engine/reflection.h"
 #include "engine/serializer.h"
+#include "engine/stream.h"
+#include "engine/string.h"
 #include "engine/universe/component.h"
 
 
@@ -27,8 +30,11 @@ Universe::Universe(IAllocator& allocator)
 	, m_component_destroyed(m_allocator)
 	, m_entity_created(m_allocator)
 	, m_entity_destroyed(m_allocator)
+	, m_entity_parent_changed(m_allocator)
 	, m_entity_moved(m_allocator)
 	, m_first_free_slot(-1)
+	, m_deferred_scenes(m_allocator)
+	, m_deferred_components_created(m_allocator)
 	, m_scenes(m_allocator)
 	, m_hierarchy(m_allocator)
 	, m_transforms(m_allocator)
@@ -336,7 +342,7 @@ EntityRef Universe::cloneEntity(EntityRef entity)
 		{
 			EntityGUID get(EntityPtr entity) override { return { (u64)entity.index }; }
 		} save_map;
-		TextSerializer serializer(blob_out, save_map);
+		BinarySerializer serializer(blob_out, save_map);
 		serializeComponent(serializer, cmp.type, entity);
 		
 		InputMemoryStream blob_in(blob_out);
@@ -344,7 +350,7 @@ EntityRef Universe::cloneEntity(EntityRef entity)
 		{
 			EntityPtr get(EntityGUID guid) override { return { (int)guid.value }; }
 		} load_map;
-		TextDeserializer deserializer(blob_in, load_map);
+		BinaryDeserializer deserializer(blob_in, load_map);
 		deserializeComponent(deserializer, clone, cmp.type, cmp.scene->getVersion());
 	}
 	return clone;
@@ -568,6 +574,8 @@ void Universe::setParent(EntityPtr new_parent, EntityRef child)
 	{
 		if (child_idx >= 0) collectGarbage(child);
 	}
+
+	m_entity_parent_changed.invoke(child);
 }
 
 
@@ -693,6 +701,7 @@ void Universe::serialize(IOutputStream& serializer)
 
 void Universe::deserialize(IInputStream& serializer)
 {
+	PROFILE_FUNCTION();
 	i32 count;
 	serializer.read(count);
 	m_entities.resize(count);
@@ -704,6 +713,7 @@ void Universe::deserialize(IInputStream& serializer)
 	}
 
 	serializer.read(count);
+	m_names.reserve(count);
 	for (int i = 0; i < count; ++i)
 	{
 		EntityName& name = m_names.emplace();
@@ -722,7 +732,7 @@ void Universe::deserialize(IInputStream& serializer)
 
 struct PrefabEntityGUIDMap : public ILoadEntityGUIDMap
 {
-	explicit PrefabEntityGUIDMap(const Array<EntityRef>& _entities)
+	explicit PrefabEntityGUIDMap(Span<const EntityRef> _entities)
 		: entities(_entities)
 	{
 	}
@@ -730,23 +740,103 @@ struct PrefabEntityGUIDMap : public ILoadEntityGUIDMap
 
 	EntityPtr get(EntityGUID guid) override
 	{
-		if (guid.value >= entities.size()) return INVALID_ENTITY;
-		return entities[(int)guid.value];
+		if (guid.value >= entities.length()) return INVALID_ENTITY;
+		return entities[(u32)guid.value];
 	}
 
 
-	const Array<EntityRef>& entities;
+	Span<const EntityRef> entities;
 };
 
 
-EntityPtr Universe::instantiatePrefab(const PrefabResource& prefab,
-	const DVec3& pos,
-	const Quat& rot,
-	float scale)
+// maps entities of the prefab instance to their indices in the prefab
+struct PrefabTemplateGUIDMap final : public ISaveEntityGUIDMap
+{
+	explicit PrefabTemplateGUIDMap(Span<const EntityRef> _entities)
+		: entities(_entities)
+	{
+	}
+
+	EntityGUID get(EntityPtr entity) override
+	{
+		for (u32 i = 0; i < entities.length(); ++i)
+		{
+			if (entities[i].index == entity.index) return {i};
+		}
+		return INVALID_ENTITY_GUID;
+	}
+
+	Span<const EntityRef> entities;
+};
+
+
+// passes values from the text form of a prefab to component deserializers and records them for PrefabTemplate
+// in binary form, so instances can be replayed with BinaryDeserializer
+struct PrefabRecorder final : public IDeserializer
 {
+	PrefabRecorder(TextDeserializer& _text, OutputMemoryStream& _blob, Span<const EntityRef> _entities)
+		: text(_text)
+		, guid_map(_entities)
+		, serializer(_blob, guid_map)
+	{
+	}
+
+	template <typename T> void pass(Ref<T> value)
+	{
+		text.read(value);
+		serializer.write("", value.value);
+	}
+
+	void read(Ref<EntityPtr> entity) override { pass(entity); }
+	void read(Ref<EntityRef> entity) override { pass(entity); }
+	void read(Ref<Transform> value) override { pass(value); }
+	void read(Ref<RigidTransform> value) override { pass(value); }
+	void read(Ref<LocalRigidTransform> value) override { pass(value); }
+	void read(Ref<Vec4> value) override { pass(value); }
+	void read(Ref<DVec3> value) override { pass(value); }
+	void read(Ref<Vec3> value) override { pass(value); }
+	void read(Ref<Quat> value) override { pass(value); }
+	void read(Ref<float> value) override { pass(value); }
+	void read(Ref<double> value) override { pass(value); }
+	void read(Ref<bool> value) override { pass(value); }
+	void read(Ref<u64> value) override { pass(value); }
+	void read(Ref<i64> value) override { pass(value); }
+	void read(Ref<u32> value) override { pass(value); }
+	void read(Ref<i32> value) override { pass(value); }
+	void read(Ref<u16> value) override { pass(value); }
+	void read(Ref<u8> value) override { pass(value); }
+	void read(Ref<i8> value) override { pass(value); }
+
+	void read(char* value, int max_size) override
+	{
+		text.read(value, max_size);
+		serializer.write("", (const char*)value);
+	}
+
+	void read(Ref<String> value) override
+	{
+		text.read(value);
+		serializer.write("", value->c_str());
+	}
+
+	EntityPtr getEntity(EntityGUID guid) override { return text.getEntity(guid); }
+
+	TextDeserializer& text;
+	PrefabTemplateGUIDMap guid_map;
+	BinarySerializer serializer;
+};
+
+
+// instantiates the prefab from its text form and fills prefab.compiled on the way
+static EntityPtr compilePrefab(Universe& universe, PrefabResource& prefab, const Transform& transform, IAllocator& allocator)
+{
+	PROFILE_FUNCTION();
+	PrefabTemplate& tmpl = prefab.compiled;
+	tmpl.clear();
+
 	InputMemoryStream blob(prefab.data.begin(), prefab.data.byte_size());
-	Array<EntityRef> entities(m_allocator);
-	PrefabEntityGUIDMap entity_map(entities);
+	Array<EntityRef> entities(allocator);
+	PrefabEntityGUIDMap entity_map(Span<const EntityRef>(nullptr, nullptr));
 	TextDeserializer deserializer(blob, entity_map);
 	u32 version;
 	deserializer.read(Ref(version));
@@ -757,18 +847,31 @@ EntityPtr Universe::instantiatePrefab(const PrefabResource& prefab,
 	}
 	int count;
 	deserializer.read(Ref(count));
-	int entity_idx = 0;
+	if (count <= 0) return INVALID_ENTITY;
+
 	entities.reserve(count);
 	for (int i = 0; i < count; ++i)
 	{
-		entities.push(createEntity({0, 0, 0}, {0, 0, 0, 1}));
+		entities.push(universe.createEntity({0, 0, 0}, {0, 0, 0, 1}));
 	}
-	while (blob.getPosition() < blob.size() && entity_idx < count)
+	entity_map.entities = Span<const EntityRef>(entities.begin(), entities.end());
+
+	OutputMemoryStream recorded(allocator);
+	PrefabRecorder recorder(deserializer, recorded, entity_map.entities);
+	tmpl.entities.reserve(count);
+	while (tmpl.entities.size() < count)
 	{
-		u64 prefab;
-		deserializer.read(Ref(prefab));
-		EntityRef entity = entities[entity_idx];
-		setTransform(entity, {pos, rot, scale});
+		const EntityRef entity = entities[tmpl.entities.size()];
+		PrefabTemplate::Entity& tmpl_entity = tmpl.entities.emplace();
+		tmpl_entity.parent = -1;
+		tmpl_entity.local_transform = {DVec3(0, 0, 0), Quat::IDENTITY, 1};
+		tmpl_entity.first_component = tmpl.components.size();
+		tmpl_entity.components_count = 0;
+		universe.setTransform(entity, transform);
+		if (blob.getPosition() >= blob.size()) continue;
+
+		u64 prefab_hash;
+		deserializer.read(Ref(prefab_hash));
 		if (version > (int)PrefabVersion::WITH_HIERARCHY)
 		{
 			EntityPtr parent;
@@ -780,8 +883,13 @@ EntityPtr Universe::instantiatePrefab(const PrefabResource& prefab,
 				deserializer.read(Ref(local_tr));
 				float scale;
 				deserializer.read(Ref(scale));
-				setParent(parent, entity);
-				setLocalTransform(entity, {local_tr.pos, local_tr.rot, scale});
+				universe.setParent(parent, entity);
+				universe.setLocalTransform(entity, {local_tr.pos, local_tr.rot, scale});
+				if (universe.getParent(entity) == parent)
+				{
+					tmpl_entity.parent = (i32)recorder.guid_map.get(parent).value;
+					tmpl_entity.local_transform = {local_tr.pos, local_tr.rot, scale};
+				}
 			}
 		}
 		u32 cmp_type_hash;
@@ -791,15 +899,114 @@ EntityPtr Universe::instantiatePrefab(const PrefabResource& prefab,
 			ComponentType cmp_type = Reflection::getComponentTypeFromHash(cmp_type_hash);
 			int scene_version;
 			deserializer.read(Ref(scene_version));
-			deserializeComponent(deserializer, entity, cmp_type, scene_version);
+			PrefabTemplate::Component& cmp = tmpl.components.emplace();
+			cmp.type = cmp_type;
+			cmp.scene_version = scene_version;
+			universe.deserializeComponent(recorder, entity, cmp_type, scene_version);
 			deserializer.read(Ref(cmp_type_hash));
 		}
-		++entity_idx;
+		tmpl_entity.components_count = tmpl.components.size() - tmpl_entity.first_component;
 	}
+
+	tmpl.data.resize((int)recorded.getPos());
+	if (!tmpl.data.empty()) copyMemory(tmpl.data.begin(), recorded.getData(), recorded.getPos());
+	tmpl.is_compiled = true;
 	return entities[0];
 }
 
 
+static const Transform& getPrefabEntityTransform(const PrefabTemplate& tmpl,
+	u32 idx,
+	const Transform& root,
+	Array<Transform>& transforms,
+	Array<bool>& is_computed)
+{
+	if (!is_computed[idx])
+	{
+		const PrefabTemplate::Entity& entity = tmpl.entities[idx];
+		transforms[idx] = entity.parent < 0
+			? root
+			: getPrefabEntityTransform(tmpl, entity.parent, root, transforms, is_computed) * entity.local_transform;
+		is_computed[idx] = true;
+	}
+	return transforms[idx];
+}
+
+
+EntityPtr Universe::instantiatePrefab(PrefabResource& prefab,
+	const DVec3& pos,
+	const Quat& rot,
+	float scale)
+{
+	const Transform tr(pos, rot, scale);
+	EntityRef root;
+	if (!instantiatePrefabs(prefab, Span<const Transform>(&tr, 1), Span<EntityRef>(&root, 1))) return INVALID_ENTITY;
+	return root;
+}
+
+
+bool Universe::instantiatePrefabs(PrefabResource& prefab, Span<const Transform> transforms, Span<EntityRef> roots)
+{
+	PROFILE_FUNCTION();
+	ASSERT(transforms.length() == roots.length());
+	if (transforms.length() == 0) return true;
+
+	PrefabTemplate& tmpl = prefab.compiled;
+	u32 first_instance = 0;
+	if (!tmpl.is_compiled)
+	{
+		const EntityPtr root = compilePrefab(*this, prefab, transforms[0], m_allocator);
+		if (!root.isValid()) return false;
+		roots[0] = (EntityRef)root;
+		first_instance = 1;
+	}
+
+	// entities are created directly with their final transforms and hierarchy,
+	// so nothing is propagated through the hierarchy and no entity is moved after it's created
+	const int count = tmpl.entities.size();
+	Array<EntityRef> entities(m_allocator);
+	Array<Transform> world_transforms(m_allocator);
+	Array<bool> is_computed(m_allocator);
+	entities.resize(count);
+	world_transforms.resize(count);
+	is_computed.resize(count);
+	PrefabEntityGUIDMap entity_map(Span<const EntityRef>(entities.begin(), entities.end()));
+	for (u32 instance = first_instance; instance < transforms.length(); ++instance)
+	{
+		const Transform& root_tr = transforms[instance];
+		for (bool& b : is_computed) b = false;
+		for (int i = 0; i < count; ++i)
+		{
+			const Transform& tr = getPrefabEntityTransform(tmpl, i, root_tr, world_transforms, is_computed);
+			entities[i] = createEntity(tr.pos, tr.rot);
+			m_transforms[entities[i].index].scale = tr.scale;
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			const PrefabTemplate::Entity& tmpl_entity = tmpl.entities[i];
+			if (tmpl_entity.parent < 0) continue;
+			setParent(entities[tmpl_entity.parent], entities[i]);
+			m_hierarchy[m_entities[entities[i].index].hierarchy].local_transform = tmpl_entity.local_transform;
+		}
+
+		InputMemoryStream blob(tmpl.data.begin(), tmpl.data.byte_size());
+		BinaryDeserializer deserializer(blob, entity_map);
+		for (int i = 0; i < count; ++i)
+		{
+			const PrefabTemplate::Entity& tmpl_entity = tmpl.entities[i];
+			for (u32 j = 0; j < tmpl_entity.components_count; ++j)
+			{
+				const PrefabTemplate::Component& cmp = tmpl.components[tmpl_entity.first_component + j];
+				deserializeComponent(deserializer, entities[i], cmp.type, cmp.scene_version);
+			}
+		}
+		roots[instance] = entities[0];
+	}
+	return true;
+}
+
+
 void Universe::setScale(EntityRef entity, float scale)
 {
 	m_transforms[entity.index].scale = scale;
@@ -895,9 +1102,32 @@ void Universe::destroyComponent(EntityRef entity, ComponentType type)
 void Universe::onComponentCreated(EntityRef entity, ComponentType component_type, IScene* scene)
 {
 	ComponentUID cmp(entity, component_type, scene);
+	if (m_deferred_scenes.indexOf(scene) >= 0) {
+		MT::CriticalSectionLock lock(m_deferred_components_mutex);
+		m_deferred_components_created.push(cmp);
+		return;
+	}
 	m_entities[entity.index].components |= (u64)1 << component_type.index;
 	m_component_added.invoke(cmp);
 }
 
 
+void Universe::beginDeferredComponentsCreated(IScene& scene)
+{
+	ASSERT(m_deferred_scenes.indexOf(&scene) < 0);
+	m_deferred_scenes.push(&scene);
+}
+
+
+void Universe::endDeferredComponentsCreated()
+{
+	m_deferred_scenes.clear();
+	for (const ComponentUID& cmp : m_deferred_components_created) {
+		m_entities[cmp.entity.index].components |= (u64)1 << cmp.type.index;
+		m_component_added.invoke(cmp);
+	}
+	m_deferred_components_created.clear();
+}
+
+
 } // namespace Lumix
@@ -6,6 +6,7 @@
 #include "engine/iplugin.h"
 #include "engine/lumix.h"
 #include "engine/math.h"
+#include "engine/mt/sync.h"
 
 
 namespace Lumix
@@ -75,6 +76,11 @@ public:
 	void destroyComponent(EntityRef entity, ComponentType type);
 	void onComponentCreated(EntityRef entity, ComponentType component_type, IScene* scene);
 	void onComponentDestroyed(EntityRef entity, ComponentType component_type, IScene* scene);
+	// components created by a deferred scene are queued, so the scene can call onComponentCreated
+	// from another thread, they are announced on the calling thread of endDeferredComponentsCreated;
+	// scenes which are not deferred announce their components immediately
+	void beginDeferredComponentsCreated(IScene& scene);
+	void endDeferredComponentsCreated();
     u64 getComponentsMask(EntityRef entity) const;
     bool hasComponent(EntityRef entity, ComponentType component_type) const;
 	ComponentUID getComponent(EntityRef entity, ComponentType type) const;
@@ -121,10 +127,12 @@ public:
 	void setPosition(EntityRef entity, double x, double y, double z);
 	void setPosition(EntityRef entity, const DVec3& pos);
 	void setScale(EntityRef entity, float scale);
-	EntityPtr instantiatePrefab(const PrefabResource& prefab,
+	EntityPtr instantiatePrefab(PrefabResource& prefab,
 		const DVec3& pos,
 		const Quat& rot,
 		float scale);
+	// creates transforms.length() instances, root of each one is written to roots
+	bool instantiatePrefabs(PrefabResource& prefab, Span<const Transform> transforms, Span<EntityRef> roots);
 	float getScale(EntityRef entity) const;
 	const DVec3& getPosition(EntityRef entity) const;
 	const Quat& getRotation(EntityRef entity) const;
@@ -137,6 +145,7 @@ public:
 	DelegateList<void(EntityRef)>& entityTransformed() { return m_entity_moved; }
 	DelegateList<void(EntityRef)>& entityCreated() { return m_entity_created; }
 	DelegateList<void(EntityRef)>& entityDestroyed() { return m_entity_destroyed; }
+	DelegateList<void(EntityRef)>& entityParentChanged() { return m_entity_parent_changed; }
 	DelegateList<void(const ComponentUID&)>& componentDestroyed() { return m_component_destroyed; }
 	DelegateList<void(const ComponentUID&)>& componentAdded() { return m_component_added; }
 
@@ -182,9 +191,13 @@ private:
 	DelegateList<void(EntityRef)> m_entity_moved;
 	DelegateList<void(EntityRef)> m_entity_created;
 	DelegateList<void(EntityRef)> m_entity_destroyed;
+	DelegateList<void(EntityRef)> m_entity_parent_changed;
 	DelegateList<void(const ComponentUID&)> m_component_destroyed;
 	DelegateList<void(const ComponentUID&)> m_component_added;
 	int m_first_free_slot;
+	Array<IScene*> m_deferred_scenes;
+	Array<ComponentUID> m_deferred_components_created;
+	MT::CriticalSection m_deferred_components_mutex;
 	StaticString<64> m_name;
 };
 
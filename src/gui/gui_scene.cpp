@@ -6,6 +6,7 @@
 #include "engine/log.h"
 #include "engine/os.h"
 #include "engine/plugin_manager.h"
+#include "engine/profiler.h"
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
 #include "engine/serializer.h"
@@ -51,6 +52,7 @@ struct GUIText
 			m_font_resource->getResourceManager().unload(*m_font_resource);
 		}
 		m_font_resource = res;
+		m_measured_font = nullptr;
 		if (res) res->onLoaded<GUIText, &GUIText::onFontLoaded>(this);
 	}
 
@@ -68,6 +70,7 @@ struct GUIText
 	void setFontSize(int value)
 	{
 		m_font_size = value;
+		m_measured_font = nullptr;
 		if (m_font_resource && m_font_resource->isReady())
 		{
 			if(m_font) m_font_resource->removeRef(*m_font);
@@ -81,6 +84,22 @@ struct GUIText
 	Font* getFont() const { return m_font; }
 
 
+	// measured size is cached for the current font, call textChanged after any change of `text`
+	Vec2 getTextSize()
+	{
+		ASSERT(m_font);
+		if (m_measured_font != m_font)
+		{
+			m_measured_size = measureTextA(*m_font, text.c_str(), nullptr);
+			m_measured_font = m_font;
+		}
+		return m_measured_size;
+	}
+
+
+	void textChanged() { m_measured_font = nullptr; }
+
+
 	String text;
 	GUIScene::TextHAlign horizontal_align = GUIScene::TextHAlign::LEFT;
 	u32 color = 0xff000000;
@@ -89,6 +108,8 @@ private:
 	int m_font_size = 13;
 	Font* m_font = nullptr;
 	FontResource* m_font_resource = nullptr;
+	const Font* m_measured_font = nullptr;
+	Vec2 m_measured_size;
 };
 
 
@@ -144,6 +165,8 @@ struct GUIRect
 	GUIText* text = nullptr;
 	GUIInputField* input_field = nullptr;
 	ffr::TextureHandle* render_target = nullptr;
+	// absolute position on canvas, valid only for rects in GUISceneImpl::m_draw_list
+	GUIScene::Rect layout;
 };
 
 
@@ -154,6 +177,7 @@ struct GUISceneImpl final : public GUIScene
 		, m_universe(context)
 		, m_system(system)
 		, m_rects(allocator)
+		, m_draw_list(allocator)
 		, m_buttons(allocator)
 		, m_rect_hovered(allocator)
 		, m_rect_hovered_out(allocator)
@@ -198,6 +222,19 @@ struct GUISceneImpl final : public GUIScene
 			, &GUISceneImpl::serializeButton
 			, &GUISceneImpl::deserializeButton);
 		m_font_manager = (FontManager*)system.getEngine().getResourceManager().get(FontResource::TYPE);
+		context.entityParentChanged().bind<GUISceneImpl, &GUISceneImpl::onEntityParentChanged>(this);
+	}
+
+
+	~GUISceneImpl()
+	{
+		m_universe.entityParentChanged().unbind<GUISceneImpl, &GUISceneImpl::onEntityParentChanged>(this);
+	}
+
+
+	void onEntityParentChanged(EntityRef entity)
+	{
+		if (m_rects.find(entity) >= 0) m_layout_dirty = true;
 	}
 
 	void renderTextCursor(GUIRect& rect, Draw2D& draw, const Vec2& pos)
@@ -209,7 +246,6 @@ struct GUISceneImpl final : public GUIScene
 		const char* text = rect.text->text.c_str();
 		const char* text_end = text + rect.input_field->cursor;
 		Font* font = rect.text->getFont();
-		float font_size = (float)rect.text->getFontSize();
 		Vec2 text_size = measureTextA(*font, text, text_end);
 		draw.addLine({ pos.x + text_size.x, pos.y }
 			, { pos.x + text_size.x, pos.y + text_size.y }
@@ -218,17 +254,37 @@ struct GUISceneImpl final : public GUIScene
 	}
 
 
-	void renderRect(GUIRect& rect, Pipeline& pipeline, const Rect& parent_rect)
+	// flattens enabled rects in draw order and computes their position on canvas,
+	// so render does not need to walk the hierarchy every frame
+	void updateLayout(GUIRect& rect, const Rect& parent_rect)
 	{
 		if (!rect.flags.isSet(GUIRect::IS_VALID)) return;
 		if (!rect.flags.isSet(GUIRect::IS_ENABLED)) return;
 
-		float l = parent_rect.x + rect.left.points + parent_rect.w * rect.left.relative;
-		float r = parent_rect.x + rect.right.points + parent_rect.w * rect.right.relative;
-		float t = parent_rect.y + rect.top.points + parent_rect.h * rect.top.relative;
-		float b = parent_rect.y + rect.bottom.points + parent_rect.h * rect.bottom.relative;
+		rect.layout = getRectOnCanvas(parent_rect, rect);
+		m_draw_list.push({&rect, false});
+
+		EntityPtr child = m_universe.getFirstChild(rect.entity);
+		while (child.isValid())
+		{
+			int idx = m_rects.find((EntityRef)child);
+			if (idx >= 0)
+			{
+				updateLayout(*m_rects.at(idx), rect.layout);
+			}
+			child = m_universe.getNextSibling((EntityRef)child);
+		}
+		if (rect.flags.isSet(GUIRect::IS_CLIP)) m_draw_list.push({&rect, true});
+	}
+
+
+	void renderRect(GUIRect& rect, Draw2D& draw)
+	{
+		const float l = rect.layout.x;
+		const float t = rect.layout.y;
+		const float r = rect.layout.x + rect.layout.w;
+		const float b = rect.layout.y + rect.layout.h;
 			 
-		Draw2D& draw = pipeline.getDraw2D();
 		if (rect.flags.isSet(GUIRect::IS_CLIP)) draw.pushClipRect({ l, t }, { r, b });
 
 		if (rect.image && rect.image->flags.isSet(GUIImage::IS_ENABLED))
@@ -288,8 +344,7 @@ struct GUISceneImpl final : public GUIScene
 			Font* font = rect.text->getFont();
 			if (font) {
 				const char* text_cstr = rect.text->text.c_str();
-				float font_size = (float)rect.text->getFontSize();
-				Vec2 text_size = measureTextA(*font, text_cstr, nullptr);
+				Vec2 text_size = rect.text->getTextSize();
 				Vec2 text_pos(l, t);
 
 				switch (rect.text->horizontal_align)
@@ -303,27 +358,33 @@ struct GUISceneImpl final : public GUIScene
 				renderTextCursor(rect, draw, text_pos);
 			}
 		}
-
-		EntityPtr child = m_universe.getFirstChild(rect.entity);
-		while (child.isValid())
-		{
-			int idx = m_rects.find((EntityRef)child);
-			if (idx >= 0)
-			{
-				renderRect(*m_rects.at(idx), pipeline, { l, t, r - l, b - t });
-			}
-			child = m_universe.getNextSibling((EntityRef)child);
-		}
-		if (rect.flags.isSet(GUIRect::IS_CLIP)) draw.popClipRect();
 	}
 
 
 	void render(Pipeline& pipeline, const Vec2& canvas_size) override
 	{
+		PROFILE_FUNCTION();
 		if (!m_root) return;
 
-		m_canvas_size = canvas_size;
-		renderRect(*m_root, pipeline, {0, 0, canvas_size.x, canvas_size.y});
+		if (m_layout_dirty || m_canvas_size != canvas_size)
+		{
+			PROFILE_BLOCK("update layout");
+			m_canvas_size = canvas_size;
+			m_draw_list.clear();
+			updateLayout(*m_root, {0, 0, canvas_size.x, canvas_size.y});
+			m_layout_dirty = false;
+		}
+
+		Draw2D& draw = pipeline.getDraw2D();
+		for (const DrawListItem& item : m_draw_list)
+		{
+			if (item.pop_clip)
+			{
+				draw.popClipRect();
+				continue;
+			}
+			renderRect(*item.rect, draw);
+		}
 	}
 
 
@@ -495,29 +556,29 @@ struct GUISceneImpl final : public GUIScene
 		return { l, t, r - l, b - t };
 	}
 
-	void setRectClip(EntityRef entity, bool enable) override { m_rects[entity]->flags.set(GUIRect::IS_CLIP, enable); }
+	void setRectClip(EntityRef entity, bool enable) override { m_rects[entity]->flags.set(GUIRect::IS_CLIP, enable); m_layout_dirty = true; }
 	bool getRectClip(EntityRef entity) override { return m_rects[entity]->flags.isSet(GUIRect::IS_CLIP); }
-	void enableRect(EntityRef entity, bool enable) override { m_rects[entity]->flags.set(GUIRect::IS_ENABLED, enable); }
+	void enableRect(EntityRef entity, bool enable) override { m_rects[entity]->flags.set(GUIRect::IS_ENABLED, enable); m_layout_dirty = true; }
 	bool isRectEnabled(EntityRef entity) override { return m_rects[entity]->flags.isSet(GUIRect::IS_ENABLED); }
 	float getRectLeftPoints(EntityRef entity) override { return m_rects[entity]->left.points; }
-	void setRectLeftPoints(EntityRef entity, float value) override { m_rects[entity]->left.points = value; }
+	void setRectLeftPoints(EntityRef entity, float value) override { m_rects[entity]->left.points = value; m_layout_dirty = true; }
 	float getRectLeftRelative(EntityRef entity) override { return m_rects[entity]->left.relative; }
-	void setRectLeftRelative(EntityRef entity, float value) override { m_rects[entity]->left.relative = value; }
+	void setRectLeftRelative(EntityRef entity, float value) override { m_rects[entity]->left.relative = value; m_layout_dirty = true; }
 
 	float getRectRightPoints(EntityRef entity) override { return m_rects[entity]->right.points; }
-	void setRectRightPoints(EntityRef entity, float value) override { m_rects[entity]->right.points = value; }
+	void setRectRightPoints(EntityRef entity, float value) override { m_rects[entity]->right.points = value; m_layout_dirty = true; }
 	float getRectRightRelative(EntityRef entity) override { return m_rects[entity]->right.relative; }
-	void setRectRightRelative(EntityRef entity, float value) override { m_rects[entity]->right.relative = value; }
+	void setRectRightRelative(EntityRef entity, float value) override { m_rects[entity]->right.relative = value; m_layout_dirty = true; }
 
 	float getRectTopPoints(EntityRef entity) override { return m_rects[entity]->top.points; }
-	void setRectTopPoints(EntityRef entity, float value) override { m_rects[entity]->top.points = value; }
+	void setRectTopPoints(EntityRef entity, float value) override { m_rects[entity]->top.points = value; m_layout_dirty = true; }
 	float getRectTopRelative(EntityRef entity) override { return m_rects[entity]->top.relative; }
-	void setRectTopRelative(EntityRef entity, float value) override { m_rects[entity]->top.relative = value; }
+	void setRectTopRelative(EntityRef entity, float value) override { m_rects[entity]->top.relative = value; m_layout_dirty = true; }
 
 	float getRectBottomPoints(EntityRef entity) override { return m_rects[entity]->bottom.points; }
-	void setRectBottomPoints(EntityRef entity, float value) override { m_rects[entity]->bottom.points = value; }
+	void setRectBottomPoints(EntityRef entity, float value) override { m_rects[entity]->bottom.points = value; m_layout_dirty = true; }
 	float getRectBottomRelative(EntityRef entity) override { return m_rects[entity]->bottom.relative; }
-	void setRectBottomRelative(EntityRef entity, float value) override { m_rects[entity]->bottom.relative = value; }
+	void setRectBottomRelative(EntityRef entity, float value) override { m_rects[entity]->bottom.relative = value; m_layout_dirty = true; }
 
 
 	void setTextFontSize(EntityRef entity, int value) override
@@ -582,6 +643,7 @@ struct GUISceneImpl final : public GUIScene
 	{
 		GUIText* gui_text = m_rects[entity]->text;
 		gui_text->text = value;
+		gui_text->textChanged();
 	}
 
 
@@ -639,6 +701,7 @@ struct GUISceneImpl final : public GUIScene
 		serializer.read(Ref(rect->left.relative));
 		
 		m_root = findRoot();
+		m_layout_dirty = true;
 		
 		m_universe.onComponentCreated(entity, GUI_RECT_TYPE, this);
 	}
@@ -773,6 +836,7 @@ struct GUISceneImpl final : public GUIScene
 		serializer.read(Ref(font_size));
 		rect.text->setFontSize(font_size);
 		serializer.read(Ref(rect.text->text));
+		rect.text->textChanged();
 		FontResource* res = tmp[0] ? m_font_manager->getOwner().load<FontResource>(Path(tmp)) : nullptr;
 		rect.text->setFontResource(res);
 
@@ -791,6 +855,8 @@ struct GUISceneImpl final : public GUIScene
 		}
 		m_rects.clear();
 		m_buttons.clear();
+		m_draw_list.clear();
+		m_layout_dirty = true;
 	}
 
 
@@ -953,6 +1019,7 @@ struct GUISceneImpl final : public GUIScene
 				if (rect->text->text.length() > 0 && rect->input_field->cursor > 0)
 				{
 					rect->text->text.eraseAt(rect->input_field->cursor - 1);
+					rect->text->textChanged();
 					--rect->input_field->cursor;
 				}
 				break;
@@ -960,6 +1027,7 @@ struct GUISceneImpl final : public GUIScene
 				if (rect->input_field->cursor < rect->text->text.length())
 				{
 					rect->text->text.eraseAt(rect->input_field->cursor);
+					rect->text->textChanged();
 				}
 				break;
 			case OS::Keycode::LEFT:
@@ -1052,6 +1120,7 @@ struct GUISceneImpl final : public GUIScene
 		rect->flags.set(GUIRect::IS_ENABLED);
 		m_universe.onComponentCreated(entity, GUI_RECT_TYPE, this);
 		m_root = findRoot();
+		m_layout_dirty = true;
 	}
 
 
@@ -1163,6 +1232,7 @@ struct GUISceneImpl final : public GUIScene
 		{
 			m_root = findRoot();
 		}
+		m_layout_dirty = true;
 		m_universe.onComponentDestroyed(entity, GUI_RECT_TYPE, this);
 	}
 
@@ -1311,6 +1381,7 @@ struct GUISceneImpl final : public GUIScene
 				serializer.read(font_size);
 				text.setFontSize(font_size);
 				serializer.read(text.text);
+				text.textChanged();
 				FontResource* res = tmp[0] == 0 ? nullptr : m_font_manager->getOwner().load<FontResource>(Path(tmp));
 				text.setFontResource(res);
 				m_universe.onComponentCreated(rect->entity, GUI_TEXT_TYPE, this);
@@ -1325,6 +1396,7 @@ struct GUISceneImpl final : public GUIScene
 			serializer.read(button);
 		}
 		m_root = findRoot();
+		m_layout_dirty = true;
 	}
 	
 
@@ -1359,7 +1431,15 @@ struct GUISceneImpl final : public GUIScene
 	Universe& m_universe;
 	GUISystem& m_system;
 	
+	struct DrawListItem
+	{
+		GUIRect* rect;
+		bool pop_clip;
+	};
+
 	AssociativeArray<EntityRef, GUIRect*> m_rects;
+	Array<DrawListItem> m_draw_list;
+	bool m_layout_dirty = true;
 	AssociativeArray<EntityRef, GUIButton> m_buttons;
 	EntityRef m_buttons_down[16];
 	int m_buttons_down_count;
@@ -0,0 +1,73 @@
+#include "editor/asset_compiler.h"
+#include "editor/studio_app.h"
+#include "editor/world_editor.h"
+
+
+// does not reference lua_script's runtime, so the cooker can link it on its own
+using namespace Lumix;
+
+
+namespace
+{
+
+
+static const ResourceType LUA_SCRIPT_TYPE("lua_script");
+
+
+struct ScriptCompiler final : AssetCompiler::IPlugin
+{
+	explicit ScriptCompiler(StudioApp& app)
+		: m_app(app)
+	{}
+
+	bool compile(const Path& src) override
+	{
+		return m_app.getAssetCompiler().copyCompile(src);
+	}
+
+	bool isThreadSafe() const override { return true; }
+
+	StudioApp& m_app;
+};
+
+
+struct CompilersPlugin : StudioApp::IPlugin
+{
+	explicit CompilersPlugin(StudioApp& app)
+		: m_app(app)
+		, m_script_compiler(app)
+	{
+	}
+
+
+	const char* getName() const override { return "lua_script_compilers"; }
+
+
+	void init() override
+	{
+		AssetCompiler& asset_compiler = m_app.getAssetCompiler();
+		asset_compiler.registerExtension("lua", LUA_SCRIPT_TYPE);
+		const char* exts[] = { "lua", nullptr };
+		asset_compiler.addPlugin(m_script_compiler, exts);
+	}
+
+
+	~CompilersPlugin()
+	{
+		m_app.getAssetCompiler().removePlugin(m_script_compiler);
+	}
+
+
+	StudioApp& m_app;
+	ScriptCompiler m_script_compiler;
+};
+
+
+} // anonymous namespace
+
+
+LUMIX_ASSET_COMPILER_ENTRY(lua_script)
+{
+	IAllocator& allocator = app.getWorldEditor().getAllocator();
+	return LUMIX_NEW(allocator, CompilersPlugin)(app);
+}
@@ -433,21 +433,14 @@ struct PropertyGridPlugin final : public PropertyGrid::IPlugin
 };
 
 
-struct AssetPlugin : AssetBrowser::IPlugin, AssetCompiler::IPlugin
+struct AssetPlugin : AssetBrowser::IPlugin
 {
 	explicit AssetPlugin(StudioApp& app)
 		: m_app(app)
 	{
-		app.getAssetCompiler().registerExtension("lua", LuaScript::TYPE);
 		m_text_buffer[0] = 0;
 	}
 
-
-	bool compile(const Path& src) override
-	{
-		return m_app.getAssetCompiler().copyCompile(src);
-	}
-
 	
 	void onGUI(Span<Resource*> resources) override
 	{
@@ -889,8 +882,6 @@ struct StudioAppPlugin : StudioApp::IPlugin
 
 		m_asset_plugin = LUMIX_NEW(allocator, AssetPlugin)(m_app);
 		m_app.getAssetBrowser().addPlugin(*m_asset_plugin);
-		const char* exts[] = { "lua", nullptr };
-		m_app.getAssetCompiler().addPlugin(*m_asset_plugin, exts);
 
 		m_console_plugin = LUMIX_NEW(allocator, ConsolePlugin)(m_app);
 		m_app.addPlugin(*m_console_plugin);
@@ -907,7 +898,6 @@ struct StudioAppPlugin : StudioApp::IPlugin
 		m_app.getPropertyGrid().removePlugin(*m_prop_grid_plugin);
 		LUMIX_DELETE(allocator, m_prop_grid_plugin);
 
-		m_app.getAssetCompiler().removePlugin(*m_asset_plugin);
 		m_app.getAssetBrowser().removePlugin(*m_asset_plugin);
 		LUMIX_DELETE(allocator, m_asset_plugin);
 
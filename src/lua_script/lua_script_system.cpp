@@ -71,6 +71,7 @@ namespace Lumix
 		LuaScriptManager& getScriptManager() { return m_script_manager; }
 
 		Engine& m_engine;
+		TagAllocator m_tag_allocator;
 		Debug::Allocator m_allocator;
 		LuaScriptManager m_script_manager;
 	};
@@ -1707,7 +1708,7 @@ namespace Lumix
 			if (!m_animation_scene) return;
 
 			InputMemoryStream blob(m_animation_scene->getEventStream());
-			u32 lua_call_type = crc32("lua_call");
+			static constexpr u32 lua_call_type = crc32Const("lua_call");
 			while (blob.getPosition() < blob.size())
 			{
 				u32 type;
@@ -1923,7 +1924,8 @@ namespace Lumix
 
 	LuaScriptSystemImpl::LuaScriptSystemImpl(Engine& engine)
 		: m_engine(engine)
-		, m_allocator(engine.getAllocator())
+		, m_tag_allocator(engine.getAllocator(), "lua_script")
+		, m_allocator(m_tag_allocator)
 		, m_script_manager(m_allocator)
 	{
 		m_script_manager.create(LuaScript::TYPE, engine.getResourceManager());
@@ -3,9 +3,11 @@
 #include "engine/array.h"
 #include "engine/crc32.h"
 #include "engine/engine.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
 #include "engine/lumix.h"
+#include "engine/mt/atomic.h"
 #include "engine/os.h"
 #include "engine/profiler.h"
 #include "engine/reflection.h"
@@ -46,6 +48,13 @@ static const float CELL_SIZE = 0.3f;
 
 
 struct RecastZone {
+	explicit RecastZone(IAllocator& allocator)
+		: agents(allocator)
+		, positions(allocator)
+		, rotations(allocator)
+		, finished(allocator)
+	{}
+
 	EntityRef entity;
 	NavmeshZone zone;
 
@@ -57,6 +66,14 @@ struct RecastZone {
 	rcHeightfield* debug_heightfield = nullptr;
 	rcContourSet* debug_contours = nullptr;
 	dtCrowd* crowd = nullptr;
+
+	// agents assigned to this zone
+	Array<EntityRef> agents;
+	// lateUpdate writeback, parallel to `agents`
+	Array<DVec3> positions;
+	Array<Quat> rotations;
+	// agents which finished their path during this lateUpdate
+	Array<EntityRef> finished;
 };
 
 
@@ -339,14 +356,15 @@ struct NavigationSceneImpl final : public NavigationScene
 	}
 
 	void update(RecastZone& zone, float time_delta) {
-		if (!zone.crowd) return;
+		PROFILE_FUNCTION();
+		Profiler::pushInt("Agents", zone.agents.size());
 		zone.crowd->update(time_delta, nullptr);
 
 		const Transform inv_tr = m_universe.getTransform(zone.entity).inverted();
 
-		for (auto& agent : m_agents) {
+		for (EntityRef entity : zone.agents) {
+			Agent& agent = m_agents[entity];
 			if (agent.agent < 0) continue;
-			if (agent.zone != zone.entity) continue;
 			
 			const dtCrowdAgent* dt_agent = zone.crowd->getAgent(agent.agent);
 			//if (dt_agent->paused) continue;
@@ -366,29 +384,43 @@ struct NavigationSceneImpl final : public NavigationScene
 		}
 	}
 
+	void getActiveZones(Array<RecastZone*>& zones) {
+		zones.reserve(m_zones.size());
+		for (RecastZone& zone : m_zones) {
+			if (zone.crowd && !zone.agents.empty()) zones.push(&zone);
+		}
+	}
+
 	void update(float time_delta, bool paused) override {
 		PROFILE_FUNCTION();
 		if (paused) return;
 		
-		for (RecastZone& zone : m_zones) {
-			update(zone, time_delta);
-		}
+		// each zone has its own dtCrowd and agent list, so zones are independent
+		Array<RecastZone*> zones(m_allocator);
+		getActiveZones(zones);
+		auto update_zone = [&](int idx){
+			update(*zones[idx], time_delta);
+		};
+		JobSystem::forEach(zones.size(), update_zone);
 
 		m_on_update.invoke(time_delta);
 	}
 
-	void lateUpdate(RecastZone& zone, float time_delta) {
-		if (!zone.crowd) return;
+	// runs on worker, must not modify universe nor call scripts
+	void lateUpdate(RecastZone& zone, float time_delta, AnimationScene* anim_scene) {
+		PROFILE_FUNCTION();
+		Profiler::pushInt("Agents", zone.agents.size());
 		
 		const Transform zone_tr = m_universe.getTransform(zone.entity);
 		const Transform inv_zone_tr = zone_tr.inverted();
 
-		static const u32 ANIMATION_HASH = crc32("animation");
-		auto* anim_scene = (AnimationScene*)m_universe.getScene(ANIMATION_HASH);
+		zone.positions.resize(zone.agents.size());
+		zone.rotations.resize(zone.agents.size());
+		zone.finished.clear();
 
-		for (Agent& agent : m_agents) {
+		for (EntityRef entity : zone.agents) {
+			Agent& agent = m_agents[entity];
 			if (agent.agent < 0) continue;
-			if (agent.zone != zone.entity) continue;
 
 			const dtCrowdAgent* dt_agent = zone.crowd->getAgent(agent.agent);
 			//if (dt_agent->paused) continue;
@@ -396,7 +428,7 @@ struct NavigationSceneImpl final : public NavigationScene
 			DVec3 pos = m_universe.getPosition(agent.entity);
 			Quat rot = m_universe.getRotation(agent.entity);
 			if (agent.flags & Agent::GET_ROOT_MOTION_FROM_ANIM_CONTROLLER && anim_scene) {
-				if (anim_scene->getUniverse().hasComponent(agent.entity, ANIM_CONTROLLER_TYPE)) {
+				if (m_universe.hasComponent(agent.entity, ANIM_CONTROLLER_TYPE)) {
 					LocalRigidTransform root_motion = anim_scene->getControllerRootMotion(agent.entity);
 					agent.root_motion = root_motion.pos;
 					//m_universe.setRotation(agent.entity, m_universe.getRotation(agent.entity) * root_motion.rot);
@@ -410,15 +442,20 @@ struct NavigationSceneImpl final : public NavigationScene
 
 		zone.crowd->doMove(time_delta);
 
-		for (auto& agent : m_agents) {
-			if (agent.agent < 0) continue;
-			if (agent.zone != zone.entity) continue;
+		for (int i = 0, c = zone.agents.size(); i < c; ++i) {
+			Agent& agent = m_agents[zone.agents[i]];
+			const Quat old_rot = m_universe.getRotation(agent.entity);
+			if (agent.agent < 0) {
+				zone.positions[i] = m_universe.getPosition(agent.entity);
+				zone.rotations[i] = old_rot;
+				continue;
+			}
 
 			const dtCrowdAgent* dt_agent = zone.crowd->getAgent(agent.agent);
 			//if (dt_agent->paused) continue;
 
-			m_moving_agent = agent.entity;
-			m_universe.setPosition(agent.entity, zone_tr.transform(*(Vec3*)dt_agent->npos));
+			zone.positions[i] = zone_tr.transform(*(Vec3*)dt_agent->npos);
+			zone.rotations[i] = old_rot;
 
 			if ((agent.flags & Agent::USE_ROOT_MOTION) == 0) {
 				Vec3 vel = *(Vec3*)dt_agent->nvel;
@@ -428,16 +465,13 @@ struct NavigationSceneImpl final : public NavigationScene
 					vel *= 1 / len;
 					float angle = atan2f(vel.x, vel.z);
 					Quat wanted_rot(Vec3(0, 1, 0), angle);
-					Quat old_rot = m_universe.getRotation(agent.entity);
-					Quat new_rot;
-					nlerp(wanted_rot, old_rot, &new_rot, 0.90f);
-					m_universe.setRotation(agent.entity, new_rot);
+					nlerp(wanted_rot, old_rot, &zone.rotations[i], 0.90f);
 				}
 			}
 			else if (agent.flags & Agent::GET_ROOT_MOTION_FROM_ANIM_CONTROLLER && anim_scene) {
-				if (anim_scene->getUniverse().hasComponent(agent.entity, ANIM_CONTROLLER_TYPE)) {
+				if (m_universe.hasComponent(agent.entity, ANIM_CONTROLLER_TYPE)) {
 					LocalRigidTransform root_motion = anim_scene->getControllerRootMotion(agent.entity);
-					m_universe.setRotation(agent.entity, m_universe.getRotation(agent.entity) * root_motion.rot);
+					zone.rotations[i] = old_rot * root_motion.rot;
 				}
 			}
 
@@ -445,7 +479,7 @@ struct NavigationSceneImpl final : public NavigationScene
 				if (!agent.is_finished) {
 					zone.crowd->resetMoveTarget(agent.agent);
 					agent.is_finished = true;
-					onPathFinished(agent);
+					zone.finished.push(agent.entity);
 				}
 			}
 			else if (dt_agent->ncorners == 1 && agent.stop_distance > 0) {
@@ -453,21 +487,47 @@ struct NavigationSceneImpl final : public NavigationScene
 				if (diff.squaredLength() < agent.stop_distance * agent.stop_distance) {
 					zone.crowd->resetMoveTarget(agent.agent);
 					agent.is_finished = true;
-					onPathFinished(agent);
+					zone.finished.push(agent.entity);
 				}
 			}
 			else {
 				agent.is_finished = false;
 			}
+		}
+	}
+
+	void writeback(const RecastZone& zone) {
+		for (int i = 0, c = zone.agents.size(); i < c; ++i) {
+			const EntityRef entity = zone.agents[i];
+			if (m_agents[entity].agent < 0) continue;
+
+			m_moving_agent = entity;
+			m_universe.setTransform(entity, RigidTransform(zone.positions[i], zone.rotations[i]));
 			m_moving_agent = INVALID_ENTITY;
 		}
+
+		for (EntityRef entity : zone.finished) {
+			onPathFinished(m_agents[entity]);
+		}
 	}
 
 	void lateUpdate(float time_delta, bool paused) override {
 		PROFILE_FUNCTION();
 		if (paused) return;
-		for (RecastZone& zone : m_zones) {
-			lateUpdate(zone, time_delta);
+
+		static const u32 ANIMATION_HASH = crc32("animation");
+		auto* anim_scene = (AnimationScene*)m_universe.getScene(ANIMATION_HASH);
+
+		Array<RecastZone*> zones(m_allocator);
+		getActiveZones(zones);
+		auto update_zone = [&](int idx){
+			lateUpdate(*zones[idx], time_delta, anim_scene);
+		};
+		JobSystem::forEach(zones.size(), update_zone);
+
+		PROFILE_BLOCK("writeback");
+		for (RecastZone* zone : zones) {
+			writeback(*zone);
 		}
 	}
 
@@ -963,11 +1023,10 @@ struct NavigationSceneImpl final : public NavigationScene
 	{
 		for (RecastZone& zone : m_zones) {
 			if (zone.crowd) {
-				for (Agent& agent : m_agents) {
-					if (agent.zone == zone.entity) {
-						zone.crowd->removeAgent(agent.agent);
-						agent.agent = -1;
-					}
+				for (EntityRef entity : zone.agents) {
+					Agent& agent = m_agents[entity];
+					if (agent.agent >= 0) zone.crowd->removeAgent(agent.agent);
+					agent.agent = -1;
 				}
 				dtFreeCrowd(zone.crowd);
 				zone.crowd = nullptr;
@@ -997,6 +1056,10 @@ struct NavigationSceneImpl final : public NavigationScene
 			return false;
 		}
 
+		for (EntityRef entity : zone.agents) {
+			addCrowdAgent(m_agents[entity], zone);
+		}
+
 		const Transform inv_zone_tr = m_universe.getTransform(zone.entity).inverted();
 		const Vec3 min = -zone.zone.extents;
 		const Vec3 max = zone.zone.extents;
@@ -1010,6 +1073,7 @@ struct NavigationSceneImpl final : public NavigationScene
 				&& pos.x < max.x && pos.y < max.y && pos.z < max.z)
 			{
 				agent.zone = zone.entity;
+				zone.agents.push(agent.entity);
 				addCrowdAgent(agent, zone);
 			}
 		}
@@ -1360,25 +1424,23 @@ struct NavigationSceneImpl final : public NavigationScene
 	}
 
 	void createZone(EntityRef entity) {
-		RecastZone zone;
+		RecastZone zone(m_allocator);
 		zone.zone.extents = Vec3(1);
 		zone.entity = entity;
-		m_zones.insert(entity, zone);
+		m_zones.insert(entity, static_cast<RecastZone&&>(zone));
 		m_universe.onComponentCreated(entity, NAVMESH_ZONE_TYPE, this);
 	}
 
 	void destroyZone(EntityRef entity) {
 		auto iter = m_zones.find(entity);
 		const RecastZone& zone = iter.value();
-		if (zone.crowd) {
-			for (Agent& agent : m_agents) {
-				if (agent.zone == zone.entity) {
-					zone.crowd->removeAgent(agent.agent);
-					agent.agent = -1;
-				}
-			}
-			dtFreeCrowd(zone.crowd);
+		for (EntityRef agent_entity : zone.agents) {
+			Agent& agent = m_agents[agent_entity];
+			if (zone.crowd && agent.agent >= 0) zone.crowd->removeAgent(agent.agent);
+			agent.agent = -1;
+			agent.zone = INVALID_ENTITY;
 		}
+		if (zone.crowd) dtFreeCrowd(zone.crowd);
 
 		m_zones.erase(iter);
 		m_universe.onComponentDestroyed(entity, NAVMESH_ZONE_TYPE, this);
@@ -1390,10 +1452,10 @@ struct NavigationSceneImpl final : public NavigationScene
 	}
 
 	void deserializeZone(IDeserializer& serializer, EntityRef entity, int scene_version) {
-		RecastZone zone;
+		RecastZone zone(m_allocator);
 		zone.entity = entity;
 		serializer.read(Ref(zone.zone.extents));
-		m_zones.insert(entity, zone);
+		m_zones.insert(entity, static_cast<RecastZone&&>(zone));
 		m_universe.onComponentCreated(entity, NAVMESH_ZONE_TYPE, this);
 	}
 
@@ -1408,6 +1470,7 @@ struct NavigationSceneImpl final : public NavigationScene
 				&& pos.x < max.x && pos.y < max.y && pos.z < max.z)
 			{
 				agent.zone = zone.entity;
+				zone.agents.push(agent.entity);
 				if (zone.crowd) addCrowdAgent(agent, zone);
 				return;
 			}
@@ -1423,8 +1486,8 @@ struct NavigationSceneImpl final : public NavigationScene
 		agent.agent = -1;
 		agent.flags = Agent::USE_ROOT_MOTION;
 		agent.is_finished = true;
-		m_agents.insert(entity, agent);
 		assignZone(agent);
+		m_agents.insert(entity, agent);
 		m_universe.onComponentCreated(entity, NAVMESH_AGENT_TYPE, this);
 	}
 
@@ -1434,8 +1497,9 @@ struct NavigationSceneImpl final : public NavigationScene
 		if (agent.zone.isValid()) {
 			RecastZone& zone = m_zones[(EntityRef)agent.zone];
 			if (zone.crowd && agent.agent >= 0) zone.crowd->removeAgent(agent.agent);
-			m_agents.erase(iter);
+			zone.agents.eraseItemFast(entity);
 		}
+		m_agents.erase(iter);
 		m_universe.onComponentDestroyed(entity, NAVMESH_AGENT_TYPE, this);
 	}
 
@@ -1500,17 +1564,21 @@ struct NavigationSceneImpl final : public NavigationScene
 	}
 
 
+	bool isDeserializeThreadSafe() const override { return true; }
+
+
 	void deserialize(InputMemoryStream& serializer) override
 	{
 		int count = 0;
 		serializer.read(count);
 		m_zones.reserve(count);
 		for (int i = 0; i < count; ++i) {
-			RecastZone zone;
+			RecastZone zone(m_allocator);
 			EntityRef e;
 			serializer.read(e);
 			serializer.read(zone.zone);
-			m_zones.insert(e, zone);
+			zone.entity = e;
+			m_zones.insert(e, static_cast<RecastZone&&>(zone));
 			m_universe.onComponentCreated(e, NAVMESH_ZONE_TYPE, this);
 		}
 
@@ -1,5 +1,8 @@
 #include "physics_geometry.h"
+#include "engine/crc32.h"
 #include "engine/log.h"
+#include "engine/os.h"
+#include "engine/profiler.h"
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
 #include "engine/string.h"
@@ -48,39 +51,6 @@ struct OutputStream final : public physx::PxOutputStream
 };
 
 
-struct InputStream final : public physx::PxInputStream
-{
-	InputStream(unsigned char* data, int size)
-	{
-		this->data = data;
-		this->size = size;
-		pos = 0;
-	}
-
-	physx::PxU32 read(void* dest, physx::PxU32 count) override
-	{
-		if (pos + (int)count <= size)
-		{
-			copyMemory(dest, data + pos, count);
-			pos += count;
-			return count;
-		}
-		else
-		{
-			copyMemory(dest, data + pos, size - pos);
-			int real_count = size - pos;
-			pos = size;
-			return real_count;
-		}
-	}
-
-
-	int pos;
-	int size;
-	unsigned char* data;
-};
-
-
 const ResourceType PhysicsGeometry::TYPE("physics");
 
 
@@ -96,30 +66,14 @@ PhysicsGeometry::PhysicsGeometry(const Path& path, ResourceManager& resource_man
 PhysicsGeometry::~PhysicsGeometry() = default;
 
 
-bool PhysicsGeometry::load(u64 size, const u8* mem)
+static bool cook(InputMemoryStream& file, bool is_convex, PhysicsSystem& system, physx::PxOutputStream& out, IAllocator& allocator)
 {
-	Header header;
-	InputMemoryStream file(mem, size);
-	file.read(&header, sizeof(header));
-	if (header.m_magic != HEADER_MAGIC)
-	{
-		logWarning("Physics") << "Corrupted geometry " << getPath().c_str();
-		return false;
-	}
-
-	if(header.m_version > (u32)Versions::LAST)
-	{
-		logWarning("Physics") << "Unsupported version of geometry " << getPath().c_str();
-		return false;
-	}
-
 	i32 num_verts;
 	Array<Vec3> verts(allocator);
 	file.read(&num_verts, sizeof(num_verts));
 	verts.resize(num_verts);
 	file.read(&verts[0], sizeof(verts[0]) * verts.size());
 
-	bool is_convex = header.m_convex != 0;
 	if (is_convex)
 	{
 		physx::PxConvexMeshDesc meshDesc;
@@ -128,49 +82,89 @@ bool PhysicsGeometry::load(u64 size, const u8* mem)
 		meshDesc.points.data = &verts[0];
 		meshDesc.flags = physx::PxConvexFlag::eCOMPUTE_CONVEX;
 
-		OutputStream writeBuffer(allocator);
-		bool status = system.getCooking()->cookConvexMesh(meshDesc, writeBuffer);
-		if (!status)
-		{
-			convex_mesh = nullptr;
-			return false;
-		}
+		return system.getCooking()->cookConvexMesh(meshDesc, out);
+	}
+
+	u32 num_indices;
+	Array<u32> tris(allocator);
+	file.read(&num_indices, sizeof(num_indices));
+	tris.resize(num_indices);
+	file.read(&tris[0], sizeof(tris[0]) * tris.size());
 
-		InputStream readBuffer(writeBuffer.data, writeBuffer.size);
-		convex_mesh = system.getPhysics()->createConvexMesh(readBuffer);
+	physx::PxTriangleMeshDesc meshDesc;
+	meshDesc.points.count = num_verts;
+	meshDesc.points.stride = sizeof(physx::PxVec3);
+	meshDesc.points.data = &verts[0];
+
+	meshDesc.triangles.count = num_indices / 3;
+	meshDesc.triangles.stride = 3 * sizeof(physx::PxU32);
+	meshDesc.triangles.data = &tris[0];
+
+	return system.getCooking()->cookTriangleMesh(meshDesc, out);
+}
+
+
+bool PhysicsGeometry::create(u8* cooked, u32 size, bool is_convex)
+{
+	physx::PxDefaultMemoryInputData input(cooked, size);
+	if (is_convex)
+	{
+		convex_mesh = system.getPhysics()->createConvexMesh(input);
 		tri_mesh = nullptr;
+		return convex_mesh != nullptr;
 	}
-	else
-	{
-		u32 num_indices;
-		Array<u32> tris(allocator);
-		file.read(&num_indices, sizeof(num_indices));
-		tris.resize(num_indices);
-		file.read(&tris[0], sizeof(tris[0]) * tris.size());
-
-		physx::PxTriangleMeshDesc meshDesc;
-		meshDesc.points.count = num_verts;
-		meshDesc.points.stride = sizeof(physx::PxVec3);
-		meshDesc.points.data = &verts[0];
 
-		meshDesc.triangles.count = num_indices / 3;
-		meshDesc.triangles.stride = 3 * sizeof(physx::PxU32);
-		meshDesc.triangles.data = &tris[0];
+	tri_mesh = system.getPhysics()->createTriangleMesh(input);
+	convex_mesh = nullptr;
+	return tri_mesh != nullptr;
+}
 
-		OutputStream writeBuffer(allocator);
-		if (!system.getCooking()->cookTriangleMesh(meshDesc, writeBuffer))
-		{
-			tri_mesh = nullptr;
-			return false;
-		}
 
-		InputStream readBuffer(writeBuffer.data, writeBuffer.size);
-		tri_mesh = system.getPhysics()->createTriangleMesh(readBuffer);
-		convex_mesh = nullptr;
+bool PhysicsGeometry::load(u64 size, const u8* mem)
+{
+	PROFILE_FUNCTION();
+	Header header;
+	InputMemoryStream file(mem, size);
+	file.read(&header, sizeof(header));
+	if (header.m_magic != HEADER_MAGIC)
+	{
+		logWarning("Physics") << "Corrupted geometry " << getPath().c_str();
+		return false;
+	}
+
+	if(header.m_version > (u32)Versions::LAST)
+	{
+		logWarning("Physics") << "Unsupported version of geometry " << getPath().c_str();
+		return false;
 	}
 
 	m_size = file.size();
-	return true;
+	const bool is_convex = header.m_convex != 0;
+	const u64 key = hash64(getPath().c_str(), stringLength(getPath().c_str()));
+	const u64 source_hash = hash64(mem, size);
+	CookingStats& stats = system.getCookingStats();
+	OS::Timer timer;
+
+	Array<u8> cooked(allocator);
+	if (system.loadCookedData(key, source_hash, Ref(cooked)) && create(cooked.begin(), cooked.size(), is_convex))
+	{
+		++stats.cache_hits;
+		stats.cache_load_time += timer.getTimeSinceStart();
+		return true;
+	}
+
+	OutputStream out(allocator);
+	if (!cook(file, is_convex, system, out, allocator))
+	{
+		logWarning("Physics") << "Failed to cook " << getPath().c_str();
+		return false;
+	}
+	system.saveCookedData(key, source_hash, out.data, out.size);
+
+	++stats.cache_misses;
+	const bool res = create(out.data, out.size, is_convex);
+	stats.cooking_time += timer.getTimeSinceStart();
+	return res;
 }
 
 
@@ -53,6 +53,7 @@ class PhysicsGeometry final : public Resource
 		PhysicsSystem& system;
 		IAllocator& allocator;
 
+		bool create(u8* cooked, u32 size, bool is_convex);
 		void unload() override;
 		bool load(u64 size, const u8* mem) override;
 
@@ -7,6 +7,7 @@
 #include "engine/lua_wrapper.h"
 #include "engine/math.h"
 #include "engine/mt/thread.h"
+#include "engine/os.h"
 #include "engine/path.h"
 #include "engine/profiler.h"
 #include "engine/reflection.h"
@@ -48,6 +49,7 @@ static const u32 RENDERER_HASH = crc32("renderer");
 
 enum class PhysicsSceneVersion
 {
+	FIXED_TIMESTEP,
 	LATEST,
 };
 
@@ -69,6 +71,7 @@ struct RagdollBone
 	RagdollBone* parent;
 	RigidTransform bind_transform;
 	RigidTransform inv_bind_transform;
+	RigidTransform kinematic_target; // computed in parallel, applied with other scene writes
 	bool is_kinematic;
 };
 
@@ -317,6 +320,7 @@ struct PhysicsSceneImpl final : public PhysicsScene
 			, entity(entity)
 			, dynamic_type(DynamicType::STATIC)
 			, is_trigger(false)
+			, has_pose(false)
 			, scale(1)
 		{
 		}
@@ -339,6 +343,10 @@ struct PhysicsSceneImpl final : public PhysicsScene
 		PhysicsSceneImpl& scene;
 		DynamicType dynamic_type;
 		bool is_trigger;
+		// dynamic actors are rendered interpolated between the two last simulated poses
+		bool has_pose;
+		RigidTransform prev_pose;
+		RigidTransform pose;
 
 	private:
 		void onStateChanged(Resource::State old_state, Resource::State new_state, Resource&);
@@ -1547,14 +1555,31 @@ struct PhysicsSceneImpl final : public PhysicsScene
 	}
 
 
-	void updateDynamicActors()
+	void storeDynamicPoses()
+	{
+		PROFILE_FUNCTION();
+		for (RigidActor* actor : m_dynamic_actors)
+		{
+			const RigidTransform pose = fromPhysx(actor->physx_actor->getGlobalPose());
+			actor->prev_pose = actor->has_pose ? actor->pose : pose;
+			actor->pose = pose;
+			actor->has_pose = true;
+		}
+	}
+
+
+	void updateDynamicActors(float alpha)
 	{
 		PROFILE_FUNCTION();
 		for (auto* actor : m_dynamic_actors)
 		{
+			if (!actor->has_pose) continue;
+
 			m_update_in_progress = actor;
-			PxTransform trans = actor->physx_actor->getGlobalPose();
-			m_universe.setTransform(actor->entity, fromPhysx(trans));
+			RigidTransform trans;
+			lerp(actor->prev_pose.pos, actor->pose.pos, &trans.pos, alpha);
+			nlerp(actor->prev_pose.rot, actor->pose.rot, &trans.rot, alpha);
+			m_universe.setTransform(actor->entity, trans);
 		}
 		m_update_in_progress = nullptr;
 
@@ -1588,10 +1613,24 @@ struct PhysicsSceneImpl final : public PhysicsScene
 	}
 
 
-	void updateControllers(float time_delta)
+	void updateControllers()
 	{
 		PROFILE_FUNCTION();
 		for (auto& controller : m_controllers)
+		{
+			const PxExtendedVec3 p = controller.m_controller->getFootPosition();
+			m_universe.setPosition(controller.m_entity, (float)p.x, (float)p.y, (float)p.z);
+		}
+	}
+
+
+	// PxControllerManager can not move controllers concurrently, so all moves are grouped under one write lock
+	// and universe is updated afterwards, since that calls back into the physx scene through onEntityMoved
+	void moveControllers(float time_delta)
+	{
+		PROFILE_FUNCTION();
+		PxSceneWriteLock lock(*m_scene);
+		for (auto& controller : m_controllers)
 		{
 			Vec3 dif = controller.m_frame_change;
 			controller.m_frame_change.set(0, 0, 0);
@@ -1621,9 +1660,6 @@ struct PhysicsSceneImpl final : public PhysicsScene
 
 			PxControllerFilters filters(nullptr, &controller.m_filter_callback);
 			controller.m_controller->move(toPhysx(dif), 0.001f, time_delta, filters);
-			PxExtendedVec3 p = controller.m_controller->getFootPosition();
-
-			m_universe.setPosition(controller.m_entity, (float)p.x, (float)p.y, (float)p.z);
 		}
 	}
 
@@ -2101,61 +2137,86 @@ struct PhysicsSceneImpl final : public PhysicsScene
 	}
 
 
-	void updateBone(const RigidTransform& root_transform, const RigidTransform& inv_root, RagdollBone* bone, Pose* pose)
+	// only reads from the physx scene, kinematic targets are applied later in applyKinematicTargets
+	static void updateBone(const RigidTransform& root_transform, const RigidTransform& inv_root, RagdollBone* bone, Pose* pose)
 	{
-		/*if (!bone) return;
+		if (!bone) return;
 
 		if (bone->is_kinematic)
 		{
-			RigidTransform bone_transform(DVec3(pose->positions[bone->pose_bone_idx]),
-		pose->rotations[bone->pose_bone_idx]); bone->actor->setKinematicTarget(toPhysx(root_transform * bone_transform *
-		bone->inv_bind_transform));
+			const RigidTransform bone_transform(DVec3(pose->positions[bone->pose_bone_idx]), pose->rotations[bone->pose_bone_idx]);
+			bone->kinematic_target = root_transform * bone_transform * bone->inv_bind_transform;
 		}
 		else
 		{
-			PxTransform bone_pose = bone->actor->getGlobalPose();
-			auto tr = inv_root * RigidTransform(DVec3(fromPhysx(bone_pose.p)), fromPhysx(bone_pose.q)) *
-		bone->bind_transform; pose->rotations[bone->pose_bone_idx] = tr.rot; pose->positions[bone->pose_bone_idx] =
-		tr.pos;
+			const PxTransform bone_pose = bone->actor->getGlobalPose();
+			const RigidTransform tr = inv_root * fromPhysx(bone_pose) * bone->bind_transform;
+			pose->rotations[bone->pose_bone_idx] = tr.rot;
+			pose->positions[bone->pose_bone_idx] = tr.pos.toFloat();
 		}
 
 		updateBone(root_transform, inv_root, bone->next, pose);
-		updateBone(root_transform, inv_root, bone->child, pose);*/
+		updateBone(root_transform, inv_root, bone->child, pose);
+	}
 
-		// TODO
+
+	static void applyKinematicTargets(RagdollBone* bone)
+	{
+		if (!bone) return;
+
+		if (bone->is_kinematic) bone->actor->setKinematicTarget(toPhysx(bone->kinematic_target));
+
+		applyKinematicTargets(bone->next);
+		applyKinematicTargets(bone->child);
 	}
 
 
 	void updateRagdolls()
 	{
+		PROFILE_FUNCTION();
 		auto* render_scene = static_cast<RenderScene*>(m_universe.getScene(RENDERER_HASH));
 		if (!render_scene) return;
+		if (m_ragdolls.size() == 0) return;
 
+		Array<Ragdoll*> ragdolls(m_allocator);
+		ragdolls.reserve(m_ragdolls.size());
 		for (auto& ragdoll : m_ragdolls)
 		{
-			EntityRef entity = ragdoll.entity;
-
-			if (!render_scene->getUniverse().hasComponent(entity, MODEL_INSTANCE_TYPE)) continue;
-			Pose* pose = render_scene->lockPose(entity);
-			if (!pose) continue;
+			if (m_universe.hasComponent(ragdoll.entity, MODEL_INSTANCE_TYPE)) ragdolls.push(&ragdoll);
+		}
 
-			RigidTransform root_transform;
-			root_transform.rot = m_universe.getRotation(ragdoll.entity);
-			root_transform.pos = m_universe.getPosition(ragdoll.entity);
+		{
+			PROFILE_BLOCK("pose writeback");
+			auto writeback = [&](int idx) {
+				const Ragdoll& ragdoll = *ragdolls[idx];
+				Pose* pose = render_scene->lockPose(ragdoll.entity);
+				if (!pose) return;
 
-			if (ragdoll.root && !ragdoll.root->is_kinematic)
-			{
-				PxTransform bone_pose = ragdoll.root->actor->getGlobalPose();
-				m_is_updating_ragdoll = true;
+				PxSceneReadLock lock(*m_scene);
+				const RigidTransform root_transform = m_universe.getTransform(ragdoll.entity).getRigidPart();
+				updateBone(root_transform, root_transform.inverted(), ragdoll.root, pose);
+				// bone attachments are moved in the serial phase, moving entities calls back into physx
+				render_scene->unlockPose(ragdoll.entity, false);
+			};
+			JobSystem::forEach(ragdolls.size(), writeback);
+		}
 
-				RigidTransform rigid_tr = fromPhysx(bone_pose) * ragdoll.root_transform;
-				m_universe.setTransform(ragdoll.entity, {rigid_tr.pos, rigid_tr.rot, 1.0f});
+		PROFILE_BLOCK("scene writes");
+		PxSceneWriteLock lock(*m_scene);
+		m_is_updating_ragdoll = true;
+		for (const Ragdoll* ragdoll : ragdolls)
+		{
+			applyKinematicTargets(ragdoll->root);
 
-				m_is_updating_ragdoll = false;
+			if (ragdoll->root && !ragdoll->root->is_kinematic)
+			{
+				const PxTransform bone_pose = ragdoll->root->actor->getGlobalPose();
+				const RigidTransform rigid_tr = fromPhysx(bone_pose) * ragdoll->root_transform;
+				m_universe.setTransform(ragdoll->entity, {rigid_tr.pos, rigid_tr.rot, 1.0f});
 			}
-			updateBone(root_transform, root_transform.inverted(), ragdoll.root, pose);
-			render_scene->unlockPose(entity, true);
+			render_scene->unlockPose(ragdoll->entity, true);
 		}
+		m_is_updating_ragdoll = false;
 	}
 
 
@@ -2182,18 +2243,56 @@ struct PhysicsSceneImpl final : public PhysicsScene
 	{
 		if (!m_is_game_running || paused) return;
 
-		time_delta = minimum(1 / 20.0f, time_delta);
-		updateVehicles(time_delta);
-		simulateScene(time_delta);
-		fetchResults();
+		PROFILE_FUNCTION();
+		// time which does not fit in m_max_substeps is dropped, so a slow frame does not make the next ones even slower
+		m_time_accumulator = minimum(m_time_accumulator + time_delta, m_fixed_timestep * m_max_substeps);
+		int substeps = 0;
+		while (m_time_accumulator >= m_fixed_timestep)
+		{
+			m_time_accumulator -= m_fixed_timestep;
+			updateVehicles(m_fixed_timestep);
+			// accumulated m_frame_change is applied in the first substep, later ones only add gravity
+			moveControllers(m_fixed_timestep);
+			simulateScene(m_fixed_timestep);
+			fetchResults();
+			storeDynamicPoses();
+			++substeps;
+		}
+		Profiler::pushInt("Substeps", substeps);
+
 		updateRagdolls();
-		updateDynamicActors();
-		updateControllers(time_delta);
+		updateDynamicActors(m_time_accumulator / m_fixed_timestep);
+		updateControllers();
 
 		render();
 	}
 
 
+	void logCookingStats()
+	{
+		const CookingStats& stats = m_system->getCookingStats();
+		logInfo("Physics") << "Cooked data cache hits: " << stats.cache_hits << ", misses: " << stats.cache_misses
+			<< ", loading from cache: " << stats.cache_load_time << "s, cooking: " << stats.cooking_time << "s";
+	}
+
+
+	void setUpdateFrequency(float hz) override
+	{
+		// callable from scripts, so invalid values are rejected instead of asserted
+		if (!(hz >= 1 && hz <= 1000))
+		{
+			logWarning("Physics") << "Invalid physics update frequency " << hz << ", must be in range 1 - 1000 Hz";
+			return;
+		}
+		m_fixed_timestep = 1 / hz;
+	}
+
+
+	float getUpdateFrequency() const override { return 1 / m_fixed_timestep; }
+	void setMaxSubsteps(int count) override { m_max_substeps = maximum(count, 1); }
+	int getMaxSubsteps() const override { return m_max_substeps; }
+
+
 	DelegateList<void(const ContactData&)>& onContact() override { return m_contact_callbacks; }
 
 
@@ -2499,6 +2598,8 @@ struct PhysicsSceneImpl final : public PhysicsScene
 		auto* scene = m_universe.getScene(crc32("lua_script"));
 		m_script_scene = static_cast<LuaScriptScene*>(scene);
 		m_is_game_running = true;
+		m_time_accumulator = 0;
+		for (RigidActor* actor : m_dynamic_actors) actor->has_pose = false;
 
 		initJoints();
 		initVehicles();
@@ -2628,6 +2729,57 @@ struct PhysicsSceneImpl final : public PhysicsScene
 	}
 
 
+	static int LUA_raycasts(lua_State* L)
+	{
+		auto* scene = LuaWrapper::checkArg<PhysicsSceneImpl*>(L, 1);
+		LuaWrapper::checkTableArg(L, 2);
+		LuaWrapper::checkTableArg(L, 3);
+		const int layer = lua_gettop(L) > 3 ? LuaWrapper::checkArg<int>(L, 4) : -1;
+
+		// lua errors longjmp past destructors, so nothing is allocated until all arguments are valid
+		auto validate = [](const Vec3&){};
+		if (!LuaWrapper::forEachArrayItem<Vec3>(L, 2, nullptr, validate)) luaL_argerror(L, 2, "array of vec3 expected");
+		if (!LuaWrapper::forEachArrayItem<Vec3>(L, 3, nullptr, validate)) luaL_argerror(L, 3, "array of vec3 expected");
+		const int count = (int)lua_objlen(L, 2);
+		if ((int)lua_objlen(L, 3) != count) luaL_argerror(L, 3, "origins and directions count mismatch");
+
+		Array<RaycastQuery> queries(scene->m_allocator);
+		queries.reserve(count);
+		LuaWrapper::forEachArrayItem<Vec3>(L, 2, nullptr, [&](const Vec3& origin){
+			RaycastQuery& query = queries.emplace();
+			query.origin = origin;
+			query.distance = FLT_MAX;
+			query.ignored = INVALID_ENTITY;
+			query.layer = layer;
+		});
+		int dir_idx = 0;
+		LuaWrapper::forEachArrayItem<Vec3>(L, 3, nullptr, [&](const Vec3& dir){
+			queries[dir_idx].dir = dir;
+			++dir_idx;
+		});
+
+		Array<RaycastHit> hits(scene->m_allocator);
+		hits.resize(queries.size());
+		scene->raycasts(Span<const RaycastQuery>(queries.begin(), queries.end()), Span<RaycastHit>(hits.begin(), hits.end()));
+
+		lua_createtable(L, hits.size(), 0);
+		for (int i = 0; i < hits.size(); ++i) {
+			const RaycastHit& hit = hits[i];
+			if (hit.entity.isValid()) {
+				lua_createtable(L, 0, 3);
+				LuaWrapper::setField(L, -1, "entity", hit.entity);
+				LuaWrapper::setField(L, -1, "position", hit.position);
+				LuaWrapper::setField(L, -1, "normal", hit.normal);
+			}
+			else {
+				lua_pushboolean(L, false);
+			}
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 1;
+	}
+
+
 	EntityPtr raycast(const Vec3& origin, const Vec3& dir, EntityPtr ignore_entity) override
 	{
 		RaycastHit hit;
@@ -2675,35 +2827,126 @@ struct PhysicsSceneImpl final : public PhysicsScene
 		EntityPtr ignored,
 		int layer) override
 	{
-		PxVec3 physx_origin(origin.x, origin.y, origin.z);
-		PxVec3 unit_dir(dir.x, dir.y, dir.z);
-		PxReal max_distance = distance;
+		return castRay({origin, dir, distance, ignored, layer}, result);
+	}
+
 
+	static void toRaycastHit(const PxLocationHit& hit, RaycastHit& result)
+	{
+		result.normal = fromPhysx(hit.normal);
+		result.position = fromPhysx(hit.position);
+		result.entity = INVALID_ENTITY;
+		if (hit.shape)
+		{
+			PxRigidActor* actor = hit.shape->getActor();
+			if (actor) result.entity = {(int)(intptr_t)actor->userData};
+		}
+	}
+
+
+	bool castRay(const RaycastQuery& query, RaycastHit& result)
+	{
 		const PxHitFlags flags = PxHitFlag::ePOSITION | PxHitFlag::eNORMAL;
 		PxRaycastBuffer hit;
 
 		Filter filter;
-		filter.entity = ignored;
-		filter.layer = layer;
+		filter.entity = query.ignored;
+		filter.layer = query.layer;
 		filter.scene = this;
 		PxQueryFilterData filter_data;
 		filter_data.flags = PxQueryFlag::eDYNAMIC | PxQueryFlag::eSTATIC | PxQueryFlag::ePREFILTER;
-		bool status = m_scene->raycast(physx_origin, unit_dir, max_distance, hit, flags, filter_data, &filter);
-		result.normal.x = hit.block.normal.x;
-		result.normal.y = hit.block.normal.y;
-		result.normal.z = hit.block.normal.z;
-		result.position.x = hit.block.position.x;
-		result.position.y = hit.block.position.y;
-		result.position.z = hit.block.position.z;
-		result.entity = INVALID_ENTITY;
-		if (hit.block.shape)
-		{
-			PxRigidActor* actor = hit.block.shape->getActor();
-			if (actor) result.entity = {(int)(intptr_t)actor->userData};
-		}
+		bool status = m_scene->raycast(toPhysx(query.origin), toPhysx(query.dir), query.distance, hit, flags, filter_data, &filter);
+		toRaycastHit(hit.block, result);
+		return status;
+	}
+
+
+	bool castSphere(const SweepQuery& query, RaycastHit& result)
+	{
+		const PxHitFlags flags = PxHitFlag::ePOSITION | PxHitFlag::eNORMAL;
+		PxSweepBuffer hit;
+
+		Filter filter;
+		filter.entity = query.ignored;
+		filter.layer = query.layer;
+		filter.scene = this;
+		PxQueryFilterData filter_data;
+		filter_data.flags = PxQueryFlag::eDYNAMIC | PxQueryFlag::eSTATIC | PxQueryFlag::ePREFILTER;
+		const PxTransform pose(toPhysx(query.origin));
+		bool status = m_scene->sweep(PxSphereGeometry(query.radius), pose, toPhysx(query.dir), query.distance, hit, flags, filter_data, &filter);
+		toRaycastHit(hit.block, result);
 		return status;
 	}
 
+
+	EntityPtr overlapSphere(const OverlapQuery& query)
+	{
+		PxOverlapBuffer hit;
+
+		Filter filter;
+		filter.entity = query.ignored;
+		filter.layer = query.layer;
+		filter.scene = this;
+		PxQueryFilterData filter_data;
+		filter_data.flags = PxQueryFlag::eDYNAMIC | PxQueryFlag::eSTATIC | PxQueryFlag::ePREFILTER | PxQueryFlag::eANY_HIT;
+		const PxTransform pose(toPhysx(query.pos));
+		if (!m_scene->overlap(PxSphereGeometry(query.radius), pose, hit, filter_data, &filter)) return INVALID_ENTITY;
+		if (!hit.block.actor) return INVALID_ENTITY;
+		return EntityPtr{(int)(intptr_t)hit.block.actor->userData};
+	}
+
+
+	// queries are split in batches, each batch is processed by a worker under the scene's read lock
+	template <typename F>
+	void runQueries(u32 count, F&& f)
+	{
+		enum { BATCH_SIZE = 64 };
+		const u32 batches_count = (count + BATCH_SIZE - 1) / BATCH_SIZE;
+		auto batch = [&](int batch_idx) {
+			PROFILE_BLOCK("physics queries");
+			PxSceneReadLock lock(*m_scene);
+			for (u32 i = batch_idx * BATCH_SIZE, end = minimum(count, i + BATCH_SIZE); i < end; ++i) {
+				f(i);
+			}
+		};
+		if (batches_count > 1) {
+			JobSystem::forEach(batches_count, batch);
+		}
+		else if (batches_count == 1) {
+			batch(0);
+		}
+	}
+
+
+	void raycasts(Span<const RaycastQuery> queries, Span<RaycastHit> results) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(queries.length() == results.length());
+		runQueries(queries.length(), [&](u32 i){
+			if (!castRay(queries[i], results[i])) results[i].entity = INVALID_ENTITY;
+		});
+	}
+
+
+	void sweeps(Span<const SweepQuery> queries, Span<RaycastHit> results) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(queries.length() == results.length());
+		runQueries(queries.length(), [&](u32 i){
+			if (!castSphere(queries[i], results[i])) results[i].entity = INVALID_ENTITY;
+		});
+	}
+
+
+	void overlaps(Span<const OverlapQuery> queries, Span<EntityPtr> results) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(queries.length() == results.length());
+		runQueries(queries.length(), [&](u32 i){
+			results[i] = overlapSphere(queries[i]);
+		});
+	}
+
 	void onEntityDestroyed(EntityRef entity)
 	{
 		for (int i = 0, c = m_joints.size(); i < c; ++i)
@@ -2762,6 +3005,9 @@ struct PhysicsSceneImpl final : public PhysicsScene
 					else
 					{
 						actor->physx_actor->setGlobalPose(toPhysx(trans.getRigidPart()), false);
+						// teleported, do not interpolate from the old pose
+						actor->prev_pose = actor->pose = trans.getRigidPart();
+						actor->has_pose = true;
 					}
 					if (actor->resource && actor->scale != trans.scale)
 					{
@@ -2773,7 +3019,7 @@ struct PhysicsSceneImpl final : public PhysicsScene
 	}
 
 
-	void heightmapLoaded(Heightfield& terrain)
+	PxHeightField* cookHeightField(Heightfield& terrain, u64 key, u64 source_hash)
 	{
 		PROFILE_FUNCTION();
 		Array<PxHeightFieldSample> heights(m_allocator);
@@ -2816,17 +3062,57 @@ struct PhysicsSceneImpl final : public PhysicsScene
 			}
 		}
 
+		PROFILE_BLOCK("cook");
+		PxHeightFieldDesc hfDesc;
+		hfDesc.format = PxHeightFieldFormat::eS16_TM;
+		hfDesc.nbColumns = width;
+		hfDesc.nbRows = height;
+		hfDesc.samples.data = &heights[0];
+		hfDesc.samples.stride = sizeof(PxHeightFieldSample);
+
+		OutputStream out(m_allocator);
+		if (!m_system->getCooking()->cookHeightField(hfDesc, out)) return nullptr;
+		m_system->saveCookedData(key, source_hash, out.data, out.size);
+
+		PxDefaultMemoryInputData input(out.data, out.size);
+		return m_system->getPhysics()->createHeightField(input);
+	}
+
+
+	void heightmapLoaded(Heightfield& terrain)
+	{
+		PROFILE_FUNCTION();
+		const int width = terrain.m_heightmap->width;
+		const int height = terrain.m_heightmap->height;
+		const int bytes_per_pixel = terrain.m_heightmap->bytes_per_pixel;
+		const u32 dims[] = { (u32)width, (u32)height, (u32)bytes_per_pixel };
+		const char* heightmap_path = terrain.m_heightmap->getPath().c_str();
+		const u64 key = hash64(heightmap_path, stringLength(heightmap_path));
+		const u64 source_hash = continueHash64(hash64(terrain.m_heightmap->getData(), width * height * bytes_per_pixel), dims, sizeof(dims));
+
+		CookingStats& stats = m_system->getCookingStats();
+		OS::Timer timer;
+		PxHeightField* heightfield = nullptr;
+		Array<u8> cooked(m_allocator);
+		if (m_system->loadCookedData(key, source_hash, Ref(cooked)))
+		{
+			PxDefaultMemoryInputData input(cooked.begin(), cooked.size());
+			heightfield = m_system->getPhysics()->createHeightField(input);
+		}
+		if (heightfield)
+		{
+			++stats.cache_hits;
+			stats.cache_load_time += timer.getTimeSinceStart();
+		}
+		else
+		{
+			heightfield = cookHeightField(terrain, key, source_hash);
+			++stats.cache_misses;
+			stats.cooking_time += timer.getTimeSinceStart();
+		}
+
 		{ // PROFILE_BLOCK scope
 			PROFILE_BLOCK("physX");
-			PxHeightFieldDesc hfDesc;
-			hfDesc.format = PxHeightFieldFormat::eS16_TM;
-			hfDesc.nbColumns = width;
-			hfDesc.nbRows = height;
-			hfDesc.samples.data = &heights[0];
-			hfDesc.samples.stride = sizeof(PxHeightFieldSample);
-
-			PxHeightField* heightfield = m_system->getCooking()->createHeightField(
-				hfDesc, m_system->getPhysics()->getPhysicsInsertionCallback());
 			float height_scale = bytes_per_pixel == 2 ? 1 / (256 * 256.0f - 1) : 1 / 255.0f;
 			PxHeightFieldGeometry hfGeom(heightfield,
 				PxMeshGeometryFlags(),
@@ -3284,6 +3570,7 @@ struct PhysicsSceneImpl final : public PhysicsScene
 		actor->dynamic_type = new_value;
 		if (new_value == DynamicType::DYNAMIC)
 		{
+			actor->has_pose = false;
 			m_dynamic_actors.push(actor);
 		}
 		else
@@ -3357,10 +3644,12 @@ struct PhysicsSceneImpl final : public PhysicsScene
 			serializer.write("name", m_layers_names[i]);
 			serializer.write("collision_matrix", m_collision_filter[i]);
 		}
+		serializer.write("update_frequency", getUpdateFrequency());
+		serializer.write("max_substeps", m_max_substeps);
 	}
 
 
-	void deserialize(IDeserializer& serializer) override
+	void deserialize(IDeserializer& serializer, int version) override
 	{
 		serializer.read(Ref(m_layers_count));
 		for (int i = 0; i < m_layers_count; ++i)
@@ -3368,6 +3657,15 @@ struct PhysicsSceneImpl final : public PhysicsScene
 			serializer.read(m_layers_names[i], lengthOf(m_layers_names[i]));
 			serializer.read(Ref(m_collision_filter[i]));
 		}
+		if (version > (int)PhysicsSceneVersion::FIXED_TIMESTEP)
+		{
+			float hz;
+			int max_substeps;
+			serializer.read(Ref(hz));
+			serializer.read(Ref(max_substeps));
+			setUpdateFrequency(hz);
+			setMaxSubsteps(max_substeps);
+		}
 	}
 
 
@@ -3984,6 +4282,8 @@ struct PhysicsSceneImpl final : public PhysicsScene
 		serializer.write(m_layers_count);
 		serializer.write(m_layers_names);
 		serializer.write(m_collision_filter);
+		serializer.write(m_fixed_timestep);
+		serializer.write(m_max_substeps);
 		serializer.write((i32)m_actors.size());
 		for (auto* actor : m_actors)
 		{
@@ -4832,6 +5132,8 @@ struct PhysicsSceneImpl final : public PhysicsScene
 		serializer.read(m_layers_count);
 		serializer.read(m_layers_names);
 		serializer.read(m_collision_filter);
+		serializer.read(m_fixed_timestep);
+		serializer.read(m_max_substeps);
 
 		deserializeActors(serializer);
 		deserializeControllers(serializer);
@@ -5038,6 +5340,9 @@ struct PhysicsSceneImpl final : public PhysicsScene
 
 	Array<RigidActor*> m_dynamic_actors;
 	RigidActor* m_update_in_progress;
+	float m_fixed_timestep = 1 / 60.0f;
+	int m_max_substeps = 4;
+	float m_time_accumulator = 0;
 	DelegateList<void(const ContactData&)> m_contact_callbacks;
 	bool m_is_game_running;
 	bool m_is_updating_ragdoll;
@@ -5208,8 +5513,14 @@ void PhysicsScene::registerLuaAPI(lua_State* L)
 	REGISTER_FUNCTION(isControllerCollisionDown);
 	REGISTER_FUNCTION(setRagdollKinematic);
 	REGISTER_FUNCTION(addForceAtPos);
+	REGISTER_FUNCTION(setUpdateFrequency);
+	REGISTER_FUNCTION(getUpdateFrequency);
+	REGISTER_FUNCTION(setMaxSubsteps);
+	REGISTER_FUNCTION(getMaxSubsteps);
+	REGISTER_FUNCTION(logCookingStats);
 
 	LuaWrapper::createSystemFunction(L, "Physics", "raycast", &PhysicsSceneImpl::LUA_raycast);
+	LuaWrapper::createSystemFunction(L, "Physics", "raycasts", &PhysicsSceneImpl::LUA_raycasts);
 
 #undef REGISTER_FUNCTION
 }
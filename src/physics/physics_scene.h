@@ -48,6 +48,38 @@ struct RaycastHit
 };
 
 
+struct RaycastQuery
+{
+	Vec3 origin;
+	Vec3 dir;
+	float distance;
+	EntityPtr ignored;
+	int layer;
+};
+
+
+// sphere cast
+struct SweepQuery
+{
+	Vec3 origin;
+	Vec3 dir;
+	float distance;
+	float radius;
+	EntityPtr ignored;
+	int layer;
+};
+
+
+// sphere overlap
+struct OverlapQuery
+{
+	Vec3 pos;
+	float radius;
+	EntityPtr ignored;
+	int layer;
+};
+
+
 class LUMIX_PHYSICS_API PhysicsScene : public IScene
 {
 public:
@@ -93,6 +125,10 @@ public:
 	virtual void render() = 0;
 	virtual EntityPtr raycast(const Vec3& origin, const Vec3& dir, EntityPtr ignore_entity) = 0;
 	virtual bool raycastEx(const Vec3& origin, const Vec3& dir, float distance, RaycastHit& result, EntityPtr ignored, int layer) = 0;
+	// batched queries run in parallel on workers, results[i].entity is invalid if queries[i] hits nothing
+	virtual void raycasts(Span<const RaycastQuery> queries, Span<RaycastHit> results) = 0;
+	virtual void sweeps(Span<const SweepQuery> queries, Span<RaycastHit> results) = 0;
+	virtual void overlaps(Span<const OverlapQuery> queries, Span<EntityPtr> results) = 0;
 	virtual PhysicsSystem& getSystem() const = 0;
 
 	virtual DelegateList<void(const ContactData&)>& onContact() = 0;
@@ -266,6 +302,12 @@ public:
 	virtual void addCollisionLayer() = 0;
 	virtual void removeCollisionLayer() = 0;
 
+	// physics is simulated in fixed steps, dynamic actors are interpolated between them
+	virtual void setUpdateFrequency(float hz) = 0;
+	virtual float getUpdateFrequency() const = 0;
+	virtual void setMaxSubsteps(int count) = 0;
+	virtual int getMaxSubsteps() const = 0;
+
 	virtual u32 getDebugVisualizationFlags() const = 0;
 	virtual void setDebugVisualizationFlags(u32 flags) = 0;
 	virtual void setVisualizationCullingBox(const DVec3& min, const DVec3& max) = 0;
@@ -3,10 +3,17 @@
 #include <PxPhysicsAPI.h>
 
 #include "cooking/PxCooking.h"
+#include "engine/array.h"
+#include "engine/crc32.h"
+#include "engine/file_system.h"
 #include "engine/log.h"
 #include "engine/engine.h"
+#include "engine/os.h"
+#include "engine/path.h"
+#include "engine/profiler.h"
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
+#include "engine/string.h"
 #include "engine/universe/universe.h"
 #include "physics/physics_geometry.h"
 #include "physics/physics_scene.h"
@@ -206,12 +213,22 @@ namespace Lumix
 	};
 
 
+	struct CookedDataHeader
+	{
+		static const u32 MAGIC = 0x324c5043; // '2LPC'
+
+		u32 magic;
+		u32 physx_version;
+		u64 source_hash;
+	};
+
+
 	struct PhysicsSystemImpl final : public PhysicsSystem
 	{
 		explicit PhysicsSystemImpl(Engine& engine)
-			: m_allocator(engine.getAllocator())
+			: m_allocator(engine.getAllocator(), "physics")
 			, m_engine(engine)
-			, m_manager(*this, engine.getAllocator())
+			, m_manager(*this, m_allocator)
 		{
 			registerProperties(engine.getAllocator());
 			m_manager.create(PhysicsGeometry::TYPE, engine.getResourceManager());
@@ -226,6 +243,9 @@ namespace Lumix
 			m_cooking = PxCreateCooking(PX_PHYSICS_VERSION, *m_foundation, physx::PxCookingParams(scale));
 			connect2VisualDebugger();
 
+			const StaticString<MAX_PATH_LENGTH> cache_dir(engine.getFileSystem().getBasePath(), ".lumix/physics");
+			OS::makePath(cache_dir);
+
 
 			if (!PxInitVehicleSDK(*m_physics)) {
 				LUMIX_FATAL(false);
@@ -264,6 +284,62 @@ namespace Lumix
 			return m_cooking;
 		}
 
+
+		static StaticString<MAX_PATH_LENGTH> getCookedDataPath(u64 key)
+		{
+			const u32 version = PX_PHYSICS_VERSION;
+			const u64 versioned_key = continueHash64(key, &version, sizeof(version));
+			return StaticString<MAX_PATH_LENGTH>(".lumix/physics/", versioned_key, ".phc");
+		}
+
+
+		bool loadCookedData(u64 key, u64 source_hash, Ref<Array<u8>> data) override
+		{
+			PROFILE_FUNCTION();
+			OS::InputFile file;
+			if (!m_engine.getFileSystem().open(getCookedDataPath(key), Ref(file))) return false;
+
+			CookedDataHeader header;
+			const u64 size = file.size();
+			bool res = size > sizeof(header) && file.read(&header, sizeof(header));
+			res = res && header.magic == CookedDataHeader::MAGIC;
+			res = res && header.physx_version == PX_PHYSICS_VERSION;
+			res = res && header.source_hash == source_hash;
+			if (res) {
+				data->resize(int(size - sizeof(header)));
+				res = file.read(data->begin(), data->size());
+			}
+			file.close();
+			return res;
+		}
+
+
+		void saveCookedData(u64 key, u64 source_hash, const u8* data, u32 size) override
+		{
+			PROFILE_FUNCTION();
+			OS::OutputFile file;
+			const StaticString<MAX_PATH_LENGTH> path = getCookedDataPath(key);
+			if (!m_engine.getFileSystem().open(path, Ref(file))) {
+				logWarning("Physics") << "Could not create " << path;
+				return;
+			}
+
+			CookedDataHeader header;
+			header.magic = CookedDataHeader::MAGIC;
+			header.physx_version = PX_PHYSICS_VERSION;
+			header.source_hash = source_hash;
+			bool res = file.write(&header, sizeof(header));
+			res = res && file.write(data, size);
+			file.close();
+			if (!res) {
+				logWarning("Physics") << "Could not write " << path;
+				m_engine.getFileSystem().deleteFile(path);
+			}
+		}
+
+
+		CookingStats& getCookingStats() override { return m_cooking_stats; }
+
 		bool connect2VisualDebugger()
 		{
 			/*if (m_physics->getPvdConnectionManager() == nullptr) return false;
@@ -281,15 +357,16 @@ namespace Lumix
 			return false;
 		}
 
+		TagAllocator m_allocator;
 		physx::PxPhysics* m_physics;
 		physx::PxFoundation* m_foundation;
 		physx::PxControllerManager* m_controller_manager;
 		AssertNullAllocator m_physx_allocator;
 		CustomErrorCallback m_error_callback;
 		physx::PxCooking* m_cooking;
+		CookingStats m_cooking_stats;
 		PhysicsGeometryManager m_manager;
 		Engine& m_engine;
-		IAllocator& m_allocator;
 	};
 
 
@@ -18,6 +18,18 @@ namespace Lumix
 {
 
 
+template <typename T> class Array;
+
+
+struct CookingStats
+{
+	u32 cache_hits = 0;
+	u32 cache_misses = 0;
+	float cache_load_time = 0; // seconds spent creating physx objects from cached data
+	float cooking_time = 0; // seconds spent cooking, including writing the results to cache
+};
+
+
 class PhysicsSystem : public IPlugin
 {
 	friend class PhysicsScene;
@@ -27,6 +39,13 @@ class PhysicsSystem : public IPlugin
 		
 		virtual physx::PxPhysics* getPhysics() = 0;
 		virtual physx::PxCooking* getCooking() = 0;
+		// cooked physx data are cached on disk, one file per source (`key` is a hash of its path) and physx version;
+		// the file is rejected if the 64bit hash of the source data does not match, and recooking overwrites it,
+		// so edits do not accumulate files. Entries of deleted or renamed sources are not pruned,
+		// .lumix/physics can be safely deleted at any time.
+		virtual bool loadCookedData(u64 key, u64 source_hash, Ref<Array<u8>> data) = 0;
+		virtual void saveCookedData(u64 key, u64 source_hash, const u8* data, u32 size) = 0;
+		virtual CookingStats& getCookingStats() = 0;
 
 	protected:
 		PhysicsSystem() {}
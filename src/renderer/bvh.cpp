@@ -0,0 +1,524 @@
+#include "bvh.h"
+#include "engine/allocator.h"
+#include "engine/geometry.h"
+#include "engine/simd.h"
+#include <string.h>
+
+
+namespace Lumix
+{
+
+
+MeshBVH::MeshBVH(IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_nodes(allocator)
+	, m_packets(allocator)
+{
+}
+
+
+void MeshBVH::build(const Vec3* vertices, const u8* indices, u32 indices_count, bool indices16)
+{
+	m_nodes.clear();
+	m_packets.clear();
+	if (indices_count < 3) return;
+
+	Array<BuildTriangle> triangles(m_allocator);
+	triangles.resize(indices_count / 3);
+	const u16* indices16_ptr = (const u16*)indices;
+	const u32* indices32_ptr = (const u32*)indices;
+	for (u32 i = 0, c = indices_count / 3; i < c; ++i) {
+		BuildTriangle& tri = triangles[i];
+		for (u32 j = 0; j < 3; ++j) {
+			const u32 idx = indices16 ? indices16_ptr[i * 3 + j] : indices32_ptr[i * 3 + j];
+			tri.p[j] = vertices[idx];
+		}
+		tri.min = AABB::minCoords(AABB::minCoords(tri.p[0], tri.p[1]), tri.p[2]);
+		tri.max = AABB::maxCoords(AABB::maxCoords(tri.p[0], tri.p[1]), tri.p[2]);
+		tri.center = (tri.min + tri.max) * 0.5f;
+	}
+
+	m_nodes.reserve(triangles.size() * 2 / LEAF_SIZE + 1);
+	m_packets.reserve(triangles.size() / LEAF_SIZE + 1);
+	build(triangles, 0, triangles.size(), 0);
+}
+
+
+u32 MeshBVH::build(Array<BuildTriangle>& triangles, u32 from, u32 to, u32 depth)
+{
+	ASSERT(depth < MAX_DEPTH);
+	const u32 node_idx = m_nodes.size();
+	Node& node = m_nodes.emplace();
+	node.min = triangles[from].min;
+	node.max = triangles[from].max;
+	Vec3 center_min = triangles[from].center;
+	Vec3 center_max = triangles[from].center;
+	for (u32 i = from + 1; i < to; ++i) {
+		node.min = AABB::minCoords(node.min, triangles[i].min);
+		node.max = AABB::maxCoords(node.max, triangles[i].max);
+		center_min = AABB::minCoords(center_min, triangles[i].center);
+		center_max = AABB::maxCoords(center_max, triangles[i].center);
+	}
+
+	if (to - from <= LEAF_SIZE) {
+		node.is_leaf = 1;
+		node.offset = m_packets.size();
+		Packet& packet = m_packets.emplace();
+		memset(&packet, 0, sizeof(packet));
+		for (u32 i = from; i < to; ++i) {
+			const BuildTriangle& tri = triangles[i];
+			const Vec3 e1 = tri.p[1] - tri.p[0];
+			const Vec3 e2 = tri.p[2] - tri.p[0];
+			const u32 lane = i - from;
+			for (u32 j = 0; j < 3; ++j) {
+				packet.v0[j][lane] = (&tri.p[0].x)[j];
+				packet.e1[j][lane] = (&e1.x)[j];
+				packet.e2[j][lane] = (&e2.x)[j];
+			}
+		}
+		// unused lanes have zero edges, so their determinant is 0 and they are never hit
+		return node_idx;
+	}
+
+	m_nodes[node_idx].is_leaf = 0;
+	if (depth >= MEDIAN_SPLIT_DEPTH) {
+		// degenerated triangle distribution, keep the rest of the subtree balanced
+		const u32 mid = (from + to) / 2;
+		build(triangles, from, mid, depth + 1);
+		const u32 right = build(triangles, mid, to, depth + 1);
+		m_nodes[node_idx].offset = right;
+		return node_idx;
+	}
+
+	// split in the middle of the longest axis, fallback to the median if all triangles end on one side
+	const Vec3 extent = center_max - center_min;
+	const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	const float split = ((&center_min.x)[axis] + (&center_max.x)[axis]) * 0.5f;
+	u32 mid = from;
+	for (u32 i = from; i < to; ++i) {
+		if ((&triangles[i].center.x)[axis] < split) {
+			const BuildTriangle tmp = triangles[i];
+			triangles[i] = triangles[mid];
+			triangles[mid] = tmp;
+			++mid;
+		}
+	}
+	if (mid == from || mid == to) mid = (from + to) / 2;
+
+	build(triangles, from, mid, depth + 1);
+	const u32 right = build(triangles, mid, to, depth + 1);
+	m_nodes[node_idx].offset = right;
+	return node_idx;
+}
+
+
+static LUMIX_FORCE_INLINE bool intersectAABB(const Vec3& min, const Vec3& max, const Vec3& origin, const Vec3& inv_dir, float max_t)
+{
+	const float t1 = (min.x - origin.x) * inv_dir.x;
+	const float t2 = (max.x - origin.x) * inv_dir.x;
+	const float t3 = (min.y - origin.y) * inv_dir.y;
+	const float t4 = (max.y - origin.y) * inv_dir.y;
+	const float t5 = (min.z - origin.z) * inv_dir.z;
+	const float t6 = (max.z - origin.z) * inv_dir.z;
+
+	const float tmin = maximum(minimum(t1, t2), minimum(t3, t4), minimum(t5, t6), 0.f);
+	const float tmax = minimum(maximum(t1, t2), maximum(t3, t4), maximum(t5, t6), max_t);
+	return tmin <= tmax;
+}
+
+
+bool MeshBVH::castRay(const Vec3& origin, const Vec3& dir, float max_t, float* out_t) const
+{
+	if (m_nodes.empty()) return false;
+
+	const Vec3 inv_dir(
+		1.0f / (dir.x == 0 ? 0.00000001f : dir.x),
+		1.0f / (dir.y == 0 ? 0.00000001f : dir.y),
+		1.0f / (dir.z == 0 ? 0.00000001f : dir.z));
+
+	const float4 ox = f4Splat(origin.x);
+	const float4 oy = f4Splat(origin.y);
+	const float4 oz = f4Splat(origin.z);
+	const float4 dx = f4Splat(dir.x);
+	const float4 dy = f4Splat(dir.y);
+	const float4 dz = f4Splat(dir.z);
+	const float4 zero = f4Splat(0);
+	const float4 one = f4Splat(1);
+
+	bool is_hit = false;
+	float best_t = max_t;
+	// every level leaves at most one node on the stack, build() keeps depth below MAX_DEPTH
+	u32 stack[MAX_DEPTH + 1];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+	while (stack_size > 0) {
+		const Node& node = m_nodes[stack[--stack_size]];
+		if (!intersectAABB(node.min, node.max, origin, inv_dir, best_t)) continue;
+
+		if (!node.is_leaf) {
+			if (stack_size + 2 > lengthOf(stack)) {
+				ASSERT(false);
+				continue;
+			}
+			stack[stack_size++] = node.offset;
+			stack[stack_size++] = u32(&node - m_nodes.begin()) + 1;
+			continue;
+		}
+
+		// Moller-Trumbore, 4 triangles at once
+		const Packet& p = m_packets[node.offset];
+		const float4 e1x = f4Load(p.e1[0]);
+		const float4 e1y = f4Load(p.e1[1]);
+		const float4 e1z = f4Load(p.e1[2]);
+		const float4 e2x = f4Load(p.e2[0]);
+		const float4 e2y = f4Load(p.e2[1]);
+		const float4 e2z = f4Load(p.e2[2]);
+
+		const float4 px = f4Sub(f4Mul(dy, e2z), f4Mul(dz, e2y));
+		const float4 py = f4Sub(f4Mul(dz, e2x), f4Mul(dx, e2z));
+		const float4 pz = f4Sub(f4Mul(dx, e2y), f4Mul(dy, e2x));
+		const float4 det = f4Add(f4Add(f4Mul(e1x, px), f4Mul(e1y, py)), f4Mul(e1z, pz));
+		const float4 inv_det = f4Div(one, det);
+
+		const float4 tx = f4Sub(ox, f4Load(p.v0[0]));
+		const float4 ty = f4Sub(oy, f4Load(p.v0[1]));
+		const float4 tz = f4Sub(oz, f4Load(p.v0[2]));
+		const float4 u = f4Mul(f4Add(f4Add(f4Mul(tx, px), f4Mul(ty, py)), f4Mul(tz, pz)), inv_det);
+
+		const float4 qx = f4Sub(f4Mul(ty, e1z), f4Mul(tz, e1y));
+		const float4 qy = f4Sub(f4Mul(tz, e1x), f4Mul(tx, e1z));
+		const float4 qz = f4Sub(f4Mul(tx, e1y), f4Mul(ty, e1x));
+		const float4 v = f4Mul(f4Add(f4Add(f4Mul(dx, qx), f4Mul(dy, qy)), f4Mul(dz, qz)), inv_det);
+		const float4 t = f4Mul(f4Add(f4Add(f4Mul(e2x, qx), f4Mul(e2y, qy)), f4Mul(e2z, qz)), inv_det);
+
+		const int mask = f4MoveMask(f4CmpGT(f4Mul(det, det), zero))
+			& f4MoveMask(f4CmpGE(u, zero))
+			& f4MoveMask(f4CmpGE(v, zero))
+			& f4MoveMask(f4CmpGE(one, f4Add(u, v)))
+			& f4MoveMask(f4CmpGE(t, zero))
+			& f4MoveMask(f4CmpGT(f4Splat(best_t), t));
+		if (!mask) continue;
+
+		alignas(16) float ts[4];
+		f4Store(ts, t);
+		for (int i = 0; i < 4; ++i) {
+			if ((mask & (1 << i)) && ts[i] < best_t) {
+				best_t = ts[i];
+				is_hit = true;
+			}
+		}
+	}
+
+	if (is_hit) *out_t = best_t;
+	return is_hit;
+}
+
+
+DynamicBVH::DynamicBVH(IAllocator& allocator)
+	: m_nodes(allocator)
+	, m_entity_to_node(allocator)
+	, m_root(-1)
+	, m_free_list(-1)
+{
+}
+
+
+void DynamicBVH::clear()
+{
+	m_nodes.clear();
+	m_entity_to_node.clear();
+	m_root = -1;
+	m_free_list = -1;
+}
+
+
+bool DynamicBVH::isAdded(EntityRef entity) const
+{
+	return entity.index < m_entity_to_node.size() && m_entity_to_node[entity.index] >= 0;
+}
+
+
+static DVec3 minCoords(const DVec3& a, const DVec3& b)
+{
+	return DVec3(minimum(a.x, b.x), minimum(a.y, b.y), minimum(a.z, b.z));
+}
+
+
+static DVec3 maxCoords(const DVec3& a, const DVec3& b)
+{
+	return DVec3(maximum(a.x, b.x), maximum(a.y, b.y), maximum(a.z, b.z));
+}
+
+
+static double getArea(const DVec3& min, const DVec3& max)
+{
+	const DVec3 d = max - min;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+
+bool DynamicBVH::intersect(const Node& node, const DVec3& origin, const Vec3& inv_dir, float* t)
+{
+	const Vec3 min = (node.min - origin).toFloat();
+	const Vec3 max = (node.max - origin).toFloat();
+	const float t1 = min.x * inv_dir.x;
+	const float t2 = max.x * inv_dir.x;
+	const float t3 = min.y * inv_dir.y;
+	const float t4 = max.y * inv_dir.y;
+	const float t5 = min.z * inv_dir.z;
+	const float t6 = max.z * inv_dir.z;
+
+	const float tmin = maximum(minimum(t1, t2), minimum(t3, t4), minimum(t5, t6), 0.f);
+	const float tmax = minimum(maximum(t1, t2), maximum(t3, t4), maximum(t5, t6));
+	*t = tmin;
+	return tmin <= tmax;
+}
+
+
+i32 DynamicBVH::allocNode()
+{
+	if (m_free_list >= 0) {
+		const i32 idx = m_free_list;
+		m_free_list = m_nodes[idx].parent;
+		return idx;
+	}
+	m_nodes.emplace();
+	return m_nodes.size() - 1;
+}
+
+
+void DynamicBVH::freeNode(i32 index)
+{
+	Node& node = m_nodes[index];
+	node.parent = m_free_list;
+	node.entity = INVALID_ENTITY;
+	node.height = -1;
+	m_free_list = index;
+}
+
+
+void DynamicBVH::add(EntityRef entity, const DVec3& min, const DVec3& max)
+{
+	ASSERT(!isAdded(entity));
+	while (entity.index >= m_entity_to_node.size()) m_entity_to_node.push(-1);
+
+	const i32 leaf = allocNode();
+	Node& node = m_nodes[leaf];
+	const DVec3 margin = (max - min) * 0.1f + DVec3(0.1f);
+	node.min = min - margin;
+	node.max = max + margin;
+	node.entity = entity;
+	node.left = node.right = -1;
+	node.height = 0;
+	node.parent = -1;
+	m_entity_to_node[entity.index] = leaf;
+	insertLeaf(leaf);
+}
+
+
+void DynamicBVH::remove(EntityRef entity)
+{
+	if (!isAdded(entity)) return;
+
+	const i32 leaf = m_entity_to_node[entity.index];
+	removeLeaf(leaf);
+	freeNode(leaf);
+	m_entity_to_node[entity.index] = -1;
+}
+
+
+void DynamicBVH::move(EntityRef entity, const DVec3& min, const DVec3& max)
+{
+	if (!isAdded(entity)) return;
+
+	const Node& node = m_nodes[m_entity_to_node[entity.index]];
+	const bool inside = node.min.x <= min.x && node.min.y <= min.y && node.min.z <= min.z
+		&& node.max.x >= max.x && node.max.y >= max.y && node.max.z >= max.z;
+	if (inside) return;
+
+	remove(entity);
+	add(entity, min, max);
+}
+
+
+void DynamicBVH::refit(i32 index)
+{
+	Node& node = m_nodes[index];
+	const Node& left = m_nodes[node.left];
+	const Node& right = m_nodes[node.right];
+	node.min = minCoords(left.min, right.min);
+	node.max = maxCoords(left.max, right.max);
+	node.height = 1 + maximum(left.height, right.height);
+}
+
+
+void DynamicBVH::insertLeaf(i32 leaf)
+{
+	if (m_root < 0) {
+		m_root = leaf;
+		m_nodes[leaf].parent = -1;
+		return;
+	}
+
+	// find the best sibling by the surface area heuristic
+	const DVec3 leaf_min = m_nodes[leaf].min;
+	const DVec3 leaf_max = m_nodes[leaf].max;
+	i32 index = m_root;
+	while (m_nodes[index].left >= 0) {
+		const Node& node = m_nodes[index];
+		const double area = getArea(node.min, node.max);
+		const double combined_area = getArea(minCoords(node.min, leaf_min), maxCoords(node.max, leaf_max));
+		const double cost = 2 * combined_area;
+		const double inheritance_cost = 2 * (combined_area - area);
+
+		auto getCost = [&](const Node& child) {
+			const double new_area = getArea(minCoords(child.min, leaf_min), maxCoords(child.max, leaf_max));
+			if (child.left < 0) return new_area + inheritance_cost;
+			return new_area - getArea(child.min, child.max) + inheritance_cost;
+		};
+		const double cost_left = getCost(m_nodes[node.left]);
+		const double cost_right = getCost(m_nodes[node.right]);
+
+		if (cost < cost_left && cost < cost_right) break;
+		index = cost_left < cost_right ? node.left : node.right;
+	}
+
+	const i32 sibling = index;
+	const i32 old_parent = m_nodes[sibling].parent;
+	const i32 new_parent = allocNode();
+	{
+		Node& node = m_nodes[new_parent];
+		node.parent = old_parent;
+		node.entity = INVALID_ENTITY;
+		node.left = sibling;
+		node.right = leaf;
+		refit(new_parent);
+	}
+	m_nodes[sibling].parent = new_parent;
+	m_nodes[leaf].parent = new_parent;
+
+	if (old_parent >= 0) {
+		Node& parent = m_nodes[old_parent];
+		if (parent.left == sibling) parent.left = new_parent;
+		else parent.right = new_parent;
+	}
+	else {
+		m_root = new_parent;
+	}
+
+	index = m_nodes[leaf].parent;
+	while (index >= 0) {
+		index = balance(index);
+		refit(index);
+		index = m_nodes[index].parent;
+	}
+}
+
+
+void DynamicBVH::removeLeaf(i32 leaf)
+{
+	if (leaf == m_root) {
+		m_root = -1;
+		return;
+	}
+
+	const i32 parent = m_nodes[leaf].parent;
+	const i32 grand_parent = m_nodes[parent].parent;
+	const i32 sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+	if (grand_parent < 0) {
+		m_root = sibling;
+		m_nodes[sibling].parent = -1;
+		freeNode(parent);
+		return;
+	}
+
+	Node& gp = m_nodes[grand_parent];
+	if (gp.left == parent) gp.left = sibling;
+	else gp.right = sibling;
+	m_nodes[sibling].parent = grand_parent;
+	freeNode(parent);
+
+	i32 index = grand_parent;
+	while (index >= 0) {
+		index = balance(index);
+		refit(index);
+		index = m_nodes[index].parent;
+	}
+}
+
+
+// rotates the taller child up if the subtree of `index_a` is unbalanced, returns the new subtree root
+i32 DynamicBVH::balance(i32 index_a)
+{
+	Node& a = m_nodes[index_a];
+	if (a.left < 0 || a.height < 2) return index_a;
+
+	const i32 index_b = a.left;
+	const i32 index_c = a.right;
+	Node& b = m_nodes[index_b];
+	Node& c = m_nodes[index_c];
+	const i32 diff = c.height - b.height;
+
+	auto replaceInParent = [&](i32 old_child, i32 new_child) {
+		const i32 parent = m_nodes[new_child].parent;
+		if (parent < 0) {
+			m_root = new_child;
+			return;
+		}
+		Node& p = m_nodes[parent];
+		if (p.left == old_child) p.left = new_child;
+		else p.right = new_child;
+	};
+
+	if (diff > 1) {
+		const i32 index_f = c.left;
+		const i32 index_g = c.right;
+		c.left = index_a;
+		c.parent = a.parent;
+		a.parent = index_c;
+		replaceInParent(index_a, index_c);
+
+		if (m_nodes[index_f].height > m_nodes[index_g].height) {
+			c.right = index_f;
+			a.right = index_g;
+			m_nodes[index_g].parent = index_a;
+		}
+		else {
+			c.right = index_g;
+			a.right = index_f;
+			m_nodes[index_f].parent = index_a;
+		}
+		refit(index_a);
+		refit(index_c);
+		return index_c;
+	}
+
+	if (diff < -1) {
+		const i32 index_d = b.left;
+		const i32 index_e = b.right;
+		b.left = index_a;
+		b.parent = a.parent;
+		a.parent = index_b;
+		replaceInParent(index_a, index_b);
+
+		if (m_nodes[index_d].height > m_nodes[index_e].height) {
+			b.right = index_d;
+			a.left = index_e;
+			m_nodes[index_e].parent = index_a;
+		}
+		else {
+			b.right = index_e;
+			a.left = index_d;
+			m_nodes[index_d].parent = index_a;
+		}
+		refit(index_a);
+		refit(index_b);
+		return index_b;
+	}
+
+	return index_a;
+}
+
+
+} // namespace Lumix
@@ -0,0 +1,134 @@
+#pragma once
+
+
+#include "engine/array.h"
+#include "engine/lumix.h"
+#include "engine/math.h"
+
+
+namespace Lumix
+{
+
+
+struct IAllocator;
+
+
+// static hierarchy over triangles of a rigid mesh, every leaf holds up to 4 triangles
+// in SoA layout so they can be tested against a ray at once
+struct MeshBVH
+{
+	enum { LEAF_SIZE = 4 };
+	// below this depth nodes are split at the median, so the depth of the tree is bounded
+	// by MEDIAN_SPLIT_DEPTH + log2(triangle count) < MAX_DEPTH
+	enum { MEDIAN_SPLIT_DEPTH = 24 };
+	enum { MAX_DEPTH = 64 };
+
+	struct Node
+	{
+		Vec3 min;
+		u32 offset; // inner node - index of the right child, left child follows the node; leaf - index of the packet
+		Vec3 max;
+		u32 is_leaf;
+	};
+
+	struct alignas(16) Packet
+	{
+		float v0[3][LEAF_SIZE];
+		float e1[3][LEAF_SIZE];
+		float e2[3][LEAF_SIZE];
+	};
+
+	explicit MeshBVH(IAllocator& allocator);
+
+	void build(const Vec3* vertices, const u8* indices, u32 indices_count, bool indices16);
+	bool castRay(const Vec3& origin, const Vec3& dir, float max_t, float* out_t) const;
+	bool empty() const { return m_nodes.empty(); }
+
+private:
+	struct BuildTriangle
+	{
+		Vec3 min;
+		Vec3 max;
+		Vec3 center;
+		Vec3 p[3];
+	};
+
+	u32 build(Array<BuildTriangle>& triangles, u32 from, u32 to, u32 depth);
+
+	IAllocator& m_allocator;
+	Array<Node> m_nodes;
+	Array<Packet> m_packets;
+};
+
+
+// dynamic AABB tree over entities, leaves are enlarged so small movements do not touch the tree
+class DynamicBVH
+{
+public:
+	explicit DynamicBVH(IAllocator& allocator);
+
+	void clear();
+	bool isAdded(EntityRef entity) const;
+	void add(EntityRef entity, const DVec3& min, const DVec3& max);
+	void remove(EntityRef entity);
+	void move(EntityRef entity, const DVec3& min, const DVec3& max);
+
+	// f(EntityRef entity, float max_t) is called for every leaf hit closer than max_t,
+	// it returns the new max_t (t of the closest hit so far)
+	template <typename F> void castRay(const DVec3& origin, const Vec3& dir, float max_t, F& f) const
+	{
+		if (m_root < 0) return;
+
+		const Vec3 inv_dir(
+			1.0f / (dir.x == 0 ? 0.00000001f : dir.x),
+			1.0f / (dir.y == 0 ? 0.00000001f : dir.y),
+			1.0f / (dir.z == 0 ? 0.00000001f : dir.z));
+
+		i32 stack[64];
+		int stack_size = 0;
+		stack[stack_size++] = m_root;
+		while (stack_size > 0) {
+			const Node& node = m_nodes[stack[--stack_size]];
+			float t;
+			if (!intersect(node, origin, inv_dir, &t) || t > max_t) continue;
+
+			if (node.left < 0) {
+				max_t = f((EntityRef)node.entity, max_t);
+				continue;
+			}
+
+			ASSERT(stack_size + 2 <= lengthOf(stack));
+			stack[stack_size++] = node.left;
+			stack[stack_size++] = node.right;
+		}
+	}
+
+private:
+	struct Node
+	{
+		DVec3 min;
+		DVec3 max;
+		i32 parent;
+		i32 left;
+		i32 right;
+		i32 height;
+		EntityPtr entity;
+	};
+
+	static bool intersect(const Node& node, const DVec3& origin, const Vec3& inv_dir, float* t);
+
+	i32 allocNode();
+	void freeNode(i32 index);
+	void insertLeaf(i32 leaf);
+	void removeLeaf(i32 leaf);
+	i32 balance(i32 index);
+	void refit(i32 index);
+
+	Array<Node> m_nodes;
+	Array<i32> m_entity_to_node;
+	i32 m_root;
+	i32 m_free_list;
+};
+
+
+} // namespace Lumix
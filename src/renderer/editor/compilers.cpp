@@ -0,0 +1,456 @@
+#include "compilers.h"
+#include "editor/asset_compiler.h"
+#include "editor/studio_app.h"
+#include "editor/world_editor.h"
+#include "engine/engine.h"
+#include "engine/file_system.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+#include "engine/lua_wrapper.h"
+#include "engine/os.h"
+#include "engine/path_utils.h"
+#include "engine/profiler.h"
+#include "fbx_importer.h"
+#include "renderer/texture.h"
+#define STB_IMAGE_IMPLEMENTATION
+#if defined _MSC_VER && _MSC_VER == 1900
+#pragma warning(disable : 4312)
+#endif
+#include "stb/stb_image.h"
+#include <nvtt.h>
+
+
+// compilers do not reference renderer's runtime, so the cooker can link them without a GPU backend
+using namespace Lumix;
+
+
+static const ResourceType ANIMATION_TYPE("animation");
+static const ResourceType FONT_TYPE("font");
+static const ResourceType MATERIAL_TYPE("material");
+static const ResourceType MODEL_TYPE("model");
+static const ResourceType PARTICLE_EMITTER_TYPE("particle_emitter");
+static const ResourceType SHADER_TYPE("shader");
+static const ResourceType TEXTURE_TYPE("texture");
+
+
+TextureMeta Lumix::TextureMeta::load(AssetCompiler& compiler, const Path& path)
+{
+	TextureMeta meta;
+	compiler.getMeta(path, [&meta](lua_State* L){
+		LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "srgb", &meta.srgb);
+		LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "normalmap", &meta.is_normalmap);
+		char tmp[32];
+		if(LuaWrapper::getOptionalStringField(L, LUA_GLOBALSINDEX, "wrap_mode", Span(tmp))) {
+			meta.wrap_mode = stricmp(tmp, "repeat") == 0 ? WrapMode::REPEAT : WrapMode::CLAMP;
+		}
+	});
+	return meta;
+}
+
+
+ModelMeta Lumix::ModelMeta::load(AssetCompiler& compiler, const Path& path)
+{
+	ModelMeta meta;
+	compiler.getMeta(path, [&](lua_State* L){
+		LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "scale", &meta.scale);
+		LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "split", &meta.split);
+	});
+	return meta;
+}
+
+
+namespace
+{
+
+
+struct CopyCompiler final : AssetCompiler::IPlugin
+{
+	explicit CopyCompiler(StudioApp& app)
+		: m_app(app)
+	{}
+
+	bool compile(const Path& src) override
+	{
+		return m_app.getAssetCompiler().copyCompile(src);
+	}
+
+	bool isThreadSafe() const override { return true; }
+
+	StudioApp& m_app;
+};
+
+
+struct ShaderCompiler final : AssetCompiler::IPlugin
+{
+	explicit ShaderCompiler(StudioApp& app)
+		: m_app(app)
+	{}
+
+
+	void findIncludes(const char* path)
+	{
+		lua_State* L = luaL_newstate();
+		luaL_openlibs(L);
+
+		OS::InputFile file;
+		if (!file.open(path[0] == '/' ? path + 1 : path)) return;
+
+		IAllocator& allocator = m_app.getWorldEditor().getAllocator();
+		Array<u8> content(allocator);
+		content.resize((int)file.size());
+		file.read(content.begin(), content.byte_size());
+		file.close();
+
+		struct Context {
+			const char* path;
+			ShaderCompiler* compiler;
+			u8* content;
+			int content_len;
+			int idx;
+		} ctx = { path, this, content.begin(), content.byte_size(), 0 };
+
+		lua_pushlightuserdata(L, &ctx);
+		lua_setfield(L, LUA_GLOBALSINDEX, "this");
+
+		auto include = [](lua_State* L) -> int {
+			lua_getfield(L, LUA_GLOBALSINDEX, "this");
+			Context* that = LuaWrapper::toType<Context*>(L, -1);
+			lua_pop(L, 1);
+			const char* path = LuaWrapper::checkArg<const char*>(L, 1);
+			that->compiler->m_app.getAssetCompiler().registerDependency(Path(that->path), Path(path));
+			return 0;
+		};
+
+		lua_pushcclosure(L, include, 0);
+		lua_setfield(L, LUA_GLOBALSINDEX, "include");
+
+		static const char* preface =
+			"local new_g = setmetatable({include = include}, {__index = function() return function() end end })\n"
+			"setfenv(1, new_g)\n";
+
+		auto reader = [](lua_State* L, void* data, size_t* size) -> const char* {
+			Context* ctx = (Context*)data;
+			++ctx->idx;
+			switch(ctx->idx) {
+				case 1:
+					*size = stringLength(preface);
+					return preface;
+				case 2:
+					*size = ctx->content_len;
+					return (const char*)ctx->content;
+				default:
+					*size = 0;
+					return nullptr;
+			}
+		};
+
+		if (lua_load(L, reader, &ctx, path) != 0) {
+			logError("Engine") << path << ": " << lua_tostring(L, -1);
+			lua_pop(L, 2);
+			lua_close(L);
+			return;
+		}
+
+		if (lua_pcall(L, 0, 0, -2) != 0) {
+			logError("Engine") << lua_tostring(L, -1);
+			lua_pop(L, 2);
+			lua_close(L);
+			return;
+		}
+		lua_pop(L, 1);
+		lua_close(L);
+	}
+
+	void addSubresources(AssetCompiler& compiler, const char* path) override {
+		compiler.addResource(SHADER_TYPE, path);
+		findIncludes(path);
+	}
+
+	bool compile(const Path& src) override
+	{
+		return m_app.getAssetCompiler().copyCompile(src);
+	}
+
+	bool isThreadSafe() const override { return true; }
+
+	StudioApp& m_app;
+};
+
+
+struct TextureCompiler final : AssetCompiler::IPlugin
+{
+	explicit TextureCompiler(StudioApp& app)
+		: m_app(app)
+	{}
+
+
+	bool compileImage(const Array<u8>& src_data, OutputMemoryStream& dst, const TextureMeta& meta)
+	{
+		PROFILE_FUNCTION();
+		int w, h, comps;
+		stbi_uc* data = stbi_load_from_memory(src_data.begin(), src_data.byte_size(), &w, &h, &comps, 4);
+		if (!data) return false;
+
+		dst.write("dds", 3);
+		u32 flags = meta.srgb ? (u32)Texture::Flags::SRGB : 0;
+		flags |= meta.wrap_mode == TextureMeta::WrapMode::CLAMP ? (u32)Texture::Flags::CLAMP : 0;
+		dst.write(&flags, sizeof(flags));
+
+		nvtt::Context context;
+
+		const bool has_alpha = comps == 4;
+		nvtt::InputOptions input;
+		input.setMipmapGeneration(true);
+		input.setAlphaMode(has_alpha ? nvtt::AlphaMode_Transparency : nvtt::AlphaMode_None);
+		input.setNormalMap(meta.is_normalmap);
+		input.setTextureLayout(nvtt::TextureType_2D, w, h);
+		input.setMipmapData(data, w, h);
+		stbi_image_free(data);
+
+		nvtt::OutputOptions output;
+		output.setSrgbFlag(meta.srgb);
+		struct : nvtt::OutputHandler {
+			bool writeData(const void * data, int size) override { return dst->write(data, size); }
+			void beginImage(int size, int width, int height, int depth, int face, int miplevel) override {}
+			void endImage() override {}
+
+			OutputMemoryStream* dst;
+		} output_handler;
+		output_handler.dst = &dst;
+		output.setOutputHandler(&output_handler);
+
+		nvtt::CompressionOptions compression;
+		compression.setFormat(meta.is_normalmap ? nvtt::Format_DXT5n : (has_alpha ? nvtt::Format_DXT5 :  nvtt::Format_DXT1));
+		compression.setQuality(nvtt::Quality_Normal);
+
+		if (!context.process(input, compression, output)) {
+			return false;
+		}
+		return true;
+	}
+
+
+	bool compile(const Path& src) override
+	{
+		char ext[4] = {};
+		PathUtils::getExtension(Span(ext), src.c_str());
+
+		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
+		Array<u8> src_data(m_app.getWorldEditor().getAllocator());
+		if (!fs.getContentSync(src, Ref(src_data))) return false;
+
+		OutputMemoryStream out(m_app.getWorldEditor().getAllocator());
+		const TextureMeta meta = TextureMeta::load(m_app.getAssetCompiler(), src);
+		if (equalStrings(ext, "dds") || equalStrings(ext, "raw") || equalStrings(ext, "tga")) {
+			out.write(ext, sizeof(ext) - 1);
+			u32 flags = meta.srgb ? (u32)Texture::Flags::SRGB : 0;
+			flags |= meta.wrap_mode == TextureMeta::WrapMode::CLAMP ? (u32)Texture::Flags::CLAMP : 0;
+			out.write(flags);
+			out.write(src_data.begin(), src_data.byte_size());
+		}
+		else if(equalStrings(ext, "jpg")) {
+			compileImage(src_data, out, meta);
+		}
+		else if(equalStrings(ext, "png")) {
+			compileImage(src_data, out, meta);
+		}
+		else {
+			ASSERT(false);
+		}
+
+		return m_app.getAssetCompiler().writeCompiledResource(src.c_str(), Span((u8*)out.getData(), (i32)out.getPos()));
+	}
+
+	bool isThreadSafe() const override { return true; }
+
+	StudioApp& m_app;
+};
+
+
+struct ModelCompiler final : AssetCompiler::IPlugin
+{
+	explicit ModelCompiler(StudioApp& app)
+		: m_app(app)
+		, m_fbx_importer(app.getAssetCompiler(), app.getWorldEditor().getEngine().getFileSystem(), app.getWorldEditor().getAllocator())
+	{}
+
+
+	~ModelCompiler()
+	{
+		JobSystem::wait(m_subres_signal);
+	}
+
+
+	void addSubresources(AssetCompiler& compiler, const char* path) override {
+		compiler.addResource(MODEL_TYPE, path);
+
+		const ModelMeta meta = ModelMeta::load(compiler, Path(path));
+		struct JobData {
+			ModelCompiler* plugin;
+			StaticString<MAX_PATH_LENGTH> path;
+			ModelMeta meta;
+		};
+		JobData* data = LUMIX_NEW(m_app.getWorldEditor().getAllocator(), JobData);
+		data->plugin = this;
+		data->path = path;
+		data->meta = meta;
+		JobSystem::runEx(data, [](void* ptr) {
+			JobData* data = (JobData*)ptr;
+			ModelCompiler* plugin = data->plugin;
+			WorldEditor& editor = plugin->m_app.getWorldEditor();
+			FileSystem& fs = editor.getEngine().getFileSystem();
+			FBXImporter importer(plugin->m_app.getAssetCompiler(), fs, editor.getAllocator());
+			AssetCompiler& compiler = plugin->m_app.getAssetCompiler();
+
+			const char* path = data->path[0] == '/' ? data->path.data + 1 : data->path;
+			importer.setSource(path, true);
+
+			if(data->meta.split) {
+				const Array<FBXImporter::ImportMesh>& meshes = importer.getMeshes();
+				for (int i = 0; i < meshes.size(); ++i) {
+					char mesh_name[256];
+					importer.getImportMeshName(meshes[i], mesh_name);
+					StaticString<MAX_PATH_LENGTH> tmp(mesh_name, ":", path);
+					compiler.addResource(MODEL_TYPE, tmp);
+				}
+			}
+
+			const Array<FBXImporter::ImportAnimation>& animations = importer.getAnimations();
+			for (const FBXImporter::ImportAnimation& anim : animations) {
+				StaticString<MAX_PATH_LENGTH> tmp(anim.name, ":", path);
+				compiler.addResource(ANIMATION_TYPE, tmp);
+			}
+
+			LUMIX_DELETE(editor.getAllocator(), data);
+		}, &m_subres_signal, JobSystem::INVALID_HANDLE, 2);
+	}
+
+	static const char* getResourceFilePath(const char* str)
+	{
+		const char* c = str;
+		while (*c && *c != ':') ++c;
+		return *c != ':' ? str : c + 1;
+	}
+
+	bool compile(const Path& src) override
+	{
+		ASSERT(PathUtils::hasExtension(src.c_str(), "fbx"));
+		const char* filepath = getResourceFilePath(src.c_str());
+		FBXImporter::ImportConfig cfg;
+		const ModelMeta meta = ModelMeta::load(m_app.getAssetCompiler(), Path(filepath));
+		cfg.mesh_scale = meta.scale;
+		m_fbx_importer.setSource(filepath, false);
+		if (m_fbx_importer.getMeshes().empty()) {
+			if (m_fbx_importer.getOFBXScene()->getMeshCount() > 0) {
+				logError("Editor") << "No meshes with materials found in " << src;
+			}
+			else {
+				logError("Editor") << "No meshes found in " << src;
+			}
+		}
+
+		if (meta.split) {
+			m_fbx_importer.writeSubmodels(filepath, cfg);
+			m_fbx_importer.writePrefab(filepath, cfg);
+		}
+		m_fbx_importer.writeModel(src.c_str(), cfg);
+		m_fbx_importer.writeMaterials(filepath, cfg);
+		m_fbx_importer.writeAnimations(filepath, cfg);
+		return true;
+	}
+
+
+	StudioApp& m_app;
+	FBXImporter m_fbx_importer;
+	JobSystem::SignalHandle m_subres_signal = JobSystem::INVALID_HANDLE;
+};
+
+
+struct CompilersPlugin : StudioApp::IPlugin
+{
+	explicit CompilersPlugin(StudioApp& app)
+		: m_app(app)
+		, m_font_compiler(app)
+		, m_pipeline_compiler(app)
+		, m_particle_emitter_compiler(app)
+		, m_material_compiler(app)
+		, m_shader_compiler(app)
+		, m_texture_compiler(app)
+		, m_model_compiler(app)
+	{
+	}
+
+
+	const char* getName() const override { return "renderer_compilers"; }
+
+
+	void init() override
+	{
+		AssetCompiler& asset_compiler = m_app.getAssetCompiler();
+
+		asset_compiler.registerExtension("shd", SHADER_TYPE);
+		asset_compiler.registerExtension("png", TEXTURE_TYPE);
+		asset_compiler.registerExtension("jpg", TEXTURE_TYPE);
+		asset_compiler.registerExtension("tga", TEXTURE_TYPE);
+		asset_compiler.registerExtension("dds", TEXTURE_TYPE);
+		asset_compiler.registerExtension("raw", TEXTURE_TYPE);
+		asset_compiler.registerExtension("par", PARTICLE_EMITTER_TYPE);
+		asset_compiler.registerExtension("mat", MATERIAL_TYPE);
+		asset_compiler.registerExtension("fbx", MODEL_TYPE);
+		asset_compiler.registerExtension("ttf", FONT_TYPE);
+
+		const char* shader_exts[] = {"shd", nullptr};
+		asset_compiler.addPlugin(m_shader_compiler, shader_exts);
+
+		const char* texture_exts[] = { "png", "jpg", "dds", "tga", "raw", nullptr};
+		asset_compiler.addPlugin(m_texture_compiler, texture_exts);
+
+		const char* pipeline_exts[] = {"pln", nullptr};
+		asset_compiler.addPlugin(m_pipeline_compiler, pipeline_exts);
+
+		const char* particle_emitter_exts[] = {"par", nullptr};
+		asset_compiler.addPlugin(m_particle_emitter_compiler, particle_emitter_exts);
+
+		const char* material_exts[] = {"mat", nullptr};
+		asset_compiler.addPlugin(m_material_compiler, material_exts);
+
+		const char* model_exts[] = {"fbx", nullptr};
+		asset_compiler.addPlugin(m_model_compiler, model_exts);
+
+		const char* fonts_exts[] = {"ttf", nullptr};
+		asset_compiler.addPlugin(m_font_compiler, fonts_exts);
+	}
+
+
+	~CompilersPlugin()
+	{
+		AssetCompiler& asset_compiler = m_app.getAssetCompiler();
+		asset_compiler.removePlugin(m_font_compiler);
+		asset_compiler.removePlugin(m_shader_compiler);
+		asset_compiler.removePlugin(m_texture_compiler);
+		asset_compiler.removePlugin(m_model_compiler);
+		asset_compiler.removePlugin(m_material_compiler);
+		asset_compiler.removePlugin(m_particle_emitter_compiler);
+		asset_compiler.removePlugin(m_pipeline_compiler);
+	}
+
+
+	StudioApp& m_app;
+	CopyCompiler m_font_compiler;
+	CopyCompiler m_pipeline_compiler;
+	CopyCompiler m_particle_emitter_compiler;
+	CopyCompiler m_material_compiler;
+	ShaderCompiler m_shader_compiler;
+	TextureCompiler m_texture_compiler;
+	ModelCompiler m_model_compiler;
+};
+
+
+} // anonymous namespace
+
+
+LUMIX_ASSET_COMPILER_ENTRY(renderer)
+{
+	IAllocator& allocator = app.getWorldEditor().getAllocator();
+	return LUMIX_NEW(allocator, CompilersPlugin)(app);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+
+#include "engine/lumix.h"
+
+
+namespace Lumix
+{
+
+
+struct AssetCompiler;
+class Path;
+
+
+struct TextureMeta
+{
+	enum WrapMode : int {
+		REPEAT,
+		CLAMP
+	};
+
+	static TextureMeta load(AssetCompiler& compiler, const Path& path);
+
+	bool srgb = false;
+	bool is_normalmap = false;
+	WrapMode wrap_mode = WrapMode::REPEAT;
+};
+
+
+struct ModelMeta
+{
+	static ModelMeta load(AssetCompiler& compiler, const Path& path);
+
+	float scale = 1;
+	bool split = false;
+};
+
+
+} // namespace Lumix
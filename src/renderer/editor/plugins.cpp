@@ -1,5 +1,6 @@
 #include "../ffr/ffr.h"
 #include "animation/animation.h"
+#include "compilers.h"
 #include "editor/asset_browser.h"
 #include "editor/asset_compiler.h"
 #include "editor/property_grid.h"
@@ -27,7 +28,6 @@
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
 #include "engine/universe/universe.h"
-#include "fbx_importer.h"
 #include "game_view.h"
 #include "renderer/culling_system.h"
 #include "renderer/ffr/ffr.h"
@@ -41,7 +41,6 @@
 #include "renderer/shader.h"
 #include "renderer/texture.h"
 #include "scene_view.h"
-#define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #if defined _MSC_VER && _MSC_VER == 1900 
 #pragma warning(disable : 4312)
@@ -110,19 +109,13 @@ static bool saveAsDDS(const char* path, const u8* data, int w, int h) {
 
 
 
-struct FontPlugin final : public AssetBrowser::IPlugin, AssetCompiler::IPlugin
+struct FontPlugin final : public AssetBrowser::IPlugin
 {
 	FontPlugin(StudioApp& app) 
 		: m_app(app) 
 	{
-		app.getAssetCompiler().registerExtension("ttf", FontResource::TYPE); 
 	}
 	
-	bool compile(const Path& src) override
-	{
-		return m_app.getAssetCompiler().copyCompile(src);
-	}
-
 	void onGUI(Span<Resource*> resources) override {}
 	void onResourceUnloaded(Resource* resource) override {}
 	const char* getName() const override { return "Font"; }
@@ -133,33 +126,11 @@ struct FontPlugin final : public AssetBrowser::IPlugin, AssetCompiler::IPlugin
 };
 
 
-struct PipelinePlugin final : AssetCompiler::IPlugin
-{
-	explicit PipelinePlugin(StudioApp& app)
-		: m_app(app)
-	{}
-
-	bool compile(const Path& src) override
-	{
-		return m_app.getAssetCompiler().copyCompile(src);
-	}
-
-	StudioApp& m_app;
-};
-
-
-struct ParticleEmitterPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
+struct ParticleEmitterPlugin final : AssetBrowser::IPlugin
 {
 	explicit ParticleEmitterPlugin(StudioApp& app)
 		: m_app(app)
 	{
-		app.getAssetCompiler().registerExtension("par", ParticleEmitterResource::TYPE);
-	}
-
-
-	bool compile(const Path& src) override
-	{
-		return m_app.getAssetCompiler().copyCompile(src);
 	}
 	
 	
@@ -175,12 +146,11 @@ struct ParticleEmitterPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlug
 };
 
 
-struct MaterialPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
+struct MaterialPlugin final : AssetBrowser::IPlugin
 {
 	explicit MaterialPlugin(StudioApp& app)
 		: m_app(app)
 	{
-		app.getAssetCompiler().registerExtension("mat", Material::TYPE);
 	}
 
 	bool canCreateResource() const override { return true; }
@@ -201,11 +171,6 @@ struct MaterialPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 		return true;
 	}
 
-	bool compile(const Path& src) override
-	{
-		return m_app.getAssetCompiler().copyCompile(src);
-	}
-
 
 	void saveMaterial(Material* material)
 	{
@@ -481,14 +446,8 @@ struct MaterialPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 };
 
 
-struct ModelPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
+struct ModelPlugin final : AssetBrowser::IPlugin
 {
-	struct Meta
-	{
-		float scale = 1;
-		bool split = false;
-	};
-
 	explicit ModelPlugin(StudioApp& app)
 		: m_app(app)
 		, m_mesh(INVALID_ENTITY)
@@ -496,9 +455,7 @@ struct ModelPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 		, m_universe(nullptr)
 		, m_is_mouse_captured(false)
 		, m_tile(app.getWorldEditor().getAllocator())
-		, m_fbx_importer(app.getAssetCompiler(), app.getWorldEditor().getEngine().getFileSystem(), app.getWorldEditor().getAllocator())
 	{
-		app.getAssetCompiler().registerExtension("fbx", Model::TYPE);
 		createPreviewUniverse();
 		createTileUniverse();
 		m_viewport.is_ortho = false;
@@ -510,7 +467,6 @@ struct ModelPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 
 	~ModelPlugin()
 	{
-		JobSystem::wait(m_subres_signal);
 		auto& engine = m_app.getWorldEditor().getEngine();
 		engine.destroyUniverse(*m_universe);
 		Pipeline::destroy(m_pipeline);
@@ -519,99 +475,6 @@ struct ModelPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 	}
 
 
-	Meta getMeta(const Path& path) const
-	{
-		Meta meta;
-		m_app.getAssetCompiler().getMeta(path, [&](lua_State* L){
-			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "scale", &meta.scale);
-			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "split", &meta.split);
-		});
-		return meta;
-	}
-
-	void addSubresources(AssetCompiler& compiler, const char* path) override {
-		compiler.addResource(Model::TYPE, path);
-
-		const Meta meta = getMeta(Path(path));
-		struct JobData {
-			ModelPlugin* plugin;
-			StaticString<MAX_PATH_LENGTH> path;
-			Meta meta;
-		};
-		JobData* data = LUMIX_NEW(m_app.getWorldEditor().getAllocator(), JobData);
-		data->plugin = this;
-		data->path = path;
-		data->meta = meta;
-		JobSystem::runEx(data, [](void* ptr) {
-			JobData* data = (JobData*)ptr;
-			ModelPlugin* plugin = data->plugin;
-			WorldEditor& editor = plugin->m_app.getWorldEditor();
-			FileSystem& fs = editor.getEngine().getFileSystem();
-			FBXImporter importer(plugin->m_app.getAssetCompiler(), fs, editor.getAllocator());
-			AssetCompiler& compiler = plugin->m_app.getAssetCompiler();
-
-			const char* path = data->path[0] == '/' ? data->path.data + 1 : data->path;
-			importer.setSource(path, true);
-
-			if(data->meta.split) {
-				const Array<FBXImporter::ImportMesh>& meshes = importer.getMeshes();
-				for (int i = 0; i < meshes.size(); ++i) {
-					char mesh_name[256];
-					importer.getImportMeshName(meshes[i], mesh_name);
-					StaticString<MAX_PATH_LENGTH> tmp(mesh_name, ":", path);
-					compiler.addResource(Model::TYPE, tmp);
-				}
-			}
-
-			const Array<FBXImporter::ImportAnimation>& animations = importer.getAnimations();
-			for (const FBXImporter::ImportAnimation& anim : animations) {
-				StaticString<MAX_PATH_LENGTH> tmp(anim.name, ":", path);
-				compiler.addResource(Animation::TYPE, tmp);
-			}
-
-			LUMIX_DELETE(editor.getAllocator(), data);
-		}, &m_subres_signal, JobSystem::INVALID_HANDLE, 2);			
-	}
-
-	static const char* getResourceFilePath(const char* str)
-	{
-		const char* c = str;
-		while (*c && *c != ':') ++c;
-		return *c != ':' ? str : c + 1;
-	}
-
-	bool compile(const Path& src) override
-	{
-		ASSERT(PathUtils::hasExtension(src.c_str(), "fbx"));
-		const char* filepath = getResourceFilePath(src.c_str());
-		FBXImporter::ImportConfig cfg;
-		const Meta meta = getMeta(Path(filepath));
-		cfg.mesh_scale = meta.scale;
-		const PathUtils::FileInfo src_info(filepath);
-		m_fbx_importer.setSource(filepath, false);
-		if (m_fbx_importer.getMeshes().empty()) {
-			if (m_fbx_importer.getOFBXScene()->getMeshCount() > 0) {
-				logError("Editor") << "No meshes with materials found in " << src;
-			}
-			else {
-				logError("Editor") << "No meshes found in " << src;
-			}
-		}
-
-		const StaticString<32> hash_str("", src.getHash());
-		if (meta.split) {
-			//cfg.origin = FBXImporter::ImportConfig::Origin::CENTER;
-			const Array<FBXImporter::ImportMesh>& meshes = m_fbx_importer.getMeshes();
-			m_fbx_importer.writeSubmodels(filepath, cfg);
-			m_fbx_importer.writePrefab(filepath, cfg);
-		}
-		m_fbx_importer.writeModel(src.c_str(), cfg);
-		m_fbx_importer.writeMaterials(filepath, cfg);
-		m_fbx_importer.writeAnimations(filepath, cfg);
-		return true;
-	}
-
-
 	void createTileUniverse()
 	{
 		Engine& engine = m_app.getWorldEditor().getEngine();
@@ -856,7 +719,7 @@ struct ModelPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 		if (ImGui::CollapsingHeader("Import")) {
 			AssetCompiler& compiler = m_app.getAssetCompiler();
 			if(m_meta_res != model->getPath().getHash()) {
-				m_meta = getMeta(model->getPath());
+				m_meta = ModelMeta::load(compiler, model->getPath());
 				m_meta_res = model->getPath().getHash();
 			}
 			ImGui::InputFloat("Scale", &m_meta.scale);
@@ -873,7 +736,7 @@ struct ModelPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 		showPreview(*model);
 	}
 
-	Meta m_meta;
+	ModelMeta m_meta;
 	u32 m_meta_res = 0;
 
 	void onResourceUnloaded(Resource* resource) override {}
@@ -1077,7 +940,7 @@ bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_READ_BACK); renderer->viewCounterAdd();
 		m_tile.texture = ffr::allocTextureHandle(); 
 		
 
-		Cmd* cmd = LUMIX_NEW(renderer->getAllocator(), Cmd);
+		Cmd* cmd = LUMIX_NEW(renderer->getEngine().getFrameAllocator(), Cmd);
 		cmd->texture = m_tile.pipeline->getOutput();
 		m_tile.data.resize(AssetBrowser::TILE_SIZE * AssetBrowser::TILE_SIZE * 4);
 		cmd->mem.data = &m_tile.data[0];
@@ -1143,32 +1006,14 @@ bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_READ_BACK); renderer->viewCounterAdd();
 	bool m_is_mouse_captured;
 	int m_captured_mouse_x;
 	int m_captured_mouse_y;
-	FBXImporter m_fbx_importer;
-	JobSystem::SignalHandle m_subres_signal = JobSystem::INVALID_HANDLE;
 };
 
 
-struct TexturePlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
+struct TexturePlugin final : AssetBrowser::IPlugin
 {
-	struct Meta
-	{
-		enum WrapMode : int {
-			REPEAT,
-			CLAMP
-		};
-		bool srgb = false;
-		bool is_normalmap = false;
-		WrapMode wrap_mode = WrapMode::REPEAT;
-	};
-
 	explicit TexturePlugin(StudioApp& app)
 		: m_app(app)
 	{
-		app.getAssetCompiler().registerExtension("png", Texture::TYPE);
-		app.getAssetCompiler().registerExtension("jpg", Texture::TYPE);
-		app.getAssetCompiler().registerExtension("tga", Texture::TYPE);
-		app.getAssetCompiler().registerExtension("dds", Texture::TYPE);
-		app.getAssetCompiler().registerExtension("raw", Texture::TYPE);
 	}
 
 
@@ -1299,99 +1144,6 @@ struct TexturePlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 	}
 
 
-	bool compileImage(const Array<u8>& src_data, OutputMemoryStream& dst, const Meta& meta)
-	{
-		PROFILE_FUNCTION();
-		int w, h, comps;
-		stbi_uc* data = stbi_load_from_memory(src_data.begin(), src_data.byte_size(), &w, &h, &comps, 4);
-		if (!data) return false;
-
-		dst.write("dds", 3);
-		u32 flags = meta.srgb ? (u32)Texture::Flags::SRGB : 0;
-		flags |= meta.wrap_mode == Meta::WrapMode::CLAMP ? (u32)Texture::Flags::CLAMP : 0;
-		dst.write(&flags, sizeof(flags));
-
-		nvtt::Context context;
-		
-		const bool has_alpha = comps == 4;
-		nvtt::InputOptions input;
-		input.setMipmapGeneration(true);
-		input.setAlphaMode(has_alpha ? nvtt::AlphaMode_Transparency : nvtt::AlphaMode_None);
-		input.setNormalMap(meta.is_normalmap);
-		input.setTextureLayout(nvtt::TextureType_2D, w, h);
-		input.setMipmapData(data, w, h);
-		stbi_image_free(data);
-		
-		nvtt::OutputOptions output;
-		output.setSrgbFlag(meta.srgb);
-		struct : nvtt::OutputHandler {
-			bool writeData(const void * data, int size) override { return dst->write(data, size); }
-			void beginImage(int size, int width, int height, int depth, int face, int miplevel) override {}
-			void endImage() override {}
-
-			OutputMemoryStream* dst;
-		} output_handler;
-		output_handler.dst = &dst;
-		output.setOutputHandler(&output_handler);
-
-		nvtt::CompressionOptions compression;
-		compression.setFormat(meta.is_normalmap ? nvtt::Format_DXT5n : (has_alpha ? nvtt::Format_DXT5 :  nvtt::Format_DXT1));
-		compression.setQuality(nvtt::Quality_Normal);
-
-		if (!context.process(input, compression, output)) {
-			return false;
-		}
-		return true;
-	}
-
-
-	Meta getMeta(const Path& path) const
-	{
-		Meta meta;
-		m_app.getAssetCompiler().getMeta(path, [&meta](lua_State* L){
-			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "srgb", &meta.srgb);
-			LuaWrapper::getOptionalField(L, LUA_GLOBALSINDEX, "normalmap", &meta.is_normalmap);
-			char tmp[32];
-			if(LuaWrapper::getOptionalStringField(L, LUA_GLOBALSINDEX, "wrap_mode", Span(tmp))) {
-				meta.wrap_mode = stricmp(tmp, "repeat") == 0 ? Meta::WrapMode::REPEAT : Meta::WrapMode::CLAMP;
-			}
-		});
-		return meta;
-	}
-
-
-	bool compile(const Path& src) override
-	{
-		char ext[4] = {};
-		PathUtils::getExtension(Span(ext), src.c_str());
-
-		FileSystem& fs = m_app.getWorldEditor().getEngine().getFileSystem();
-		Array<u8> src_data(m_app.getWorldEditor().getAllocator());
-		if (!fs.getContentSync(src, Ref(src_data))) return false;
-		
-		OutputMemoryStream out(m_app.getWorldEditor().getAllocator());
-		Meta meta = getMeta(src);
-		if (equalStrings(ext, "dds") || equalStrings(ext, "raw") || equalStrings(ext, "tga")) {
-			out.write(ext, sizeof(ext) - 1);
-			u32 flags = meta.srgb ? (u32)Texture::Flags::SRGB : 0;
-			flags |= meta.wrap_mode == Meta::WrapMode::CLAMP ? (u32)Texture::Flags::CLAMP : 0;
-			out.write(flags);
-			out.write(src_data.begin(), src_data.byte_size());
-		}
-		else if(equalStrings(ext, "jpg")) {
-			compileImage(src_data, out, meta);
-		}
-		else if(equalStrings(ext, "png")) {
-			compileImage(src_data, out, meta);
-		}
-		else {
-			ASSERT(false);
-		}
-
-		return m_app.getAssetCompiler().writeCompiledResource(src.c_str(), Span((u8*)out.getData(), (i32)out.getPos()));
-	}
-
-
 	void onGUI(Span<Resource*> resources) override
 	{
 		if(resources.length() > 1) return;
@@ -1432,7 +1184,7 @@ struct TexturePlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 			AssetCompiler& compiler = m_app.getAssetCompiler();
 			
 			if(texture->getPath().getHash() != m_meta_res) {
-				m_meta = getMeta(texture->getPath());
+				m_meta = TextureMeta::load(compiler, texture->getPath());
 				m_meta_res = texture->getPath().getHash();
 			}
 			
@@ -1443,7 +1195,7 @@ struct TexturePlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 			if (ImGui::Button("Apply")) {
 				const StaticString<256> src("srgb = ", m_meta.srgb ? "true" : "false"
 					, "\nnormalmap = ", m_meta.is_normalmap ? "true" : "false"
-					, "\nwrap_mode = \"", m_meta.wrap_mode == Meta::WrapMode::REPEAT ? "repeat\"" : "clamp\"");
+					, "\nwrap_mode = \"", m_meta.wrap_mode == TextureMeta::WrapMode::REPEAT ? "repeat\"" : "clamp\"");
 				compiler.updateMeta(texture->getPath(), src);
 				if (compiler.compile(texture->getPath())) {
 					texture->getResourceManager().reload(*texture);
@@ -1462,102 +1214,16 @@ struct TexturePlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
 	Texture* m_texture;
 	ffr::TextureHandle m_texture_view = ffr::INVALID_TEXTURE;
 	JobSystem::SignalHandle m_tile_signal = JobSystem::INVALID_HANDLE;
-	Meta m_meta;
+	TextureMeta m_meta;
 	u32 m_meta_res = 0;
 };
 
 
-struct ShaderPlugin final : AssetBrowser::IPlugin, AssetCompiler::IPlugin
+struct ShaderPlugin final : AssetBrowser::IPlugin
 {
 	explicit ShaderPlugin(StudioApp& app)
 		: m_app(app)
 	{
-		app.getAssetCompiler().registerExtension("shd", Shader::TYPE);
-	}
-
-
-	void findIncludes(const char* path)
-	{
-		lua_State* L = luaL_newstate();
-		luaL_openlibs(L);
-
-		OS::InputFile file;
-		if (!file.open(path[0] == '/' ? path + 1 : path)) return;
-		
-		IAllocator& allocator = m_app.getWorldEditor().getAllocator();
-		Array<u8> content(allocator);
-		content.resize((int)file.size());
-		file.read(content.begin(), content.byte_size());
-		file.close();
-
-		struct Context {
-			const char* path;
-			ShaderPlugin* plugin;
-			u8* content;
-			int content_len;
-			int idx;
-		} ctx = { path, this, content.begin(), content.byte_size(), 0 };
-
-		lua_pushlightuserdata(L, &ctx);
-		lua_setfield(L, LUA_GLOBALSINDEX, "this");
-
-		auto include = [](lua_State* L) -> int {
-			lua_getfield(L, LUA_GLOBALSINDEX, "this");
-			Context* that = LuaWrapper::toType<Context*>(L, -1);
-			lua_pop(L, 1);
-			const char* path = LuaWrapper::checkArg<const char*>(L, 1);
-			that->plugin->m_app.getAssetCompiler().registerDependency(Path(that->path), Path(path));
-			return 0;
-		};
-
-		lua_pushcclosure(L, include, 0);
-		lua_setfield(L, LUA_GLOBALSINDEX, "include");
-
-		static const char* preface = 
-			"local new_g = setmetatable({include = include}, {__index = function() return function() end end })\n"
-			"setfenv(1, new_g)\n";
-
-		auto reader = [](lua_State* L, void* data, size_t* size) -> const char* {
-			Context* ctx = (Context*)data;
-			++ctx->idx;
-			switch(ctx->idx) {
-				case 1: 
-					*size = stringLength(preface);
-					return preface;
-				case 2: 
-					*size = ctx->content_len;
-					return (const char*)ctx->content;
-				default:
-					*size = 0;
-					return nullptr;
-			}
-		};
-
-		if (lua_load(L, reader, &ctx, path) != 0) {
-			logError("Engine") << path << ": " << lua_tostring(L, -1);
-			lua_pop(L, 2);
-			lua_close(L);
-			return;
-		}
-
-		if (lua_pcall(L, 0, 0, -2) != 0) {
-			logError("Engine") << lua_tostring(L, -1);
-			lua_pop(L, 2);
-			lua_close(L);
-			return;
-		}
-		lua_pop(L, 1);
-		lua_close(L);
-	}
-
-	void addSubresources(AssetCompiler& compiler, const char* path) override {
-		compiler.addResource(Shader::TYPE, path);
-		findIncludes(path);
-	}
-
-	bool compile(const Path& src) override
-	{
-		return m_app.getAssetCompiler().copyCompile(src);
 	}
 
 
@@ -2623,7 +2289,8 @@ struct EditorUIRenderPlugin final : public StudioApp::GUIPlugin
 		}
 
 		Renderer* renderer = static_cast<Renderer*>(m_engine.getPluginManager().getPlugin("renderer"));
-		RenderCommand* cmd = LUMIX_NEW(renderer->getAllocator(), RenderCommand)(renderer->getAllocator());
+		IAllocator& allocator = m_engine.getFrameAllocator();
+		RenderCommand* cmd = LUMIX_NEW(allocator, RenderCommand)(allocator);
 		cmd->plugin = this;
 		
 		renderer->queue(cmd, 0);
@@ -2892,35 +2559,13 @@ struct StudioAppPlugin : StudioApp::IPlugin
 		m_add_terrain_plugin = LUMIX_NEW(allocator, AddTerrainComponentPlugin)(m_app);
 		m_app.registerComponent("terrain", *m_add_terrain_plugin);
 
-		AssetCompiler& asset_compiler = m_app.getAssetCompiler();
-
+		// compilers are registered by LUMIX_ASSET_COMPILER_ENTRY in compilers.cpp
 		m_shader_plugin = LUMIX_NEW(allocator, ShaderPlugin)(m_app);
-		const char* shader_exts[] = {"shd", nullptr};
-		asset_compiler.addPlugin(*m_shader_plugin, shader_exts);
-
 		m_texture_plugin = LUMIX_NEW(allocator, TexturePlugin)(m_app);
-		const char* texture_exts[] = { "png", "jpg", "dds", "tga", "raw", nullptr};
-		asset_compiler.addPlugin(*m_texture_plugin, texture_exts);
-
-		m_pipeline_plugin = LUMIX_NEW(allocator, PipelinePlugin)(m_app);
-		const char* pipeline_exts[] = {"pln", nullptr};
-		asset_compiler.addPlugin(*m_pipeline_plugin, pipeline_exts);
-
 		m_particle_emitter_plugin = LUMIX_NEW(allocator, ParticleEmitterPlugin)(m_app);
-		const char* particle_emitter_exts[] = {"par", nullptr};
-		asset_compiler.addPlugin(*m_particle_emitter_plugin, particle_emitter_exts);
-
 		m_material_plugin = LUMIX_NEW(allocator, MaterialPlugin)(m_app);
-		const char* material_exts[] = {"mat", nullptr};
-		asset_compiler.addPlugin(*m_material_plugin, material_exts);
-
 		m_model_plugin = LUMIX_NEW(allocator, ModelPlugin)(m_app);
-		const char* model_exts[] = {"fbx", nullptr};
-		asset_compiler.addPlugin(*m_model_plugin, model_exts);
-
 		m_font_plugin = LUMIX_NEW(allocator, FontPlugin)(m_app);
-		const char* fonts_exts[] = {"ttf", nullptr};
-		asset_compiler.addPlugin(*m_font_plugin, fonts_exts);
 		
 		AssetBrowser& asset_browser = m_app.getAssetBrowser();
 		asset_browser.addPlugin(*m_model_plugin);
@@ -2960,19 +2605,9 @@ struct StudioAppPlugin : StudioApp::IPlugin
 		asset_browser.removePlugin(*m_texture_plugin);
 		asset_browser.removePlugin(*m_shader_plugin);
 
-		AssetCompiler& asset_compiler = m_app.getAssetCompiler();
-		asset_compiler.removePlugin(*m_font_plugin);
-		asset_compiler.removePlugin(*m_shader_plugin);
-		asset_compiler.removePlugin(*m_texture_plugin);
-		asset_compiler.removePlugin(*m_model_plugin);
-		asset_compiler.removePlugin(*m_material_plugin);
-		asset_compiler.removePlugin(*m_particle_emitter_plugin);
-		asset_compiler.removePlugin(*m_pipeline_plugin);
-
 		LUMIX_DELETE(allocator, m_model_plugin);
 		LUMIX_DELETE(allocator, m_material_plugin);
 		LUMIX_DELETE(allocator, m_particle_emitter_plugin);
-		LUMIX_DELETE(allocator, m_pipeline_plugin);
 		LUMIX_DELETE(allocator, m_font_plugin);
 		LUMIX_DELETE(allocator, m_texture_plugin);
 		LUMIX_DELETE(allocator, m_shader_plugin);
@@ -3003,7 +2638,6 @@ struct StudioAppPlugin : StudioApp::IPlugin
 	ModelPlugin* m_model_plugin;
 	MaterialPlugin* m_material_plugin;
 	ParticleEmitterPlugin* m_particle_emitter_plugin;
-	PipelinePlugin* m_pipeline_plugin;
 	FontPlugin* m_font_plugin;
 	TexturePlugin* m_texture_plugin;
 	ShaderPlugin* m_shader_plugin;
@@ -198,7 +198,7 @@ void SceneView::renderIcons()
 	Engine& engine = m_editor.getEngine();
 	Renderer* renderer = static_cast<Renderer*>(engine.getPluginManager().getPlugin("renderer"));
 
-	IAllocator& allocator = renderer->getAllocator();
+	IAllocator& allocator = engine.getFrameAllocator();
 	Cmd* cmd = LUMIX_NEW(allocator, Cmd)(allocator);
 	cmd->view = this;
 	renderer->queue(cmd, 0);
@@ -269,7 +269,7 @@ void SceneView::renderSelection()
 
 	Engine& engine = m_editor.getEngine();
 	Renderer* renderer = static_cast<Renderer*>(engine.getPluginManager().getPlugin("renderer"));
-	IAllocator& allocator = renderer->getAllocator();
+	IAllocator& allocator = engine.getFrameAllocator();
 	RenderJob* job = LUMIX_NEW(allocator, RenderJob)(allocator);
 	job->m_pipeline = m_pipeline;
 	job->m_editor = &m_editor;
@@ -355,7 +355,7 @@ void SceneView::renderGizmos()
 	Engine& engine = m_editor.getEngine();
 	Renderer* renderer = static_cast<Renderer*>(engine.getPluginManager().getPlugin("renderer"));
 
-	IAllocator& allocator = renderer->getAllocator();
+	IAllocator& allocator = engine.getFrameAllocator();
 	Cmd* cmd = LUMIX_NEW(allocator, Cmd)(allocator);
 	cmd->shader = m_debug_shape_shader->m_render_data;
 	cmd->view = this;
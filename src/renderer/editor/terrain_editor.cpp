@@ -23,6 +23,7 @@
 #include "renderer/model.h"
 #include "renderer/render_scene.h"
 #include "renderer/renderer.h"
+#include "renderer/terrain.h"
 #include "renderer/texture.h"
 #include "stb/stb_image.h"
 #include <math.h>
@@ -499,7 +500,11 @@ private:
 
 		auto texture = getDestinationTexture();
 		int bpp = texture->bytes_per_pixel;
+		const EntityRef e = (EntityRef)m_terrain.entity;
+		Terrain* terrain = static_cast<RenderScene*>(m_terrain.scene)->getTerrain(e);
 
+		// grass jobs read the data, render jobs can be reading grass generated from it
+		terrain->beginDataUpdate();
 		for (int j = m_y; j < m_y + m_height; ++j)
 		{
 			for (int i = m_x; i < m_x + m_width; ++i)
@@ -511,13 +516,14 @@ private:
 				}
 			}
 		}
+		terrain->endDataUpdate();
 		texture->onDataUpdated(m_x, m_y, m_width, m_height);
-		const EntityRef e = (EntityRef)m_terrain.entity;
-		static_cast<RenderScene*>(m_terrain.scene)->forceGrassUpdate(e);
 
 		if (m_action_type != TerrainEditor::LAYER && m_action_type != TerrainEditor::COLOR &&
 			m_action_type != TerrainEditor::ADD_GRASS && m_action_type != TerrainEditor::REMOVE_GRASS)
 		{
+			terrain->onHeightmapChanged(m_x, m_y, m_width, m_height);
+
 			IScene* scene = m_world_editor.getUniverse()->getScene(crc32("physics"));
 			if (!scene) return;
 
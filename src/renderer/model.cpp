@@ -11,6 +11,7 @@
 #include "engine/resource_manager.h"
 #include "engine/stream.h"
 #include "engine/math.h"
+#include "renderer/bvh.h"
 #include "renderer/material.h"
 #include "renderer/pose.h"
 #include "renderer/renderer.h"
@@ -117,11 +118,12 @@ Model::Model(const Path& path, ResourceManager& resource_manager, Renderer& rend
 	, m_bones(m_allocator)
 	, m_first_nonroot_bone_index(0)
 	, m_renderer(renderer)
+	, m_bvhs(m_allocator)
 {
-	m_lods[0] = { 0, -1, FLT_MAX };
-	m_lods[1] = { 0, -1, FLT_MAX };
-	m_lods[2] = { 0, -1, FLT_MAX };
-	m_lods[3] = { 0, -1, FLT_MAX };
+	m_lods[0] = { 0, -1, FLT_MAX, 0 };
+	m_lods[1] = { 0, -1, FLT_MAX, 0 };
+	m_lods[2] = { 0, -1, FLT_MAX, 0 };
+	m_lods[3] = { 0, -1, FLT_MAX, 0 };
 }
 
 
@@ -131,7 +133,7 @@ Model::~Model()
 }
 
 
-static Vec3 evaluateSkin(Vec3& p, Mesh::Skin s, const Matrix* matrices)
+static Vec3 evaluateSkin(const Vec3& p, Mesh::Skin s, const Matrix* matrices)
 {
 	Matrix m = matrices[s.indices[0]] * s.weights.x + matrices[s.indices[1]] * s.weights.y +
 			   matrices[s.indices[2]] * s.weights.z + matrices[s.indices[3]] * s.weights.w;
@@ -161,6 +163,52 @@ bool Model::isSkinned() const
 }
 
 
+const MeshBVH& Model::getBVH(int mesh_index)
+{
+	MT::CriticalSectionLock lock(m_bvhs_mutex);
+	if (m_bvhs.empty()) {
+		m_bvhs.resize(m_meshes.size());
+		for (MeshBVH*& bvh : m_bvhs) bvh = nullptr;
+	}
+	MeshBVH*& bvh = m_bvhs[mesh_index];
+	if (!bvh) {
+		const Mesh& mesh = m_meshes[mesh_index];
+		const int index_size = mesh.areIndices16() ? 2 : 4;
+		bvh = LUMIX_NEW(m_allocator, MeshBVH)(m_allocator);
+		bvh->build(mesh.vertices.begin(), mesh.indices.begin(), mesh.indices.size() / index_size, mesh.areIndices16());
+	}
+	return *bvh;
+}
+
+
+static bool castRaySkinned(const Mesh& mesh, const Vec3& origin, const Vec3& dir, const Matrix* matrices, float max_t, float* out_t, IAllocator& allocator)
+{
+	Array<Vec3> vertices(allocator);
+	vertices.resize(mesh.vertices.size());
+	for (int i = 0, c = mesh.vertices.size(); i < c; ++i) {
+		vertices[i] = evaluateSkin(mesh.vertices[i], mesh.skin[i], matrices);
+	}
+
+	const u16* indices16 = (const u16*)mesh.indices.begin();
+	const u32* indices32 = (const u32*)mesh.indices.begin();
+	const bool is16 = mesh.areIndices16();
+	const int index_size = is16 ? 2 : 4;
+	bool is_hit = false;
+	for (int i = 0, c = mesh.indices.size() / index_size; i < c; i += 3) {
+		const Vec3& p0 = vertices[is16 ? indices16[i] : indices32[i]];
+		const Vec3& p1 = vertices[is16 ? indices16[i + 1] : indices32[i + 1]];
+		const Vec3& p2 = vertices[is16 ? indices16[i + 2] : indices32[i + 2]];
+		float t;
+		if (getRayTriangleIntersection(origin, dir, p0, p1, p2, &t) && t < max_t) {
+			max_t = t;
+			is_hit = true;
+		}
+	}
+	if (is_hit) *out_t = max_t;
+	return is_hit;
+}
+
+
 RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose* pose)
 {
 	RayCastModelHit hit;
@@ -169,82 +217,36 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose*
 
 	Matrix matrices[256];
 	ASSERT(!pose || pose->count <= lengthOf(matrices));
-	bool is_skinned = false;
-	for (int mesh_index = m_lods[0].from_mesh; mesh_index <= m_lods[0].to_mesh; ++mesh_index)
-	{
-		Mesh& mesh = m_meshes[mesh_index];
-		is_skinned = pose && !mesh.skin.empty() && pose->count <= lengthOf(matrices);
-	}
-	if (is_skinned)
-	{
-		computeSkinMatrices(*pose, *this, matrices);
-	}
+	const bool has_pose = pose && pose->count <= lengthOf(matrices);
+	bool matrices_computed = false;
 
+	float best_t = FLT_MAX;
 	for (int mesh_index = m_lods[0].from_mesh; mesh_index <= m_lods[0].to_mesh; ++mesh_index)
 	{
-		Mesh& mesh = m_meshes[mesh_index];
-		bool is_mesh_skinned = !mesh.skin.empty();
-		u16* indices16 = (u16*)&mesh.indices[0];
-		u32* indices32 = (u32*)&mesh.indices[0];
-		bool is16 = mesh.flags.isSet(Mesh::Flags::INDICES_16_BIT);
-		int index_size = is16 ? 2 : 4;
-		for(int i = 0, c = mesh.indices.size() / index_size; i < c; i += 3)
+		const Mesh& mesh = m_meshes[mesh_index];
+		float t;
+		bool is_mesh_hit;
+		if (has_pose && !mesh.skin.empty())
 		{
-			Vec3 p0, p1, p2;
-			if (is16)
-			{
-				p0 = mesh.vertices[indices16[i]];
-				p1 = mesh.vertices[indices16[i + 1]];
-				p2 = mesh.vertices[indices16[i + 2]];
-				if (is_mesh_skinned)
-				{
-					p0 = evaluateSkin(p0, mesh.skin[indices16[i]], matrices);
-					p1 = evaluateSkin(p1, mesh.skin[indices16[i + 1]], matrices);
-					p2 = evaluateSkin(p2, mesh.skin[indices16[i + 2]], matrices);
-				}
-			}
-			else
+			// skinned vertices change every frame, no point in caching a BVH for them
+			if (!matrices_computed)
 			{
-				p0 = mesh.vertices[indices32[i]];
-				p1 = mesh.vertices[indices32[i + 1]];
-				p2 = mesh.vertices[indices32[i + 2]];
-				if (is_mesh_skinned)
-				{
-					p0 = evaluateSkin(p0, mesh.skin[indices32[i]], matrices);
-					p1 = evaluateSkin(p1, mesh.skin[indices32[i + 1]], matrices);
-					p2 = evaluateSkin(p2, mesh.skin[indices32[i + 2]], matrices);
-				}
+				computeSkinMatrices(*pose, *this, matrices);
+				matrices_computed = true;
 			}
+			is_mesh_hit = castRaySkinned(mesh, origin, dir, matrices, best_t, &t, m_allocator);
+		}
+		else
+		{
+			is_mesh_hit = getBVH(mesh_index).castRay(origin, dir, best_t, &t);
+		}
 
-
-			Vec3 normal = crossProduct(p1 - p0, p2 - p0);
-			float q = dotProduct(normal, dir);
-			if (q == 0)	continue;
-
-			float d = -dotProduct(normal, p0);
-			float t = -(dotProduct(normal, origin) + d) / q;
-			if (t < 0) continue;
-
-			Vec3 hit_point = origin + dir * t;
-
-			Vec3 edge0 = p1 - p0;
-			Vec3 VP0 = hit_point - p0;
-			if (dotProduct(normal, crossProduct(edge0, VP0)) < 0) continue;
-
-			Vec3 edge1 = p2 - p1;
-			Vec3 VP1 = hit_point - p1;
-			if (dotProduct(normal, crossProduct(edge1, VP1)) < 0) continue;
-
-			Vec3 edge2 = p0 - p2;
-			Vec3 VP2 = hit_point - p2;
-			if (dotProduct(normal, crossProduct(edge2, VP2)) < 0) continue;
-
-			if (!hit.is_hit || hit.t > t)
-			{
-				hit.is_hit = true;
-				hit.t = t;
-				hit.mesh = &m_meshes[mesh_index];
-			}
+		if (is_mesh_hit)
+		{
+			best_t = t;
+			hit.is_hit = true;
+			hit.t = t;
+			hit.mesh = &m_meshes[mesh_index];
 		}
 	}
 	hit.origin = DVec3(origin.x, origin.y, origin.z);
@@ -255,10 +257,10 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Pose*
 
 void Model::getRelativePose(Pose& pose)
 {
-	ASSERT(pose.count == getBoneCount());
+	ASSERT(pose.count <= getBoneCount());
 	Vec3* pos = pose.positions;
 	Quat* rot = pose.rotations;
-	for (int i = 0, c = getBoneCount(); i < c; ++i)
+	for (int i = 0, c = pose.count; i < c; ++i)
 	{
 		pos[i] = m_bones[i].relative_transform.pos;
 		rot[i] = m_bones[i].relative_transform.rot;
@@ -269,10 +271,10 @@ void Model::getRelativePose(Pose& pose)
 
 void Model::getPose(Pose& pose)
 {
-	ASSERT(pose.count == getBoneCount());
+	ASSERT(pose.count <= getBoneCount());
 	Vec3* pos = pose.positions;
 	Quat* rot = pose.rotations;
-	for (int i = 0, c = getBoneCount(); i < c; ++i)
+	for (int i = 0, c = pose.count; i < c; ++i)
 	{
 		pos[i] = m_bones[i].transform.pos;
 		rot[i] = m_bones[i].transform.rot;
@@ -333,6 +335,21 @@ void Model::onBeforeReady()
 		mesh.type = getBoneCount() == 0 || mesh.skin.empty() ? Mesh::RIGID_INSTANCED : Mesh::SKINNED;
 		mesh.layer = mesh.material->getLayer();
 	}
+
+	// the first LOD evaluates all bones, since attachments and IK can reference any of them
+	m_lods[0].bones_count = getBoneCount();
+	for (int i = 1; i < MAX_LOD_COUNT; ++i) {
+		LOD& lod = m_lods[i];
+		int max_bone = -1;
+		for (int mesh_idx = lod.from_mesh; mesh_idx <= lod.to_mesh; ++mesh_idx) {
+			for (const Mesh::Skin& skin : m_meshes[mesh_idx].skin) {
+				for (int j = 0; j < 4; ++j) {
+					if (skin.weights[j] > 0) max_bone = maximum(max_bone, (int)skin.indices[j]);
+				}
+			}
+		}
+		lod.bones_count = max_bone + 1;
+	}
 }
 
 
@@ -699,6 +716,11 @@ void Model::unload()
 	}
 	m_meshes.clear();
 	m_bones.clear();
+
+	for (MeshBVH* bvh : m_bvhs) {
+		LUMIX_DELETE(m_allocator, bvh);
+	}
+	m_bvhs.clear();
 }
 
 
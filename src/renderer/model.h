@@ -8,6 +8,7 @@
 #include "engine/math.h"
 #include "engine/string.h"
 #include "engine/math.h"
+#include "engine/mt/sync.h"
 #include "engine/resource.h"
 #include "ffr/ffr.h"
 #include "renderer.h"
@@ -21,6 +22,7 @@ namespace Lumix
 
 class Material;
 struct Mesh;
+struct MeshBVH;
 class Model;
 struct Pose;
 class Renderer;
@@ -150,6 +152,8 @@ public:
 		int to_mesh;
 
 		float distance;
+		// bones used by the LOD's meshes, bones are sorted parent first, so it's a prefix with all the ancestors
+		int bones_count;
 	};
 
 	struct Bone
@@ -184,6 +188,13 @@ public:
 		return {m_lods[i].from_mesh, m_lods[i].to_mesh};
 	}
 
+	int getLODBonesCount(float squared_distance) const
+	{
+		int i = 0;
+		while (squared_distance >= m_lods[i].distance) ++i;
+		return m_lods[i].bones_count;
+	}
+
 	Mesh& getMesh(int index) { return m_meshes[index]; }
 	const Mesh& getMesh(int index) const { return m_meshes[index]; }
 	const Mesh* getMeshPtr(int index) const { return &m_meshes[index]; }
@@ -215,6 +226,7 @@ private:
 	bool parseMeshes(InputMemoryStream& file, FileVersion version);
 	bool parseLODs(InputMemoryStream& file);
 	int getBoneIdx(const char* name);
+	const MeshBVH& getBVH(int mesh_index);
 
 	void unload() override;
 	bool load(u64 size, const u8* mem) override;
@@ -229,6 +241,9 @@ private:
 	BoneMap m_bone_map;
 	AABB m_aabb;
 	int m_first_nonroot_bone_index;
+	// built on the first raycast, so models which are never raycasted do not pay for it
+	Array<MeshBVH*> m_bvhs;
+	MT::CriticalSection m_bvhs_mutex;
 };
 
 
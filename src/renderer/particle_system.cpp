@@ -580,7 +580,7 @@ static float4* getStream(const ParticleEmitter& emitter
 }
 
 
-void ParticleEmitter::update(float dt)
+void ParticleEmitter::update(float dt, IAllocator& frame_allocator)
 {
 	if (!m_resource || !m_resource->isReady()) return;
 
@@ -600,8 +600,7 @@ void ParticleEmitter::update(float dt)
 	m_constants[0].value = dt;
 	const OutputMemoryStream& bytecode = m_resource->getBytecode();
 	InputMemoryStream blob(bytecode.getData(), bytecode.getPos());
-	// TODO
-	Array<float4> reg_mem(m_allocator);
+	Array<float4> reg_mem(frame_allocator);
 	reg_mem.resize(m_resource->getRegistersCount() * ((m_particles_count + 3) >> 2));
 	m_instances_count = m_particles_count;
 
@@ -60,7 +60,7 @@ public:
 
 	void serialize(IOutputStream& blob);
 	void deserialize(IInputStream& blob, ResourceManagerHub& manager);
-	void update(float dt);
+	void update(float dt, IAllocator& frame_allocator);
 	void emit(const float* args);
 	void fillInstanceData(const DVec3& cam_pos, float* data);
 	int getInstanceDataSizeBytes() const;
@@ -1,9 +1,11 @@
 #include "ffr/ffr.h"
+#include "engine/allocator.h"
 #include "engine/associative_array.h"
 #include "engine/crc32.h"
 #include "engine/engine.h"
 #include "engine/file_system.h"
 #include "engine/geometry.h"
+#include "engine/hash_map.h"
 #include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
@@ -215,6 +217,7 @@ struct MTBucketArray
 
 static const float SHADOW_CAM_NEAR = 50.0f;
 static const float SHADOW_CAM_FAR = 5000.0f;
+static const u32 BONE_MATRIX_SIZE = sizeof(float) * 12;
 
 
 ResourceType PipelineResource::TYPE("pipeline");
@@ -265,6 +268,7 @@ struct PipelineImpl final : Pipeline
 		, m_output(-1)
 		, m_renderbuffers(allocator)
 		, m_shaders(allocator)
+		, m_skinning_palettes(allocator)
 	{
 		m_viewport.w = m_viewport.h = 800;
 		ResourceManagerHub& rm = renderer.getEngine().getResourceManager();
@@ -281,6 +285,8 @@ struct PipelineImpl final : Pipeline
 		m_terrain_params_uniform = ffr::allocUniform("u_terrain_params", ffr::UniformType::VEC4, 1);
 		m_rel_camera_pos_uniform = ffr::allocUniform("u_rel_camera_pos", ffr::UniformType::VEC3, 1);
 		m_terrain_scale_uniform = ffr::allocUniform("u_terrain_scale", ffr::UniformType::VEC3, 1);
+		m_from_to_uniform = ffr::allocUniform("u_from_to", ffr::UniformType::IVEC4, 1);
+		m_from_to_sup_uniform = ffr::allocUniform("u_from_to_sup", ffr::UniformType::IVEC4, 1);
 		m_terrain_matrix_uniform = ffr::allocUniform("u_terrain_matrix", ffr::UniformType::MAT4, 1);
 		m_model_uniform = ffr::allocUniform("u_model", ffr::UniformType::MAT4, 1);
 		m_bones_uniform = ffr::allocUniform("u_bones", ffr::UniformType::MAT4, 196);
@@ -645,6 +651,72 @@ struct PipelineImpl final : Pipeline
 		return {(float)atlas_texture->width, (float)atlas_texture->height};
 	}
 
+	struct SkinningPalette
+	{
+		ffr::BufferHandle buffer;
+		u32 offset;
+	};
+
+
+	// bone matrices as 3x4 (transposed affine part), 48B per bone instead of 64B
+	static void writeBoneMatrix(const LocalRigidTransform& tr, float* LUMIX_RESTRICT out)
+	{
+		const Quat& q = tr.rot;
+		const float fx = q.x + q.x;
+		const float fy = q.y + q.y;
+		const float fz = q.z + q.z;
+		const float fwx = fx * q.w;
+		const float fwy = fy * q.w;
+		const float fwz = fz * q.w;
+		const float fxx = fx * q.x;
+		const float fxy = fy * q.x;
+		const float fxz = fz * q.x;
+		const float fyy = fy * q.y;
+		const float fyz = fz * q.y;
+		const float fzz = fz * q.z;
+
+		out[0] = 1.0f - (fyy + fzz); out[1] = fxy - fwz; out[2] = fxz + fwy; out[3] = tr.pos.x;
+		out[4] = fxy + fwz; out[5] = 1.0f - (fxx + fzz); out[6] = fyz - fwx; out[7] = tr.pos.y;
+		out[8] = fxz - fwy; out[9] = fyz + fwx; out[10] = 1.0f - (fxx + fyy); out[11] = tr.pos.z;
+	}
+
+
+	// bone matrices of an instance are computed once per frame and shared by all its meshes and all views (main, shadows, ...) of this pipeline,
+	// called from command creation jobs
+	SkinningPalette getSkinningPalette(EntityRef entity, const ModelInstance& mi)
+	{
+		{
+			MT::CriticalSectionLock lock(m_skinning_mutex);
+			auto iter = m_skinning_palettes.find(entity.index);
+			if (iter.isValid()) return iter.value();
+		}
+
+		PROFILE_FUNCTION();
+		const Pose& pose = *mi.pose;
+		const Renderer::TransientSlice slice = m_renderer.allocTransient(pose.count * BONE_MATRIX_SIZE + 256);
+		const u32 align = (256 - slice.offset % 256) % 256;
+		SkinningPalette palette;
+		palette.buffer = slice.buffer;
+		palette.offset = slice.offset + align;
+
+		if (slice.ptr) {
+			float* out = (float*)(slice.ptr + align);
+			const Model& model = *mi.model;
+			for (int j = 0; j < pose.count; ++j) {
+				const LocalRigidTransform tmp = {pose.positions[j], pose.rotations[j]};
+				writeBoneMatrix(tmp * model.getBone(j).inv_bind_transform, out + j * 12);
+			}
+		}
+
+		MT::CriticalSectionLock lock(m_skinning_mutex);
+		// another view might have computed it in the meantime, keep the first one
+		auto iter = m_skinning_palettes.find(entity.index);
+		if (iter.isValid()) return iter.value();
+		m_skinning_palettes.insert(entity.index, palette);
+		return palette;
+	}
+
+
 	bool render(bool only_2d) override 
 	{ 
 		PROFILE_FUNCTION();
@@ -660,6 +732,7 @@ struct PipelineImpl final : Pipeline
 
 		m_stats = {};
 		clearBuffers();
+		m_skinning_palettes.clear();
 
 		{
 			PROFILE_BLOCK("destroy renderbuffers");
@@ -718,7 +791,7 @@ struct PipelineImpl final : Pipeline
 			PassState pass_state;
 		};
 
-		StartFrameCmd* start_frame_cmd = LUMIX_NEW(m_renderer.getAllocator(), StartFrameCmd);
+		StartFrameCmd* start_frame_cmd = LUMIX_NEW(m_renderer.getEngine().getFrameAllocator(), StartFrameCmd);
 		start_frame_cmd->global_state = global_state;
 		start_frame_cmd->global_state_buffer = m_global_state_buffer;
 		start_frame_cmd->pass_state_buffer = m_pass_state_buffer;
@@ -801,7 +874,7 @@ struct PipelineImpl final : Pipeline
 		const Array<DebugTriangle>& tris = m_scene->getDebugTriangles();
 		if (tris.empty() || !m_debug_shape_shader->isReady()) return;
 
-		IAllocator& allocator = m_renderer.getAllocator();
+		IAllocator& allocator = m_renderer.getEngine().getFrameAllocator();
 		Cmd* cmd = LUMIX_NEW(allocator, Cmd);
 		cmd->pipeline = this;
 		cmd->viewport_pos = m_viewport.pos;
@@ -866,7 +939,7 @@ struct PipelineImpl final : Pipeline
 		const Array<DebugLine>& lines = m_scene->getDebugLines();
 		if (lines.empty() || !m_debug_shape_shader->isReady()) return;
 
-		IAllocator& allocator = m_renderer.getAllocator();
+		IAllocator& allocator = m_renderer.getEngine().getFrameAllocator();
 		Cmd* cmd = LUMIX_NEW(allocator, Cmd);
 		cmd->pipeline = this;
 		cmd->viewport_pos = m_viewport.pos;
@@ -985,7 +1058,7 @@ struct PipelineImpl final : Pipeline
 		};
 
 		const Texture* atlas_texture = m_renderer.getFontManager().getAtlasTexture();
-		IAllocator& allocator = m_renderer.getAllocator();
+		IAllocator& allocator = m_renderer.getEngine().getFrameAllocator();
 		Cmd* cmd = LUMIX_NEW(allocator, Cmd)(allocator);
 		cmd->pipeline = this;
 		cmd->atlas_texture = atlas_texture->handle;
@@ -1082,7 +1155,7 @@ struct PipelineImpl final : Pipeline
 
 		const CameraParams cp = checkCameraParams(L, 1);
 		
-		IAllocator& allocator = pipeline->m_renderer.getAllocator();
+		IAllocator& allocator = pipeline->m_renderer.getEngine().getFrameAllocator();
 		RenderTerrainsCommand* cmd = LUMIX_NEW(allocator, RenderTerrainsCommand)(allocator);
 
 		if (lua_gettop(L) > 1 && lua_istable(L, 2)) {
@@ -1090,21 +1163,21 @@ struct PipelineImpl final : Pipeline
 			while (lua_next(L, 2) != 0) {
 				if(lua_type(L, -1) != LUA_TNUMBER) {
 					logError("Renderer") << "Incorrect global textures arguments of renderTerrains";
-					LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+					LUMIX_DELETE(allocator, cmd);
 					lua_pop(L, 2);
 					return 0;
 				}
 
 				if(lua_type(L, -2) != LUA_TSTRING) {
 					logError("Renderer") << "Incorrect global textures arguments of renderTerrains";
-					LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+					LUMIX_DELETE(allocator, cmd);
 					lua_pop(L, 2);
 					return 0;
 				}
 			
 				if (cmd->m_global_textures_count > lengthOf(cmd->m_global_textures)) {
 					logError("Renderer") << "Too many textures in renderTerrains call";
-					LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+					LUMIX_DELETE(allocator, cmd);
 					lua_pop(L, 2);
 					return 0;
 				}
@@ -1232,7 +1305,7 @@ struct PipelineImpl final : Pipeline
 			u32 m_size;
 		};
 
-		Cmd* cmd = LUMIX_NEW(pipeline->m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(pipeline->m_renderer.getEngine().getFrameAllocator(), Cmd);
 		cmd->m_pipeline = pipeline;
 		cmd->m_camera_params = cp;
 
@@ -1353,7 +1426,7 @@ struct PipelineImpl final : Pipeline
 
 		const int offset = lua_gettop(L) > 1 ? LuaWrapper::checkArg<int>(L, 2) : 0;
 
-		Cmd* cmd = LUMIX_NEW(pipeline->m_renderer.getAllocator(), Cmd);
+		Cmd* cmd = LUMIX_NEW(pipeline->m_renderer.getEngine().getFrameAllocator(), Cmd);
 		cmd->m_offset = offset;
 		
 		
@@ -1361,12 +1434,12 @@ struct PipelineImpl final : Pipeline
 		for(int i = 0; i < len; ++i) {
 			lua_rawgeti(L, 1, i + 1);
 			if(lua_type(L, -1) != LUA_TNUMBER) {
-				LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+				LUMIX_DELETE(pipeline->m_renderer.getEngine().getFrameAllocator(), cmd);
 				return luaL_error(L, "%s", "Incorrect texture arguments of bindTextures");
 			}
 
 			if (cmd->m_textures_count > lengthOf(cmd->m_textures_handles)) {
-				LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+				LUMIX_DELETE(pipeline->m_renderer.getEngine().getFrameAllocator(), cmd);
 				return luaL_error(L, "%s", "Too many texture in bindTextures call");
 			}
 
@@ -1470,7 +1543,7 @@ struct PipelineImpl final : Pipeline
 		};
 
 		if(shader->isReady()) {
-			IAllocator& allocator = pipeline->m_renderer.getAllocator();
+			IAllocator& allocator = pipeline->m_renderer.getEngine().getFrameAllocator();
 			Cmd* cmd = LUMIX_NEW(allocator, Cmd)(allocator);
 			cmd->m_pipeline = pipeline;
 			cmd->m_shader = shader->m_render_data;
@@ -1507,7 +1580,7 @@ struct PipelineImpl final : Pipeline
 		}
 		PipelineImpl* pipeline = LuaWrapper::toType<PipelineImpl*>(L, pipeline_idx);
 		const CameraParams cp = checkCameraParams(L, 1);
-		PushPassStateCmd* cmd = LUMIX_NEW(pipeline->m_renderer.getAllocator(), PushPassStateCmd);
+		PushPassStateCmd* cmd = LUMIX_NEW(pipeline->m_renderer.getEngine().getFrameAllocator(), PushPassStateCmd);
 		cmd->pass_state.view = cp.view;
 		cmd->pass_state.projection = cp.projection;
 		cmd->pass_state.inv_projection = cp.projection.inverted();
@@ -1533,7 +1606,7 @@ struct PipelineImpl final : Pipeline
 		LuaWrapper::checkTableArg(L, 1);
 		const CameraParams cp = checkCameraParams(L, 1);
 
-		IAllocator& allocator = pipeline->m_renderer.getAllocator();
+		IAllocator& allocator = pipeline->m_renderer.getEngine().getFrameAllocator();
 		PageAllocator& page_allocator = pipeline->m_renderer.getEngine().getPageAllocator();
 		PrepareCommandsRenderJob* cmd = LUMIX_NEW(allocator, PrepareCommandsRenderJob)(allocator, page_allocator);
 
@@ -1666,18 +1739,18 @@ struct PipelineImpl final : Pipeline
 		}
 		if (!shader->isReady()) return 0;
 
-		Cmd* cmd = LUMIX_NEW(pipeline->m_renderer.getAllocator(), Cmd);
+		Cmd* cmd = LUMIX_NEW(pipeline->m_renderer.getEngine().getFrameAllocator(), Cmd);
 		if(lua_gettop(L) > 3) {
 			const int len = (int)lua_objlen(L, 4);
 			for(int i = 0; i < len; ++i) {
 				lua_rawgeti(L, 4, i + 1);
 				if(lua_type(L, -1) != LUA_TNUMBER) {
-					LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+					LUMIX_DELETE(pipeline->m_renderer.getEngine().getFrameAllocator(), cmd);
 					return luaL_error(L, "%s", "Incorrect texture arguments of drawArrays");
 				}
 
 				if (cmd->m_textures_count > lengthOf(cmd->m_textures_handles)) {
-					LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+					LUMIX_DELETE(pipeline->m_renderer.getEngine().getFrameAllocator(), cmd);
 					return luaL_error(L, "%s", "Too many texture in drawArray call");
 				}
 
@@ -1691,12 +1764,12 @@ struct PipelineImpl final : Pipeline
 				lua_pushnil(L);
 				while (lua_next(L, 5) != 0) {
 					if(lua_type(L, -1) != LUA_TTABLE) {
-						LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+						LUMIX_DELETE(pipeline->m_renderer.getEngine().getFrameAllocator(), cmd);
 						return luaL_error(L, "%s", "Incorrect uniform arguments of drawArrays");
 					}
 
 					if(lua_type(L, -2) != LUA_TSTRING) {
-						LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+						LUMIX_DELETE(pipeline->m_renderer.getEngine().getFrameAllocator(), cmd);
 						return luaL_error(L, "%s", "Incorrect uniform arguments of drawArrays");
 					}
 
@@ -1706,7 +1779,7 @@ struct PipelineImpl final : Pipeline
 					for(int i = 0; i < 4; ++i) {
 						lua_rawgeti(L, -1, 1 + i);
 						if (lua_type(L, -1) != LUA_TNUMBER) {
-							LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+							LUMIX_DELETE(pipeline->m_renderer.getEngine().getFrameAllocator(), cmd);
 							return luaL_error(L, "%s", "Incorrect uniform arguments of drawArrays. Uniforms can only be Vec4.");
 						}
 						value[i] = (float)lua_tonumber(L, -1);
@@ -1726,7 +1799,7 @@ struct PipelineImpl final : Pipeline
 				lua_pushnil(L);
 				while (lua_next(L, 6) != 0) {
 					if(lua_type(L, -1) != LUA_TSTRING) {
-						LUMIX_DELETE(pipeline->m_renderer.getAllocator(), cmd);
+						LUMIX_DELETE(pipeline->m_renderer.getEngine().getFrameAllocator(), cmd);
 						return luaL_error(L, "%s", "Incorrect uniform arguments of drawArrays");
 					}
 					const char* define = lua_tostring(L, -1);
@@ -1968,7 +2041,7 @@ struct PipelineImpl final : Pipeline
 
 
 		Texture* atlas = m_renderer.getFontManager().getAtlasTexture();
-		IAllocator& allocator = m_renderer.getAllocator();
+		IAllocator& allocator = m_renderer.getEngine().getFrameAllocator();
 		RenderJob* job = LUMIX_NEW(allocator, RenderJob);
 		job->m_pipeline = this;
 		job->m_atlas = atlas ? atlas->handle : ffr::INVALID_TEXTURE;
@@ -2066,7 +2139,7 @@ struct PipelineImpl final : Pipeline
 
 		if(!shader) return;
 
-		RenderJob* job = LUMIX_NEW(m_renderer.getAllocator(), RenderJob);
+		RenderJob* job = LUMIX_NEW(m_renderer.getEngine().getFrameAllocator(), RenderJob);
 		job->m_define_mask = define[0] ? 1 << m_renderer.getShaderDefineIdx(define) : 0;
 		job->m_pipeline = this;
 		job->m_cmds = cmds;
@@ -2214,7 +2287,7 @@ struct PipelineImpl final : Pipeline
 								
 									ffr::useProgram(prog);
 
-									const int bones_size = bones_count * sizeof(Matrix);
+									const int bones_size = bones_count * BONE_MATRIX_SIZE;
 									ffr::bindUniformBuffer(2, buffer, offset, bones_size);
 
 									ffr::bindVAO(mesh->vao);
@@ -2317,7 +2390,7 @@ struct PipelineImpl final : Pipeline
 		CmdPage* cmd_page = LuaWrapper::checkArg<CmdPage*>(L, 1);
 		LuaWrapper::checkTableArg(L, 2);
 
-		RenderJob* job = LUMIX_NEW(pipeline->m_renderer.getAllocator(), RenderJob);
+		RenderJob* job = LUMIX_NEW(pipeline->m_renderer.getEngine().getFrameAllocator(), RenderJob);
 
 		char tmp[64];
 		if (LuaWrapper::getOptionalStringField(L, 2, "define", Span(tmp))) {
@@ -2387,7 +2460,7 @@ struct PipelineImpl final : Pipeline
 			u32 h;
 		};
 
-		Cmd* cmd = LUMIX_NEW(pipeline->m_renderer.getAllocator(), Cmd);
+		Cmd* cmd = LUMIX_NEW(pipeline->m_renderer.getEngine().getFrameAllocator(), Cmd);
 		for(int i = 0; i < rb_count; ++i) {
 			const int rb_idx = LuaWrapper::checkArg<int>(L, i + 1);
 			cmd->rbs[i] = pipeline->m_renderbuffers[rb_idx].handle;
@@ -2459,9 +2532,9 @@ struct PipelineImpl final : Pipeline
 
 				ffr::setState(state);
 				const int loc = ffr::getUniformLocation(p, m_pipeline->m_lod_uniform);
-				const int loc2 = ffr::getUniformLocation(p, ffr::allocUniform("u_from_to", ffr::UniformType::IVEC4, 1));
+				const int loc2 = ffr::getUniformLocation(p, m_pipeline->m_from_to_uniform);
 				const int loc3 = ffr::getUniformLocation(p, m_pipeline->m_terrain_scale_uniform);
-				const int loc4 = ffr::getUniformLocation(p, ffr::allocUniform("u_from_to_sup", ffr::UniformType::IVEC4, 1));
+				const int loc4 = ffr::getUniformLocation(p, m_pipeline->m_from_to_sup_uniform);
 				IVec4 prev_from_to;
 				for (int i = 0; ; ++i) {
 					const int s = 1 << i;
@@ -2561,8 +2634,9 @@ struct PipelineImpl final : Pipeline
 				RADIXSORT_BIT_MASK = RADIXSORT_HISTOGRAM_SIZE - 1
 			};
 
-			Array<u64> tmp_keys(m_allocator); // TODO more suitable allocator
-			Array<u64> tmp_values(m_allocator);
+			IAllocator& allocator = m_pipeline->m_renderer.getEngine().getFrameAllocator();
+			Array<u64> tmp_keys(allocator);
+			Array<u64> tmp_values(allocator);
 			tmp_keys.resize(size);
 			tmp_values.resize(size);
 
@@ -2734,21 +2808,9 @@ struct PipelineImpl final : Pipeline
 							WRITE(tr.scale);
 							WRITE(mi->pose->count);
 
-							const Renderer::TransientSlice slice = renderer.allocTransient(mi->pose->count * sizeof(Matrix) + 256);
-							WRITE(slice.buffer);
-							u32 align = 256 - slice.offset % 256; 
-							u32 offset = slice.offset + align;
-							WRITE(offset);
-							const Quat* rotations = mi->pose->rotations;
-							const Vec3* positions = mi->pose->positions;
-
-							Model& model = *mi->model;
-							for (int j = 0, c = mi->pose->count; j < c; ++j) {
-								const Model::Bone& bone = model.getBone(j);
-								const LocalRigidTransform tmp = {positions[j], rotations[j]};
-								Matrix m = (tmp * bone.inv_bind_transform).toMatrix();
-								memcpy(slice.ptr + align + sizeof(Matrix) * j, &m, sizeof(Matrix));
-							}
+							const PipelineImpl::SkinningPalette palette = ctx->cmd->m_pipeline->getSkinningPalette(e, *mi);
+							WRITE(palette.buffer);
+							WRITE(palette.offset);
 							break;
 						}
 						case RenderableTypes::DECAL: {
@@ -3124,7 +3186,7 @@ struct PipelineImpl final : Pipeline
 			u32 flags;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_renderer.getAllocator(), Cmd);
+		Cmd* cmd = LUMIX_NEW(m_renderer.getEngine().getFrameAllocator(), Cmd);
 		cmd->color.set(r, g, b, a);
 		cmd->flags = flags;
 		cmd->depth = depth;
@@ -3143,7 +3205,7 @@ struct PipelineImpl final : Pipeline
 			int x, y, w, h;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_renderer.getAllocator(), Cmd);
+		Cmd* cmd = LUMIX_NEW(m_renderer.getEngine().getFrameAllocator(), Cmd);
 		cmd->x = x;
 		cmd->y = y;
 		cmd->w = w;
@@ -3168,7 +3230,7 @@ struct PipelineImpl final : Pipeline
 			Renderer* renderer;
 			i64 profiler_link;
 		};
-		Cmd* cmd = LUMIX_NEW(m_renderer.getAllocator(), Cmd);
+		Cmd* cmd = LUMIX_NEW(m_renderer.getEngine().getFrameAllocator(), Cmd);
 		cmd->name = name;
 		cmd->renderer = &m_renderer;
 		m_profiler_link = Profiler::createNewLinkID();
@@ -3190,7 +3252,7 @@ struct PipelineImpl final : Pipeline
 			}
 			Renderer* renderer;
 		};
-		Cmd* cmd = LUMIX_NEW(m_renderer.getAllocator(), Cmd);
+		Cmd* cmd = LUMIX_NEW(m_renderer.getEngine().getFrameAllocator(), Cmd);
 		cmd->renderer = &m_renderer;
 		m_renderer.queue(cmd, m_profiler_link);
 		m_profiler_link = 0;
@@ -3400,6 +3462,8 @@ struct PipelineImpl final : Pipeline
 	ffr::UniformHandle m_terrain_params_uniform;
 	ffr::UniformHandle m_rel_camera_pos_uniform;
 	ffr::UniformHandle m_terrain_scale_uniform;
+	ffr::UniformHandle m_from_to_uniform;
+	ffr::UniformHandle m_from_to_sup_uniform;
 	ffr::UniformHandle m_terrain_matrix_uniform;
 	ffr::UniformHandle m_model_uniform;
 	ffr::UniformHandle m_bones_uniform;
@@ -3411,6 +3475,8 @@ struct PipelineImpl final : Pipeline
 	ffr::UniformHandle m_material_color_uniform;
 	ffr::BufferHandle m_cube_vb;
 	ffr::BufferHandle m_cube_ib;
+	HashMap<u32, SkinningPalette> m_skinning_palettes;
+	MT::CriticalSection m_skinning_mutex;
 };
 
 
@@ -10,6 +10,7 @@
 #include "engine/log.h"
 #include "engine/lua_wrapper.h"
 #include "engine/math.h"
+#include "engine/mt/atomic.h"
 #include "engine/os.h"
 #include "engine/page_allocator.h"
 #include "engine/plugin_manager.h"
@@ -20,6 +21,7 @@
 #include "engine/stream.h"
 #include "engine/universe/universe.h"
 #include "lua_script/lua_script_system.h"
+#include "renderer/bvh.h"
 #include "renderer/culling_system.h"
 #include "renderer/font.h"
 #include "renderer/material.h"
@@ -249,6 +251,7 @@ public:
 			}
 		}
 		m_model_instances.clear();
+		m_raycast_bvh.clear();
 		for(auto iter = m_model_entity_map.begin(), end = m_model_entity_map.end(); iter != end; ++iter) {
 			Model* model = iter.key();
 			model->getObserverCb().unbind<RenderSceneImpl, &RenderSceneImpl::modelStateChanged>(this);
@@ -537,6 +540,20 @@ public:
 	}
 
 
+	int getAttachedBonesCount(EntityRef entity) override
+	{
+		if (entity.index >= m_model_instances.size()) return 0;
+		if (!m_model_instances[entity.index].flags.isSet(ModelInstance::IS_BONE_ATTACHMENT_PARENT)) return 0;
+
+		int count = 0;
+		for (const BoneAttachment& ba : m_bone_attachments)
+		{
+			if (ba.parent_entity == entity) count = maximum(count, ba.bone_index + 1);
+		}
+		return count;
+	}
+
+
 	void setBoneAttachmentBone(EntityRef entity, int value) override
 	{
 		BoneAttachment& ba = m_bone_attachments[entity];
@@ -580,7 +597,7 @@ public:
 		{
 			for (auto* emitter : m_particle_emitters)
 			{
-				emitter->update(dt);
+				emitter->update(dt, m_engine.getFrameAllocator());
 			}
 		}
 	}
@@ -1707,6 +1724,11 @@ public:
 			if (m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) {
 				const DVec3 position = m_universe.getPosition(entity);
 				m_culling_system->setPosition(entity, position);
+				if (m_raycast_bvh.isAdded(entity)) {
+					DVec3 min, max;
+					getModelInstanceBounds(entity, &min, &max);
+					m_raycast_bvh.move(entity, min, max);
+				}
 			}
 			else if (m_universe.hasComponent(entity, DECAL_TYPE)) {
 				auto iter = m_decals.find(entity);
@@ -1762,6 +1784,22 @@ public:
 	}
 
 
+	EntityPtr getFirstCamera() override
+	{
+		if (m_cameras.empty()) return INVALID_ENTITY;
+		return m_cameras.begin().key();
+	}
+
+
+	EntityPtr getNextCamera(EntityRef entity) override
+	{
+		auto iter = m_cameras.find(entity);
+		++iter;
+		if (!iter.isValid()) return INVALID_ENTITY;
+		return iter.key();
+	}
+
+
 	EntityPtr getFirstTerrain() override
 	{
 		if (m_terrains.empty()) return INVALID_ENTITY;
@@ -1791,6 +1829,18 @@ public:
 	}
 
 
+	void getTerrainHeightsAt(EntityRef entity, Span<const Vec2> xz, Span<float> heights) override
+	{
+		m_terrains[entity]->getHeights(xz, heights);
+	}
+
+
+	void getTerrainNormalsAt(EntityRef entity, Span<const Vec2> xz, Span<Vec3> normals) override
+	{
+		m_terrains[entity]->getNormals(xz, normals);
+	}
+
+
 	AABB getTerrainAABB(EntityRef entity) override
 	{
 		return m_terrains[entity]->getAABB();
@@ -1950,10 +2000,16 @@ public:
 				const RenderableTypes type = getRenderableType(*model_instance.model);
 				m_culling_system->add(entity, (u8)type, pos, radius);
 			}
+			if (!m_raycast_bvh.isAdded(entity)) {
+				DVec3 min, max;
+				getModelInstanceBounds(entity, &min, &max);
+				m_raycast_bvh.add(entity, min, max);
+			}
 		}
 		else
 		{
 			m_culling_system->remove(entity);
+			m_raycast_bvh.remove(entity);
 		}
 	}
 
@@ -2839,6 +2895,33 @@ bgfx::TextureHandle& handle = pipeline->getRenderbuffer(framebuffer_name, render
 	}
 
 
+	void getModelInstanceBounds(EntityRef entity, DVec3* min, DVec3* max) const
+	{
+		const ModelInstance& r = m_model_instances[entity.index];
+		const Transform tr = m_universe.getTransform(entity);
+		if (r.model->getBoneCount() > 0) {
+			// animated vertices can leave the bind pose AABB, bounding sphere is safe
+			const float radius = r.model->getBoundingRadius() * tr.scale;
+			*min = tr.pos - Vec3(radius);
+			*max = tr.pos + Vec3(radius);
+			return;
+		}
+
+		const AABB& aabb = r.model->getAABB();
+		const Vec3 center = tr.rot.rotate((aabb.min + aabb.max) * (0.5f * tr.scale));
+		const Vec3 half = (aabb.max - aabb.min) * (0.5f * tr.scale);
+		const Vec3 x = tr.rot.rotate(Vec3(half.x, 0, 0));
+		const Vec3 y = tr.rot.rotate(Vec3(0, half.y, 0));
+		const Vec3 z = tr.rot.rotate(Vec3(0, 0, half.z));
+		const Vec3 extents(
+			fabsf(x.x) + fabsf(y.x) + fabsf(z.x),
+			fabsf(x.y) + fabsf(y.y) + fabsf(z.y),
+			fabsf(x.z) + fabsf(y.z) + fabsf(z.z));
+		*min = tr.pos + (center - extents);
+		*max = tr.pos + (center + extents);
+	}
+
+
 	RayCastModelHit castRay(const DVec3& origin, const Vec3& dir, EntityPtr ignored_model_instance) override
 	{
 		PROFILE_FUNCTION();
@@ -2846,34 +2929,27 @@ bgfx::TextureHandle& handle = pipeline->getRenderbuffer(framebuffer_name, render
 		hit.is_hit = false;
 		hit.origin = origin;
 		hit.dir = dir;
-		double cur_dist = DBL_MAX;
 		const Universe& universe = getUniverse();
-		for (int i = 0; i < m_model_instances.size(); ++i) {
-			auto& r = m_model_instances[i];
-			if (ignored_model_instance.index == i || !r.model) continue;
-			if (!r.flags.isSet(ModelInstance::ENABLED)) continue;
-
-			const EntityRef entity = (EntityRef)r.entity;
-			const DVec3& pos = universe.getPosition(entity);
-			float scale = universe.getScale(entity);
-			float radius = r.model->getBoundingRadius() * scale;
-			const double dist = (pos - origin).length();
-			if (dist - radius > cur_dist) continue;
-			
-			Vec3 intersection;
-			const Vec3 rel_pos = (origin - pos).toFloat();
-			if (getRaySphereIntersection(rel_pos, dir, Vec3::ZERO, radius, intersection)) {
-				RayCastModelHit new_hit = r.model->castRay(rel_pos / scale, dir, r.pose);
-				if (new_hit.is_hit && (!hit.is_hit || new_hit.t * scale < hit.t)) {
-					new_hit.entity = entity;
-					new_hit.component_type = MODEL_INSTANCE_TYPE;
-					hit = new_hit;
-					hit.t *= scale;
-					hit.is_hit = true;
-					cur_dist = dir.length() * hit.t;
-				}
-			}
-		}
+
+		auto cast_model = [&](EntityRef entity, float max_t) -> float {
+			const ModelInstance& r = m_model_instances[entity.index];
+			if (ignored_model_instance == entity || !r.model) return max_t;
+
+			const Transform tr = universe.getTransform(entity);
+			const Quat inv_rot = tr.rot.conjugated();
+			const Vec3 rel_pos = inv_rot.rotate((origin - tr.pos).toFloat()) / tr.scale;
+			const Vec3 rel_dir = inv_rot.rotate(dir);
+			RayCastModelHit new_hit = r.model->castRay(rel_pos, rel_dir, r.pose);
+			if (!new_hit.is_hit || new_hit.t * tr.scale >= max_t) return max_t;
+
+			hit.is_hit = true;
+			hit.t = new_hit.t * tr.scale;
+			hit.mesh = new_hit.mesh;
+			hit.entity = entity;
+			hit.component_type = MODEL_INSTANCE_TYPE;
+			return hit.t;
+		};
+		m_raycast_bvh.castRay(origin, dir, FLT_MAX, cast_model);
 
 		for (auto* terrain : m_terrains) {
 			RayCastModelHit terrain_hit = terrain->castRay(origin, dir);
@@ -2888,6 +2964,33 @@ bgfx::TextureHandle& handle = pipeline->getRenderbuffer(framebuffer_name, render
 		return hit;
 	}
 
+
+	void castRays(Span<const DVec3> origins, Span<const Vec3> dirs, Span<RayCastModelHit> hits, EntityPtr ignored_model_instance) override
+	{
+		PROFILE_FUNCTION();
+		ASSERT(origins.length() == dirs.length() && origins.length() == hits.length());
+		enum { RAYS_PER_JOB = 16 };
+
+		const u32 count = origins.length();
+		if (count <= RAYS_PER_JOB) {
+			for (u32 i = 0; i < count; ++i) {
+				hits[i] = castRay(origins[i], dirs[i], ignored_model_instance);
+			}
+			return;
+		}
+
+		// scene and models are only read here, BVHs of models are built under a lock
+		auto cast_batch = [&](int batch) {
+			PROFILE_BLOCK("cast rays batch");
+			const u32 from = batch * RAYS_PER_JOB;
+			const u32 to = minimum(from + RAYS_PER_JOB, count);
+			for (u32 i = from; i < to; ++i) {
+				hits[i] = castRay(origins[i], dirs[i], ignored_model_instance);
+			}
+		};
+		JobSystem::forEach((count + RAYS_PER_JOB - 1) / RAYS_PER_JOB, cast_batch);
+	}
+
 	
 	Vec4 getShadowmapCascades(EntityRef entity) override
 	{
@@ -3083,6 +3186,7 @@ bgfx::TextureHandle& handle = pipeline->getRenderbuffer(framebuffer_name, render
 		r.pose = nullptr;
 
 		m_culling_system->remove(entity);
+		m_raycast_bvh.remove(entity);
 	}
 
 
@@ -3099,6 +3203,9 @@ bgfx::TextureHandle& handle = pipeline->getRenderbuffer(framebuffer_name, render
 		if(r.flags.isSet(ModelInstance::ENABLED)) {
 			const RenderableTypes type = getRenderableType(*model);
 			m_culling_system->add(entity, (u8)type, pos, radius);
+			DVec3 min, max;
+			getModelInstanceBounds(entity, &min, &max);
+			m_raycast_bvh.add(entity, min, max);
 		}
 		ASSERT(!r.pose);
 		if (model->getBoneCount() > 0)
@@ -3243,6 +3350,7 @@ bgfx::TextureHandle& handle = pipeline->getRenderbuffer(framebuffer_name, render
 			if (old_model->isReady())
 			{
 				m_culling_system->remove(entity);
+				m_raycast_bvh.remove(entity);
 			}
 			old_model->getResourceManager().unload(*old_model);
 		}
@@ -3412,6 +3520,7 @@ private:
 	HashMap<EntityRef, Decal> m_decals;
 	Array<ModelInstance> m_model_instances;
 	Array<MeshSortData> m_mesh_sort_data;
+	DynamicBVH m_raycast_bvh;
 	HashMap<EntityRef, Environment> m_environments;
 	HashMap<EntityRef, Camera> m_cameras;
 	EntityPtr m_active_camera;
@@ -3497,6 +3606,7 @@ RenderSceneImpl::RenderSceneImpl(Renderer& renderer,
 	, m_is_updating_attachments(false)
 	, m_material_decal_map(m_allocator)
 	, m_mesh_sort_data(m_allocator)
+	, m_raycast_bvh(m_allocator)
 {
 
 	m_universe.entityTransformed().bind<RenderSceneImpl, &RenderSceneImpl::onEntityMoved>(this);
@@ -204,10 +204,13 @@ public:
 	static void registerLuaAPI(lua_State* L);
 
 	virtual RayCastModelHit castRay(const DVec3& origin, const Vec3& dir, EntityPtr ignore) = 0;
+	virtual void castRays(Span<const DVec3> origins, Span<const Vec3> dirs, Span<RayCastModelHit> hits, EntityPtr ignore) = 0;
 	virtual RayCastModelHit castRayTerrain(EntityRef entity, const DVec3& origin, const Vec3& dir) = 0;
 	virtual void getRay(EntityRef entity, const Vec2& screen_pos, DVec3& origin, Vec3& dir) = 0;
 
 	virtual EntityPtr getActiveCamera() const = 0;
+	virtual EntityPtr getFirstCamera() = 0;
+	virtual EntityPtr getNextCamera(EntityRef entity) = 0;
 	virtual	struct Viewport getCameraViewport(EntityRef camera) const = 0;
 	virtual float getCameraLODMultiplier(float fov, bool is_ortho) const = 0;
 	virtual float getCameraLODMultiplier(EntityRef entity) const = 0;
@@ -249,6 +252,8 @@ public:
 	virtual Vec3 getBoneAttachmentRotation(EntityRef entity) = 0;
 	virtual void setBoneAttachmentRotation(EntityRef entity, const Vec3& rot) = 0;
 	virtual void setBoneAttachmentRotationQuat(EntityRef entity, const Quat& rot) = 0;
+	// number of bones of the entity's pose which must be kept up to date for its bone attachments
+	virtual int getAttachedBonesCount(EntityRef entity) = 0;
 
 	virtual void clearDebugLines() = 0;
 	virtual void clearDebugTriangles() = 0;
@@ -291,6 +296,8 @@ public:
 	virtual void getTerrainInfos(const ShiftedFrustum& frustum, const DVec3& lod_ref_point, Array<TerrainInfo>& infos) = 0;
 	virtual float getTerrainHeightAt(EntityRef entity, float x, float z) = 0;
 	virtual Vec3 getTerrainNormalAt(EntityRef entity, float x, float z) = 0;
+	virtual void getTerrainHeightsAt(EntityRef entity, Span<const Vec2> xz, Span<float> heights) = 0;
+	virtual void getTerrainNormalsAt(EntityRef entity, Span<const Vec2> xz, Span<Vec3> normals) = 0;
 	virtual void setTerrainMaterialPath(EntityRef entity, const Path& path) = 0;
 	virtual Path getTerrainMaterialPath(EntityRef entity) = 0;
 	virtual Material* getTerrainMaterial(EntityRef entity) = 0;
@@ -1,5 +1,6 @@
 #include "renderer.h"
 
+#include "engine/allocator.h"
 #include "engine/array.h"
 #include "engine/command_line_parser.h"
 #include "engine/crc32.h"
@@ -381,7 +382,7 @@ struct RendererImpl final : public Renderer
 
 	explicit RendererImpl(Engine& engine)
 		: m_engine(engine)
-		, m_allocator(engine.getAllocator())
+		, m_allocator(engine.getAllocator(), "renderer")
 		, m_texture_manager(*this, m_allocator)
 		, m_pipeline_manager(*this, m_allocator)
 		, m_model_manager(*this, m_allocator)
@@ -545,7 +546,7 @@ struct RendererImpl final : public Renderer
 			void* buf;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->handle = texture;
 		cmd->size = size;
 		cmd->buf = data;
@@ -575,7 +576,7 @@ struct RendererImpl final : public Renderer
 			RendererImpl* renderer;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->handle = handle;
 		cmd->x = x;
 		cmd->y = y;
@@ -618,7 +619,7 @@ struct RendererImpl final : public Renderer
 			RendererImpl* renderer; 
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->debug_name = debug_name;
 		cmd->handle = handle;
 		cmd->memory = memory;
@@ -694,7 +695,7 @@ struct RendererImpl final : public Renderer
 			u32 attribs_count;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		memcpy(cmd->attribs, attribs, sizeof(attribs[0]) * attribs_count);
 		cmd->attribs_count = attribs_count;
 		cmd->handle = handle;
@@ -726,7 +727,7 @@ struct RendererImpl final : public Renderer
 			Renderer* renderer;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->handle = handle;
 		cmd->memory = memory;
 		cmd->renderer = this;
@@ -773,7 +774,7 @@ struct RendererImpl final : public Renderer
 
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->fnc = fnc;
 		cmd->ptr = user_ptr;
 		cmd->renderer = this;
@@ -794,7 +795,7 @@ struct RendererImpl final : public Renderer
 			RendererImpl* renderer;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->program = program;
 		cmd->renderer = this;
 		queue(cmd, 0);
@@ -822,7 +823,7 @@ struct RendererImpl final : public Renderer
 			RendererImpl* renderer;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->buffer = buffer;
 		cmd->renderer = this;
 		queue(cmd, 0);
@@ -854,7 +855,7 @@ struct RendererImpl final : public Renderer
 			u32 flags;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->debug_name = debug_name;
 		cmd->handle = handle;
 		cmd->memory = memory;
@@ -884,7 +885,7 @@ struct RendererImpl final : public Renderer
 			RendererImpl* renderer;
 		};
 
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		cmd->texture = tex;
 		cmd->renderer = this;
 		queue(cmd, 0);
@@ -954,7 +955,7 @@ struct RendererImpl final : public Renderer
 				ffr::startCapture();
 			}
 		};
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		queue(cmd, 0);
 	}
 
@@ -968,7 +969,7 @@ struct RendererImpl final : public Renderer
 				ffr::stopCapture();
 			}
 		};
-		Cmd* cmd = LUMIX_NEW(m_allocator, Cmd);
+		Cmd* cmd = LUMIX_NEW(m_engine.getFrameAllocator(), Cmd);
 		queue(cmd, 0);
 	}
 
@@ -989,7 +990,8 @@ struct RendererImpl final : public Renderer
 				Profiler::blockColor(0xaa, 0xff, 0xaa);
 				Profiler::link(job->profiler_link);
 				job->execute();
-				LUMIX_DELETE(m_renderer.m_allocator, job);
+				// all queued jobs are allocated from the frame allocator
+				LUMIX_DELETE(m_renderer.m_engine.getFrameAllocator(), job);
 			}
 
 			PROFILE_BLOCK("swap buffers");
@@ -1012,14 +1014,20 @@ struct RendererImpl final : public Renderer
 		i32 m_transient_size;
 	};
 
+	u32 getFrameNumber() const override { return m_frame_number; }
+
+
 	void frame() override
 	{
 		PROFILE_FUNCTION();
 		
 		JobSystem::wait(m_setup_jobs_done);
 		m_setup_jobs_done = JobSystem::INVALID_HANDLE;
+		++m_frame_number;
 		JobSystem::wait(m_prev_frame_job);
 		m_prev_frame_job = JobSystem::INVALID_HANDLE;
+		// previous frame is rendered, its part of the frame allocator can be reused for the next frame
+		m_engine.getFrameAllocator().nextFrame();
 
 		RenderFrameData* data = LUMIX_NEW(m_allocator, RenderFrameData)(*this);
 		JobSystem::runEx(data, [](void* ptr){
@@ -1032,7 +1040,7 @@ struct RendererImpl final : public Renderer
 	}
 
 	Engine& m_engine;
-	IAllocator& m_allocator;
+	TagAllocator m_allocator;
 	Array<StaticString<32>> m_shader_defines;
 	Array<StaticString<32>> m_layers;
 	HashMap<u32, VAO> m_vaos;
@@ -1048,6 +1056,7 @@ struct RendererImpl final : public Renderer
 	bool m_debug_opengl = false;
 	JobSystem::SignalHandle m_prev_frame_job = JobSystem::INVALID_HANDLE;
 	JobSystem::SignalHandle m_setup_jobs_done = JobSystem::INVALID_HANDLE;
+	u32 m_frame_number = 0;
 	Array<RenderJob*> m_cmd_queue;
 
 	ffr::FramebufferHandle m_framebuffer;
@@ -51,6 +51,8 @@ class LUMIX_RENDERER_API Renderer : public IPlugin
 		virtual void startCapture() = 0;
 		virtual void stopCapture() = 0;
 		virtual void frame() = 0;
+		// incremented by frame() once all render jobs of the previous frame finished their setup()
+		virtual u32 getFrameNumber() const = 0;
 		virtual void resize(int width, int height) = 0;
 		virtual void makeScreenshot(const Path& filename) = 0;
 		virtual u8 getShaderDefineIdx(const char* define) = 0;
@@ -77,6 +79,7 @@ class LUMIX_RENDERER_API Renderer : public IPlugin
 		virtual void getTextureImage(ffr::TextureHandle texture, int size, void* data) = 0;
 		virtual void destroy(ffr::TextureHandle tex) = 0;
 		
+		// cmd must be allocated from Engine::getFrameAllocator(), it's deleted after it's executed
 		virtual void queue(RenderJob* cmd, i64 profiler_link) = 0;
 		virtual ffr::FramebufferHandle getFramebuffer() const = 0;
 
@@ -2,6 +2,7 @@
 #include "engine/crc32.h"
 #include "engine/engine.h"
 #include "engine/geometry.h"
+#include "engine/job_system.h"
 #include "engine/log.h"
 #include "engine/math.h"
 #include "engine/profiler.h"
@@ -16,6 +17,7 @@
 #include "engine/universe/universe.h"
 #include <float.h>
 #include <math.h>
+#include <stdlib.h>
 
 
 namespace Lumix
@@ -24,6 +26,9 @@ namespace Lumix
 
 static const float GRASS_QUAD_SIZE = 10.0f;
 static const float GRASS_QUAD_RADIUS = GRASS_QUAD_SIZE * 0.7072f;
+// quads in this many rings beyond grass distance are generated before they become visible
+static const int GRASS_PREFETCH_RINGS = 1;
+static const u32 GRASS_CACHE_SIZE = 1024;
 static const ComponentType TERRAIN_HASH = Reflection::getComponentType("terrain");
 static const char* TEX_COLOR_UNIFORM = "u_detail_albedomap";
 
@@ -47,10 +52,16 @@ Terrain::Terrain(Renderer& renderer, EntityPtr entity, RenderScene& scene, IAllo
 	, m_scene(scene)
 	, m_allocator(allocator)
 	, m_grass_quads(m_allocator)
-	, m_last_camera_position(m_allocator)
+	, m_grass_quads_frame(m_allocator)
+	, m_grass_cache(m_allocator)
+	, m_grass_retired(m_allocator)
+	, m_grass_retired_frame(0)
+	, m_grass_jobs(JobSystem::INVALID_HANDLE)
+	, m_grass_frame(0)
+	, m_grass_jobs_blocked(0)
+	, m_height_tree(m_allocator)
 	, m_grass_types(m_allocator)
 	, m_renderer(renderer)
-	, m_force_grass_update(false)
 {
 }
 
@@ -65,12 +76,11 @@ Terrain::GrassType::~GrassType()
 
 Terrain::~Terrain()
 {
-	setMaterial(nullptr);
-	for (const Array<GrassQuad*>& quads : m_grass_quads) {
-		for (GrassQuad* quad : quads) {
-			LUMIX_DELETE(m_allocator, quad);
-		}
+	forceGrassUpdate();
+	for (GrassQuad* quad : m_grass_retired) {
+		LUMIX_DELETE(m_allocator, quad);
 	}
+	setMaterial(nullptr);
 }
 
 
@@ -124,8 +134,8 @@ Terrain::GrassType::RotationMode Terrain::getGrassTypeRotationMode(int index) co
 
 void Terrain::setGrassTypeRotationMode(int index, Terrain::GrassType::RotationMode mode)
 {
-	m_grass_types[index].m_rotation_mode = mode;
 	forceGrassUpdate();
+	m_grass_types[index].m_rotation_mode = mode;
 }
 
 
@@ -155,16 +165,94 @@ AABB Terrain::getAABB() const
 {
 	Vec3 min(0, 0, 0);
 	Vec3 max(m_width * m_scale.x, 0, m_height * m_scale.z);
-	for (int j = 0; j < m_height; ++j)
+	if (!m_height_tree.empty())
+	{
+		const HeightRange& root = m_height_tree.back().ranges[0];
+		min.y = root.min * m_scale.y / 65535.0f;
+		max.y = root.max * m_scale.y / 65535.0f;
+	}
+	return AABB(min, max);
+}
+
+
+void Terrain::buildHeightTree()
+{
+	PROFILE_FUNCTION();
+	m_height_tree.clear();
+	if (!m_heightmap || !m_heightmap->getData() || m_width < 2 || m_height < 2) return;
+
+	int w = m_width - 1;
+	int h = m_height - 1;
+	for (;;)
 	{
-		for (int i = 0; i < m_width; ++i)
+		HeightTreeLevel& level = m_height_tree.emplace(m_allocator);
+		level.width = w;
+		level.height = h;
+		level.ranges.resize(w * h);
+		if (w == 1 && h == 1) break;
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+	updateHeightTree(0, 0, m_width, m_height);
+}
+
+
+// recomputes ranges affected by heightmap texels in [from, to)
+void Terrain::updateHeightTree(int from_x, int from_z, int to_x, int to_z)
+{
+	if (m_height_tree.empty()) return;
+
+	const u16* data = (const u16*)m_heightmap->getData();
+	HeightTreeLevel& base = m_height_tree[0];
+	// texel is shared by the cell to the left/top and the cell it starts
+	int x0 = maximum(from_x - 1, 0);
+	int z0 = maximum(from_z - 1, 0);
+	int x1 = minimum(to_x, base.width);
+	int z1 = minimum(to_z, base.height);
+	for (int z = z0; z < z1; ++z)
+	{
+		for (int x = x0; x < x1; ++x)
 		{
-			float height = getHeight(i, j);
-			if (height > max.y) max.y = height;
+			const u16 h00 = data[x + z * m_width];
+			const u16 h10 = data[x + 1 + z * m_width];
+			const u16 h01 = data[x + (z + 1) * m_width];
+			const u16 h11 = data[x + 1 + (z + 1) * m_width];
+			HeightRange& range = base.ranges[x + z * base.width];
+			range.min = minimum(h00, h10, h01, h11);
+			range.max = maximum(h00, h10, h01, h11);
+		}
+	}
+
+	for (int i = 1; i < m_height_tree.size(); ++i)
+	{
+		const HeightTreeLevel& src = m_height_tree[i - 1];
+		HeightTreeLevel& dst = m_height_tree[i];
+		x0 >>= 1;
+		z0 >>= 1;
+		x1 = minimum((x1 + 1) >> 1, dst.width);
+		z1 = minimum((z1 + 1) >> 1, dst.height);
+		for (int z = z0; z < z1; ++z)
+		{
+			for (int x = x0; x < x1; ++x)
+			{
+				HeightRange range = src.ranges[x * 2 + z * 2 * src.width];
+				const int sx = minimum(x * 2 + 1, src.width - 1);
+				const int sz = minimum(z * 2 + 1, src.height - 1);
+				const HeightRange& r10 = src.ranges[sx + z * 2 * src.width];
+				const HeightRange& r01 = src.ranges[x * 2 + sz * src.width];
+				const HeightRange& r11 = src.ranges[sx + sz * src.width];
+				range.min = minimum(range.min, r10.min, r01.min, r11.min);
+				range.max = maximum(range.max, r10.max, r01.max, r11.max);
+				dst.ranges[x + z * dst.width] = range;
+			}
 		}
 	}
-			
-	return AABB(min, max);
+}
+
+
+void Terrain::onHeightmapChanged(int x, int z, int w, int h)
+{
+	updateHeightTree(x, z, x + w, z + h);
 }
 
 
@@ -197,25 +285,91 @@ void Terrain::setGrassTypePath(int index, const Path& path)
 }
 	
 
+// waits for generating jobs, since they read grass types, heightmap and splatmap, which the caller is about to change
 void Terrain::forceGrassUpdate()
 {
-	m_force_grass_update = true;
-	for (Array<GrassQuad*>& quads : m_grass_quads) {
-		for (GrassQuad* quad : quads) {
-			LUMIX_DELETE(m_allocator, quad);
-		}
-		quads.clear();
+	beginDataUpdate();
+	endDataUpdate();
+}
+
+
+// no new grass jobs can start until endDataUpdate; m_grass_mutex is not held while waiting,
+// the waiting fiber can resume on another worker and render jobs run by this worker lock it in updateGrass
+void Terrain::beginDataUpdate()
+{
+	JobSystem::SignalHandle jobs;
+	{
+		MT::CriticalSectionLock lock(m_grass_mutex);
+		++m_grass_jobs_blocked;
+		jobs = m_grass_jobs;
+	}
+	JobSystem::wait(jobs);
+}
+
+
+void Terrain::endDataUpdate()
+{
+	MT::CriticalSectionLock lock(m_grass_mutex);
+	retireGrassQuads();
+	--m_grass_jobs_blocked;
+}
+
+
+// must be called with m_grass_mutex locked and no generating jobs running, i.e. between beginDataUpdate and endDataUpdate
+void Terrain::retireGrassQuads()
+{
+	for (GrassQuad* quad : m_grass_cache) {
+		m_grass_retired.push(quad);
+	}
+	m_grass_cache.clear();
+	m_grass_retired_frame = m_renderer.getFrameNumber();
+}
+
+
+// render jobs of the frame quads were retired in are finished once the renderer frame number changes
+void Terrain::deleteRetiredGrassQuads()
+{
+	if (m_grass_retired.empty() || m_grass_retired_frame == m_grass_frame) return;
+
+	// views not updated in this frame have no readers, their next update rebuilds them anyway
+	for (int i = 0; i < m_grass_quads.size(); ++i) {
+		if (m_grass_quads_frame[i] != m_grass_frame) m_grass_quads[i].clear();
+	}
+	for (GrassQuad* quad : m_grass_retired) {
+		LUMIX_DELETE(m_allocator, quad);
 	}
+	m_grass_retired.clear();
 }
 
+
 Array<Terrain::GrassQuad*>& Terrain::getQuads(int view)
 {
-	while (view >= m_grass_quads.size()) m_grass_quads.emplace(m_allocator);
+	while (view >= m_grass_quads.size()) {
+		m_grass_quads.emplace(m_allocator);
+		m_grass_quads_frame.push(0xffFFffFF);
+	}
 	return m_grass_quads[view];
 }
 
 
-void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& terrain_tr, const Vec2& quad_pos)
+// quads are generated in parallel, so they can not share the global random generator
+struct GrassRandom
+{
+	explicit GrassRandom(u32 seed) : state(seed ? seed : 1) {}
+
+	float next(float from, float to)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return from + (to - from) * ((state >> 8) * (1.f / 16777216.f));
+	}
+
+	u32 state;
+};
+
+
+void Terrain::generateGrassTypeQuad(GrassPatch& patch, const Vec2& quad_pos)
 {
 	if (m_splatmap->data.empty()) return;
 
@@ -235,7 +389,7 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 
 	struct { float x, y; void* type; } hashed_patch = { quad_pos.x, quad_pos.y, patch.m_type };
 	const u32 hash = crc32(&hashed_patch, sizeof(hashed_patch));
-	seedRandom(hash);
+	GrassRandom random(hash);
 	const int max_idx = splat_map->width * splat_map->height;
 
 	const Vec2 step = quad_size * (1 / (float)patch.m_type->m_density);
@@ -256,8 +410,8 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 			const int ground_mask = (pixel_value >> 16) & 0xffff;
 			if ((ground_mask & (1 << patch.m_type->m_idx)) == 0) continue;
 
-			const float x = (quad_pos.x + dx + step.x * randFloat(-0.5f, 0.5f)) * m_scale.x;
-			const float z = (quad_pos.y + dy + step.y * randFloat(-0.5f, 0.5f)) * m_scale.z;
+			const float x = (quad_pos.x + dx + step.x * random.next(-0.5f, 0.5f)) * m_scale.x;
+			const float z = (quad_pos.y + dy + step.y * random.next(-0.5f, 0.5f)) * m_scale.z;
 			const Vec3 instance_rel_pos(x, getHeight(x, z), z);
 			Quat instance_rel_rot;
 			
@@ -265,20 +419,20 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 			{
 				case GrassType::RotationMode::Y_UP:
 				{
-					instance_rel_rot = Quat(Vec3(0, 1, 0), randFloat(0, PI * 2));
+					instance_rel_rot = Quat(Vec3(0, 1, 0), random.next(0, PI * 2));
 				}
 				break;
 				case GrassType::RotationMode::ALL_RANDOM:
 				{
-					const Vec3 random_axis(randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1));
-					const float random_angle = randFloat(0, PI * 2);
+					const Vec3 random_axis(random.next(-1, 1), random.next(-1, 1), random.next(-1, 1));
+					const float random_angle = random.next(0, PI * 2);
 					instance_rel_rot = Quat(random_axis.normalized(), random_angle);
 				}
 				break;
 				case GrassType::RotationMode::ALIGN_WITH_NORMAL:
 				{
 					const Vec3 normal = getNormal(x, z);
-					const Quat random_base(Vec3(0, 1, 0), randFloat(0, PI * 2));
+					const Quat random_base(Vec3(0, 1, 0), random.next(0, PI * 2));
 					const Quat to_normal = Quat::vec3ToVec3({0, 1, 0}, normal);
 					instance_rel_rot = to_normal * random_base;
 				}
@@ -287,7 +441,7 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 			}
 
 			GrassPatch::InstanceData& instance_data = patch.instance_data.emplace();
-			instance_data.pos_scale.set(instance_rel_pos, randFloat(0.9f, 1.1f));
+			instance_data.pos_scale.set(instance_rel_pos, random.next(0.9f, 1.1f));
 			instance_data.rot = instance_rel_rot;
 			instance_data.normal = Vec4(getNormal(x, z), 0);
 		}
@@ -295,91 +449,136 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 }
 
 
-void Terrain::updateGrass(int view, const DVec3& camera_pos)
+void Terrain::generateGrassQuad(GrassQuad& quad)
 {
 	PROFILE_FUNCTION();
-	if (!m_splatmap) return;
+	float min_y = FLT_MAX;
+	float max_y = -FLT_MAX;
+	for (GrassPatch& patch : quad.m_patches)
+	{
+		generateGrassTypeQuad(patch, {quad.pos.x / m_scale.x, quad.pos.z / m_scale.z});
+		for (auto instance_data : patch.instance_data)
+		{
+			min_y = minimum(instance_data.pos_scale.y, min_y);
+			max_y = maximum(instance_data.pos_scale.y, max_y);
+		}
+	}
 
-	Universe& universe = m_scene.getUniverse();
+	quad.pos.y = (max_y + min_y) * 0.5f;
+	quad.radius = maximum((max_y - min_y) * 0.5f, GRASS_QUAD_SIZE) * SQRT2;
+}
 
-	while (m_last_camera_position.size() <= view) m_last_camera_position.push({ DBL_MAX, DBL_MAX, DBL_MAX });
 
-	if ((m_last_camera_position[view] - camera_pos).length() <= FLT_MIN && !m_force_grass_update) return;
-	m_last_camera_position[view] = camera_pos;
+void Terrain::evictGrassQuads(int used_count)
+{
+	const u32 max_size = maximum(GRASS_CACHE_SIZE, u32(used_count) * 2);
+	if (m_grass_cache.size() <= max_size) return;
+
+	PROFILE_FUNCTION();
+	Array<u32> frames(m_allocator);
+	for (GrassQuad* quad : m_grass_cache)
+	{
+		if (quad->is_ready && quad->last_used_frame != m_grass_frame) frames.push(quad->last_used_frame);
+	}
+	const u32 excess = m_grass_cache.size() - max_size;
+	if (frames.empty()) return;
+
+	qsort(frames.begin(), frames.size(), sizeof(frames[0]), [](const void* a, const void* b) -> int {
+		const u32 fa = *(const u32*)a;
+		const u32 fb = *(const u32*)b;
+		return fa < fb ? -1 : (fa > fb ? 1 : 0);
+	});
+	const u32 oldest_kept = frames[minimum(excess, (u32)frames.size()) - 1];
+
+	m_grass_cache.eraseIf([&](GrassQuad* quad){
+		if (!quad->is_ready || quad->last_used_frame == m_grass_frame || quad->last_used_frame > oldest_kept) return false;
+		m_grass_retired.push(quad);
+		m_grass_retired_frame = m_grass_frame;
+		return true;
+	});
+}
+
+
+// does not block - quads are generated in jobs and show up in m_grass_quads once they are ready;
+// called from render jobs' setup, only the first call for a view in a frame updates its quads,
+// i.e. the first pipeline rendering grass in a frame decides the camera position
+void Terrain::updateGrass(int view, const DVec3& camera_pos)
+{
+	PROFILE_FUNCTION();
+	if (!m_splatmap || !m_heightmap) return;
+
+	MT::CriticalSectionLock lock(m_grass_mutex);
+	Array<GrassQuad*>& quads = getQuads(view);
+	const u32 frame = m_renderer.getFrameNumber();
+	// render jobs of this frame can be reading the quads already
+	if (m_grass_quads_frame[view] == frame) return;
+	m_grass_quads_frame[view] = frame;
+	m_grass_frame = frame;
 
-	m_force_grass_update = false;
+	Universe& universe = m_scene.getUniverse();
 	const RigidTransform terrain_tr = universe.getTransform(m_entity).getRigidPart();
 	const Vec3 local_camera_pos = terrain_tr.rot.conjugated() * (camera_pos - terrain_tr.pos).toFloat();
-	float cx = (int)(local_camera_pos.x / (GRASS_QUAD_SIZE)) * GRASS_QUAD_SIZE;
-	float cz = (int)(local_camera_pos.z / (GRASS_QUAD_SIZE)) * GRASS_QUAD_SIZE;
+	const int cx = (int)(local_camera_pos.x / GRASS_QUAD_SIZE);
+	const int cz = (int)(local_camera_pos.z / GRASS_QUAD_SIZE);
 	int grass_distance = 0;
 	for (auto& type : m_grass_types)
 	{
 		grass_distance = maximum(grass_distance, int(type.m_distance / GRASS_QUAD_RADIUS + 0.99f));
 	}
 
-	float from_quad_x = cx - grass_distance * GRASS_QUAD_SIZE;
-	float from_quad_z = cz - grass_distance * GRASS_QUAD_SIZE;
-	float to_quad_x = cx + grass_distance * GRASS_QUAD_SIZE;
-	float to_quad_z = cz + grass_distance * GRASS_QUAD_SIZE;
-
-	float old_bounds[4] = {FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX};
-	Array<GrassQuad*>& quads = getQuads(view);
-	for (int i = quads.size() - 1; i >= 0; --i)
-	{
-		GrassQuad* quad = quads[i];
-		old_bounds[0] = minimum(old_bounds[0], quad->pos.x);
-		old_bounds[1] = maximum(old_bounds[1], quad->pos.x);
-		old_bounds[2] = minimum(old_bounds[2], quad->pos.z);
-		old_bounds[3] = maximum(old_bounds[3], quad->pos.z);
-		if (quad->pos.x < from_quad_x || quad->pos.x > to_quad_x || quad->pos.z < from_quad_z ||
-			quad->pos.z > to_quad_z)
-		{
-			LUMIX_DELETE(m_allocator, quads[i]);
-			quads.eraseFast(i);
-		}
-	}
-
-	from_quad_x = maximum(0.0f, from_quad_x);
-	from_quad_z = maximum(0.0f, from_quad_z);
-
-	for (float quad_z = from_quad_z; quad_z <= to_quad_z; quad_z += GRASS_QUAD_SIZE)
+	const int prefetch_distance = grass_distance + GRASS_PREFETCH_RINGS;
+	const int max_x = int(m_width * m_scale.x / GRASS_QUAD_SIZE);
+	const int max_z = int(m_height * m_scale.z / GRASS_QUAD_SIZE);
+	quads.clear();
+	int used_count = 0;
+	for (int z = maximum(0, cz - prefetch_distance); z <= minimum(max_z, cz + prefetch_distance); ++z)
 	{
-		for (float quad_x = from_quad_x; quad_x <= to_quad_x; quad_x += GRASS_QUAD_SIZE)
+		for (int x = maximum(0, cx - prefetch_distance); x <= minimum(max_x, cx + prefetch_distance); ++x)
 		{
-			if (quad_x >= old_bounds[0] && quad_x <= old_bounds[1] && quad_z >= old_bounds[2] &&
-				quad_z <= old_bounds[3])
+			const u64 key = u64(u32(x)) | (u64(u32(z)) << 32);
+			auto iter = m_grass_cache.find(key);
+			GrassQuad* quad;
+			if (iter.isValid())
+			{
+				quad = iter.value();
+			}
+			else if (m_grass_jobs_blocked > 0)
+			{
 				continue;
-
-			PROFILE_BLOCK("generate quad");
-			GrassQuad* quad = LUMIX_NEW(m_allocator, GrassQuad)(m_allocator);
-			quads.push(quad);
-			quad->pos.x = quad_x;
-			quad->pos.z = quad_z;
-			quad->m_patches.reserve(m_grass_types.size());
-
-			float min_y = FLT_MAX;
-			float max_y = -FLT_MAX;
-			for (auto& grass_type : m_grass_types)
+			}
+			else
 			{
-				Model* model = grass_type.m_grass_model;
-				if (!model || !model->isReady()) continue;
-				GrassPatch& patch = quad->m_patches.emplace(m_allocator);
-				patch.m_type = &grass_type;
-
-				generateGrassTypeQuad(patch, terrain_tr, {quad_x / m_scale.x, quad_z / m_scale.z});
-				for (auto instance_data : patch.instance_data)
+				quad = LUMIX_NEW(m_allocator, GrassQuad)(m_allocator);
+				quad->pos = Vec3(x * GRASS_QUAD_SIZE, 0, z * GRASS_QUAD_SIZE);
+				quad->radius = 0;
+				quad->terrain = this;
+				quad->is_ready = 0;
+				quad->m_patches.reserve(m_grass_types.size());
+				for (auto& grass_type : m_grass_types)
 				{
-					min_y = minimum(instance_data.pos_scale.y, min_y);
-					max_y = maximum(instance_data.pos_scale.y, max_y);
+					Model* model = grass_type.m_grass_model;
+					if (!model || !model->isReady()) continue;
+					GrassPatch& patch = quad->m_patches.emplace(m_allocator);
+					patch.m_type = &grass_type;
 				}
-			}
+				m_grass_cache.insert(key, quad);
 
-			quad->pos.y = (max_y + min_y) * 0.5f;
-			quad->radius = maximum((max_y - min_y) * 0.5f, GRASS_QUAD_SIZE) * SQRT2;
+				JobSystem::run(quad, [](void* data){
+					GrassQuad* quad = (GrassQuad*)data;
+					quad->terrain->generateGrassQuad(*quad);
+					MT::atomicIncrement(&quad->is_ready);
+				}, &m_grass_jobs);
+			}
 
+			quad->last_used_frame = m_grass_frame;
+			++used_count;
+			const bool is_visible = abs(x - cx) <= grass_distance && abs(z - cz) <= grass_distance;
+			if (is_visible && quad->is_ready) quads.push(quad);
 		}
 	}
+
+	evictGrassQuads(used_count);
+	deleteRetiredGrassQuads();
 }
 
 
@@ -392,6 +591,7 @@ void Terrain::grassLoaded(Resource::State, Resource::State, Resource&)
 void Terrain::setMaterial(Material* material)
 {
 	if (material != m_material) {
+		forceGrassUpdate();
 		if (m_material) {
 			m_material->getResourceManager().unload(*m_material);
 			m_material->getObserverCb().unbind<Terrain, &Terrain::onMaterialLoaded>(this);
@@ -537,6 +737,151 @@ float Terrain::getHeight(float x, float z) const
 }
 	
 
+namespace
+{
+
+
+// direct heightmap access for batched queries, invariants are computed once per batch
+struct HeightSampler
+{
+	HeightSampler(const Texture& heightmap, int width, int height, const Vec3& scale)
+		: data((const u16*)heightmap.getData())
+		, width(width)
+		, height(height)
+		, cell_size(scale.x)
+		, inv_cell_size(1.0f / scale.x)
+		, height_scale(scale.y / 65535.0f)
+	{}
+
+	LUMIX_FORCE_INLINE float texel(int x, int z) const
+	{
+		return height_scale * data[clamp(x, 0, width - 1) + clamp(z, 0, height - 1) * width];
+	}
+
+	// same as Terrain::getHeight(float, float)
+	LUMIX_FORCE_INLINE float getHeight(float x, float z) const
+	{
+		const int int_x = (int)(x * inv_cell_size);
+		const int int_z = (int)(z * inv_cell_size);
+		const float dec_x = (x - (int_x * cell_size)) * inv_cell_size;
+		const float dec_z = (z - (int_z * cell_size)) * inv_cell_size;
+		const float h0 = texel(int_x, int_z);
+		if (dec_x > dec_z) {
+			const float h1 = texel(int_x + 1, int_z);
+			const float h2 = texel(int_x + 1, int_z + 1);
+			return h0 + (h1 - h0) * dec_x + (h2 - h1) * dec_z;
+		}
+		const float h1 = texel(int_x + 1, int_z + 1);
+		const float h2 = texel(int_x, int_z + 1);
+		return h0 + (h2 - h0) * dec_z + (h1 - h2) * dec_x;
+	}
+
+	// same as Terrain::getNormal
+	LUMIX_FORCE_INLINE Vec3 getNormal(float x, float z) const
+	{
+		const int int_x = (int)(x * inv_cell_size);
+		const int int_z = (int)(z * inv_cell_size);
+		const float dec_x = (x - (int_x * cell_size)) * inv_cell_size;
+		const float dec_z = (z - (int_z * cell_size)) * inv_cell_size;
+		const float h0 = texel(int_x, int_z);
+		if (dec_x > dec_z) {
+			const float h1 = texel(int_x + 1, int_z);
+			const float h2 = texel(int_x + 1, int_z + 1);
+			return crossProduct(Vec3(cell_size, h2 - h0, cell_size), Vec3(cell_size, h1 - h0, 0)).normalized();
+		}
+		const float h1 = texel(int_x + 1, int_z + 1);
+		const float h2 = texel(int_x, int_z + 1);
+		return crossProduct(Vec3(0, h2 - h0, cell_size), Vec3(cell_size, h1 - h0, cell_size)).normalized();
+	}
+
+	const u16* data;
+	int width;
+	int height;
+	float cell_size;
+	float inv_cell_size;
+	float height_scale;
+};
+
+
+} // anonymous namespace
+
+
+// calls f(sample_index) for all samples, grouped by heightmap blocks of 2^BATCH_BLOCK_SHIFT cells,
+// so texels of each block are read while they are in cache, instead of jumping around the heightmap
+template <typename F>
+void Terrain::forEachSampleByBlock(Span<const Vec2> xz, F&& f) const
+{
+	enum { BATCH_BLOCK_SHIFT = 5 };
+
+	const u32 count = xz.length();
+	const int blocks_w = ((m_width - 1) >> BATCH_BLOCK_SHIFT) + 1;
+	const int blocks_h = ((m_height - 1) >> BATCH_BLOCK_SHIFT) + 1;
+	if (count < 64 || blocks_w * blocks_h == 1) {
+		for (u32 i = 0; i < count; ++i) f(i);
+		return;
+	}
+
+	const float inv_block_size = 1.0f / (m_scale.x * (1 << BATCH_BLOCK_SHIFT));
+	Array<u32> block_of(m_allocator);
+	Array<u32> offsets(m_allocator);
+	Array<u32> order(m_allocator);
+	block_of.resize(count);
+	offsets.resize(blocks_w * blocks_h + 1);
+	order.resize(count);
+	for (u32& offset : offsets) offset = 0;
+
+	// counting sort by block
+	for (u32 i = 0; i < count; ++i) {
+		const Vec2 p = xz.begin()[i];
+		const int bx = clamp((int)(p.x * inv_block_size), 0, blocks_w - 1);
+		const int bz = clamp((int)(p.y * inv_block_size), 0, blocks_h - 1);
+		block_of[i] = bx + bz * blocks_w;
+		++offsets[block_of[i] + 1];
+	}
+	for (int i = 1; i < offsets.size(); ++i) offsets[i] += offsets[i - 1];
+	for (u32 i = 0; i < count; ++i) {
+		order[offsets[block_of[i]]++] = i;
+	}
+	for (u32 i : order) f(i);
+}
+
+
+void Terrain::getHeights(Span<const Vec2> xz, Span<float> heights) const
+{
+	PROFILE_FUNCTION();
+	ASSERT(xz.length() == heights.length());
+	if (!m_heightmap || !m_heightmap->getData()) {
+		for (u32 i = 0, c = heights.length(); i < c; ++i) heights[i] = 0;
+		return;
+	}
+	ASSERT(m_heightmap->bytes_per_pixel == 2);
+
+	const HeightSampler sampler(*m_heightmap, m_width, m_height, m_scale);
+	forEachSampleByBlock(xz, [&](u32 i){
+		const Vec2 p = xz.begin()[i];
+		heights[i] = sampler.getHeight(p.x, p.y);
+	});
+}
+
+
+void Terrain::getNormals(Span<const Vec2> xz, Span<Vec3> normals)
+{
+	PROFILE_FUNCTION();
+	ASSERT(xz.length() == normals.length());
+	if (!m_heightmap || !m_heightmap->getData()) {
+		for (u32 i = 0, c = normals.length(); i < c; ++i) normals[i] = Vec3(0, 1, 0);
+		return;
+	}
+	ASSERT(m_heightmap->bytes_per_pixel == 2);
+
+	const HeightSampler sampler(*m_heightmap, m_width, m_height, m_scale);
+	forEachSampleByBlock(xz, [&](u32 i){
+		const Vec2 p = xz.begin()[i];
+		normals[i] = sampler.getNormal(p.x, p.y);
+	});
+}
+
+
 float Terrain::getHeight(int x, int z) const
 {
 	const float DIV64K = 1.0f / 65535.0f;
@@ -544,23 +889,23 @@ float Terrain::getHeight(int x, int z) const
 
 	Texture* t = m_heightmap;
 	ASSERT(t->bytes_per_pixel == 2);
-	int idx = clamp(x, 0, m_width) + clamp(z, 0, m_height) * m_width;
+	int idx = clamp(x, 0, m_width - 1) + clamp(z, 0, m_height - 1) * m_width;
 	return m_scale.y * DIV64K * ((u16*)t->getData())[idx];
 }
 
 
 void Terrain::setXZScale(float scale) 
 {
+	forceGrassUpdate();
 	m_scale.x = scale;
 	m_scale.z = scale;
-	forceGrassUpdate();
 }
 
 
 void Terrain::setYScale(float scale)
 {
-	m_scale.y = scale;
 	forceGrassUpdate();
+	m_scale.y = scale;
 }
 
 
@@ -570,8 +915,26 @@ void Terrain::setHeight(int x, int z, float h)
 
 	Texture* t = m_heightmap;
 	ASSERT(t->bytes_per_pixel == 2);
-	int idx = clamp(x, 0, m_width) + clamp(z, 0, m_height) * m_width;
-	((u16*)t->getData())[idx] = (u16)(h * (65535.0f / m_scale.y));
+	x = clamp(x, 0, m_width - 1);
+	z = clamp(z, 0, m_height - 1);
+	((u16*)t->getData())[x + z * m_width] = (u16)(h * (65535.0f / m_scale.y));
+	updateHeightTree(x, z, x + 1, z + 1);
+}
+
+
+static bool getRayAABBDistance(const Vec3& origin, const Vec3& inv_dir, const Vec3& min, const Vec3& max, float* t)
+{
+	const float t1 = (min.x - origin.x) * inv_dir.x;
+	const float t2 = (max.x - origin.x) * inv_dir.x;
+	const float t3 = (min.y - origin.y) * inv_dir.y;
+	const float t4 = (max.y - origin.y) * inv_dir.y;
+	const float t5 = (min.z - origin.z) * inv_dir.z;
+	const float t6 = (max.z - origin.z) * inv_dir.z;
+
+	const float tmin = maximum(minimum(t1, t2), minimum(t3, t4), minimum(t5, t6), 0.f);
+	const float tmax = minimum(maximum(t1, t2), maximum(t3, t4), maximum(t5, t6));
+	*t = tmin;
+	return tmin <= tmax;
 }
 
 
@@ -579,64 +942,84 @@ RayCastModelHit Terrain::castRay(const DVec3& origin, const Vec3& dir)
 {
 	RayCastModelHit hit;
 	hit.is_hit = false;
-	if (!m_heightmap || !m_heightmap->isReady()) return hit;
+	if (!m_heightmap || !m_heightmap->isReady() || m_height_tree.empty()) return hit;
 
 	const Universe& universe = m_scene.getUniverse();
-	const Quat rot = universe.getRotation(m_entity);
+	const Quat inv_rot = universe.getRotation(m_entity).conjugated();
 	const DVec3 pos = universe.getPosition(m_entity);
-	const Vec3 rel_dir = rot.rotate(dir);
-	const Vec3 terrain_to_ray = (origin - pos).toFloat();
-	const Vec3 rel_origin = rot.conjugated().rotate(terrain_to_ray);
-
-	Vec3 start;
-	const Vec3 size(m_width * m_scale.x, m_scale.y * 65535.0f, m_height * m_scale.x);
-	if (!getRayAABBIntersection(rel_origin, rel_dir, Vec3::ZERO, size, start)) return hit;
-
-	int hx = (int)(start.x / m_scale.x);
-	int hz = (int)(start.z / m_scale.x);
-
-	float next_x = fabs(rel_dir.x) < 0.01f ? hx : ((hx + (rel_dir.x < 0 ? 0 : 1)) * m_scale.x - rel_origin.x) / rel_dir.x;
-	float next_z = fabs(rel_dir.z) < 0.01f ? hz : ((hz + (rel_dir.z < 0 ? 0 : 1)) * m_scale.x - rel_origin.z) / rel_dir.z;
-
-	float delta_x = fabs(rel_dir.x) < 0.01f ? 0 : m_scale.x / abs(rel_dir.x);
-	float delta_z = fabs(rel_dir.z) < 0.01f ? 0 : m_scale.x / abs(rel_dir.z);
-	int step_x = (int)signum(rel_dir.x);
-	int step_z = (int)signum(rel_dir.z);
-
-	while (hx >= 0 && hz >= 0 && hx + step_x < m_width && hz + step_z < m_height) {
+	const Vec3 rel_dir = inv_rot.rotate(dir);
+	const Vec3 rel_origin = inv_rot.rotate((origin - pos).toFloat());
+	const Vec3 inv_dir(
+		1.0f / (rel_dir.x == 0 ? 0.00000001f : rel_dir.x),
+		1.0f / (rel_dir.y == 0 ? 0.00000001f : rel_dir.y),
+		1.0f / (rel_dir.z == 0 ? 0.00000001f : rel_dir.z));
+
+	// walk the min/max tree front to back, skipping nodes whose bounds the ray misses
+	struct Node { int level, x, z; };
+	Node stack[128];
+	int stack_size = 0;
+	stack[stack_size++] = { m_height_tree.size() - 1, 0, 0 };
+	const float cell_size = m_scale.x;
+	const float height_scale = m_scale.y / 65535.0f;
+	const int near_x = rel_dir.x < 0 ? 1 : 0;
+	const int near_z = rel_dir.z < 0 ? 1 : 0;
+	float best_t = FLT_MAX;
+
+	while (stack_size > 0)
+	{
+		const Node node = stack[--stack_size];
+		const HeightTreeLevel& level = m_height_tree[node.level];
+		const HeightRange& range = level.ranges[node.x + node.z * level.width];
+		const HeightTreeLevel& base = m_height_tree[0];
+		const Vec3 min(
+			(node.x << node.level) * cell_size,
+			range.min * height_scale,
+			(node.z << node.level) * cell_size);
+		const Vec3 max(
+			minimum((node.x + 1) << node.level, base.width) * cell_size,
+			range.max * height_scale,
+			minimum((node.z + 1) << node.level, base.height) * cell_size);
 		float t;
-		float x = hx * m_scale.x;
-		float z = hz * m_scale.x;
-		Vec3 p0(x, getHeight(x, z), z);
-		Vec3 p1(x + m_scale.x, getHeight(x + m_scale.x, z), z);
-		Vec3 p2(x + m_scale.x, getHeight(x + m_scale.x, z + m_scale.x), z + m_scale.x);
-		Vec3 p3(x, getHeight(x, z + m_scale.x), z + m_scale.x);
-		if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p1, p2, &t)) {
-			hit.is_hit = true;
-			hit.origin = origin;
-			hit.dir = dir;
-			hit.t = t;
-			return hit;
-		}
-		if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p2, p3, &t)) {
-			hit.is_hit = true;
-			hit.origin = origin;
-			hit.dir = dir;
-			hit.t = t;
-			return hit;
-		}
-		if (next_x < next_z && step_x != 0) {
-			next_x += delta_x;
-			hx += step_x;
-		}
-		else {
-			next_z += delta_z;
-			hz += step_z;
+		if (!getRayAABBDistance(rel_origin, inv_dir, min, max, &t) || t >= best_t) continue;
+
+		if (node.level == 0)
+		{
+			const float x = node.x * cell_size;
+			const float z = node.z * cell_size;
+			const Vec3 p0(x, getHeight(node.x, node.z), z);
+			const Vec3 p1(x + cell_size, getHeight(node.x + 1, node.z), z);
+			const Vec3 p2(x + cell_size, getHeight(node.x + 1, node.z + 1), z + cell_size);
+			const Vec3 p3(x, getHeight(node.x, node.z + 1), z + cell_size);
+			if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p1, p2, &t) && t < best_t) best_t = t;
+			if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p2, p3, &t) && t < best_t) best_t = t;
+			continue;
 		}
-		if (delta_x == 0 && delta_z == 0) {
-			return hit;
+
+		// push the farthest child first, so the nearest one is processed first
+		const HeightTreeLevel& child_level = m_height_tree[node.level - 1];
+		const int order[4][2] = {
+			{ 1 - near_x, 1 - near_z },
+			{ near_x, 1 - near_z },
+			{ 1 - near_x, near_z },
+			{ near_x, near_z }
+		};
+		for (const auto& o : order)
+		{
+			const int cx = node.x * 2 + o[0];
+			const int cz = node.z * 2 + o[1];
+			if (cx >= child_level.width || cz >= child_level.height) continue;
+			ASSERT(stack_size < lengthOf(stack));
+			stack[stack_size++] = { node.level - 1, cx, cz };
 		}
 	}
+
+	if (best_t < FLT_MAX)
+	{
+		hit.is_hit = true;
+		hit.origin = origin;
+		hit.dir = dir;
+		hit.t = best_t;
+	}
 	return hit;
 }
 
@@ -644,6 +1027,7 @@ RayCastModelHit Terrain::castRay(const DVec3& origin, const Vec3& dir)
 void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state, Resource&)
 {
 	PROFILE_FUNCTION();
+	forceGrassUpdate();
 	if (new_state == Resource::State::READY)
 	{
 		m_heightmap = m_material->getTextureByName("Heightmap");
@@ -658,6 +1042,7 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state, Resou
 			m_width = m_heightmap->width;
 			m_height = m_heightmap->height;
 		}
+		buildHeightTree();
 
 		m_albedomap = m_material->getTextureByName("Albedo");
 		m_splatmap = m_material->getTextureByName("Splatmap");
@@ -687,6 +1072,7 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state, Resou
 	}
 	else
 	{
+		m_height_tree.clear();
 		//LUMIX_DELETE(m_allocator, m_root);
 		//m_root = nullptr;
 	}
@@ -2,7 +2,11 @@
 
 
 #include "engine/array.h"
+#include "engine/hash_map.h"
 #include "engine/math.h"
+#include "engine/mt/atomic.h"
+#include "engine/mt/sync.h"
+#include "engine/job_system.h"
 #include "engine/resource.h"
 #include "ffr/ffr.h"
 
@@ -78,6 +82,26 @@ class Terrain
 			Array<GrassPatch> m_patches;
 			Vec3 pos;
 			float radius;
+			Terrain* terrain;
+			u32 last_used_frame;
+			volatile i32 is_ready;
+		};
+
+		struct HeightRange
+		{
+			u16 min;
+			u16 max;
+		};
+
+		struct HeightTreeLevel
+		{
+			explicit HeightTreeLevel(IAllocator& allocator)
+				: ranges(allocator)
+			{}
+
+			Array<HeightRange> ranges;
+			int width;
+			int height;
 		};
 
 	public:
@@ -92,6 +116,8 @@ class Terrain
 		EntityRef getEntity() const { return m_entity; }
 		Vec3 getNormal(float x, float z);
 		float getHeight(float x, float z) const;
+		void getNormals(Span<const Vec2> xz, Span<Vec3> normals);
+		void getHeights(Span<const Vec2> xz, Span<float> heights) const;
 		float getXZScale() const { return m_scale.x; }
 		float getYScale() const { return m_scale.y; }
 		Path getGrassTypePath(int index);
@@ -107,6 +133,7 @@ class Terrain
 
 		float getHeight(int x, int z) const;
 		void setHeight(int x, int z, float height);
+		void onHeightmapChanged(int x, int z, int w, int h);
 		void setXZScale(float scale);
 		void setYScale(float scale);
 		void setGrassTypePath(int index, const Path& path);
@@ -125,10 +152,20 @@ class Terrain
 		void removeGrassType(int index);
 		void forceGrassUpdate();
 		void updateGrass(int view, const DVec3& position);
+		// grass is generated from heightmap and splatmap data in jobs, writes to the data must be between these
+		void beginDataUpdate();
+		void endDataUpdate();
 
 	private: 
 		Array<Terrain::GrassQuad*>& getQuads(int view);
-		void generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& terrain_tr, const Vec2& quad_pos_hm_space);
+		void buildHeightTree();
+		template <typename F> void forEachSampleByBlock(Span<const Vec2> xz, F&& f) const;
+		void updateHeightTree(int from_x, int from_z, int to_x, int to_z);
+		void generateGrassQuad(GrassQuad& quad);
+		void generateGrassTypeQuad(GrassPatch& patch, const Vec2& quad_pos_hm_space);
+		void evictGrassQuads(int used_count);
+		void retireGrassQuads();
+		void deleteRetiredGrassQuads();
 		void onMaterialLoaded(Resource::State, Resource::State new_state, Resource&);
 		void grassLoaded(Resource::State, Resource::State, Resource&);
 
@@ -145,9 +182,26 @@ class Terrain
 		Texture* m_albedomap;
 		RenderScene& m_scene;
 		Array<GrassType> m_grass_types;
+		// quads ready to be rendered in each view, built by the first updateGrass of the view in a frame
+		// and not changed until the next frame, so render jobs can read them without a lock
 		Array<Array<GrassQuad*> > m_grass_quads;
-		Array<DVec3> m_last_camera_position;
-		bool m_force_grass_update;
+		// renderer frame number in which m_grass_quads of each view were built
+		Array<u32> m_grass_quads_frame;
+		// generated quads of all views, keyed by quad coordinates, least recently used are evicted
+		HashMap<u64, GrassQuad*> m_grass_cache;
+		// quads removed from the cache, they can still be in m_grass_quads of this frame, so they
+		// are deleted in a later frame
+		Array<GrassQuad*> m_grass_retired;
+		u32 m_grass_retired_frame;
+		JobSystem::SignalHandle m_grass_jobs;
+		// renderer frame number of the last grass update
+		u32 m_grass_frame;
+		MT::CriticalSection m_grass_mutex;
+		// > 0 between beginDataUpdate and endDataUpdate, no new quads are generated then
+		u32 m_grass_jobs_blocked;
+		// min/max of raw heightmap values, level 0 has one range per heightmap cell,
+		// every next level merges 2x2 ranges of the previous one, the last level is a single range
+		Array<HeightTreeLevel> m_height_tree;
 		Renderer& m_renderer;
 };
 